@@ -63,6 +63,8 @@ extern "C" {
 #define CIAA_MODBUS_E_WRONG_STR_ADDR               0x02
 #define CIAA_MODBUS_E_WRONG_REG_QTY                0x03
 #define CIAA_MODBUS_E_FNC_ERROR                    0x04
+#define CIAA_MODBUS_E_GW_PATH_UNAVAILABLE          0x0A
+#define CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND        0x0B
 
 #define CIAA_MODBUS_E_SLAVE_NOT_RESPOND            0X10
 #define CIAA_MODBUS_E_PDU_RECEIVED_WRONG           0X11
@@ -77,6 +79,7 @@ extern "C" {
 #define CIAA_MODBUS_FCN_WRITE_SINGLE_REGISTER            0x06
 #define CIAA_MODBUS_FCN_WRITE_MULTIPLE_COILS             0x0F
 #define CIAA_MODBUS_FCN_WRITE_MULTIPLE_REGISTERS         0x10
+#define CIAA_MODBUS_FCN_MASK_WRITE_REGISTER              0x16
 #define CIAA_MODBUS_FCN_READ_WRITE_MULTIPLE_REGISTERS    0x17
 
 #define CIAA_MODBUS_SLAVE_MIN_ID_VALUE             1
@@ -188,7 +191,9 @@ typedef void (*modbusMaster_cbEndOfCommType)(
 
 /** \brief Modbus Transport types */
 #if ( (CIAA_MODBUS_TOTAL_TRANSPORT_ASCII + CIAA_MODBUS_TOTAL_TRANSPORT_RTU + \
-       CIAA_MODBUS_TOTAL_TRANSPORT_TCP ) > 0 )
+       CIAA_MODBUS_TOTAL_TRANSPORT_TCP + CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK + \
+       CIAA_MODBUS_TOTAL_TRANSPORT_SHM + CIAA_MODBUS_TOTAL_TRANSPORT_AUTO + \
+       CIAA_MODBUS_TOTAL_TRANSPORT_USER ) > 0 )
 
 typedef enum
 {
@@ -198,8 +203,86 @@ typedef enum
    CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE,
    CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER,
    CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE,
+   CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER,
+   CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE,
+   CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER,
+   CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE,
+   CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE,  /** <- slave detecting ASCII or RTU */
+   CIAAMODBUS_TRANSPORT_MODE_USER,        /** <- first mode registered with
+                                               ciaaModbus_transportRegister */
 }ciaaModbus_transportModeEnum;
 
+/** \brief Trasnsport type Master */
+#define CIAAMODBUS_TRANSPORT_TYPE_MASTER        1
+
+/** \brief Trasnsport type Salve */
+#define CIAAMODBUS_TRANSPORT_TYPE_SLAVE         0
+
+/** \brief Trasnsport type Invalid */
+#define CIAAMODBUS_TRANSPORT_TYPE_INVALID       -1
+
+/** \brief Operations of a Modbus Transport
+ **
+ ** Each transport instance is bound to the operations of its mode when it
+ ** is opened. The handler passed to task, recvMsg and sendMsg is the one
+ ** returned by open.
+ **/
+typedef struct
+{
+   int32_t (*open)(int32_t fildes);    /** <- open, return handler or -1.
+                                              NULL if opened otherwise */
+   void (*task)(int32_t handler);      /** <- perform task */
+   void (*recvMsg)(int32_t handler, uint8_t *id, uint8_t *pdu, uint32_t *size);
+                                       /** <- receive message */
+   void (*sendMsg)(int32_t handler, uint8_t id, uint8_t *pdu, uint32_t size);
+                                       /** <- send message */
+   bool (*txReady)(int32_t handler);   /** <- true if a message can be sent
+                                              without discarding it. NULL if
+                                              always true */
+   int8_t type;                        /** <- CIAAMODBUS_TRANSPORT_TYPE_MASTER
+                                              or CIAAMODBUS_TRANSPORT_TYPE_SLAVE */
+   bool (*pending)(int32_t handler);   /** <- true if task or recvMsg have
+                                              work: data pending, a message
+                                              received or to write, or a
+                                              timer running. NULL if always
+                                              true */
+}ciaaModbus_transportOpsType;
+
+/** \brief Serial parity none */
+#define CIAAMODBUS_SERIAL_PARITY_NONE           0
+
+/** \brief Serial parity even */
+#define CIAAMODBUS_SERIAL_PARITY_EVEN           1
+
+/** \brief Serial parity odd */
+#define CIAAMODBUS_SERIAL_PARITY_ODD            2
+
+/** \brief Configuration of a serial line
+ **
+ ** vmin and vtime are the termios read parameters of the host build, 0
+ ** and 0 for the non blocking reads performed by the transports.
+ **
+ ** The transports read the port through a ciaaPOSIX file descriptor, which
+ ** is not a file descriptor of the host. On the host build termios is
+ ** applied to hostFd, the same port opened by the application with the
+ ** host open(). Without it, and on the target, only the baud rate is set
+ ** through ciaaPOSIX_ioctl() and the character format shall be the one of
+ ** the driver: 8 data bits, no parity and 1 stop bit.
+ **/
+typedef struct
+{
+   uint32_t baudRate;                  /** <- bits per second, up to 921600 */
+   uint8_t dataBits;                   /** <- 7 or 8 */
+   uint8_t parity;                     /** <- CIAAMODBUS_SERIAL_PARITY_xxx */
+   uint8_t stopBits;                   /** <- 1 or 2 */
+   uint8_t vmin;                       /** <- minimum bytes returned by read */
+   uint8_t vtime;                      /** <- read timeout (tenths of second) */
+   bool lowLatency;                    /** <- disable the buffering of the
+                                              driver if supported */
+   int32_t hostFd;                     /** <- file descriptor of the port in
+                                              the host, -1 if not known */
+}ciaaModbus_serialConfigType;
+
 #endif   /* end Modbus Transport types */
 
 /*==================[external data declaration]==============================*/
@@ -254,6 +337,20 @@ extern int8_t ciaaModbus_gatewayAddSlave(
       int32_t hModbusGW,
       int32_t hModbusSlave);
 
+/** \brief Remove slave from Modbus Gateway
+ **
+ ** Requests waiting the slave are dropped and its unit id is no longer
+ ** routed to it.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] hModbusSlave handler slave
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewayRemoveSlave(
+      int32_t hModbusGW,
+      int32_t hModbusSlave);
+
 /** \brief Add master to Modbus Gateway
  **
  ** \param[in] hModbusGW handler Modbus Gateway
@@ -276,6 +373,205 @@ extern int8_t ciaaModbus_gatewayAddTransport(
       int32_t hModbusGW,
       int32_t hModbusTransport);
 
+/** \brief Remove transport from Modbus Gateway
+ **
+ ** Requests in course from or to the transport are dropped. If a request
+ ** of the transport was sent, its server takes no other request until
+ ** the response is received and discarded or its timeout elapses.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] hModbusTransport handler Transport
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewayRemoveTransport(
+      int32_t hModbusGW,
+      int32_t hModbusTransport);
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+/** \brief Set time to live of reads cached by gateway
+ **
+ ** Responses to reads of holding and input registers (0x03, 0x04) of
+ ** the unit id are kept by the gateway, and the same reads received
+ ** within the time to live are answered without sending them to the
+ ** server. Writes of holding registers through the gateway (0x06, 0x10,
+ ** 0x16, 0x17) invalidate the entries of the registers written. The
+ ** time to live is measured with a monotonic clock on the host, and with
+ ** the calls to ciaaModbus_gatewayMainTask() on the target.
+ **
+ ** \param[in] hModbusGW handler Gateway
+ ** \param[in] id unit id
+ ** \param[in] ttl time to live (milliseconds), 0 to disable
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetCacheTtl(
+      int32_t hModbusGW,
+      uint8_t id,
+      uint32_t ttl);
+#endif
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+/** \brief Set batching window of reads merged by gateway
+ **
+ ** Reads of coils, discrete inputs, holding and input registers
+ ** (0x01 to 0x04) waiting the same server, with the same unit id and
+ ** function and adjacent or overlapping addresses, are merged in one
+ ** request of up to 125 registers or 2000 bits. The response is split
+ ** back to each client. A read waits the window for others to merge
+ ** before being sent.
+ **
+ ** \param[in] hModbusGW handler Gateway
+ ** \param[in] window batching window (milliseconds), 0 to disable
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetMergeWindow(
+      int32_t hModbusGW,
+      uint32_t window);
+#endif
+
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+#if CIAA_MODBUS_TOTAL_MASTERS > 0
+/** \brief Set priority of a master of Modbus Gateway
+ **
+ ** When several requests wait the same server, the one of highest
+ ** priority is sent first. The priority of a request is the highest of
+ ** its client and its function code.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] hModbusMaster handler Master added to gateway
+ ** \param[in] priority 0 (lowest, default) to 7 (highest)
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetMasterPriority(
+      int32_t hModbusGW,
+      int32_t hModbusMaster,
+      uint8_t priority);
+#endif
+
+/** \brief Set priority of a transport of Modbus Gateway
+ **
+ ** Same as ciaaModbus_gatewaySetMasterPriority for a transport slave
+ ** added to the gateway.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] hModbusTransport handler Transport added to gateway
+ ** \param[in] priority 0 (lowest, default) to 7 (highest)
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetTransportPriority(
+      int32_t hModbusGW,
+      int32_t hModbusTransport,
+      uint8_t priority);
+
+/** \brief Set priority of a function code in Modbus Gateway
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] function function code (1 to 127)
+ ** \param[in] priority 0 (lowest, default) to 7 (highest)
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetFunctionPriority(
+      int32_t hModbusGW,
+      uint8_t function,
+      uint8_t priority);
+
+/** \brief Set aging of requests waiting a server of Modbus Gateway
+ **
+ ** Each aging time a request waits a server its priority is raised one
+ ** level, so requests of low priority are not starved.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] aging aging time (milliseconds), 0 to disable
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetPriorityAging(
+      int32_t hModbusGW,
+      uint32_t aging);
+#endif
+
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+/** \brief Set quantum of deficit round robin of Modbus Gateway
+ **
+ ** Requests waiting the same server are sent by deficit round robin:
+ ** each round every client waiting is credited the quantum, and sends
+ ** its request once the credit covers the bytes of the request and of
+ ** its response. Clients share the link by bytes instead of by
+ ** requests. A quantum below the smallest request gives the finest
+ ** sharing.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] quantum bytes credited by round, 0 for arrival order
+ ** \return 0 if ok
+ **         -1 if error occurs
+ **/
+extern int8_t ciaaModbus_gatewaySetQuantum(
+      int32_t hModbusGW,
+      uint16_t quantum);
+#endif
+
+#if CIAA_MODBUS_GATEWAY_THREADS > 0
+/** \brief Run Modbus Gateway by its own thread
+ **
+ ** Only on the host build. The thread calls ciaaModbus_gatewayMainTask()
+ ** each time base and sleeps while the gateway is idle, so the
+ ** application shall not call it. Gateways run by different threads
+ ** exchange messages through loopback channels, e.g. a gateway with TCP
+ ** slaves sending to a loopback master, and another gateway of a serial
+ ** line receiving from the loopback slave. The gateway shall be set up
+ ** before started and not changed while running.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \param[in] cpu cpu to pin the thread, -1 if not pinned
+ ** \return 0 if ok
+ **         -1 if error occurs or not supported
+ **/
+extern int8_t ciaaModbus_gatewayStart(
+      int32_t hModbusGW,
+      int32_t cpu);
+
+/** \brief Stop thread of Modbus Gateway
+ **
+ ** Waits the thread to finish its main task.
+ **
+ ** \param[in] hModbusGW handler Modbus Gateway
+ ** \return 0 if ok
+ **         -1 if error occurs or not running
+ **/
+extern int8_t ciaaModbus_gatewayStop(
+      int32_t hModbusGW);
+#endif
+
+/** \brief Check if gateway is idle
+ **
+ ** The main task visits only the clients with a request in course or
+ ** whose transport has work. When no client has work, and on the
+ ** target no cached read is valid, the gateway is idle and the caller
+ ** may sleep until a port has data, for instance with
+ ** ciaaModbus_reactorWait(), instead of calling
+ ** ciaaModbus_gatewayMainTask each time base. Transports without
+ ** function pending, as the user ones registered without it, have always
+ ** work.
+ **
+ ** The transports do not raise their work: each call, and each main task,
+ ** asks the function pending of every client, so their cost grows with
+ ** the number of clients.
+ **
+ ** While the gateway is run by its own thread, the lock of the thread is
+ ** taken instead of resource MODBUSR, so it may be called from any
+ ** thread.
+ **
+ ** \param[in] hModbusGW handler Gateway
+ ** \return true if idle
+ **/
+extern bool ciaaModbus_gatewayIdle(
+      int32_t hModbusGW);
+
 /** \brief Execute task of gateway
  **
  ** \param[in] hModbusGW handler Gateway
@@ -287,15 +583,29 @@ extern void ciaaModbus_gatewayMainTask(
 
 /** \brief Modbus Transport interfaces */
 #if ( (CIAA_MODBUS_TOTAL_TRANSPORT_ASCII + CIAA_MODBUS_TOTAL_TRANSPORT_RTU + \
-       CIAA_MODBUS_TOTAL_TRANSPORT_TCP ) > 0 )
+       CIAA_MODBUS_TOTAL_TRANSPORT_TCP + CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK + \
+       CIAA_MODBUS_TOTAL_TRANSPORT_SHM + CIAA_MODBUS_TOTAL_TRANSPORT_AUTO + \
+       CIAA_MODBUS_TOTAL_TRANSPORT_USER ) > 0 )
 
 /** \brief Open Modbus Transport
  **
  ** This function initialize Modbus Transport with device indicate in fildes
  ** and selected mode. Also reserves the buffer for reception and
- ** transmission.
- **
- ** \param[in] fildes File Descriptor to write and read data
+ ** transmission. Mode CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER is opened with
+ ** ciaaModbus_transportOpenTcpMaster().
+ **
+ ** \param[in] fildes File Descriptor to write and read data. In mode
+ **            CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE it is a listening
+ **            socket and the connections accepted are served. In modes
+ **            CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER and
+ **            CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE it is the loopback
+ **            channel connecting both ends. In modes
+ **            CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER and
+ **            CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE it is a shared memory
+ **            object shared with a process of the same host. In mode
+ **            CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE it is a serial port
+ **            where ASCII or RTU is used as detected from the first valid
+ **            frame received.
  ** \param[in] mode mode may take one of the following values:
  **            CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER
  **            CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE
@@ -303,12 +613,73 @@ extern void ciaaModbus_gatewayMainTask(
  **            CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE
  **            CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER
  **            CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE
+ **            CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER
+ **            CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE
+ **            CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER
+ **            CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE
+ **            CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE
+ **            a mode returned by ciaaModbus_transportRegister()
  ** \return handler of Modbus Transport
  **/
 extern int32_t ciaaModbus_transportOpen(
       int32_t fildes,
       ciaaModbus_transportModeEnum mode);
 
+/** \brief Register a Modbus Transport mode
+ **
+ ** This function adds a transport mode implemented by the application
+ ** (e.g. a radio link). Transports of this mode are opened with
+ ** ciaaModbus_transportOpen() and take objects from
+ ** CIAA_MODBUS_TOTAL_TRANSPORT_USER.
+ **
+ ** \param[in] ops operations of the transport, must remain valid
+ ** \return mode to open the transport
+ **         -1 if error: operation open, task, recvMsg or sendMsg missing,
+ **         type neither master nor slave, or no mode available
+ **/
+extern int32_t ciaaModbus_transportRegister(
+      const ciaaModbus_transportOpsType *ops);
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0
+/** \brief Open Modbus TCP Master Transport
+ **
+ ** This function initialize a Modbus Transport in mode
+ ** CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER. The connection to the destination
+ ** is established when the first request is sent and kept open. While the
+ ** destination is reconnecting the requests fail with a gateway exception.
+ **
+ ** \param[in] address IPv4 address of destination (host byte order)
+ ** \param[in] port port of destination
+ ** \return handler of Modbus Transport
+ **/
+extern int32_t ciaaModbus_transportOpenTcpMaster(
+      uint32_t address,
+      uint16_t port);
+#endif
+
+/** \brief Open Modbus Transport on a configured serial line
+ **
+ ** Applies the line configuration to the serial port and opens a
+ ** transport as ciaaModbus_transportOpen(). The baud rate sets the silent
+ ** interval of RTU frames. The transport reads fildes, the line is
+ ** configured with termios through config->hostFd, if any, see
+ ** ciaaModbus_serialConfigType.
+ **
+ ** \param[in] fildes ciaaPOSIX File Descriptor of the serial port
+ ** \param[in] mode CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER
+ **            CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE
+ **            CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER
+ **            CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE
+ **            CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE
+ ** \param[in] config configuration of the line
+ ** \return handler of Modbus Transport
+ **         -1 if error or configuration not supported
+ **/
+extern int32_t ciaaModbus_transportOpenSerial(
+      int32_t fildes,
+      ciaaModbus_transportModeEnum mode,
+      ciaaModbus_serialConfigType const *config);
+
 #endif   /* end Modbus Transport interfaces */
 
 /** \brief Modbus Master interfaces */
@@ -46,6 +46,8 @@
 
 /*==================[inclusions]=============================================*/
 #include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaModbus_transport.h"
 
 /*==================[cplusplus]==============================================*/
 #ifdef __cplusplus
@@ -98,6 +100,18 @@ extern "C" {
 #define CIAAMODBUS_ASCII_END_2      0x0A
 
 /*==================[typedef]================================================*/
+/** \brief Modbus ASCII framer
+ **
+ ** Keeps the state of the framing of a modbus ascii byte stream. Shall be
+ ** accessed only by the ciaaModbus_asciiFramer functions.
+ **/
+typedef struct
+{
+   ciaaModbus_framerCbType cbFrame;             /** <- called for each frame */
+   void *param;                                 /** <- parameter of cbFrame */
+   int32_t size;                                /** <- bytes of current frame */
+   uint8_t buffer[CIAAMODBUS_ASCII_MAXLENGHT];  /** <- current frame */
+}ciaaModbus_asciiFramerType;
 
 /*==================[external data declaration]==============================*/
 
@@ -158,7 +172,74 @@ void ciaaModbus_asciiSendMsg(
       uint8_t id,
       uint8_t *pdu,
       uint32_t size);
+/** \brief Check if a message can be sent
+ **
+ ** Messages are queued by ciaaModbus_asciiSendMsg and written by it and
+ ** ciaaModbus_asciiTask as the device accepts them. A message sent while
+ ** the queue is full is discarded.
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a message of maximal length can be queued
+ **/
+extern bool ciaaModbus_asciiTxReady(int32_t handler);
+
+/** \brief Check if the transport has work
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a frame received, data queued to write, a frame being
+ **         received or data pending in the device
+ **/
+extern bool ciaaModbus_asciiPending(int32_t handler);
+
+/** \brief Set the file descriptor of the port in the host
+ **
+ ** The port is read only if the reactor reports data pending on this
+ ** file descriptor. If not set the port is read on each task.
+ **
+ ** \param[in] handler handler of modbus ascii
+ ** \param[in] hostFd file descriptor registered with the reactor
+ ** \return
+ **/
+extern void ciaaModbus_asciiSetHostFd(int32_t handler, int32_t hostFd);
 
+/** \brief Init a Modbus ASCII framer
+ **
+ ** \param[out] framer framer to initialize
+ ** \param[in] cbFrame callback called for each complete and valid frame
+ ** \param[in] param parameter passed to cbFrame
+ ** \return
+ **/
+extern void ciaaModbus_asciiFramerInit(
+      ciaaModbus_asciiFramerType *framer,
+      ciaaModbus_framerCbType cbFrame,
+      void *param);
+
+/** \brief Discard the frame being received
+ **
+ ** Shall be called if the time between characters is exceeded.
+ **
+ ** \param[inout] framer framer to reset
+ ** \return
+ **/
+extern void ciaaModbus_asciiFramerReset(ciaaModbus_asciiFramerType *framer);
+
+/** \brief Feed a Modbus ASCII framer
+ **
+ ** Process a chunk of a modbus ascii byte stream. The chunk may contain
+ ** any part of one or more frames. Data before a start character is
+ ** discarded, a start character discards the frame being received and
+ ** frames with invalid characters, invalid LRC or too long are discarded.
+ ** The callback of the framer is called for each valid frame.
+ **
+ ** \param[inout] framer framer to feed
+ ** \param[in] buf chunk of the byte stream
+ ** \param[in] len length of the chunk
+ ** \return count of valid frames found
+ **/
+extern int32_t ciaaModbus_asciiFramerFeed(
+      ciaaModbus_asciiFramerType *framer,
+      uint8_t const *buf,
+      int32_t len);
 
 /** \brief Convert received ascii data to bin
 **
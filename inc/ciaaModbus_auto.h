@@ -0,0 +1,178 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _CIAAMODBUS_AUTO_H_
+#define _CIAAMODBUS_AUTO_H_
+/** \brief Modbus Serial Auto Detection Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus serial transport with detection of ASCII or RTU
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_auto initialization
+ **
+ ** Performs the initialization of the MODBUS serial auto detection
+ **
+ **/
+extern void ciaaModbus_autoInit(void);
+
+/** \brief Open a serial port with detection of ASCII or RTU
+ **
+ ** The data received is framed as ASCII and as RTU until the first valid
+ ** frame, then a transport of the detected protocol is opened on the port
+ ** and used from then on.
+ **
+ ** \param[in] fildes file descriptor serial port
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_autoOpen(int32_t fildes);
+
+/** \brief CIAA Modbus serial auto detection task
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_autoTask(int32_t handler);
+
+/** \brief Receive modbus message
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message received
+ ** \return
+ **/
+extern void ciaaModbus_autoRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus message
+ **
+ ** Messages sent before the protocol is detected are discarded.
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_autoSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if a message can be sent
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a message can be sent
+ **/
+extern bool ciaaModbus_autoTxReady(int32_t handler);
+
+/** \brief Check if the transport has work
+ **
+ ** Once the protocol is detected its transport is checked.
+ **
+ ** \param[in] handler handler to check
+ ** \return true if data to read, a frame to end or to receive
+ **/
+extern bool ciaaModbus_autoPending(int32_t handler);
+
+/** \brief Set the baud rate of the line
+ **
+ ** Sets the silent interval ending a RTU frame, also used by the RTU
+ ** transport once RTU detected.
+ **
+ ** \param[in] handler handler of modbus auto detection
+ ** \param[in] baudRate bits per second of the line
+ ** \return
+ **/
+extern void ciaaModbus_autoSetBaudRate(int32_t handler, uint32_t baudRate);
+
+/** \brief Set the file descriptor of the port in the host
+ **
+ ** The port is read only if the reactor reports data pending on this
+ ** file descriptor, also by the transport once the protocol detected. If
+ ** not set the port is read on each task.
+ **
+ ** \param[in] handler handler of modbus auto detection
+ ** \param[in] hostFd file descriptor registered with the reactor
+ ** \return
+ **/
+extern void ciaaModbus_autoSetHostFd(int32_t handler, int32_t hostFd);
+
+/** \brief Get the detected protocol
+ **
+ ** \param[in] handler handler to check
+ ** \return CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE if ASCII detected
+ **         CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE if RTU detected
+ **         -1 if not yet detected
+ **/
+extern int32_t ciaaModbus_autoGetMode(int32_t handler);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_AUTO_H_ */
+
@@ -59,6 +59,15 @@ extern "C" {
 
 /*==================[external data declaration]==============================*/
 
+/** \brief RAM used by the gateway objects (bytes)
+ **
+ ** Computed at compile time from CIAA_MODBUS_TOTAL_GATEWAY,
+ ** CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS and CIAA_MODBUS_GATEWAY_TOTAL_SERVERS,
+ ** and stored in read only memory, so it can be read from the image or
+ ** reported by the application.
+ **/
+extern const uint32_t ciaaModbus_gatewayRamSize;
+
 /*==================[external functions declaration]=========================*/
 
 /** \brief ciaaModbus_gateway initialization
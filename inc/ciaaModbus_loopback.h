@@ -0,0 +1,204 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _CIAAMODBUS_LOOPBACK_H_
+#define _CIAAMODBUS_LOOPBACK_H_
+/** \brief Modbus Loopback Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus Loopback
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+/** \brief Maximal length of a pdu transferred by a loopback channel */
+#define CIAAMODBUS_LOOPBACK_PDU_MAXLENGTH    253
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_loopback initialization
+ **
+ ** Performs the initialization of the MODBUS Loopback
+ **
+ **/
+extern void ciaaModbus_loopbackInit(void);
+
+/** \brief Open master end of a Modbus Loopback channel
+ **
+ ** A channel has a master end and a slave end. The requests sent by the
+ ** master end are received by the slave end and the responses sent by the
+ ** slave end are received by the master end. No I/O is performed. The
+ ** ends may be used by different threads, e.g. to pass the requests of a
+ ** gateway to another one run by its own thread.
+ **
+ ** \param[in] channel channel number, 0 to
+ **            CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK - 1
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_loopbackMasterOpen(int32_t channel);
+
+/** \brief Open slave end of a Modbus Loopback channel
+ **
+ ** \param[in] channel channel number, 0 to
+ **            CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK - 1
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_loopbackSlaveOpen(int32_t channel);
+
+/** \brief CIAA Modbus Loopback task
+ **
+ ** Messages are transferred when sent, nothing to do.
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_loopbackTask(int32_t handler);
+
+/** \brief Receive modbus response on master end
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message
+ ** \return
+ **/
+extern void ciaaModbus_loopbackMasterRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus request on master end
+ **
+ ** The request is discarded if the queue of the channel is full.
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_loopbackMasterSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Receive modbus request on slave end
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message
+ ** \return
+ **/
+extern void ciaaModbus_loopbackSlaveRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus response on slave end
+ **
+ ** The response is discarded if the queue of the channel is full.
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_loopbackSlaveSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if a request can be sent on master end
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the queue of requests of the channel is not full
+ **/
+extern bool ciaaModbus_loopbackMasterTxReady(int32_t handler);
+
+/** \brief Check if a response can be sent on slave end
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the queue of responses of the channel is not full
+ **/
+extern bool ciaaModbus_loopbackSlaveTxReady(int32_t handler);
+
+/** \brief Check if a response is queued for master end
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the queue of responses of the channel is not empty
+ **/
+extern bool ciaaModbus_loopbackMasterPending(int32_t handler);
+
+/** \brief Check if a request is queued for slave end
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the queue of requests of the channel is not empty
+ **/
+extern bool ciaaModbus_loopbackSlavePending(int32_t handler);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_LOOPBACK_H_ */
+
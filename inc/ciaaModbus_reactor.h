@@ -0,0 +1,195 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _CIAAMODBUS_REACTOR_H_
+#define _CIAAMODBUS_REACTOR_H_
+/** \brief Modbus Reactor Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus reactor
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+#ifndef CIAA_MODBUS_REACTOR_MAX_FDS
+/** \brief Default file descriptors which can be registered (0 .. max-1) */
+#define CIAA_MODBUS_REACTOR_MAX_FDS       256
+#endif
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_reactor initialization
+ **
+ ** Unregisters all file descriptors
+ **
+ **/
+extern void ciaaModbus_reactorInit(void);
+
+/** \brief Register a file descriptor
+ **
+ ** Once registered the file descriptor is read only if data is pending.
+ ** It is polled by the waiter bound to the caller, or by the shared epoll
+ ** instance if the caller is not bound. Only supported on the host build.
+ **
+ ** \param[in] fildes file descriptor to register
+ ** \return 0 if registered
+ **         -1 if not supported, the file descriptor is read on each task
+ **/
+extern int32_t ciaaModbus_reactorAdd(int32_t fildes);
+
+/** \brief Unregister a file descriptor
+ **
+ ** Shall be called before closing a registered file descriptor, its
+ ** number may be reused by a file descriptor not registered.
+ **
+ ** \param[in] fildes file descriptor to unregister
+ **/
+extern void ciaaModbus_reactorRemove(int32_t fildes);
+
+/** \brief Poll the registered file descriptors
+ **
+ ** Updates the file descriptors of the caller with pending data. Shall be
+ ** called once before performing the tasks of the transports.
+ **
+ **/
+extern void ciaaModbus_reactorPoll(void);
+
+/** \brief Wait for pending data
+ **
+ ** Same as ciaaModbus_reactorPoll() but the caller sleeps until a
+ ** registered file descriptor has pending data, ciaaModbus_reactorWakeup()
+ ** is called or the timeout elapses. Only waits on the host build.
+ **
+ ** \param[in] timeout max time to wait (milliseconds), -1 without limit
+ **/
+extern void ciaaModbus_reactorWait(int32_t timeout);
+
+/** \brief Wake up a task waiting in ciaaModbus_reactorWait
+ **
+ ** May be called from other threads, for instance when a message is put
+ ** in a transport not read through a file descriptor. A wake up before
+ ** the first wait is lost, so waits shall have a timeout.
+ **
+ **/
+extern void ciaaModbus_reactorWakeup(void);
+
+/** \brief Open a waiter of the reactor
+ **
+ ** A waiter lets each of several threads sleep on the reactor: all of
+ ** them are woken up by ciaaModbus_reactorWakeup(). Only supported on the
+ ** host build.
+ **
+ ** \return -1 if error or not supported
+ **         >= 0 handler of the waiter
+ **/
+extern int32_t ciaaModbus_reactorWaiterOpen(void);
+
+/** \brief Close a waiter of the reactor
+ **
+ ** \param[in] hWaiter handler of the waiter
+ **/
+extern void ciaaModbus_reactorWaiterClose(int32_t hWaiter);
+
+/** \brief Bind the calling thread to a waiter
+ **
+ ** From now on the file descriptors registered or checked by the thread
+ ** are polled by the waiter, so the waiter only wakes up on its own file
+ ** descriptors and on ciaaModbus_reactorWakeup().
+ **
+ ** \param[in] hWaiter handler of the waiter
+ **/
+extern void ciaaModbus_reactorWaiterBind(int32_t hWaiter);
+
+/** \brief Wait for pending data on a waiter
+ **
+ ** Same as ciaaModbus_reactorWait() for a thread bound to the waiter. A
+ ** wake up while the thread is not waiting is not lost.
+ **
+ ** \param[in] hWaiter handler of the waiter
+ ** \param[in] timeout max time to wait (milliseconds), -1 without limit
+ **/
+extern void ciaaModbus_reactorWaiterWait(int32_t hWaiter, int32_t timeout);
+
+/** \brief Check if a file descriptor shall be read
+ **
+ ** A registered file descriptor polled by other waiter, or by the shared
+ ** epoll instance, moves to the waiter bound to the caller and shall be
+ ** read once.
+ **
+ ** \param[in] fildes file descriptor to check
+ ** \return true if data pending at last poll or not registered
+ **/
+extern bool ciaaModbus_reactorReady(int32_t fildes);
+
+/** \brief Get the next registered file descriptor to read
+ **
+ ** Lets a transport visit only the registered file descriptors which
+ ** ciaaModbus_reactorReady() would report, without checking each one. The
+ ** search starts after fildes, so all of them are visited starting with
+ ** -1 and passing each returned value.
+ **
+ ** \param[in] fildes file descriptor to search after, -1 to search from 0
+ ** \return -1 if no more file descriptors to read
+ **         >= 0 file descriptor to read
+ **/
+extern int32_t ciaaModbus_reactorNext(int32_t fildes);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_REACTOR_H_ */
+
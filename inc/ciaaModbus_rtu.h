@@ -0,0 +1,262 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _CIAAMODBUS_RTU_H_
+#define _CIAAMODBUS_RTU_H_
+/** \brief Modbus RTU Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus RTU transport
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaModbus_transport.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+/*
+ * AAFF0011..CCCC
+ * | | |     |
+ * | | |     +-- 2 bytes: CRC, low byte first
+ * | | |
+ * | | +-- n bytes: data
+ * | |
+ * | +-- 1 byte: function
+ * |
+ * +-- 1 byte: addres
+ *
+ * frames are delimited by a silent interval of at least 3.5 characters
+ */
+
+/** \brief Maximal length of a rtu modbus message */
+#define CIAAMODBUS_RTU_MAXLENGTH    256
+
+/** \brief Minimal length of a rtu modbus message */
+#define CIAAMODBUS_RTU_MINLENGTH    4
+
+/*==================[typedef]================================================*/
+/** \brief Modbus RTU framer
+ **
+ ** Keeps the state of the framing of a modbus rtu byte stream. Shall be
+ ** accessed only by the ciaaModbus_rtuFramer functions.
+ **/
+typedef struct
+{
+   ciaaModbus_framerCbType cbFrame;             /** <- called for each frame */
+   void *param;                                 /** <- parameter of cbFrame */
+   int32_t size;                                /** <- bytes of current frame,
+                                                       greater than maximal
+                                                       length if overflowed */
+   uint8_t buffer[CIAAMODBUS_RTU_MAXLENGTH];    /** <- current frame */
+}ciaaModbus_rtuFramerType;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_rtu initialization
+ **
+ ** Performs the initialization of the MODBUS RTU
+ **
+ **/
+extern void ciaaModbus_rtuInit(void);
+
+/** \brief Init Modbus RTU communication channel
+ **
+ ** The end of a frame is detected when a call to ciaaModbus_rtuTask reads
+ ** no data, so the task shall be called with a period not shorter than
+ ** the silent interval of 3.5 characters.
+ **
+ ** \param[in] fildes file descriptor serial port
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_rtuOpen(int32_t fildes);
+
+/** \brief CIAA Modbus RTU task
+ **
+ ** This function perform task of modbus rtu
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_rtuTask(int32_t handler);
+
+/** \brief Receive modbus message
+ **
+ ** This function receive a message
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message received
+ ** \return
+ **/
+extern void ciaaModbus_rtuRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus message
+ **
+ ** This function send a message
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_rtuSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if a message can be sent
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a message of maximal length can be queued
+ **/
+extern bool ciaaModbus_rtuTxReady(int32_t handler);
+
+/** \brief Check if the transport has work
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a frame received, data queued to write, the silent
+ **         interval running or data pending in the device
+ **/
+extern bool ciaaModbus_rtuPending(int32_t handler);
+
+/** \brief Set the baud rate of the line
+ **
+ ** Sets the silent interval ending a frame. If not set, a frame ends at
+ ** the first call to ciaaModbus_rtuTask without data.
+ **
+ ** \param[in] handler handler of modbus rtu
+ ** \param[in] baudRate bits per second of the line
+ ** \return
+ **/
+extern void ciaaModbus_rtuSetBaudRate(int32_t handler, uint32_t baudRate);
+
+/** \brief Set the file descriptor of the port in the host
+ **
+ ** The port is read only if the reactor reports data pending on this
+ ** file descriptor. If not set the port is read on each task.
+ **
+ ** \param[in] handler handler of modbus rtu
+ ** \param[in] hostFd file descriptor registered with the reactor
+ ** \return
+ **/
+extern void ciaaModbus_rtuSetHostFd(int32_t handler, int32_t hostFd);
+
+/** \brief Calculate the task calls of the silent interval
+ **
+ ** The silent interval is 3.5 characters of 11 bits, fixed to 1750 us
+ ** above 19200 bps.
+ **
+ ** \param[in] baudRate bits per second of the line
+ ** \return task calls without data ending a frame, at least 1
+ **/
+extern int32_t ciaaModbus_rtuSilenceTicks(uint32_t baudRate);
+
+/** \brief Init a Modbus RTU framer
+ **
+ ** \param[out] framer framer to initialize
+ ** \param[in] cbFrame callback called for each complete and valid frame
+ ** \param[in] param parameter passed to cbFrame
+ ** \return
+ **/
+extern void ciaaModbus_rtuFramerInit(
+      ciaaModbus_rtuFramerType *framer,
+      ciaaModbus_framerCbType cbFrame,
+      void *param);
+
+/** \brief Feed a Modbus RTU framer
+ **
+ ** Appends a chunk of a modbus rtu byte stream to the frame being
+ ** received. A frame longer than the maximal length is discarded.
+ **
+ ** \param[inout] framer framer to feed
+ ** \param[in] buf chunk of the byte stream
+ ** \param[in] len length of the chunk
+ ** \return
+ **/
+extern void ciaaModbus_rtuFramerFeed(
+      ciaaModbus_rtuFramerType *framer,
+      uint8_t const *buf,
+      int32_t len);
+
+/** \brief End the frame of a Modbus RTU framer
+ **
+ ** Shall be called when a silent interval is detected. Checks the CRC of
+ ** the frame received, calls the callback of the framer if valid and
+ ** starts a new frame.
+ **
+ ** \param[inout] framer framer to end the frame
+ ** \return 1 if valid frame
+ **         0 if invalid or no frame
+ **/
+extern int32_t ciaaModbus_rtuFramerEnd(ciaaModbus_rtuFramerType *framer);
+
+/** \brief Calculate the CRC of a Modbus RTU message
+ **
+ ** \param[in] buf buffer
+ ** \param[in] len length of the data stored in the buffer
+ ** \return CRC, 0 if the buffer includes its correct CRC
+ **/
+extern uint16_t ciaaModbus_rtuCrc16(uint8_t const *buf, int32_t len);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_RTU_H_ */
+
@@ -0,0 +1,250 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _CIAAMODBUS_SHM_H_
+#define _CIAAMODBUS_SHM_H_
+/** \brief Modbus Shared Memory Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus Shared Memory transport
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+/** \brief Identification of an initialized segment ("MBSH") */
+#define CIAAMODBUS_SHM_MAGIC              0x4D425348
+
+/** \brief Messages by ring, power of 2 */
+#define CIAAMODBUS_SHM_QUEUE_LENGTH       8
+
+/** \brief Maximal length of a pdu transferred by shared memory */
+#define CIAAMODBUS_SHM_PDU_MAXLENGTH      253
+
+/*==================[typedef]================================================*/
+/** \brief Modbus message in a ring */
+typedef struct
+{
+   uint32_t size;                                  /** <- size of pdu */
+   uint8_t id;                                     /** <- identification */
+   uint8_t pdu[CIAAMODBUS_SHM_PDU_MAXLENGTH];      /** <- pdu */
+}ciaaModbus_shmMsgType;
+
+/** \brief Single producer single consumer ring of messages
+ **
+ ** head and tail are free running counters, each one written only by one
+ ** side, in separated cache lines.
+ **/
+typedef struct
+{
+   uint32_t head __attribute__((aligned(64)));     /** <- next message to read */
+   uint32_t tail __attribute__((aligned(64)));     /** <- next message to write */
+   uint32_t seq;                                   /** <- futex word, incremented
+                                                          by each message */
+   uint32_t waiters;                               /** <- consumers waiting */
+   ciaaModbus_shmMsgType msg[CIAAMODBUS_SHM_QUEUE_LENGTH];
+}ciaaModbus_shmRingType;
+
+/** \brief Shared memory segment
+ **
+ ** The stack reads from toStack and writes to fromStack. If the transport
+ ** is slave the peer process sends requests and receives responses, if
+ ** master it receives requests and sends responses.
+ **/
+typedef struct
+{
+   uint32_t magic;                                 /** <- CIAAMODBUS_SHM_MAGIC */
+   int32_t peerEvent;                              /** <- eventfd waking up the
+                                                          stack as opened in the
+                                                          peer process, -1 if none */
+   ciaaModbus_shmRingType toStack;                 /** <- from peer to stack */
+   ciaaModbus_shmRingType fromStack;               /** <- from stack to peer */
+}ciaaModbus_shmSegmentType;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_shm initialization
+ **
+ ** Performs the initialization of the MODBUS Shared Memory
+ **
+ **/
+extern void ciaaModbus_shmInit(void);
+
+/** \brief Init Modbus Shared Memory communication channel
+ **
+ ** The shared memory object is sized, mapped and initialized, pending
+ ** messages are discarded.
+ **
+ ** \param[in] fildes file descriptor of a shared memory object
+ **            (memfd_create or shm_open) shared with the peer process
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_shmOpen(int32_t fildes);
+
+/** \brief CIAA Modbus Shared Memory task
+ **
+ ** Messages are transferred when sent, only the wake ups of the peer are
+ ** consumed.
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_shmTask(int32_t handler);
+
+/** \brief Receive modbus message sent by the peer
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message
+ ** \return
+ **/
+extern void ciaaModbus_shmRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus message to the peer
+ **
+ ** The message is discarded if the ring is full. The peer is woken up if
+ ** waiting.
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_shmSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if a message can be sent to the peer
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the ring to the peer is not full
+ **/
+extern bool ciaaModbus_shmTxReady(int32_t handler);
+
+/** \brief Check if the transport has work
+ **
+ ** \param[in] handler handler to check
+ ** \return true if the peer sent messages not received yet
+ **/
+extern bool ciaaModbus_shmPending(int32_t handler);
+
+/** \brief Get the event signalled by the peer
+ **
+ ** The eventfd is registered in the reactor and signalled by each message
+ ** of the peer, so a gateway waiting for data is woken up. It shall be
+ ** passed to the peer process along with the shared memory object.
+ **
+ ** \param[in] handler handler of the transport
+ ** \return eventfd, -1 if not available
+ **/
+extern int32_t ciaaModbus_shmGetEvent(int32_t handler);
+
+/** \brief Map a shared memory segment in the peer process
+ **
+ ** \param[in] fildes file descriptor of the shared memory object opened
+ **            with ciaaModbus_shmOpen
+ ** \param[in] event file descriptor of the eventfd returned by
+ **            ciaaModbus_shmGetEvent, -1 if the stack is not woken up
+ ** \return pointer to segment, NULL if error or not initialized
+ **/
+extern ciaaModbus_shmSegmentType * ciaaModbus_shmPeerMap(
+      int32_t fildes,
+      int32_t event);
+
+/** \brief Send modbus message from the peer process
+ **
+ ** \param[in] segment segment returned by ciaaModbus_shmPeerMap
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return 0 if sent, -1 if ring full or invalid size
+ **/
+extern int32_t ciaaModbus_shmPeerSendMsg(
+      ciaaModbus_shmSegmentType *segment,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Receive modbus message in the peer process
+ **
+ ** Waits on a futex until a message is sent by the stack or the timeout
+ ** expires.
+ **
+ ** \param[in] segment segment returned by ciaaModbus_shmPeerMap
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if no message
+ ** \param[in] timeout maximal time to wait (milliseconds), 0 no wait
+ ** \return
+ **/
+extern void ciaaModbus_shmPeerRecvMsg(
+      ciaaModbus_shmSegmentType *segment,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size,
+      uint32_t timeout);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_SHM_H_ */
+
@@ -79,7 +79,9 @@ extern void ciaaModbus_slaveTask(int32_t handler);
 
 /** \brief Receive modbus message
  **
- ** This function receive a message from slave
+ ** This function receive a message from slave. The response is left in
+ ** the buffer given to ciaaModbus_slaveSendMsg, if pdu is that buffer
+ ** nothing is copied.
  **
  ** \param[in] handler handler to recv msg
  ** \param[out] id identification number of modbus message
@@ -96,7 +98,9 @@ extern void ciaaModbus_slaveRecvMsg(
 
 /** \brief Send modbus message
  **
- ** This send a message to slave
+ ** This send a message to slave. The buffer is not copied, the slave
+ ** processes the request in place and the buffer shall remain valid until
+ ** the response is received.
  **
  ** \param[in] handler handler to send msg
  ** \param[in] id identification number of modbus message
@@ -0,0 +1,296 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _CIAAMODBUS_TCP_H_
+#define _CIAAMODBUS_TCP_H_
+/** \brief Modbus TCP Header File
+ **
+ ** This files shall be included by moodules using the interfaces provided by
+ ** the Modbus TCP
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaPOSIX_stdint.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==================[macros]=================================================*/
+/*
+ * TTTTPPPPLLLLUU0011..DD
+ * |\|\|\|\|\|\|\|\|\|
+ * | | | | | | | | | |
+ * | | | | | | | +-+-+-- n bytes: data
+ * | | | | | | |
+ * | | | | | | +-- 1 byte: function
+ * | | | | | |
+ * | | | | | +-- 1 byte: unit identifier
+ * | | | | |
+ * | | | | +-- 2 bytes: length (unit identifier + pdu)
+ * | | | |
+ * | | +-+-- 2 bytes: protocol identifier (0x0000)
+ * | |
+ * +-+-- 2 bytes: transaction identifier
+ */
+
+/** \brief Length of the MBAP header (unit identifier included) */
+#define CIAAMODBUS_TCP_MBAP_LENGTH     7
+
+/** \brief Maximal length of a modbus tcp message */
+#define CIAAMODBUS_TCP_MAXLENGTH       260
+
+/** \brief Minimal length of a modbus tcp message */
+#define CIAAMODBUS_TCP_MINLENGTH       8
+
+/** \brief Modbus protocol identifier */
+#define CIAAMODBUS_TCP_PROTOCOL_ID     0x0000
+
+/*==================[typedef]================================================*/
+/** \brief Statistics of the connections of a Modbus TCP server */
+typedef struct
+{
+   uint32_t active;                 /** <- connections open */
+   uint32_t accepted;               /** <- connections accepted */
+   uint32_t refused;                /** <- connections refused (no slot) */
+   uint32_t reaped;                 /** <- connections closed by idle timeout */
+   uint32_t incomplete;             /** <- connections closed by frame timeout */
+   uint32_t closed;                 /** <- connections closed (reaped and
+                                           incomplete included) */
+}ciaaModbus_tcpStatsType;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+/** \brief ciaaModbus_tcp initialization
+ **
+ ** Performs the initialization of the MODBUS TCP
+ **
+ **/
+extern void ciaaModbus_tcpInit(void);
+
+/** \brief Init Modbus TCP server
+ **
+ ** Connections are taken from a slab shared by all the servers
+ ** (CIAA_MODBUS_TCP_TOTAL_CONNECTIONS). When it is exhausted further
+ ** connections are refused.
+ **
+ ** \param[in] fildes listening socket, connections are accepted from it
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_tcpOpen(int32_t fildes);
+
+/** \brief CIAA Modbus TCP task
+ **
+ ** This function accepts new connections and reads every connection with
+ ** pending data. All complete frames are kept in the connection buffers
+ ** and delivered by consecutive calls to ciaaModbus_tcpRecvMsg(). Buffers
+ ** are taken from a slab (CIAA_MODBUS_TCP_TOTAL_BUFFERS) and released when
+ ** no data is pending. Connections of all the servers without data for
+ ** CIAA_MODBUS_TCP_IDLE_TIMEOUT are closed.
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_tcpTask(int32_t handler);
+
+/** \brief Receive modbus message
+ **
+ ** This function receive the next complete message. Connections are
+ ** visited in round robin and each one delivers up to
+ ** CIAA_MODBUS_TCP_ADU_BUDGET messages per call to ciaaModbus_tcpTask().
+ ** If no message is pending the responses gathered are sent.
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu. If no valid message received
+ **             size must be less than 5
+ ** \return
+ **/
+extern void ciaaModbus_tcpRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus message
+ **
+ ** This function send a message to the connection which sent the last
+ ** received message, using its transaction identifier. Responses of a
+ ** connection are gathered and sent together by ciaaModbus_tcpRecvMsg()
+ ** when no more messages are pending, or by ciaaModbus_tcpTask().
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_tcpSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if a response can be sent
+ **
+ ** Responses are gathered in the buffer of their connection and sent in
+ ** order. A response which can not be kept in order closes its connection.
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a response of maximal length can be sent to any
+ **         connection
+ **/
+extern bool ciaaModbus_tcpTxReady(int32_t handler);
+
+/** \brief Check if the Modbus TCP server has work
+ **
+ ** Idle connections are closed by the next task performed with work.
+ **
+ ** \param[in] handler handler to check
+ ** \return true if connections to accept, data to read or receive, or
+ **         responses to send
+ **/
+extern bool ciaaModbus_tcpPending(int32_t handler);
+
+/** \brief Get statistics of Modbus TCP server
+ **
+ ** \param[in] handler handler of modbus tcp server
+ ** \param[out] stats statistics of the connections
+ ** \return
+ **/
+extern void ciaaModbus_tcpGetStats(
+      int32_t handler,
+      ciaaModbus_tcpStatsType *stats);
+
+/** \brief Init Modbus TCP master
+ **
+ ** The connection to the destination is established when the first
+ ** request is sent and kept open for the next ones.
+ **
+ ** \param[in] address IPv4 address of destination (host byte order)
+ ** \param[in] port port of destination
+ ** \return -1 if error
+ **         >= 0 handler modbus
+ **/
+extern int32_t ciaaModbus_tcpMasterOpen(uint32_t address, uint16_t port);
+
+/** \brief CIAA Modbus TCP master task
+ **
+ ** This function completes the connection, sends the pending request
+ ** and receives data. The connection is retried with exponential backoff
+ ** and idle connections of all the masters are closed.
+ **
+ ** \param[in] handler handler to perform task
+ ** \return
+ **/
+extern void ciaaModbus_tcpMasterTask(int32_t handler);
+
+/** \brief Receive modbus response
+ **
+ ** This function receive the response of the last request. If the
+ ** request failed an exception response is returned:
+ **   CIAA_MODBUS_E_GW_PATH_UNAVAILABLE if destination is reconnecting
+ **   CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND if connection failed
+ **
+ ** \param[in] handler handler in to recv msg
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu. If no valid message received
+ **             size must be less than 5
+ ** \return
+ **/
+extern void ciaaModbus_tcpMasterRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size);
+
+/** \brief Send modbus request
+ **
+ ** This function send a request to the destination. If not connected,
+ ** the connection is started and the request is sent by
+ ** ciaaModbus_tcpMasterTask() when connected.
+ **
+ ** \param[in] handler handler to send msg
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+extern void ciaaModbus_tcpMasterSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
+
+/** \brief Check if the Modbus TCP master has work
+ **
+ ** \param[in] handler handler to check
+ ** \return true if a request is in course
+ **/
+extern bool ciaaModbus_tcpMasterPending(int32_t handler);
+
+/** \brief Check if a complete modbus tcp message is stored in buffer
+ **
+ ** \param[in] buf buffer starting with a MBAP header
+ ** \param[in] len length of the data stored in the buffer
+ ** \return length of the first message if complete
+ **         0 if no complete message
+ **         -1 if invalid MBAP header
+ **
+ ** \remarks This function shall not be called from outside this file.
+ ** Is not static due to the tests.
+ **/
+extern int32_t ciaaModbus_tcp_checkCompleteMsg(uint8_t * buf, int32_t len);
+
+/*==================[cplusplus]==============================================*/
+#ifdef __cplusplus
+}
+#endif
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+#endif /* #ifndef _CIAAMODBUS_TCP_H_ */
+
@@ -64,17 +64,24 @@ extern "C" {
 /** \brief Min lenght of a modbus exception response pdu */
 #define CIAAMODBUS_EXCEP_RSP_PDU_MINLENGTH      0x02
 
-/** \brief Trasnsport type Master */
-#define CIAAMODBUS_TRANSPORT_TYPE_MASTER        1
-
-/** \brief Trasnsport type Salve */
-#define CIAAMODBUS_TRANSPORT_TYPE_SLAVE         0
-
-/** \brief Trasnsport type Invalid */
-#define CIAAMODBUS_TRANSPORT_TYPE_INVALID       -1
-
 
 /*==================[typedef]================================================*/
+/** \brief Callback of a framer
+ **
+ ** Called by a framer each time a complete and valid ADU is found in the
+ ** fed byte stream.
+ **
+ ** \param[in] param parameter given to the framer when initialized
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu pdu of the message, only valid during the call
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+typedef void (*ciaaModbus_framerCbType)(
+      void *param,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size);
 
 /*==================[external data declaration]==============================*/
 
@@ -129,6 +136,28 @@ void ciaaModbus_transportSendMsg(
       uint8_t *pdu,
       uint32_t size);
 
+/** \brief Check if a message can be sent
+ **
+ ** Transports queue the messages sent and write them from their task. A
+ ** message sent while the queue is full may be discarded, so the sender
+ ** shall wait until this function returns true.
+ **
+ ** \param[in] handler handler of transport
+ ** \return true if a message can be sent
+ **/
+extern bool ciaaModbus_transportTxReady(int32_t handler);
+
+/** \brief Check if the transport has work
+ **
+ ** When false ciaaModbus_transportTask and ciaaModbus_transportRecvMsg
+ ** have nothing to do and their calls may be skipped.
+ **
+ ** \param[in] handler handler of transport
+ ** \return true if data pending, a message received or to write, or a
+ **         timer of the transport running
+ **/
+extern bool ciaaModbus_transportPending(int32_t handler);
+
 /** \brief Get transport type
  **
  ** This function indicate the type of transport (Master or Slave)
@@ -45,6 +45,7 @@
 /*==================[inclusions]=============================================*/
 #include "ciaaModbus_ascii.h"
 #include "ciaaModbus_transport.h"
+#include "ciaaModbus_reactor.h"
 #include "ciaaModbus_Cfg.h"
 #include "ciaaPOSIX_stdio.h"
 #include "ciaaPOSIX_string.h"
@@ -52,13 +53,30 @@
 
 /*==================[macros and definitions]=================================*/
 
+#ifndef CIAA_MODBUS_ASCII_TX_BUFFER_SIZE
+/** \brief Default size of the transmission queue (bytes) */
+#define CIAA_MODBUS_ASCII_TX_BUFFER_SIZE  (CIAAMODBUS_ASCII_MAXLENGHT * 2)
+#endif
+
+#if (CIAA_MODBUS_ASCII_TX_BUFFER_SIZE < CIAAMODBUS_ASCII_MAXLENGHT)
+#error CIAA_MODBUS_ASCII_TX_BUFFER_SIZE shall be at least CIAAMODBUS_ASCII_MAXLENGHT
+#endif
+
 /** \brief Modbus ASCII Object type */
 typedef struct
 {
    int32_t fildes;                              /** <- File descriptor */
-   int32_t bufferSize;                          /** <- buffer size */
+   int32_t hostFd;                              /** <- File descriptor in the
+                                                       host checked with the
+                                                       reactor, -1 if not known */
    int32_t timeOut;                             /** <- timeout between consecutive characters */
-   uint8_t buffer[CIAAMODBUS_ASCII_MAXLENGHT];  /** <- buffer */
+   ciaaModbus_asciiFramerType framer;           /** <- framer of received data */
+   uint32_t frameSize;                          /** <- pdu size of received frame, 0 if none */
+   uint8_t frame[CIAAMODBUS_ASCII_MAXLENGHT/2]; /** <- received frame (id and pdu) */
+   uint8_t buffer[CIAAMODBUS_ASCII_MAXLENGHT];  /** <- read and send buffer */
+   uint32_t txHead;                             /** <- first byte to write */
+   uint32_t txCount;                            /** <- bytes queued to write */
+   uint8_t txBuffer[CIAA_MODBUS_ASCII_TX_BUFFER_SIZE]; /** <- transmission queue */
    bool inUse;                                  /** <- Object in use */
 }ciaaModbus_asciiObjType;
 
@@ -130,43 +148,116 @@ static int32_t ciaaModbus_checkLRC(uint8_t * buf, int32_t len)
    return ret;
 }
 
-/** \brief Check if Complete the reception of a ASCII Modbus Message
+/** \brief Check the frame stored in a Modbus ASCII framer
  **
- ** Check if the provided buffer has a complete ascii message.
+ ** Converts the stored frame to binary, checks the LRC and calls the
+ ** callback of the framer if the frame is valid.
  **
- ** \param[in] buf buffer
- ** \param[in] length length of the data stored in the buffer
- ** \return the length of the modbus ascii message
- **         -1 if no complete message
+ ** \param[inout] framer framer with a frame ended by CRLF
+ ** \return 1 if valid frame
+ **         0 if invalid frame
  **/
-static int32_t ciaaModbus_asciiCheckCompleteMsg(uint8_t * buf, int8_t length)
+static int32_t ciaaModbus_asciiFramerCheck(ciaaModbus_asciiFramerType *framer)
 {
-   int32_t loopi;
-   /* set end to an invalid value */
-   int32_t end = -1;
+   int32_t ret = 0;
+   int32_t len_bin;
 
-   /* if the minimal bus length has been received */
-   if (CIAAMODBUS_ASCII_MINLENGHT <= length)
+   if (CIAAMODBUS_ASCII_MINLENGHT <= framer->size)
    {
-      /* search for the end of a modbus message */
-      for (loopi = CIAAMODBUS_ASCII_MINLENGHT-2;
-            (loopi < length -1) &&
-            (-1 == end);
-            loopi++)
+      /* convert to bin (not convert CRLF)*/
+      len_bin = ciaaModbus_ascii_ascii2bin(framer->buffer, framer->size-2);
+
+      /* if ascii to binary correct conversion and lrc correct */
+      if ( (0 < len_bin) &&
+           (ciaaModbus_checkLRC(framer->buffer, len_bin) == CIAAMODBUS_ASCII_LRC_OK) )
       {
-         /* check if end has been found */
-         if ( (CIAAMODBUS_ASCII_END_1 == buf[loopi]) &&
-              (CIAAMODBUS_ASCII_END_2 == buf[loopi+1]) &&
-              (CIAAMODBUS_ASCII_START == buf[0]) )
-         {
-            /* set end position */
-            end = loopi + 2;
-         }
+         /* report frame without id and LRC */
+         framer->cbFrame(
+               framer->param,
+               framer->buffer[0],
+               &framer->buffer[1],
+               len_bin - 2);
+
+         ret = 1;
       }
    }
 
-   return end;
-} /* end ciaaModbus_ascii_completeReception */
+   return ret;
+}
+
+/** \brief Store a frame received by a Modbus ASCII Object
+ **
+ ** Callback of the framer of the object. A frame not yet read by
+ ** ciaaModbus_asciiRecvMsg is replaced by the newer one.
+ **
+ ** \param[in] param pointer to the Modbus ASCII Object
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+static void ciaaModbus_asciiRecvFrame(
+      void *param,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_asciiObjType *obj = param;
+   uint32_t loopi;
+
+   /* copy id */
+   obj->frame[0] = id;
+
+   /* copy pdu */
+   for (loopi = 0 ; loopi < size ; loopi++)
+   {
+      obj->frame[loopi+1] = pdu[loopi];
+   }
+
+   /* set size of the received pdu */
+   obj->frameSize = size;
+}
+
+/** \brief Write the transmission queue of a Modbus ASCII Object
+ **
+ ** Writes until the queue is empty or the device accepts no more data. A
+ ** partial write is resumed in the next call.
+ **
+ ** \param[in] handler handler of the object
+ ** \return
+ **/
+static void ciaaModbus_asciiFlush(int32_t handler)
+{
+   ciaaModbus_asciiObjType *obj = &ciaaModbus_asciiObj[handler];
+   int32_t len;
+   int32_t written;
+
+   do
+   {
+      /* write the queued data up to the end of the queue buffer */
+      len = CIAA_MODBUS_ASCII_TX_BUFFER_SIZE - obj->txHead;
+      if (len > obj->txCount)
+      {
+         len = obj->txCount;
+      }
+
+      written = 0;
+
+      if (0 < len)
+      {
+         written = ciaaPOSIX_write(obj->fildes, &obj->txBuffer[obj->txHead], len);
+      }
+
+      /* discard the written data */
+      if (0 < written)
+      {
+         obj->txHead = (obj->txHead + written) % CIAA_MODBUS_ASCII_TX_BUFFER_SIZE;
+         obj->txCount -= written;
+      }
+
+      /* continue only if all data has been written (queue wrapped) */
+   }while ( (0 < len) && (written == len) && (0 < obj->txCount) );
+}
 
 /*==================[external functions definition]==========================*/
 extern int32_t ciaaModbus_ascii_ascii2bin(uint8_t * buf, int32_t len)
@@ -230,6 +321,66 @@ extern int32_t ciaaModbus_ascii_ascii2bin(uint8_t * buf, int32_t len)
 } /* end ciaaModbus_ascii_ascii2bin */
 
 
+extern void ciaaModbus_asciiFramerInit(
+      ciaaModbus_asciiFramerType *framer,
+      ciaaModbus_framerCbType cbFrame,
+      void *param)
+{
+   framer->cbFrame = cbFrame;
+   framer->param = param;
+   framer->size = 0;
+}
+
+extern void ciaaModbus_asciiFramerReset(ciaaModbus_asciiFramerType *framer)
+{
+   framer->size = 0;
+}
+
+extern int32_t ciaaModbus_asciiFramerFeed(
+      ciaaModbus_asciiFramerType *framer,
+      uint8_t const *buf,
+      int32_t len)
+{
+   int32_t loopi;
+   int32_t ret = 0;
+
+   for (loopi = 0 ; loopi < len ; loopi++)
+   {
+      /* a start character begins a new frame */
+      if (CIAAMODBUS_ASCII_START == buf[loopi])
+      {
+         framer->buffer[0] = CIAAMODBUS_ASCII_START;
+         framer->size = 1;
+      }
+      /* data out of a frame is discarded */
+      else if (0 < framer->size)
+      {
+         /* if maximum size reached discard the frame */
+         if (CIAAMODBUS_ASCII_MAXLENGHT <= framer->size)
+         {
+            framer->size = 0;
+         }
+         else
+         {
+            framer->buffer[framer->size] = buf[loopi];
+            framer->size++;
+
+            /* check if end has been found */
+            if ( (CIAAMODBUS_ASCII_END_2 == buf[loopi]) &&
+                 (CIAAMODBUS_ASCII_END_1 == framer->buffer[framer->size-2]) )
+            {
+               ret += ciaaModbus_asciiFramerCheck(framer);
+
+               /* wait for the next start character */
+               framer->size = 0;
+            }
+         }
+      }
+   }
+
+   return ret;
+}
+
 extern void ciaaModbus_asciiInit(void)
 {
    int32_t loopi;
@@ -261,9 +412,21 @@ extern int32_t ciaaModbus_asciiOpen(int32_t fildes)
 
       /* set low layer file descriptor */
       ciaaModbus_asciiObj[hModbusAscii].fildes = fildes;
+      ciaaModbus_asciiObj[hModbusAscii].hostFd = -1;
 
-      /* empty buffer */
-      ciaaModbus_asciiObj[hModbusAscii].bufferSize = 0;
+      /* empty transmission queue */
+      ciaaModbus_asciiObj[hModbusAscii].txHead = 0;
+      ciaaModbus_asciiObj[hModbusAscii].txCount = 0;
+
+      /* no frame received */
+      ciaaModbus_asciiObj[hModbusAscii].frameSize = 0;
+      ciaaModbus_asciiObj[hModbusAscii].timeOut = 0;
+
+      /* init framer, frames are stored in the object */
+      ciaaModbus_asciiFramerInit(
+            &ciaaModbus_asciiObj[hModbusAscii].framer,
+            ciaaModbus_asciiRecvFrame,
+            &ciaaModbus_asciiObj[hModbusAscii]);
    }
    else
    {
@@ -275,77 +438,39 @@ extern int32_t ciaaModbus_asciiOpen(int32_t fildes)
 
 extern void ciaaModbus_asciiTask(int32_t handler)
 {
-   int32_t begin;
-   int32_t read;
-   int32_t loopi;
+   int32_t read = 0;
 
-   uint8_t *buf;
+   /* resume the transmission */
+   ciaaModbus_asciiFlush(handler);
 
    if (0 == ciaaModbus_asciiObj[handler].timeOut)
    {
-      ciaaModbus_asciiObj[handler].bufferSize = 0;
+      ciaaModbus_asciiFramerReset(&ciaaModbus_asciiObj[handler].framer);
    }
    else
    {
       ciaaModbus_asciiObj[handler].timeOut --;
    }
 
-   /* set pointer to buffer */
-   buf = ciaaModbus_asciiObj[handler].buffer;
-
-   /* set begin to an invalid value */
-   begin = -1;
-
-   /* max read */
-   read = CIAAMODBUS_ASCII_MAXLENGHT -
-         ciaaModbus_asciiObj[handler].bufferSize;
-
-   /* checks if the maximum size reached */
-   if (0 == read)
+   /* read from device if data pending */
+   if (ciaaModbus_reactorReady(ciaaModbus_asciiObj[handler].hostFd))
    {
-      /* if reached discards all data */
-      ciaaModbus_asciiObj[handler].bufferSize = 0;
-
-      /* max read */
-      read = CIAAMODBUS_ASCII_MAXLENGHT;
+      read = ciaaPOSIX_read(
+            ciaaModbus_asciiObj[handler].fildes,
+            ciaaModbus_asciiObj[handler].buffer,
+            CIAAMODBUS_ASCII_MAXLENGHT);
    }
 
-   /* read from device */
-   read = ciaaPOSIX_read(
-         ciaaModbus_asciiObj[handler].fildes,
-         &buf[ciaaModbus_asciiObj[handler].bufferSize],
-         read);
-
    /* if received data process */
    if (read > 0)
    {
       ciaaModbus_asciiObj[handler].timeOut = CIAAMODBUS_ASCII_TIMOUT_RCV / CIAA_MODBUS_TIME_BASE;
-      /* increment buffer size */
-      ciaaModbus_asciiObj[handler].bufferSize += read;
 
-      /* search for START character */
-      for (loopi = ciaaModbus_asciiObj[handler].bufferSize-1 ;
-           (0 <= loopi) && (-1 == begin) ;
-           loopi--)
-      {
-         /* check for the begin of a ascii modbus message */
-         if (CIAAMODBUS_ASCII_START == buf[loopi])
-         {
-            begin = loopi;
-         }
-      }
-
-      /* move the received part to the beginning of the buffer */
-      if (begin > 0)
-      {
-         for (loopi = begin; loopi < ciaaModbus_asciiObj[handler].bufferSize; loopi++)
-         {
-            buf[loopi-begin] = buf[loopi];
-         }
-
-         /* set new buffer size */
-         ciaaModbus_asciiObj[handler].bufferSize -= begin;
-      }
+      /* frame received data */
+      ciaaModbus_asciiFramerFeed(
+            &ciaaModbus_asciiObj[handler].framer,
+            ciaaModbus_asciiObj[handler].buffer,
+            read);
    }
 }
 
@@ -355,61 +480,26 @@ extern void ciaaModbus_asciiRecvMsg(
       uint8_t *pdu,
       uint32_t *size)
 {
-   int32_t loopi;
-   int32_t len_ascii;
-   int32_t len_bin;
+   uint32_t loopi;
+   uint8_t *frame;
 
-   len_ascii = ciaaModbus_asciiCheckCompleteMsg(
-         ciaaModbus_asciiObj[handler].buffer,
-         ciaaModbus_asciiObj[handler].bufferSize);
+   /* set pointer to received frame */
+   frame = ciaaModbus_asciiObj[handler].frame;
 
-   if (CIAAMODBUS_ASCII_MINLENGHT <= len_ascii)
+   /* copy pdu */
+   for (loopi = 0 ; loopi < ciaaModbus_asciiObj[handler].frameSize ; loopi++)
    {
-      /* empty buffer for the upcoming receptions */
-      ciaaModbus_asciiObj[handler].bufferSize = 0;
-
-      /* convert to bin (not convert CRLF)*/
-      len_bin = ciaaModbus_ascii_ascii2bin(
-            ciaaModbus_asciiObj[handler].buffer,
-            len_ascii-2);
-
-      /* if ascii to binary correct conversion */
-      if (0 < len_bin)
-      {
-         /* check lrc */
-         if ( ciaaModbus_checkLRC(
-              ciaaModbus_asciiObj[handler].buffer,
-              len_bin) == CIAAMODBUS_ASCII_LRC_OK)
-         {
-            /* discard LRC */
-            len_bin--;
+      pdu[loopi] = frame[loopi+1];
+   }
 
-            /* copy pdu */
-            for (loopi = 0 ; loopi < len_bin ; loopi++)
-            {
-               pdu[loopi] = ciaaModbus_asciiObj[handler].buffer[loopi+1];
-            }
+   /* copy id */
+   *id = frame[0];
 
-            /* copy id */
-            *id = ciaaModbus_asciiObj[handler].buffer[0];
+   /* copy size, 0 if no frame received */
+   *size = ciaaModbus_asciiObj[handler].frameSize;
 
-            /* copy size */
-            *size = len_bin - 1;
-         }
-         else
-         {
-            *size = 0;
-         }
-      }
-      else
-      {
-         *size = 0;
-      }
-   }
-   else
-   {
-      *size = 0;
-   }
+   /* frame read */
+   ciaaModbus_asciiObj[handler].frameSize = 0;
 }
 
 void ciaaModbus_asciiSendMsg(
@@ -420,6 +510,7 @@ void ciaaModbus_asciiSendMsg(
 {
    int32_t loopi, lenAscii;
    uint32_t upper, lower;
+   uint32_t end;
    uint8_t *buf;
 
    /* set pointer to buffer */
@@ -464,13 +555,48 @@ void ciaaModbus_asciiSendMsg(
       buf[lenAscii] = CIAAMODBUS_ASCII_END_2;
       lenAscii++;
 
-      ciaaPOSIX_write(
-            ciaaModbus_asciiObj[handler].fildes,
-            buf,
-            lenAscii);
+      /* queue the frame if it fits, never queue a part of it */
+      if ( (CIAA_MODBUS_ASCII_TX_BUFFER_SIZE -
+            ciaaModbus_asciiObj[handler].txCount) >= lenAscii )
+      {
+         end = (ciaaModbus_asciiObj[handler].txHead +
+                ciaaModbus_asciiObj[handler].txCount) %
+               CIAA_MODBUS_ASCII_TX_BUFFER_SIZE;
+
+         for (loopi = 0 ; loopi < lenAscii ; loopi++)
+         {
+            ciaaModbus_asciiObj[handler].txBuffer[end] = buf[loopi];
+            end = (end + 1) % CIAA_MODBUS_ASCII_TX_BUFFER_SIZE;
+         }
+
+         ciaaModbus_asciiObj[handler].txCount += lenAscii;
+
+         /* start the transmission */
+         ciaaModbus_asciiFlush(handler);
+      }
    }
 }
 
+extern bool ciaaModbus_asciiTxReady(int32_t handler)
+{
+   return ( (CIAA_MODBUS_ASCII_TX_BUFFER_SIZE -
+             ciaaModbus_asciiObj[handler].txCount) >=
+            CIAAMODBUS_ASCII_MAXLENGHT );
+}
+
+extern bool ciaaModbus_asciiPending(int32_t handler)
+{
+   return ( (0 != ciaaModbus_asciiObj[handler].frameSize) ||
+            (0 != ciaaModbus_asciiObj[handler].txCount) ||
+            (0 != ciaaModbus_asciiObj[handler].timeOut) ||
+            (ciaaModbus_reactorReady(ciaaModbus_asciiObj[handler].hostFd)) );
+}
+
+extern void ciaaModbus_asciiSetHostFd(int32_t handler, int32_t hostFd)
+{
+   ciaaModbus_asciiObj[handler].hostFd = hostFd;
+}
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /*==================[end of file]============================================*/
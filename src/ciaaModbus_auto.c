@@ -0,0 +1,466 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus serial auto detection
+ **
+ ** The data received on a serial port is fed to an ASCII and to an RTU
+ ** framer. The first valid frame selects the protocol, then a transport of
+ ** that protocol is opened on the port and the detection is not performed
+ ** anymore.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_auto.h"
+#include "ciaaModbus_ascii.h"
+#include "ciaaModbus_rtu.h"
+#include "ciaaModbus_transport.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdio.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[macros and definitions]=================================*/
+
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_AUTO
+/** \brief Default serial ports with auto detection */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_AUTO  0
+#endif
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0
+
+/** \brief Modbus serial auto detection Object type */
+typedef struct
+{
+   int32_t fildes;                              /** <- File descriptor */
+   int32_t hostFd;                              /** <- File descriptor in the
+                                                       host checked with the
+                                                       reactor, -1 if not known */
+   int32_t silence;                             /** <- task calls without data
+                                                       to end a rtu frame */
+   uint32_t baudRate;                           /** <- baud rate, 0 if not set */
+   int32_t mode;                                /** <- detected protocol, -1 if none */
+   const ciaaModbus_transportOpsType *ops;      /** <- operations of detected
+                                                       protocol, NULL while
+                                                       detecting */
+   int32_t hModbusLowLayer;                     /** <- handler of transport of
+                                                       detected protocol */
+   ciaaModbus_asciiFramerType asciiFramer;      /** <- ascii framer of received data */
+   ciaaModbus_rtuFramerType rtuFramer;          /** <- rtu framer of received data */
+   uint32_t frameSize;                          /** <- pdu size of detected frame, 0 if none */
+   uint8_t frame[CIAAMODBUS_RTU_MAXLENGTH];     /** <- detected frame (id and pdu) */
+   uint8_t buffer[CIAAMODBUS_RTU_MAXLENGTH];    /** <- read buffer */
+   bool inUse;                                  /** <- Object in use */
+}ciaaModbus_autoObjType;
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief Array of Modbus serial auto detection Object */
+static ciaaModbus_autoObjType ciaaModbus_autoObj[CIAA_MODBUS_TOTAL_TRANSPORT_AUTO];
+
+/** \brief Operations of the transport used once ASCII detected */
+static const ciaaModbus_transportOpsType ciaaModbus_autoAsciiOps =
+{
+   ciaaModbus_asciiOpen,
+   ciaaModbus_asciiTask,
+   ciaaModbus_asciiRecvMsg,
+   ciaaModbus_asciiSendMsg,
+   ciaaModbus_asciiTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_asciiPending,
+};
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+/** \brief Operations of the transport used once RTU detected */
+static const ciaaModbus_transportOpsType ciaaModbus_autoRtuOps =
+{
+   ciaaModbus_rtuOpen,
+   ciaaModbus_rtuTask,
+   ciaaModbus_rtuRecvMsg,
+   ciaaModbus_rtuSendMsg,
+   ciaaModbus_rtuTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_rtuPending,
+};
+#endif
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Store a detected frame
+ **
+ ** \param[inout] obj Modbus serial auto detection Object
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \param[in] mode detected protocol
+ ** \return
+ **/
+static void ciaaModbus_autoStoreFrame(
+      ciaaModbus_autoObjType *obj,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size,
+      int32_t mode)
+{
+   uint32_t loopi;
+
+   /* only the first valid frame is detected */
+   if (-1 == obj->mode)
+   {
+      /* copy id and pdu */
+      obj->frame[0] = id;
+      for (loopi = 0 ; loopi < size ; loopi++)
+      {
+         obj->frame[loopi+1] = pdu[loopi];
+      }
+
+      obj->frameSize = size;
+      obj->mode = mode;
+   }
+}
+
+/** \brief Callback of the ascii framer of an object */
+static void ciaaModbus_autoAsciiFrame(
+      void *param,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_autoStoreFrame(param, id, pdu, size,
+         CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE);
+}
+
+/** \brief Callback of the rtu framer of an object */
+static void ciaaModbus_autoRtuFrame(
+      void *param,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_autoStoreFrame(param, id, pdu, size,
+         CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE);
+}
+
+/** \brief Open the transport of the detected protocol
+ **
+ ** If the transport can not be opened the frame is discarded and the
+ ** detection goes on.
+ **
+ ** \param[inout] obj Modbus serial auto detection Object
+ ** \return
+ **/
+static void ciaaModbus_autoLock(ciaaModbus_autoObjType *obj)
+{
+   const ciaaModbus_transportOpsType *ops = NULL;
+
+   if (CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE == obj->mode)
+   {
+      ops = &ciaaModbus_autoAsciiOps;
+   }
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+   else
+   {
+      ops = &ciaaModbus_autoRtuOps;
+   }
+#endif
+
+   if (NULL != ops)
+   {
+      obj->hModbusLowLayer = ops->open(obj->fildes);
+   }
+
+   if ( (NULL != ops) && (0 <= obj->hModbusLowLayer) )
+   {
+      obj->ops = ops;
+
+      /* pass the file descriptor of the host, if any */
+      if (0 <= obj->hostFd)
+      {
+         if (&ciaaModbus_autoAsciiOps == ops)
+         {
+            ciaaModbus_asciiSetHostFd(obj->hModbusLowLayer, obj->hostFd);
+         }
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+         else
+         {
+            ciaaModbus_rtuSetHostFd(obj->hModbusLowLayer, obj->hostFd);
+         }
+#endif
+      }
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+      /* pass the baud rate to the rtu transport */
+      if ( (&ciaaModbus_autoRtuOps == ops) && (0 < obj->baudRate) )
+      {
+         ciaaModbus_rtuSetBaudRate(obj->hModbusLowLayer, obj->baudRate);
+      }
+#endif
+   }
+   else
+   {
+      /* discard the frame and go on detecting */
+      obj->frameSize = 0;
+      obj->mode = -1;
+   }
+}
+
+/*==================[external functions definition]==========================*/
+extern void ciaaModbus_autoInit(void)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_AUTO ; loopi++)
+   {
+      ciaaModbus_autoObj[loopi].inUse = false;
+   }
+}
+
+extern int32_t ciaaModbus_autoOpen(int32_t fildes)
+{
+   int32_t hModbusAuto = 0;
+
+   /* search a modbus auto detection Object not in use */
+   while ( (hModbusAuto < CIAA_MODBUS_TOTAL_TRANSPORT_AUTO) &&
+           (ciaaModbus_autoObj[hModbusAuto].inUse == true) )
+   {
+      hModbusAuto++;
+   }
+
+   /* if object available, use it */
+   if (hModbusAuto < CIAA_MODBUS_TOTAL_TRANSPORT_AUTO)
+   {
+      /* set object in use */
+      ciaaModbus_autoObj[hModbusAuto].inUse = true;
+
+      /* set low layer file descriptor */
+      ciaaModbus_autoObj[hModbusAuto].fildes = fildes;
+      ciaaModbus_autoObj[hModbusAuto].hostFd = -1;
+
+      /* protocol not detected */
+      ciaaModbus_autoObj[hModbusAuto].mode = -1;
+      ciaaModbus_autoObj[hModbusAuto].ops = NULL;
+      ciaaModbus_autoObj[hModbusAuto].hModbusLowLayer = -1;
+      ciaaModbus_autoObj[hModbusAuto].frameSize = 0;
+      ciaaModbus_autoObj[hModbusAuto].silence = 0;
+      ciaaModbus_autoObj[hModbusAuto].baudRate = 0;
+
+      /* init both framers, frames are stored in the object */
+      ciaaModbus_asciiFramerInit(
+            &ciaaModbus_autoObj[hModbusAuto].asciiFramer,
+            ciaaModbus_autoAsciiFrame,
+            &ciaaModbus_autoObj[hModbusAuto]);
+
+      ciaaModbus_rtuFramerInit(
+            &ciaaModbus_autoObj[hModbusAuto].rtuFramer,
+            ciaaModbus_autoRtuFrame,
+            &ciaaModbus_autoObj[hModbusAuto]);
+   }
+   else
+   {
+      hModbusAuto = -1;
+   }
+
+   return hModbusAuto;
+}
+
+extern void ciaaModbus_autoTask(int32_t handler)
+{
+   ciaaModbus_autoObjType *obj = &ciaaModbus_autoObj[handler];
+   int32_t read = 0;
+
+   /* once detected, only the transport of the protocol is performed */
+   if (NULL != obj->ops)
+   {
+      obj->ops->task(obj->hModbusLowLayer);
+   }
+   else
+   {
+      /* read from device if data pending */
+      if (ciaaModbus_reactorReady(obj->hostFd))
+      {
+         read = ciaaPOSIX_read(obj->fildes, obj->buffer, CIAAMODBUS_RTU_MAXLENGTH);
+      }
+
+      if (read > 0)
+      {
+         /* frame received data as both protocols */
+         ciaaModbus_asciiFramerFeed(&obj->asciiFramer, obj->buffer, read);
+         ciaaModbus_rtuFramerFeed(&obj->rtuFramer, obj->buffer, read);
+
+         /* restart the silent interval */
+         obj->silence = ciaaModbus_rtuSilenceTicks(obj->baudRate);
+      }
+      else if (0 < obj->silence)
+      {
+         obj->silence--;
+
+         /* silent interval elapsed, end of rtu frame */
+         if (0 == obj->silence)
+         {
+            ciaaModbus_rtuFramerEnd(&obj->rtuFramer);
+         }
+      }
+
+      /* if a protocol has been detected use it */
+      if (-1 != obj->mode)
+      {
+         ciaaModbus_autoLock(obj);
+      }
+   }
+}
+
+extern void ciaaModbus_autoRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_autoObjType *obj = &ciaaModbus_autoObj[handler];
+   uint32_t loopi;
+
+   /* the frame of the detection is received first */
+   if (0 < obj->frameSize)
+   {
+      *id = obj->frame[0];
+      for (loopi = 0 ; loopi < obj->frameSize ; loopi++)
+      {
+         pdu[loopi] = obj->frame[loopi+1];
+      }
+      *size = obj->frameSize;
+
+      /* frame read */
+      obj->frameSize = 0;
+   }
+   else if (NULL != obj->ops)
+   {
+      obj->ops->recvMsg(obj->hModbusLowLayer, id, pdu, size);
+   }
+   else
+   {
+      /* no frame received */
+      *size = 0;
+   }
+}
+
+extern void ciaaModbus_autoSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_autoObjType *obj = &ciaaModbus_autoObj[handler];
+
+   /* discarded if protocol not yet detected */
+   if (NULL != obj->ops)
+   {
+      obj->ops->sendMsg(obj->hModbusLowLayer, id, pdu, size);
+   }
+}
+
+extern bool ciaaModbus_autoTxReady(int32_t handler)
+{
+   ciaaModbus_autoObjType *obj = &ciaaModbus_autoObj[handler];
+   bool ret = true;
+
+   if (NULL != obj->ops)
+   {
+      ret = obj->ops->txReady(obj->hModbusLowLayer);
+   }
+
+   return ret;
+}
+
+extern bool ciaaModbus_autoPending(int32_t handler)
+{
+   ciaaModbus_autoObjType *obj = &ciaaModbus_autoObj[handler];
+   bool ret;
+
+   if (0 < obj->frameSize)
+   {
+      /* frame of the detection not received yet */
+      ret = true;
+   }
+   else if (NULL != obj->ops)
+   {
+      ret = obj->ops->pending(obj->hModbusLowLayer);
+   }
+   else
+   {
+      /* detecting: data to read or rtu frame to end */
+      ret = ( (0 < obj->silence) ||
+              (ciaaModbus_reactorReady(obj->hostFd)) );
+   }
+
+   return ret;
+}
+
+extern void ciaaModbus_autoSetBaudRate(int32_t handler, uint32_t baudRate)
+{
+   ciaaModbus_autoObj[handler].baudRate = baudRate;
+}
+
+extern void ciaaModbus_autoSetHostFd(int32_t handler, int32_t hostFd)
+{
+   ciaaModbus_autoObj[handler].hostFd = hostFd;
+}
+
+extern int32_t ciaaModbus_autoGetMode(int32_t handler)
+{
+   int32_t ret = -1;
+
+   if (NULL != ciaaModbus_autoObj[handler].ops)
+   {
+      ret = ciaaModbus_autoObj[handler].mode;
+   }
+
+   return ret;
+}
+
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0 */
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
@@ -43,34 +43,122 @@
 
 /*==================[inclusions]=============================================*/
 
+/* cpu affinity of the gateway threads on the host build */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "ciaaModbus_gateway.h"
 #include "ciaaModbus_transport.h"
 #include "ciaaModbus_slave.h"
 #include "ciaaModbus_master.h"
+#include "ciaaModbus_reactor.h"
 #include "ciaaModbus_Cfg.h"
 #include "ciaaPOSIX_stdbool.h"
 #include "ciaaPOSIX_string.h"
+#include "ciaaPlatforms.h"
 #include "os.h"
 
+#if (x86 == ARCH)
+#include <time.h>
+#endif
+
+#if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH)
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#endif
+
 
 /*==================[macros and definitions]=================================*/
 
-/** \brief Total servers by gateway */
+#ifndef CIAA_MODBUS_GATEWAY_TOTAL_SERVERS
+/** \brief Default total servers by gateway */
 #define CIAA_MODBUS_GATEWAY_TOTAL_SERVERS    2
+#endif
 
-/** \brief Total clients by gateway */
+#ifndef CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS
+/** \brief Default total clients by gateway */
 #define CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS    2
+#endif
+
+#if (CIAA_MODBUS_GATEWAY_TOTAL_SERVERS < 1) || (CIAA_MODBUS_GATEWAY_TOTAL_SERVERS > 127)
+#error CIAA_MODBUS_GATEWAY_TOTAL_SERVERS shall be between 1 and 127
+#endif
+
+#if (CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS < 1)
+#error CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS shall be greater than 0
+#endif
+
+#ifndef CIAA_MODBUS_GATEWAY_CACHE_ENTRIES
+/** \brief Default read responses cached by gateway, 0 to disable cache */
+#define CIAA_MODBUS_GATEWAY_CACHE_ENTRIES    0
+#endif
+
+#ifndef CIAA_MODBUS_GATEWAY_MERGE
+/** \brief Default merge of adjacent reads disabled */
+#define CIAA_MODBUS_GATEWAY_MERGE            0
+#endif
+
+#ifndef CIAA_MODBUS_GATEWAY_PRIORITY
+/** \brief Default priority of gateway clients disabled */
+#define CIAA_MODBUS_GATEWAY_PRIORITY         0
+#endif
+
+#ifndef CIAA_MODBUS_GATEWAY_THREADS
+/** \brief Default gateways run by the application task */
+#define CIAA_MODBUS_GATEWAY_THREADS          0
+#endif
+
+#ifndef CIAA_MODBUS_GATEWAY_DRR
+/** \brief Default deficit round robin of gateway clients disabled */
+#define CIAA_MODBUS_GATEWAY_DRR              0
+#endif
+
+/** \brief Highest priority of a client or function */
+#define CIAA_MODBUS_GATEWAY_PRIORITY_MAX     7
+
+/** \brief Total function codes with priority (function code without
+ ** exception bit) */
+#define CIAA_MODBUS_GATEWAY_TOTAL_FUNCTIONS  128
+
+/** \brief Max registers read by a merged request */
+#define CIAA_MODBUS_GATEWAY_MERGE_MAX_REGISTERS    125
+
+/** \brief Max coils or discrete inputs read by a merged request */
+#define CIAA_MODBUS_GATEWAY_MERGE_MAX_BITS         2000
+
+/** \brief Max size of a cached response: function, byte count and
+ ** 125 registers */
+#define CIAA_MODBUS_GATEWAY_CACHE_PDU_SIZE   252
+
+/** \brief Size of the message buffer of each client: unit id is kept
+ ** apart, so a PDU of the longest ADU (256 bytes) always fits */
+#define CIAA_MODBUS_GATEWAY_BUFFER_SIZE      256
 
-/** \brief Limit consecutive calls to ciaaModbus_gatewayClientProcess */
+/** \brief Limit consecutive calls to ciaaModbus_gatewayClientProcess
+ ** for each message processed */
 #define CIAA_MODBUS_GATEWAY_LIMIT_CALLS      5
 
+/** \brief Words of the bitmask of clients ready */
+#define CIAA_MODBUS_GATEWAY_READY_WORDS      ((CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS + 31) / 32)
+
+/** \brief Total entries of route table (one by unit id) */
+#define CIAA_MODBUS_GATEWAY_TOTAL_ROUTES     256
+
+#ifndef CIAA_MODBUS_GATEWAY_ADU_BUDGET
+/** \brief Default messages processed by client in each main task */
+#define CIAA_MODBUS_GATEWAY_ADU_BUDGET       1
+#endif
+
 /** \brief state of client in gateway */
 typedef enum
 {
    CIAA_MODBUS_CLIENT_STATE_IDLE = 0,
    CIAA_MODBUS_CLIENT_STATE_ROUTING,
-   CIAA_MODBUS_CLIENT_STATE_SEND_MSG_TO_SERVER,
+   CIAA_MODBUS_CLIENT_STATE_QUEUED,
    CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE,
+   CIAA_MODBUS_CLIENT_STATE_COALESCED,
 }ciaaModbus_clientStateEnum;
 
 /** \brief CIAA Modbus task module
@@ -107,6 +195,24 @@ typedef void (*ciaaModbus_recvMsgType)(int32_t handler, uint8_t *id, uint8_t *pd
  **/
 typedef void (*ciaaModbus_sendMsgType)(int32_t handler, uint8_t id, uint8_t *pdu, uint32_t size);
 
+/** \brief Check if a message can be sent
+ **
+ ** This function tells if the module can take a message now
+ **
+ ** \param[in] handler handler in to module
+ ** \return true if a message can be sent
+ **/
+typedef bool (*ciaaModbus_txReadyType)(int32_t handler);
+
+/** \brief Check if a module has work
+ **
+ ** This function tells if task or recvMsg of the module have work
+ **
+ ** \param[in] handler handler in to module
+ ** \return true if data pending, a message received or a timer running
+ **/
+typedef bool (*ciaaModbus_pendingType)(int32_t handler);
+
 /** \brief Get response timeout
  **
  ** This function return response timeout in milliseconds
@@ -116,27 +222,76 @@ typedef void (*ciaaModbus_sendMsgType)(int32_t handler, uint8_t id, uint8_t *pdu
  **/
 typedef uint32_t (*ciaaModbus_getRespTimeoutType)(int32_t handler);
 
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+/** \brief Cached read response type */
+typedef struct
+{
+   uint32_t expire;                    /** <- time the entry expires
+                                              (milliseconds)                 */
+   uint32_t size;                      /** <- size of response               */
+   uint16_t start;                     /** <- starting address of request    */
+   uint16_t quantity;                  /** <- quantity of registers          */
+   uint8_t id;                         /** <- id of request                  */
+   uint8_t function;                   /** <- function of request            */
+   bool inUse;                         /** <- entry valid                    */
+   uint8_t pdu[CIAA_MODBUS_GATEWAY_CACHE_PDU_SIZE];
+                                       /** <- response                       */
+}ciaaModbus_gatewayCacheType;
+#endif /* #if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0 */
+
 /** \brief Client Modbus type */
 typedef struct
 {
    int32_t handler;                    /** <- handler of module (slave, master,
                                               transport)                     */
-   uint8_t buffer[256];                /** <- buffer to store modbus message
-                                              received TODO: use macro       */
+   uint8_t buffer[CIAA_MODBUS_GATEWAY_BUFFER_SIZE];
+                                       /** <- buffer to store modbus message
+                                              received                       */
    uint32_t size;                      /** <- size of message received       */
    uint32_t timeout;                   /** <- response timeout               */
    int32_t indexServer;                /** <- index server to send message   */
+   int32_t nextClient;                 /** <- index of next client in queue
+                                              of server, -1 if last          */
+   int32_t indexLeader;                /** <- index of client sending the
+                                              same request, -1 if none       */
+   uint32_t queueTick;                 /** <- tick of gateway the client was
+                                              queued                         */
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+   uint16_t mergeStart;                /** <- address of merged request      */
+   uint16_t mergeQuantity;             /** <- quantity of merged request, 0
+                                              if request not merged          */
+   bool noMerge;                       /** <- request not to be merged       */
+#endif
    ciaaModbus_taskType task;           /** <- function task of module (master,
                                               transport)                     */
    ciaaModbus_recvMsgType recvMsg;     /** <- function recvMsg of module
                                               (master, transport)            */
    ciaaModbus_sendMsgType sendMsg;     /** <- function sendMsg of module
                                               (master, transport)            */
+   ciaaModbus_txReadyType txReady;     /** <- function txReady of module,
+                                              NULL if always ready           */
+   ciaaModbus_pendingType pending;     /** <- function pending of module,
+                                              NULL if always with work       */
    ciaaModbus_getRespTimeoutType
    getRespTimeout;                     /** <- function getRespTimeout of
                                               module (master, transport)     */
    ciaaModbus_clientStateEnum state;   /** <- State of client */
    uint8_t id;                         /** <- id of message received         */
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+   uint8_t priority;                   /** <- priority of requests of client */
+#endif
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+   uint32_t deficit;                   /** <- bytes the client may send to
+                                              its server                     */
+#endif
+   uint8_t reqFunction;                /** <- function of request sent       */
+   uint16_t reqStart;                  /** <- address of request sent (write
+                                              address for 0x17)              */
+   uint16_t reqQuantity;               /** <- quantity of request sent (write
+                                              quantity for 0x17), 0 if other
+                                              function                       */
+   bool taskDone;                      /** <- task performed in this main
+                                              task call                      */
    bool inUse;                         /** <- Object in use                  */
 }ciaaModbus_gatewayClientType;
 
@@ -151,9 +306,19 @@ typedef struct
                                               (master, transport)            */
    ciaaModbus_sendMsgType sendMsg;     /** <- function sendMsg of module
                                               (master, transport)            */
+   ciaaModbus_txReadyType txReady;     /** <- function txReady of module,
+                                              NULL if always ready           */
    uint8_t id;                         /** <- id of slave, 0 if it transport */
    bool inUse;                         /** <- Object in use                  */
    bool busy;                          /** <- indicate slave busy */
+   bool discard;                       /** <- response of a removed client
+                                              to be discarded                */
+   uint32_t timeout;                   /** <- response timeout of the
+                                              response discarded             */
+   int32_t queueHead;                  /** <- index of first client waiting
+                                              the server, -1 if none         */
+   int32_t queueTail;                  /** <- index of last client waiting
+                                              the server, -1 if none         */
 }ciaaModbus_gatewayServerType;
 
 
@@ -163,6 +328,51 @@ typedef struct
    bool inUse;
    ciaaModbus_gatewayClientType client[CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS];
    ciaaModbus_gatewayServerType server[CIAA_MODBUS_GATEWAY_TOTAL_SERVERS];
+   int8_t route[CIAA_MODBUS_GATEWAY_TOTAL_ROUTES];
+                                       /** <- index of server by unit id,
+                                              -1 if no server               */
+   uint32_t tick;                      /** <- calls to main task             */
+   uint8_t discardBuffer[CIAA_MODBUS_GATEWAY_BUFFER_SIZE];
+                                       /** <- buffer to receive responses
+                                              discarded                      */
+   uint32_t ready[CIAA_MODBUS_GATEWAY_READY_WORDS];
+                                       /** <- bitmask of clients with work
+                                              in this main task call         */
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+   uint8_t fcnPriority[CIAA_MODBUS_GATEWAY_TOTAL_FUNCTIONS];
+                                       /** <- priority of requests by
+                                              function code                  */
+   uint16_t aging;                     /** <- time a queued request waits to
+                                              raise its priority one level
+                                              (ticks), 0 if no aging         */
+#endif
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+   uint16_t quantum;                   /** <- bytes credited to each client
+                                              queued by round, 0 if arrival
+                                              order                          */
+#endif
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+   bool merge;                         /** <- merge adjacent reads           */
+   uint16_t mergeWindow;               /** <- time a read waits to be merged
+                                              (ticks)                        */
+#endif
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+   uint16_t cacheTtl[CIAA_MODBUS_GATEWAY_TOTAL_ROUTES];
+                                       /** <- time to live of reads cached
+                                              by unit id (ticks), 0 if not
+                                              cached                         */
+   ciaaModbus_gatewayCacheType cache[CIAA_MODBUS_GATEWAY_CACHE_ENTRIES];
+#endif
+#if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH)
+   bool running;                       /** <- run by its own thread, accessed
+                                              atomically                     */
+   int32_t hWaiter;                    /** <- waiter of the reactor of the
+                                              thread                         */
+   pthread_t thread;                   /** <- thread running the gateway     */
+   pthread_mutex_t lock;               /** <- lock of the gateway taken by
+                                              its thread, instead of
+                                              resource MODBUSR               */
+#endif
 }ciaaModbus_gatewayObjType;
 
 
@@ -173,393 +383,2263 @@ static ciaaModbus_gatewayObjType ciaaModbus_gatewayObj[CIAA_MODBUS_TOTAL_GATEWAY
 
 /*==================[internal functions declaration]=========================*/
 
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+static bool ciaaModbus_gatewayMergeWait(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client);
+
+static void ciaaModbus_gatewayMergeRequests(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer);
+#endif
+
 /*==================[internal data definition]===============================*/
 
 /*==================[external data definition]===============================*/
 
+/** \brief RAM used by the gateway objects (bytes) */
+const uint32_t ciaaModbus_gatewayRamSize = sizeof(ciaaModbus_gatewayObj);
+
 /*==================[internal functions definition]==========================*/
 
-/** \brief perform client task in idle mode and
- ** receive message. If receive a correct message, set state
- ** CIAA_MODBUS_CLIENT_STATE_ROUTING
- **
+/** \brief Check if a module can take a message
  **
- ** \param[inout] client pointer to client to process
- ** \return 1  if task pending
- **         0  if done
+ ** \param[in] txReady function txReady of module, NULL if always ready
+ ** \param[in] handler handler of module
+ ** \return true if a message can be sent
  **/
-static int8_t ciaaModbus_gatewayClientStateIdle(ciaaModbus_gatewayClientType *client)
+static bool ciaaModbus_gatewayTxReady(
+      ciaaModbus_txReadyType txReady,
+      int32_t handler)
 {
-   int8_t ret = 0;
-
-   /* perform client task */
-   client->task(client->handler);
+   bool ret = true;
 
-   /* receive message */
-   client->recvMsg(
-         client->handler,
-         &client->id,
-         client->buffer,
-         &client->size);
-
-   /* check if a valid message received */
-   if (client->size >= CIAAMODBUS_REQ_PDU_MINLENGTH)
+   if (NULL != txReady)
    {
-      /* if a valid message received, step next state */
-      client->state = CIAA_MODBUS_CLIENT_STATE_ROUTING;
-
-      /* indicate task pending */
-      ret = 1;
+      ret = txReady(handler);
    }
 
    return ret;
 }
 
-/** \brief Routing message to server
- ** search server with id received. If not found
- ** search server with id 0.
- ** If server found, set state CIAA_MODBUS_CLIENT_STATE_SEND_MSG_TO_SERVER
- ** else set state CIAA_MODBUS_CLIENT_STATE_IDLE
+/** \brief Update the bitmask of clients ready
  **
+ ** A client is ready if it has a request in course or its module has
+ ** work. Clients not ready are not visited by the main task. Servers
+ ** only have work while a client has a request in course, or while they
+ ** discard the response of a removed client.
  **
- ** \param[inout] client pointer to client
- ** \param[in] server array of servers to search
- ** \return 1  if task pending
- **         0  if done
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \return true if any client ready or any server discarding
  **/
-static int8_t ciaaModbus_gatewayClientStateRouting(
-      ciaaModbus_gatewayClientType *client,
-      ciaaModbus_gatewayServerType *servers)
+static bool ciaaModbus_gatewayReadyUpdate(ciaaModbus_gatewayObjType *gatewayObj)
 {
+   ciaaModbus_gatewayClientType *client;
    int32_t loopi;
-   int8_t ret = 0;
+   bool ret = false;
 
-   /* search server with same id */
-   for ( loopi = 0 ;
-         (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret == 0) ;
-         loopi++ )
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_READY_WORDS ; loopi++)
    {
-      /* message id == server id? */
-      if ( (servers[loopi].inUse) && (servers[loopi].id == client->id) )
-      {
-         /* save index server */
-         client->indexServer = loopi;
-
-         /* indicate task pending */
-         ret = 1;
-      }
+      gatewayObj->ready[loopi] = 0;
    }
 
-   /* search server with id == 0 */
-   for ( loopi = 0 ;
-         (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret == 0) ;
-         loopi++ )
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
    {
-      /* message id == server id? */
-      if ( (servers[loopi].inUse) && (0 == servers[loopi].id ) )
-      {
-         /* save index server */
-         client->indexServer = loopi;
+      client = &gatewayObj->client[loopi];
 
-         /* indicate task pending */
-         ret = 1;
+      if ( (client->inUse) &&
+           ( (CIAA_MODBUS_CLIENT_STATE_IDLE != client->state) ||
+             (NULL == client->pending) ||
+             (client->pending(client->handler)) ) )
+      {
+         gatewayObj->ready[loopi / 32] |= (1u << (loopi % 32));
+         ret = true;
       }
    }
 
-   /* if no server found, goto idle state */
-   if (ret == 0)
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS ; loopi++)
    {
-      client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
-   }
-   else
-   {
-      /* else set next step */
-      client->state = CIAA_MODBUS_CLIENT_STATE_SEND_MSG_TO_SERVER;
+      if ( (gatewayObj->server[loopi].inUse) &&
+           (gatewayObj->server[loopi].discard) )
+      {
+         ret = true;
+      }
    }
 
    return ret;
 }
 
-/** \brief Send message to server
- ** check if server is busy. If not busy send message,
- ** set state CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE
- ** load timeout in client, and set server busy flag
+/** \brief Check if a gateway is idle
  **
+ ** The caller shall hold the lock of the gateway: resource MODBUSR, or
+ ** the lock of its thread if run by its own thread.
  **
- ** \param[inout] client pointer to client
- ** \param[inout] server array of servers to send modbus messages
- ** \return 1  if task pending
- **         0  if done
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \return true if idle
  **/
-static int8_t ciaaModbus_gatewayClientStateSendMsgToServer(
-      ciaaModbus_gatewayClientType *client,
-      ciaaModbus_gatewayServerType *servers)
+static bool ciaaModbus_gatewayIdleCheck(ciaaModbus_gatewayObjType *gatewayObj)
 {
-   int8_t ret = 0;
+   bool ret;
+#if (CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0) && (x86 != ARCH)
+   uint32_t loopi;
+#endif
 
-   /* check if server not busy */
-   if (0 == servers[client->indexServer].busy)
+   /* no client with work */
+   ret = (false == ciaaModbus_gatewayReadyUpdate(gatewayObj));
+
+#if (CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0) && (x86 != ARCH)
+   /* on the target time to live of cached reads counted by main task
+    * calls, on the host entries expire while sleeping */
+   for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES) && (ret) ; loopi++)
    {
-      /* set busy flag */
-      servers[client->indexServer].busy = true;
+      if ( (gatewayObj->cache[loopi].inUse) &&
+           (0 < (int32_t)(gatewayObj->cache[loopi].expire - gatewayObj->tick)) )
+      {
+         ret = false;
+      }
+   }
+#endif
 
-      /* send message to server */
-      servers[client->indexServer].sendMsg(
-            servers[client->indexServer].handler,
-            client->id,
-            client->buffer,
-            client->size);
+   return ret;
+}
 
-      /* load timeout */
-      client->timeout = client->getRespTimeout(client->handler) / CIAA_MODBUS_TIME_BASE;
+/** \brief Update route table of a gateway
+ **
+ ** Each unit id is routed to the first server with the same id, else to
+ ** the first server with id 0 (transport), else to no server (-1). The
+ ** table is rebuilt each time a server is added or removed, so routing a
+ ** message takes a single access.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ **/
+static void ciaaModbus_gatewayRouteUpdate(ciaaModbus_gatewayObjType *gatewayObj)
+{
+   int32_t loopi;
+   int8_t defaultServer = -1;
 
-      /* step next state */
-      client->state = CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE;
+   /* search first server with id 0 */
+   for (loopi = CIAA_MODBUS_GATEWAY_TOTAL_SERVERS - 1 ; loopi >= 0 ; loopi--)
+   {
+      if ( (gatewayObj->server[loopi].inUse) &&
+           (0 == gatewayObj->server[loopi].id) )
+      {
+         defaultServer = loopi;
+      }
+   }
 
-      /* indicate task pending */
-      ret = 1;
+   /* route all ids to default server */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_ROUTES ; loopi++)
+   {
+      gatewayObj->route[loopi] = defaultServer;
    }
 
-   return ret;
+   /* route ids of servers, first server takes precedence */
+   for (loopi = CIAA_MODBUS_GATEWAY_TOTAL_SERVERS - 1 ; loopi >= 0 ; loopi--)
+   {
+      if (gatewayObj->server[loopi].inUse)
+      {
+         gatewayObj->route[gatewayObj->server[loopi].id] = loopi;
+      }
+   }
 }
 
-/** \brief Waiting server response
- ** Wait response from server. If received correct message,
- ** send to client, reset busy flag of server and set
- ** state CIAA_MODBUS_CLIENT_STATE_IDLE.
- ** Else, decrement timeout, if reach zero reset busy flag
- ** of server and set state  CIAA_MODBUS_CLIENT_STATE_IDLE
- **
+/** \brief Append a client to the queue of its server
  **
- ** \param[inout] client pointer to client
- ** \param[inout] server array of servers to send modbus messages
- ** \return 1  if task pending
- **         0  if done
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client, routed to a server
  **/
-static int8_t ciaaModbus_gatewayClientStateWaitingServerResponse(
-      ciaaModbus_gatewayClientType *client,
-      ciaaModbus_gatewayServerType *servers)
+static void ciaaModbus_gatewayServerEnqueue(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
 {
-   int8_t ret;
+   ciaaModbus_gatewayServerType *server;
 
-   /* perform server task */
-   servers[client->indexServer].task(
-         servers[client->indexServer].handler);
+   server = &gatewayObj->server[gatewayObj->client[indexClient].indexServer];
 
-   /* receive message */
-   servers[client->indexServer].recvMsg(
-         servers[client->indexServer].handler,
-         &client->id,
-         client->buffer,
-         &client->size);
+   gatewayObj->client[indexClient].nextClient = -1;
 
-   /* check if a valid message received */
-   if (client->size >= CIAAMODBUS_RSP_PDU_MINLENGTH)
+   /* start of batching window and aging */
+   gatewayObj->client[indexClient].queueTick = gatewayObj->tick;
+
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+   /* credit not kept from previous requests */
+   gatewayObj->client[indexClient].deficit = 0;
+#endif
+
+   /* link client after the last one */
+   if (0 > server->queueTail)
    {
-      /* if a valid message received, send to client */
-      client->sendMsg(
-            client->handler,
-            client->id,
-            client->buffer,
-            client->size);
+      server->queueHead = indexClient;
+   }
+   else
+   {
+      gatewayObj->client[server->queueTail].nextClient = indexClient;
+   }
 
-      /* reset busy flag */
-      servers[client->indexServer].busy = false;
+   server->queueTail = indexClient;
+}
 
-      /* step next state: idle */
-      client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+/** \brief Remove a client from the queue of its server
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client in state
+ **            CIAA_MODBUS_CLIENT_STATE_QUEUED
+ **/
+static void ciaaModbus_gatewayServerDequeue(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
+{
+   ciaaModbus_gatewayServerType *server;
+   int32_t prev = -1;
+   int32_t curr;
 
-      /* indicate task pending */
-      ret = 1;
+   server = &gatewayObj->server[gatewayObj->client[indexClient].indexServer];
+
+   /* search client in queue */
+   curr = server->queueHead;
+   while ( (0 <= curr) && (curr != indexClient) )
+   {
+      prev = curr;
+      curr = gatewayObj->client[curr].nextClient;
    }
-   else
+
+   /* unlink client */
+   if (0 <= curr)
    {
-      /* check if timeout reached */
-      if (0 != client->timeout)
+      if (0 > prev)
       {
-         /* decrement timeout */
-         client->timeout--;
+         server->queueHead = gatewayObj->client[curr].nextClient;
       }
       else
       {
-         /* reset busy flag */
-         servers[client->indexServer].busy = false;
+         gatewayObj->client[prev].nextClient = gatewayObj->client[curr].nextClient;
+      }
 
-         /* timeout, step next state: idle */
-         client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+      if (server->queueTail == curr)
+      {
+         server->queueTail = prev;
       }
 
-      /* no task pending */
-      ret = 0;
+      gatewayObj->client[curr].nextClient = -1;
    }
-
-   return ret;
 }
 
-/** \brief Process task of Modbus client
+#if (CIAA_MODBUS_GATEWAY_MERGE > 0) || (CIAA_MODBUS_GATEWAY_PRIORITY > 0)
+/** \brief Insert a client at the front of the queue of its server
  **
- **
- ** \param[inout] client pointer to client to process
- ** \param[inout] server array of servers to send modbus messages
- ** \return 1  if task pending
- **         0  if done
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client, routed to a server
  **/
-static int8_t ciaaModbus_gatewayClientProcess(
-      ciaaModbus_gatewayClientType *client,
-      ciaaModbus_gatewayServerType *servers)
+static void ciaaModbus_gatewayServerPush(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
 {
-   int8_t ret = 0;
+   ciaaModbus_gatewayServerType *server;
 
-   /* check if client in use */
-   if (client->inUse)
-   {
-      /* state client */
-      switch (client->state)
-      {
-         /* client idle state: waiting new message */
-         case CIAA_MODBUS_CLIENT_STATE_IDLE:
-            ret = ciaaModbus_gatewayClientStateIdle(client);
-            break;
+   server = &gatewayObj->server[gatewayObj->client[indexClient].indexServer];
 
-         /* routing message: search a server for the message received */
-         case CIAA_MODBUS_CLIENT_STATE_ROUTING:
-            ret = ciaaModbus_gatewayClientStateRouting(client, servers);
-            break;
+   gatewayObj->client[indexClient].nextClient = server->queueHead;
+   server->queueHead = indexClient;
 
-         /* send message to server: if server not busy, send message */
-         case CIAA_MODBUS_CLIENT_STATE_SEND_MSG_TO_SERVER:
-            ret = ciaaModbus_gatewayClientStateSendMsgToServer(client, servers);
-            break;
+   if (0 > server->queueTail)
+   {
+      server->queueTail = indexClient;
+   }
+}
+#endif /* #if (CIAA_MODBUS_GATEWAY_MERGE > 0) || (CIAA_MODBUS_GATEWAY_PRIORITY > 0) */
 
-         /* wait response from server: perform task and receive response */
-         case CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE:
-            ret = ciaaModbus_gatewayClientStateWaitingServerResponse(client, servers);
-            break;
-      }
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+/** \brief Get bytes a request takes on the link to its server
+ **
+ ** Unit id and pdu of request and of expected response, framing not
+ ** included.
+ **
+ ** \param[in] client pointer to client with the request key taken
+ ** \return cost of request (bytes)
+ **/
+static uint32_t ciaaModbus_gatewayRequestCost(ciaaModbus_gatewayClientType *client)
+{
+   uint32_t ret;
+
+   /* id, function and exception code or echo of write */
+   switch (client->reqFunction)
+   {
+      case CIAA_MODBUS_FCN_READ_COILS:
+      case CIAA_MODBUS_FCN_READ_DISCRETE_INPUTS:
+         ret = 3 + ((client->reqQuantity + 7) / 8);
+         break;
+
+      case CIAA_MODBUS_FCN_READ_HOLDING_REGISTERS:
+      case CIAA_MODBUS_FCN_READ_INPUT_REGISTERS:
+         ret = 3 + (client->reqQuantity * 2);
+         break;
+
+      case CIAA_MODBUS_FCN_READ_WRITE_MULTIPLE_REGISTERS:
+         ret = 3 + (ciaaModbus_readInt(&client->buffer[3]) * 2);
+         break;
+
+      default:
+         ret = 6;
+         break;
    }
 
-   return ret;
+   return ret + 1 + client->size;
 }
 
-/*==================[external functions definition]==========================*/
-extern void ciaaModbus_gatewayInit(void)
+/** \brief Select the next request of a queue by deficit round robin
+ **
+ ** Each round the queued clients are credited the quantum of the
+ ** gateway, and a client sends its request once its credit covers the
+ ** bytes of the request and the response. Clients before the selected
+ ** one are moved to the back of the queue, as the round continues
+ ** after it. Rounds in which no request is sent are performed at once.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server
+ **/
+static void ciaaModbus_gatewayDrrFirst(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
 {
-   int32_t loopi;
-   int32_t loopj;
-
-   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_GATEWAY ; loopi++)
+   ciaaModbus_gatewayServerType *server = &gatewayObj->server[indexServer];
+   ciaaModbus_gatewayClientType *client;
+   int32_t curr;
+   int32_t prev = -1;
+   int32_t first = -1;
+   int32_t firstPrev = -1;
+   uint32_t cost;
+   uint32_t rounds;
+   uint32_t firstRounds = 0;
+
+   /* search first client needing the fewest rounds */
+   for (curr = server->queueHead ; 0 <= curr ; curr = gatewayObj->client[curr].nextClient)
    {
-      ciaaModbus_gatewayObj[loopi].inUse = false;
+      client = &gatewayObj->client[curr];
+      cost = ciaaModbus_gatewayRequestCost(client);
+      rounds = 0;
 
-      for (loopj = 0 ;
-           CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS > loopj ;
-           loopj++)
+      if (client->deficit < cost)
       {
-         ciaaPOSIX_memset(
-               ciaaModbus_gatewayObj[loopi].client[loopj].buffer,
-               0,
-               sizeof(ciaaModbus_gatewayObj[loopi].client[loopj].buffer));
-         ciaaModbus_gatewayObj[loopi].client[loopj].getRespTimeout = NULL;
-         ciaaModbus_gatewayObj[loopi].client[loopj].handler = -1;
-         ciaaModbus_gatewayObj[loopi].client[loopj].id = 0;
-         ciaaModbus_gatewayObj[loopi].client[loopj].inUse = false;
-         ciaaModbus_gatewayObj[loopi].client[loopj].indexServer = -1;
-         ciaaModbus_gatewayObj[loopi].client[loopj].recvMsg = NULL;
-         ciaaModbus_gatewayObj[loopi].client[loopj].sendMsg = NULL;
-         ciaaModbus_gatewayObj[loopi].client[loopj].size = 0;
-         ciaaModbus_gatewayObj[loopi].client[loopj].state = CIAA_MODBUS_CLIENT_STATE_IDLE;
-         ciaaModbus_gatewayObj[loopi].client[loopj].task = NULL;
-         ciaaModbus_gatewayObj[loopi].client[loopj].timeout = 0;
+         rounds = (cost - client->deficit + gatewayObj->quantum - 1) / gatewayObj->quantum;
       }
 
-      for (loopj = 0 ;
-           CIAA_MODBUS_GATEWAY_TOTAL_SERVERS > loopj ;
-           loopj++)
+      if ( (0 > first) || (rounds < firstRounds) )
       {
-         ciaaModbus_gatewayObj[loopi].server[loopj].busy = false;
-         ciaaModbus_gatewayObj[loopi].server[loopj].handler = -1;
-         ciaaModbus_gatewayObj[loopi].server[loopj].id = 0;
-         ciaaModbus_gatewayObj[loopi].server[loopj].inUse = false;
-         ciaaModbus_gatewayObj[loopi].server[loopj].recvMsg = NULL;
-         ciaaModbus_gatewayObj[loopi].server[loopj].sendMsg = NULL;
-         ciaaModbus_gatewayObj[loopi].server[loopj].task = NULL;
+         first = curr;
+         firstPrev = prev;
+         firstRounds = rounds;
+      }
+
+      prev = curr;
+   }
+
+   /* credit clients for the rounds performed, the selected one included */
+   if (0 < firstRounds)
+   {
+      rounds = firstRounds;
+
+      for (curr = server->queueHead ; 0 <= curr ; curr = gatewayObj->client[curr].nextClient)
+      {
+         gatewayObj->client[curr].deficit += rounds * gatewayObj->quantum;
+
+         /* clients after the selected one not visited in last round */
+         if (curr == first)
+         {
+            rounds--;
+         }
       }
    }
+
+   /* clients before the selected one to the back of the queue */
+   if (0 <= firstPrev)
+   {
+      gatewayObj->client[server->queueTail].nextClient = server->queueHead;
+      gatewayObj->client[firstPrev].nextClient = -1;
+      server->queueHead = first;
+      server->queueTail = firstPrev;
+   }
 }
+#endif /* #if CIAA_MODBUS_GATEWAY_DRR > 0 */
 
-extern int32_t ciaaModbus_gatewayOpen(void)
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+/** \brief Get priority of a queued request
+ **
+ ** The priority is the highest of the client and the function, raised
+ ** one level each aging time the request is queued.
+ **
+ ** \param[in] gatewayObj pointer to gateway object
+ ** \param[in] client pointer to client in state
+ **            CIAA_MODBUS_CLIENT_STATE_QUEUED
+ ** \return priority of request
+ **/
+static uint32_t ciaaModbus_gatewayPriority(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client)
 {
-   int32_t hModbusGW = 0;
-   uint32_t loopi;
+   uint32_t ret = client->priority;
+   uint8_t function = client->buffer[0] & 0x7F;
 
-   /* enter critical section */
-   GetResource(MODBUSR);
+   /* priority of function */
+   if (ret < gatewayObj->fcnPriority[function])
+   {
+      ret = gatewayObj->fcnPriority[function];
+   }
 
-   /* search a Gateway Object not in use */
-   while ( (hModbusGW < CIAA_MODBUS_TOTAL_GATEWAY) &&
-           (ciaaModbus_gatewayObj[hModbusGW].inUse == true) )
+   /* aging of request */
+   if (0 < gatewayObj->aging)
    {
-      /* next object */
-      hModbusGW++;
+      ret += (gatewayObj->tick - client->queueTick) / gatewayObj->aging;
+   }
+
+   return ret;
+}
+
+/** \brief Move the request of highest priority to the front of a queue
+ **
+ ** Requests of the same priority keep their arrival order.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server
+ **/
+static void ciaaModbus_gatewayPriorityFirst(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
+{
+   int32_t curr = gatewayObj->server[indexServer].queueHead;
+   int32_t first = curr;
+   uint32_t priority;
+   uint32_t firstPriority = 0;
+
+   /* search first request of highest priority */
+   if (0 <= curr)
+   {
+      firstPriority = ciaaModbus_gatewayPriority(gatewayObj, &gatewayObj->client[curr]);
+      curr = gatewayObj->client[curr].nextClient;
+   }
+
+   while (0 <= curr)
+   {
+      priority = ciaaModbus_gatewayPriority(gatewayObj, &gatewayObj->client[curr]);
+
+      if (priority > firstPriority)
+      {
+         first = curr;
+         firstPriority = priority;
+      }
+
+      curr = gatewayObj->client[curr].nextClient;
+   }
+
+   /* move it to the front */
+   if (first != gatewayObj->server[indexServer].queueHead)
+   {
+      ciaaModbus_gatewayServerDequeue(gatewayObj, first);
+      ciaaModbus_gatewayServerPush(gatewayObj, first);
+   }
+}
+
+/** \brief Set priority of a gateway client
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] handler handler of module of client
+ ** \param[in] task function task of module of client
+ ** \param[in] priority priority of requests of client
+ ** \return 0 if ok
+ **         -1 if client not found
+ **/
+static int8_t ciaaModbus_gatewayClientPriority(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t handler,
+      ciaaModbus_taskType task,
+      uint8_t priority)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+
+   for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+   {
+      if ( (gatewayObj->client[loopi].inUse) &&
+           (gatewayObj->client[loopi].handler == handler) &&
+           (gatewayObj->client[loopi].task == task) )
+      {
+         gatewayObj->client[loopi].priority = priority;
+         ret = 0;
+      }
+   }
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_PRIORITY > 0 */
+
+/** \brief Send the request of the first client waiting a server
+ ** If the server is not busy and can take the message, the first
+ ** client of its queue, or the one of highest priority if priorities
+ ** are enabled, is removed from it, its request is sent,
+ ** its timeout is loaded and its state set to
+ ** CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server
+ **/
+static void ciaaModbus_gatewayServerDispatch(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
+{
+   ciaaModbus_gatewayServerType *server = &gatewayObj->server[indexServer];
+   ciaaModbus_gatewayClientType *client;
+
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+   /* request of client with enough credit first */
+   if ( (false == server->busy) && (0 <= server->queueHead) &&
+        (0 < gatewayObj->quantum) )
+   {
+      ciaaModbus_gatewayDrrFirst(gatewayObj, indexServer);
+   }
+#endif
+
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+   /* request of highest priority first */
+   if (false == server->busy)
+   {
+      ciaaModbus_gatewayPriorityFirst(gatewayObj, indexServer);
+   }
+#endif
+
+   /* check if a client waiting, server not busy and can take the message */
+   if ( (0 <= server->queueHead) &&
+        (false == server->busy) &&
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+        (false == ciaaModbus_gatewayMergeWait(
+              gatewayObj,
+              &gatewayObj->client[server->queueHead])) &&
+#endif
+        (ciaaModbus_gatewayTxReady(server->txReady, server->handler)) )
+   {
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+      /* merge adjacent reads waiting the server */
+      ciaaModbus_gatewayMergeRequests(gatewayObj, indexServer);
+#endif
+
+      client = &gatewayObj->client[server->queueHead];
+
+      /* remove client from queue */
+      server->queueHead = client->nextClient;
+      if (0 > server->queueHead)
+      {
+         server->queueTail = -1;
+      }
+      client->nextClient = -1;
+
+      /* set busy flag */
+      server->busy = true;
+
+      /* send message to server */
+      server->sendMsg(
+            server->handler,
+            client->id,
+            client->buffer,
+            client->size);
+
+      /* load timeout */
+      client->timeout = client->getRespTimeout(client->handler) / CIAA_MODBUS_TIME_BASE;
+
+      /* step next state */
+      client->state = CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE;
+   }
+}
+
+/** \brief Discard the response of a removed client
+ **
+ ** The server is kept busy until the response of the request of the
+ ** removed client is received or its timeout elapses, then the request
+ ** of the next client is sent.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server discarding a response
+ **/
+static void ciaaModbus_gatewayServerDiscard(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
+{
+   ciaaModbus_gatewayServerType *server = &gatewayObj->server[indexServer];
+   uint32_t size;
+   uint8_t id;
+
+   /* perform server task */
+   server->task(server->handler);
+
+   /* receive message, not sent to any client */
+   server->recvMsg(
+         server->handler,
+         &id,
+         gatewayObj->discardBuffer,
+         &size);
+
+   if ( (size >= CIAAMODBUS_RSP_PDU_MINLENGTH) || (0 == server->timeout) )
+   {
+      /* response discarded or timeout, reset busy flag */
+      server->discard = false;
+      server->busy = false;
+
+      /* send request of next client */
+      ciaaModbus_gatewayServerDispatch(gatewayObj, indexServer);
+   }
+   else
+   {
+      /* decrement timeout */
+      server->timeout--;
+   }
+}
+
+/** \brief Remove a server of a gateway
+ **
+ ** Clients routed to the server drop their request and return to
+ ** CIAA_MODBUS_CLIENT_STATE_IDLE, then the route table is updated.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server to remove
+ **/
+static void ciaaModbus_gatewayServerRemove(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
+{
+   int32_t loopi;
+
+   /* drop requests routed to the server */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+   {
+      if ( (gatewayObj->client[loopi].inUse) &&
+           (gatewayObj->client[loopi].indexServer == indexServer) &&
+           (CIAA_MODBUS_CLIENT_STATE_ROUTING < gatewayObj->client[loopi].state) )
+      {
+         gatewayObj->client[loopi].state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+         gatewayObj->client[loopi].indexServer = -1;
+         gatewayObj->client[loopi].nextClient = -1;
+         gatewayObj->client[loopi].indexLeader = -1;
+      }
+   }
+
+   /* set server not in use */
+   gatewayObj->server[indexServer].inUse = false;
+   gatewayObj->server[indexServer].busy = false;
+   gatewayObj->server[indexServer].discard = false;
+   gatewayObj->server[indexServer].handler = -1;
+   gatewayObj->server[indexServer].queueHead = -1;
+   gatewayObj->server[indexServer].queueTail = -1;
+
+   /* server no longer reachable */
+   ciaaModbus_gatewayRouteUpdate(gatewayObj);
+}
+
+/** \brief Take the key of the request received by a client
+ **
+ ** The function, address and quantity of reads and writes of coils and
+ ** registers are stored in the client. The quantity is 0 for other
+ ** requests or malformed ones.
+ **
+ ** \param[inout] client pointer to client with the request received
+ **/
+static void ciaaModbus_gatewayRequestKey(ciaaModbus_gatewayClientType *client)
+{
+   client->reqFunction = client->buffer[0];
+   client->reqStart = 0;
+   client->reqQuantity = 0;
+
+   switch (client->reqFunction)
+   {
+      case CIAA_MODBUS_FCN_READ_COILS:
+      case CIAA_MODBUS_FCN_READ_DISCRETE_INPUTS:
+      case CIAA_MODBUS_FCN_READ_HOLDING_REGISTERS:
+      case CIAA_MODBUS_FCN_READ_INPUT_REGISTERS:
+         if (5 == client->size)
+         {
+            client->reqStart = ciaaModbus_readInt(&client->buffer[1]);
+            client->reqQuantity = ciaaModbus_readInt(&client->buffer[3]);
+         }
+         break;
+
+      case CIAA_MODBUS_FCN_WRITE_SINGLE_REGISTER:
+         if (5 <= client->size)
+         {
+            client->reqStart = ciaaModbus_readInt(&client->buffer[1]);
+            client->reqQuantity = 1;
+         }
+         break;
+
+      case CIAA_MODBUS_FCN_MASK_WRITE_REGISTER:
+         if (7 <= client->size)
+         {
+            client->reqStart = ciaaModbus_readInt(&client->buffer[1]);
+            client->reqQuantity = 1;
+         }
+         break;
+
+      case CIAA_MODBUS_FCN_WRITE_MULTIPLE_REGISTERS:
+         if (5 <= client->size)
+         {
+            client->reqStart = ciaaModbus_readInt(&client->buffer[1]);
+            client->reqQuantity = ciaaModbus_readInt(&client->buffer[3]);
+         }
+         break;
+
+      case CIAA_MODBUS_FCN_READ_WRITE_MULTIPLE_REGISTERS:
+         if (9 <= client->size)
+         {
+            client->reqStart = ciaaModbus_readInt(&client->buffer[5]);
+            client->reqQuantity = ciaaModbus_readInt(&client->buffer[7]);
+         }
+         break;
+
+      default:
+         break;
+   }
+}
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+/** \brief Get time of a gateway
+ **
+ ** On the host a monotonic clock, so a gateway sleeping while idle does
+ ** not extend the time to live of its cached reads. On the target the
+ ** calls to the main task.
+ **
+ ** \param[in] gatewayObj pointer to gateway object
+ ** \return time in milliseconds, wraps around
+ **/
+static uint32_t ciaaModbus_gatewayGetTime(ciaaModbus_gatewayObjType *gatewayObj)
+{
+#if (x86 == ARCH)
+   struct timespec ts;
+
+   (void)gatewayObj;
+
+   (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (uint32_t)(ts.tv_sec * 1000) + (uint32_t)(ts.tv_nsec / 1000000);
+#else
+   return gatewayObj->tick * CIAA_MODBUS_TIME_BASE;
+#endif
+}
+
+/** \brief Invalidate cached reads of a register range
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] id id written, 0 (broadcast) for all
+ ** \param[in] start first register written
+ ** \param[in] quantity quantity of registers written
+ **/
+static void ciaaModbus_gatewayCacheInvalidate(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      uint8_t id,
+      uint16_t start,
+      uint16_t quantity)
+{
+   int32_t loopi;
+   ciaaModbus_gatewayCacheType *entry;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES ; loopi++)
+   {
+      entry = &gatewayObj->cache[loopi];
+
+      /* only holding registers can be written */
+      if ( (entry->inUse) &&
+           (CIAA_MODBUS_FCN_READ_HOLDING_REGISTERS == entry->function) &&
+           ( (0 == id) || (entry->id == id) ) &&
+           ((uint32_t)start < ((uint32_t)entry->start + entry->quantity)) &&
+           ((uint32_t)entry->start < ((uint32_t)start + quantity)) )
+      {
+         entry->inUse = false;
+      }
+   }
+}
+
+/** \brief Answer a request from cache
+ **
+ ** A read of holding or input registers found in cache and not expired
+ ** is answered to the client. A write invalidates the cached reads of
+ ** the registers written.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[inout] client pointer to client with the request received and
+ **               its key taken
+ ** \return true if the request was answered from cache
+ **/
+static bool ciaaModbus_gatewayCacheRequest(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client)
+{
+   int32_t loopi;
+   ciaaModbus_gatewayCacheType *entry;
+   bool ret = false;
+
+   if (0 != client->reqQuantity)
+   {
+      switch (client->reqFunction)
+      {
+         case CIAA_MODBUS_FCN_READ_HOLDING_REGISTERS:
+         case CIAA_MODBUS_FCN_READ_INPUT_REGISTERS:
+            /* search a valid entry with the same key */
+            for (loopi = 0 ;
+                 (loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES) && (false == ret) ;
+                 loopi++)
+            {
+               entry = &gatewayObj->cache[loopi];
+
+               if ( (entry->inUse) &&
+                    (0 < (int32_t)(entry->expire - ciaaModbus_gatewayGetTime(gatewayObj))) &&
+                    (entry->id == client->id) &&
+                    (entry->function == client->reqFunction) &&
+                    (entry->start == client->reqStart) &&
+                    (entry->quantity == client->reqQuantity) )
+               {
+                  /* answer client from cache */
+                  ciaaPOSIX_memcpy(client->buffer, entry->pdu, entry->size);
+                  client->size = entry->size;
+
+                  client->sendMsg(
+                        client->handler,
+                        client->id,
+                        client->buffer,
+                        client->size);
+
+                  ret = true;
+               }
+            }
+            break;
+
+         /* registers written are no longer valid in cache */
+         case CIAA_MODBUS_FCN_WRITE_SINGLE_REGISTER:
+         case CIAA_MODBUS_FCN_WRITE_MULTIPLE_REGISTERS:
+         case CIAA_MODBUS_FCN_MASK_WRITE_REGISTER:
+         case CIAA_MODBUS_FCN_READ_WRITE_MULTIPLE_REGISTERS:
+            ciaaModbus_gatewayCacheInvalidate(
+                  gatewayObj,
+                  client->id,
+                  client->reqStart,
+                  client->reqQuantity);
+            break;
+
+         default:
+            break;
+      }
+   }
+
+   return ret;
+}
+
+/** \brief Store the response of a read in cache
+ **
+ ** Successful reads of unit ids with time to live are stored, taking a
+ ** free or expired entry, else the entry closest to expire. Responses
+ ** of writes invalidate again the registers written, so a read sent
+ ** before the write can not keep stale values.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] client pointer to client with the response received
+ **/
+static void ciaaModbus_gatewayCacheResponse(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client)
+{
+   int32_t loopi;
+   int32_t indexEntry = -1;
+   ciaaModbus_gatewayCacheType *entry;
+
+   switch (client->reqFunction)
+   {
+      case CIAA_MODBUS_FCN_READ_HOLDING_REGISTERS:
+      case CIAA_MODBUS_FCN_READ_INPUT_REGISTERS:
+         if ( (0 != gatewayObj->cacheTtl[client->id]) &&
+              (0 != client->reqQuantity) &&
+              (client->buffer[0] == client->reqFunction) &&
+              (CIAA_MODBUS_GATEWAY_CACHE_PDU_SIZE >= client->size) )
+         {
+            /* search entry with same key */
+            for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES) && (0 > indexEntry) ; loopi++)
+            {
+               entry = &gatewayObj->cache[loopi];
+
+               if ( (entry->inUse) &&
+                    (entry->id == client->id) &&
+                    (entry->function == client->reqFunction) &&
+                    (entry->start == client->reqStart) &&
+                    (entry->quantity == client->reqQuantity) )
+               {
+                  indexEntry = loopi;
+               }
+            }
+
+            /* else search free entry */
+            for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES) && (0 > indexEntry) ; loopi++)
+            {
+               if (false == gatewayObj->cache[loopi].inUse)
+               {
+                  indexEntry = loopi;
+               }
+            }
+
+            /* else take entry closest to expire */
+            if (0 > indexEntry)
+            {
+               indexEntry = 0;
+
+               for (loopi = 1 ; loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES ; loopi++)
+               {
+                  if (0 > (int32_t)(gatewayObj->cache[loopi].expire -
+                                    gatewayObj->cache[indexEntry].expire))
+                  {
+                     indexEntry = loopi;
+                  }
+               }
+            }
+
+            entry = &gatewayObj->cache[indexEntry];
+
+            entry->inUse = true;
+            entry->expire = ciaaModbus_gatewayGetTime(gatewayObj) +
+                            ((uint32_t)gatewayObj->cacheTtl[client->id] * CIAA_MODBUS_TIME_BASE);
+            entry->id = client->id;
+            entry->function = client->reqFunction;
+            entry->start = client->reqStart;
+            entry->quantity = client->reqQuantity;
+            entry->size = client->size;
+            ciaaPOSIX_memcpy(entry->pdu, client->buffer, client->size);
+         }
+         break;
+
+      case CIAA_MODBUS_FCN_WRITE_SINGLE_REGISTER:
+      case CIAA_MODBUS_FCN_WRITE_MULTIPLE_REGISTERS:
+      case CIAA_MODBUS_FCN_MASK_WRITE_REGISTER:
+      case CIAA_MODBUS_FCN_READ_WRITE_MULTIPLE_REGISTERS:
+         if (0 != client->reqQuantity)
+         {
+            ciaaModbus_gatewayCacheInvalidate(
+                  gatewayObj,
+                  client->id,
+                  client->reqStart,
+                  client->reqQuantity);
+         }
+         break;
+
+      default:
+         break;
+   }
+}
+
+/** \brief Discard cached reads of a unit id
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] id id of entries to discard
+ **/
+static void ciaaModbus_gatewayCacheFlush(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      uint8_t id)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_CACHE_ENTRIES ; loopi++)
+   {
+      if (gatewayObj->cache[loopi].id == id)
+      {
+         gatewayObj->cache[loopi].inUse = false;
+      }
+   }
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0 */
+
+/** \brief Search a client sending the same read to a server
+ **
+ ** Reads (functions 0x01 to 0x04) with the same id, function, address and
+ ** quantity as the read received by a client queued or waiting in the
+ ** same server can take its response, so only one of them is sent. The
+ ** read received is compared, not the request sent, as a merged request
+ ** is answered with the part of the read received. Broadcast requests
+ ** have no response and are not coalesced.
+ **
+ ** \param[in] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client with request routed and its key
+ **            taken
+ ** \return index of client sending the request, -1 if none
+ **/
+static int32_t ciaaModbus_gatewayCoalesceSearch(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
+{
+   ciaaModbus_gatewayClientType *client = &gatewayObj->client[indexClient];
+   ciaaModbus_gatewayClientType *leader;
+   int32_t loopi;
+   int32_t ret = -1;
+
+   if ( (0 != client->id) &&
+        (0 != client->reqQuantity) &&
+        (CIAA_MODBUS_FCN_READ_COILS <= client->reqFunction) &&
+        (CIAA_MODBUS_FCN_READ_INPUT_REGISTERS >= client->reqFunction) )
+   {
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (0 > ret) ; loopi++)
+      {
+         leader = &gatewayObj->client[loopi];
+
+         if ( (loopi != indexClient) &&
+              (leader->inUse) &&
+              ( (CIAA_MODBUS_CLIENT_STATE_QUEUED == leader->state) ||
+                (CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE == leader->state) ) &&
+              (leader->indexServer == client->indexServer) &&
+              (leader->id == client->id) &&
+              (leader->reqFunction == client->reqFunction) &&
+              (leader->reqStart == client->reqStart) &&
+              (leader->reqQuantity == client->reqQuantity) )
+         {
+            ret = loopi;
+         }
+      }
+   }
+
+   return ret;
+}
+
+/** \brief Release the clients coalesced with a client
+ **
+ ** The clients coalesced with a released client are released too, the
+ ** depth is bounded by the count of clients as each one is released
+ ** once.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexLeader index of client which sent the request
+ ** \param[in] respond true to send them the response received by the
+ **            client, false to drop their request
+ **/
+static void ciaaModbus_gatewayCoalesceRelease(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexLeader,
+      bool respond)
+{
+   ciaaModbus_gatewayClientType *leader = &gatewayObj->client[indexLeader];
+   ciaaModbus_gatewayClientType *client;
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+   {
+      client = &gatewayObj->client[loopi];
+
+      if ( (client->inUse) &&
+           (CIAA_MODBUS_CLIENT_STATE_COALESCED == client->state) &&
+           (client->indexLeader == indexLeader) )
+      {
+         if (respond)
+         {
+            /* send the same response */
+            client->id = leader->id;
+            client->size = leader->size;
+            ciaaPOSIX_memcpy(client->buffer, leader->buffer, leader->size);
+
+            client->sendMsg(
+                  client->handler,
+                  client->id,
+                  client->buffer,
+                  client->size);
+         }
+
+         client->indexLeader = -1;
+         client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+
+         /* and the clients waiting the client, coalesced before it was
+          * merged */
+         ciaaModbus_gatewayCoalesceRelease(gatewayObj, loopi, respond);
+      }
+   }
+}
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+/** \brief Check if the request of a client can be merged
+ **
+ ** \param[in] gatewayObj pointer to gateway object
+ ** \param[in] client pointer to client
+ ** \return true if the request is a read which can be merged
+ **/
+static bool ciaaModbus_gatewayMergeable(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client)
+{
+   return ( (gatewayObj->merge) &&
+            (false == client->noMerge) &&
+            (0 != client->id) &&
+            (0 != client->reqQuantity) &&
+            (CIAA_MODBUS_FCN_READ_COILS <= client->reqFunction) &&
+            (CIAA_MODBUS_FCN_READ_INPUT_REGISTERS >= client->reqFunction) );
+}
+
+/** \brief Check if a queued read waits other reads to be merged
+ **
+ ** \param[in] gatewayObj pointer to gateway object
+ ** \param[in] client pointer to client first in queue
+ ** \return true if the batching window of the read is not elapsed
+ **/
+static bool ciaaModbus_gatewayMergeWait(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      ciaaModbus_gatewayClientType *client)
+{
+   return ( (ciaaModbus_gatewayMergeable(gatewayObj, client)) &&
+            ((gatewayObj->tick - client->queueTick) < gatewayObj->mergeWindow) );
+}
+
+/** \brief Merge the reads waiting a server with the first one
+ **
+ ** Reads of the same id and function whose addresses overlap or are
+ ** adjacent to the range of the first client in queue are removed from
+ ** the queue and attached to it in state
+ ** CIAA_MODBUS_CLIENT_STATE_COALESCED, while the merged range does not
+ ** exceed the maximum of one request. The request of the first client
+ ** is rewritten with the merged range.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexServer index of server with clients in queue
+ **/
+static void ciaaModbus_gatewayMergeRequests(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexServer)
+{
+   int32_t indexHead = gatewayObj->server[indexServer].queueHead;
+   ciaaModbus_gatewayClientType *head = &gatewayObj->client[indexHead];
+   ciaaModbus_gatewayClientType *client;
+   int32_t curr;
+   int32_t next;
+   uint32_t start;
+   uint32_t end;
+   uint32_t newStart;
+   uint32_t newEnd;
+   uint32_t max;
+   bool merged = false;
+   bool added;
+
+   head->mergeQuantity = 0;
+
+   if (ciaaModbus_gatewayMergeable(gatewayObj, head))
+   {
+      start = head->reqStart;
+      end = start + head->reqQuantity;
+
+      if ( (CIAA_MODBUS_FCN_READ_COILS == head->reqFunction) ||
+           (CIAA_MODBUS_FCN_READ_DISCRETE_INPUTS == head->reqFunction) )
+      {
+         max = CIAA_MODBUS_GATEWAY_MERGE_MAX_BITS;
+      }
+      else
+      {
+         max = CIAA_MODBUS_GATEWAY_MERGE_MAX_REGISTERS;
+      }
+
+      /* repeat while a read is merged, it may join others */
+      do
+      {
+         added = false;
+
+         curr = head->nextClient;
+         while (0 <= curr)
+         {
+            client = &gatewayObj->client[curr];
+            next = client->nextClient;
+
+            /* range merged with the read */
+            newStart = (client->reqStart < start) ? client->reqStart : start;
+            newEnd = (uint32_t)client->reqStart + client->reqQuantity;
+            newEnd = (newEnd > end) ? newEnd : end;
+
+            /* same id and function, adjacent or overlapping range */
+            if ( (ciaaModbus_gatewayMergeable(gatewayObj, client)) &&
+                 (client->id == head->id) &&
+                 (client->reqFunction == head->reqFunction) &&
+                 (client->reqStart <= end) &&
+                 (((uint32_t)client->reqStart + client->reqQuantity) >= start) &&
+                 ((newEnd - newStart) <= max) )
+            {
+               /* take the read out of the queue */
+               ciaaModbus_gatewayServerDequeue(gatewayObj, curr);
+
+               /* response taken from the one of first client */
+               client->state = CIAA_MODBUS_CLIENT_STATE_COALESCED;
+               client->indexLeader = indexHead;
+
+               /* extend merged range */
+               start = newStart;
+               end = newEnd;
+
+               merged = true;
+               added = true;
+            }
+
+            curr = next;
+         }
+      }while (added);
+
+      if (merged)
+      {
+         /* request merged range */
+         head->mergeStart = start;
+         head->mergeQuantity = end - start;
+         ciaaModbus_writeInt(&head->buffer[1], head->mergeStart);
+         ciaaModbus_writeInt(&head->buffer[3], head->mergeQuantity);
+      }
+   }
+}
+
+/** \brief Take the response of a client from a merged response
+ **
+ ** \param[out] dst buffer to store the response, may be src
+ ** \param[in] src merged response
+ ** \param[in] offset address of the client read minus the merged one
+ ** \param[in] quantity quantity of the client read
+ ** \return size of response
+ **/
+static uint32_t ciaaModbus_gatewayMergeSlice(
+      uint8_t *dst,
+      uint8_t const *src,
+      uint32_t offset,
+      uint32_t quantity)
+{
+   uint32_t loopi;
+   uint32_t count;
+   uint8_t bit;
+
+   if ( (CIAA_MODBUS_FCN_READ_COILS == src[0]) ||
+        (CIAA_MODBUS_FCN_READ_DISCRETE_INPUTS == src[0]) )
+   {
+      count = (quantity + 7) / 8;
+
+      /* bits copied forward, so src and dst may be the same */
+      for (loopi = 0 ; loopi < quantity ; loopi++)
+      {
+         bit = (src[2 + ((offset + loopi) / 8)] >> ((offset + loopi) % 8)) & 0x01;
+
+         dst[2 + (loopi / 8)] &= ~(1 << (loopi % 8));
+         dst[2 + (loopi / 8)] |= bit << (loopi % 8);
+      }
+
+      /* unused bits of last byte are zero */
+      if (0 != (quantity % 8))
+      {
+         dst[2 + count - 1] &= (1 << (quantity % 8)) - 1;
+      }
+   }
+   else
+   {
+      count = 2 * quantity;
+
+      for (loopi = 0 ; loopi < count ; loopi++)
+      {
+         dst[2 + loopi] = src[2 + (2 * offset) + loopi];
+      }
+   }
+
+   dst[0] = src[0];
+   dst[1] = count;
+
+   return 2 + count;
+}
+
+/** \brief Split the response of a merged request
+ **
+ ** If the response is correct, each client merged takes its part of it
+ ** and is answered, and the first client keeps its own part. Else the
+ ** reads are queued again in the server to be sent apart.
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexHead index of client which sent the merged request
+ ** \return true if the response was split, false if the reads were
+ **         queued again
+ **/
+static bool ciaaModbus_gatewayMergeSplit(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexHead)
+{
+   ciaaModbus_gatewayClientType *head = &gatewayObj->client[indexHead];
+   ciaaModbus_gatewayClientType *client;
+   int32_t loopi;
+   uint32_t count;
+   bool ret;
+
+   /* expected byte count of merged response */
+   if ( (CIAA_MODBUS_FCN_READ_COILS == head->reqFunction) ||
+        (CIAA_MODBUS_FCN_READ_DISCRETE_INPUTS == head->reqFunction) )
+   {
+      count = (head->mergeQuantity + 7) / 8;
+   }
+   else
+   {
+      count = 2 * head->mergeQuantity;
+   }
+
+   ret = ( (head->buffer[0] == head->reqFunction) &&
+           (head->buffer[1] == count) &&
+           (head->size == (2 + count)) );
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+   {
+      client = &gatewayObj->client[loopi];
+
+      if ( (client->inUse) &&
+           (CIAA_MODBUS_CLIENT_STATE_COALESCED == client->state) &&
+           (client->indexLeader == indexHead) )
+      {
+         if (ret)
+         {
+            /* answer the part of the client */
+            client->id = head->id;
+            client->size = ciaaModbus_gatewayMergeSlice(
+                  client->buffer,
+                  head->buffer,
+                  client->reqStart - head->mergeStart,
+                  client->reqQuantity);
+
+            client->sendMsg(
+                  client->handler,
+                  client->id,
+                  client->buffer,
+                  client->size);
+
+            client->indexLeader = -1;
+            client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+
+            /* and to clients waiting the same response */
+            ciaaModbus_gatewayCoalesceRelease(gatewayObj, loopi, true);
+         }
+         else if ( (client->reqStart != head->reqStart) ||
+                   (client->reqQuantity != head->reqQuantity) )
+         {
+            /* send the read apart, clients with the same read wait the
+             * first client */
+            client->indexLeader = -1;
+            client->noMerge = true;
+            client->state = CIAA_MODBUS_CLIENT_STATE_QUEUED;
+            ciaaModbus_gatewayServerPush(gatewayObj, loopi);
+         }
+      }
+   }
+
+   if (ret)
+   {
+      /* first client keeps its own part */
+      head->size = ciaaModbus_gatewayMergeSlice(
+            head->buffer,
+            head->buffer,
+            head->reqStart - head->mergeStart,
+            head->reqQuantity);
+   }
+   else
+   {
+      /* send own read again, first in queue */
+      head->buffer[0] = head->reqFunction;
+      ciaaModbus_writeInt(&head->buffer[1], head->reqStart);
+      ciaaModbus_writeInt(&head->buffer[3], head->reqQuantity);
+      head->size = 5;
+      head->noMerge = true;
+      head->state = CIAA_MODBUS_CLIENT_STATE_QUEUED;
+      ciaaModbus_gatewayServerPush(gatewayObj, indexHead);
+   }
+
+   head->mergeQuantity = 0;
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_MERGE > 0 */
+
+/** \brief perform client task in idle mode and
+ ** receive message if the client can take its response.
+ ** If receive a correct message, set state
+ ** CIAA_MODBUS_CLIENT_STATE_ROUTING
+ ** The task is performed once by main task call, so all the
+ ** messages received by it may be processed in the same call.
+ **
+ **
+ ** \param[inout] client pointer to client to process
+ ** \return 1  if task pending
+ **         0  if done
+ **/
+static int8_t ciaaModbus_gatewayClientStateIdle(ciaaModbus_gatewayClientType *client)
+{
+   int8_t ret = 0;
+
+   /* perform client task if not done in this main task call */
+   if (false == client->taskDone)
+   {
+      client->task(client->handler);
+
+      client->taskDone = true;
+   }
+
+   /* no request is taken while its response can not be sent */
+   if (ciaaModbus_gatewayTxReady(client->txReady, client->handler))
+   {
+      /* receive message */
+      client->recvMsg(
+            client->handler,
+            &client->id,
+            client->buffer,
+            &client->size);
+   }
+   else
+   {
+      client->size = 0;
+   }
+
+   /* check if a valid message received */
+   if (client->size >= CIAAMODBUS_REQ_PDU_MINLENGTH)
+   {
+      /* if a valid message received, step next state */
+      client->state = CIAA_MODBUS_CLIENT_STATE_ROUTING;
+
+      /* indicate task pending */
+      ret = 1;
+   }
+
+   return ret;
+}
+
+/** \brief Routing message to server
+ ** take the server of the id received from the route table.
+ ** If server found and other client sends the same read, set state
+ ** CIAA_MODBUS_CLIENT_STATE_COALESCED to take its response. Else append
+ ** the client to the queue of the server, set state
+ ** CIAA_MODBUS_CLIENT_STATE_QUEUED and send the request if the server
+ ** is free. If no server found set state CIAA_MODBUS_CLIENT_STATE_IDLE
+ **
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client
+ ** \return 1  if task pending
+ **         0  if done
+ **/
+static int8_t ciaaModbus_gatewayClientStateRouting(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
+{
+   ciaaModbus_gatewayClientType *client = &gatewayObj->client[indexClient];
+   int8_t ret = 0;
+
+   /* get index server of message id */
+   client->indexServer = gatewayObj->route[client->id];
+
+   /* take function, address and quantity of request */
+   ciaaModbus_gatewayRequestKey(client);
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+   client->noMerge = false;
+   client->mergeQuantity = 0;
+#endif
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+   /* reads found in cache are answered without server */
+   if ( (0 <= client->indexServer) &&
+        (ciaaModbus_gatewayCacheRequest(gatewayObj, client)) )
+   {
+      /* step next state: idle */
+      client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+
+      /* indicate task pending */
+      ret = 1;
+   }
+   else
+#endif
+   /* if no server found, goto idle state */
+   if (0 > client->indexServer)
+   {
+      client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+   }
+   else
+   {
+      /* search the same read sent by other client */
+      client->indexLeader = ciaaModbus_gatewayCoalesceSearch(gatewayObj, indexClient);
+
+      if (0 <= client->indexLeader)
+      {
+         /* wait the response of the other client */
+         client->state = CIAA_MODBUS_CLIENT_STATE_COALESCED;
+      }
+      else
+      {
+         /* else wait the server in arrival order */
+         client->state = CIAA_MODBUS_CLIENT_STATE_QUEUED;
+
+         ciaaModbus_gatewayServerEnqueue(gatewayObj, indexClient);
+
+         /* send request now if server free */
+         ciaaModbus_gatewayServerDispatch(gatewayObj, client->indexServer);
+
+         /* indicate task pending if request sent */
+         if (CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE == client->state)
+         {
+            ret = 1;
+         }
+      }
+   }
+
+   return ret;
+}
+
+/** \brief Waiting server response
+ ** Wait response from server. If received correct message,
+ ** send to client, reset busy flag of server and set
+ ** state CIAA_MODBUS_CLIENT_STATE_IDLE.
+ ** Else, decrement timeout, if reach zero reset busy flag
+ ** of server and set state  CIAA_MODBUS_CLIENT_STATE_IDLE.
+ ** Once the server is free, the request of next client in its queue
+ ** is sent.
+ **
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client
+ ** \return 1  if task pending
+ **         0  if done
+ **/
+static int8_t ciaaModbus_gatewayClientStateWaitingServerResponse(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
+{
+   ciaaModbus_gatewayClientType *client = &gatewayObj->client[indexClient];
+   ciaaModbus_gatewayServerType *server = &gatewayObj->server[client->indexServer];
+   uint32_t size;
+   uint8_t id;
+   bool respond = true;
+   int8_t ret;
+
+   /* perform server task */
+   server->task(server->handler);
+
+   /* receive message, id and size of request kept until response */
+   server->recvMsg(
+         server->handler,
+         &id,
+         client->buffer,
+         &size);
+
+   /* check if a valid message received */
+   if (size >= CIAAMODBUS_RSP_PDU_MINLENGTH)
+   {
+      client->id = id;
+      client->size = size;
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+      /* answer clients merged, or send reads apart if failed */
+      if (0 != client->mergeQuantity)
+      {
+         respond = ciaaModbus_gatewayMergeSplit(gatewayObj, indexClient);
+      }
+#endif
+
+      if (respond)
+      {
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+         /* keep response of reads */
+         ciaaModbus_gatewayCacheResponse(gatewayObj, client);
+#endif
+
+         /* if a valid message received, send to client */
+         client->sendMsg(
+               client->handler,
+               client->id,
+               client->buffer,
+               client->size);
+
+         /* and to clients waiting the same response */
+         ciaaModbus_gatewayCoalesceRelease(gatewayObj, indexClient, true);
+
+         /* step next state: idle */
+         client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+      }
+
+      /* reset busy flag */
+      server->busy = false;
+
+      /* send request of next client */
+      ciaaModbus_gatewayServerDispatch(gatewayObj, client->indexServer);
+
+      /* indicate task pending */
+      ret = 1;
+   }
+   else
+   {
+      /* check if timeout reached */
+      if (0 != client->timeout)
+      {
+         /* decrement timeout */
+         client->timeout--;
+      }
+      else
+      {
+         /* reset busy flag */
+         server->busy = false;
+
+         /* timeout, step next state: idle */
+         client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+         client->mergeQuantity = 0;
+#endif
+
+         /* clients waiting the same response drop their request */
+         ciaaModbus_gatewayCoalesceRelease(gatewayObj, indexClient, false);
+
+         /* send request of next client */
+         ciaaModbus_gatewayServerDispatch(gatewayObj, client->indexServer);
+      }
+
+      /* no task pending */
+      ret = 0;
+   }
+
+   return ret;
+}
+
+/** \brief Process task of Modbus client
+ **
+ **
+ ** \param[inout] gatewayObj pointer to gateway object
+ ** \param[in] indexClient index of client to process
+ ** \return 1  if task pending
+ **         0  if done
+ **/
+static int8_t ciaaModbus_gatewayClientProcess(
+      ciaaModbus_gatewayObjType *gatewayObj,
+      int32_t indexClient)
+{
+   ciaaModbus_gatewayClientType *client = &gatewayObj->client[indexClient];
+   int8_t ret = 0;
+
+   /* check if client in use */
+   if (client->inUse)
+   {
+      /* state client */
+      switch (client->state)
+      {
+         /* client idle state: waiting new message */
+         case CIAA_MODBUS_CLIENT_STATE_IDLE:
+            ret = ciaaModbus_gatewayClientStateIdle(client);
+            break;
+
+         /* routing message: search a server for the message received */
+         case CIAA_MODBUS_CLIENT_STATE_ROUTING:
+            ret = ciaaModbus_gatewayClientStateRouting(gatewayObj, indexClient);
+            break;
+
+         /* queued: request sent by server when free */
+         case CIAA_MODBUS_CLIENT_STATE_QUEUED:
+            break;
+
+         /* coalesced: response sent with the one of other client */
+         case CIAA_MODBUS_CLIENT_STATE_COALESCED:
+            break;
+
+         /* wait response from server: perform task and receive response */
+         case CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE:
+            ret = ciaaModbus_gatewayClientStateWaitingServerResponse(gatewayObj, indexClient);
+            break;
+      }
+   }
+
+   return ret;
+}
+
+#if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH)
+/** \brief Thread running a gateway
+ **
+ ** Calls the main task each time base. While the gateway is idle the
+ ** thread sleeps on its waiter until one of its ports has data or a
+ ** message is put in a loopback channel, then the time base restarts.
+ ** The ports move to the waiter when the main task first checks them.
+ ** The thread is not an OSEK task, it takes the lock of the gateway
+ ** instead of resource MODBUSR.
+ **
+ ** \param[in] param handler of the gateway
+ ** \return NULL
+ **/
+static void *ciaaModbus_gatewayThread(void *param)
+{
+   int32_t hModbusGW = (int32_t)(intptr_t)param;
+   struct timespec next;
+   bool idle;
+
+   /* poll only the ports of this gateway */
+   ciaaModbus_reactorWaiterBind(ciaaModbus_gatewayObj[hModbusGW].hWaiter);
+
+   (void)clock_gettime(CLOCK_MONOTONIC, &next);
+
+   while (__atomic_load_n(&ciaaModbus_gatewayObj[hModbusGW].running, __ATOMIC_ACQUIRE))
+   {
+      (void)pthread_mutex_lock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+      ciaaModbus_gatewayMainTask(hModbusGW);
+      (void)pthread_mutex_unlock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+
+      /* sleep until next time base, not drifting with the main task */
+      next.tv_nsec += CIAA_MODBUS_TIME_BASE * 1000000L;
+      if (1000000000L <= next.tv_nsec)
+      {
+         next.tv_sec++;
+         next.tv_nsec -= 1000000000L;
+      }
+
+      (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+      (void)pthread_mutex_lock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+      idle = ciaaModbus_gatewayIdleCheck(&ciaaModbus_gatewayObj[hModbusGW]);
+      (void)pthread_mutex_unlock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+
+      /* nothing to do until a port has data or a wake up */
+      if (idle)
+      {
+         ciaaModbus_reactorWaiterWait(ciaaModbus_gatewayObj[hModbusGW].hWaiter, -1);
+
+         (void)clock_gettime(CLOCK_MONOTONIC, &next);
+      }
+   }
+
+   return NULL;
+}
+#endif /* #if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH) */
+
+/*==================[external functions definition]==========================*/
+extern void ciaaModbus_gatewayInit(void)
+{
+   int32_t loopi;
+   int32_t loopj;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_GATEWAY ; loopi++)
+   {
+      ciaaModbus_gatewayObj[loopi].inUse = false;
+
+      for (loopj = 0 ;
+           CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS > loopj ;
+           loopj++)
+      {
+         ciaaPOSIX_memset(
+               ciaaModbus_gatewayObj[loopi].client[loopj].buffer,
+               0,
+               sizeof(ciaaModbus_gatewayObj[loopi].client[loopj].buffer));
+         ciaaModbus_gatewayObj[loopi].client[loopj].getRespTimeout = NULL;
+         ciaaModbus_gatewayObj[loopi].client[loopj].pending = NULL;
+         ciaaModbus_gatewayObj[loopi].client[loopj].handler = -1;
+         ciaaModbus_gatewayObj[loopi].client[loopj].id = 0;
+         ciaaModbus_gatewayObj[loopi].client[loopj].inUse = false;
+         ciaaModbus_gatewayObj[loopi].client[loopj].indexServer = -1;
+         ciaaModbus_gatewayObj[loopi].client[loopj].nextClient = -1;
+         ciaaModbus_gatewayObj[loopi].client[loopj].indexLeader = -1;
+         ciaaModbus_gatewayObj[loopi].client[loopj].recvMsg = NULL;
+         ciaaModbus_gatewayObj[loopi].client[loopj].sendMsg = NULL;
+         ciaaModbus_gatewayObj[loopi].client[loopj].size = 0;
+         ciaaModbus_gatewayObj[loopi].client[loopj].state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+         ciaaModbus_gatewayObj[loopi].client[loopj].task = NULL;
+         ciaaModbus_gatewayObj[loopi].client[loopj].taskDone = false;
+         ciaaModbus_gatewayObj[loopi].client[loopj].timeout = 0;
+      }
+
+      for (loopj = 0 ;
+           CIAA_MODBUS_GATEWAY_TOTAL_SERVERS > loopj ;
+           loopj++)
+      {
+         ciaaModbus_gatewayObj[loopi].server[loopj].busy = false;
+         ciaaModbus_gatewayObj[loopi].server[loopj].discard = false;
+         ciaaModbus_gatewayObj[loopi].server[loopj].handler = -1;
+         ciaaModbus_gatewayObj[loopi].server[loopj].id = 0;
+         ciaaModbus_gatewayObj[loopi].server[loopj].inUse = false;
+         ciaaModbus_gatewayObj[loopi].server[loopj].recvMsg = NULL;
+         ciaaModbus_gatewayObj[loopi].server[loopj].sendMsg = NULL;
+         ciaaModbus_gatewayObj[loopi].server[loopj].task = NULL;
+         ciaaModbus_gatewayObj[loopi].server[loopj].queueHead = -1;
+         ciaaModbus_gatewayObj[loopi].server[loopj].queueTail = -1;
+      }
+
+      /* no route available */
+      ciaaModbus_gatewayRouteUpdate(&ciaaModbus_gatewayObj[loopi]);
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+      /* no reads cached */
+      ciaaPOSIX_memset(
+            &ciaaModbus_gatewayObj[loopi].cacheTtl,
+            0,
+            sizeof(ciaaModbus_gatewayObj[loopi].cacheTtl));
+      ciaaPOSIX_memset(
+            &ciaaModbus_gatewayObj[loopi].cache,
+            0,
+            sizeof(ciaaModbus_gatewayObj[loopi].cache));
+#endif
+
+      ciaaModbus_gatewayObj[loopi].tick = 0;
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+      ciaaModbus_gatewayObj[loopi].merge = false;
+      ciaaModbus_gatewayObj[loopi].mergeWindow = 0;
+#endif
+
+#if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH)
+      ciaaModbus_gatewayObj[loopi].running = false;
+      ciaaModbus_gatewayObj[loopi].hWaiter = -1;
+      (void)pthread_mutex_init(&ciaaModbus_gatewayObj[loopi].lock, NULL);
+#endif
+   }
+}
+
+extern int32_t ciaaModbus_gatewayOpen(void)
+{
+   int32_t hModbusGW = 0;
+   uint32_t loopi;
+
+   /* enter critical section */
+   GetResource(MODBUSR);
+
+   /* search a Gateway Object not in use */
+   while ( (hModbusGW < CIAA_MODBUS_TOTAL_GATEWAY) &&
+           (ciaaModbus_gatewayObj[hModbusGW].inUse == true) )
+   {
+      /* next object */
+      hModbusGW++;
    }
 
    /* if object available, use it */
    if (hModbusGW != CIAA_MODBUS_TOTAL_GATEWAY)
    {
-      /* set object in use */
-      ciaaModbus_gatewayObj[hModbusGW].inUse = true;
+      /* set object in use */
+      ciaaModbus_gatewayObj[hModbusGW].inUse = true;
+
+      /* set servers not in use */
+      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS ; loopi++)
+      {
+         ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = false;
+      }
+
+      /* set clients not in use */
+      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+      {
+         ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = false;
+      }
+
+      /* no route available */
+      ciaaModbus_gatewayRouteUpdate(&ciaaModbus_gatewayObj[hModbusGW]);
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+      /* reads not merged */
+      ciaaModbus_gatewayObj[hModbusGW].merge = false;
+      ciaaModbus_gatewayObj[hModbusGW].mergeWindow = 0;
+#endif
+
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+      /* all functions of lowest priority, no aging */
+      ciaaPOSIX_memset(
+            &ciaaModbus_gatewayObj[hModbusGW].fcnPriority,
+            0,
+            sizeof(ciaaModbus_gatewayObj[hModbusGW].fcnPriority));
+      ciaaModbus_gatewayObj[hModbusGW].aging = 0;
+#endif
+
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+      /* requests in arrival order */
+      ciaaModbus_gatewayObj[hModbusGW].quantum = 0;
+#endif
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+      /* no reads cached */
+      ciaaPOSIX_memset(
+            &ciaaModbus_gatewayObj[hModbusGW].cacheTtl,
+            0,
+            sizeof(ciaaModbus_gatewayObj[hModbusGW].cacheTtl));
+      ciaaPOSIX_memset(
+            &ciaaModbus_gatewayObj[hModbusGW].cache,
+            0,
+            sizeof(ciaaModbus_gatewayObj[hModbusGW].cache));
+#endif
+   }
+   else
+   {
+      /* if no object available, return invalid handler */
+      hModbusGW = -1;
+   }
+
+   /* exit critical section */
+   ReleaseResource(MODBUSR);
+
+   return hModbusGW;
+}
+
+#if CIAA_MODBUS_TOTAL_SLAVES > 0
+extern int8_t ciaaModbus_gatewayAddSlave(
+      int32_t hModbusGW,
+      int32_t hModbusSlave)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+
+   if ( (0 <= hModbusSlave) && (0 <= hModbusGW) )
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
+      {
+         if (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse == false)
+         {
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = true;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler = hModbusSlave;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].busy = false;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].discard = false;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].queueHead = -1;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].queueTail = -1;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].id = ciaaModbus_slaveGetId(hModbusSlave);
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].recvMsg = ciaaModbus_slaveRecvMsg;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].sendMsg = ciaaModbus_slaveSendMsg;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].task = ciaaModbus_slaveTask;
+            ciaaModbus_gatewayObj[hModbusGW].server[loopi].txReady = NULL;
+            ret = 0;
+         }
+      }
+
+      /* route id of slave */
+      if (0 == ret)
+      {
+         ciaaModbus_gatewayRouteUpdate(&ciaaModbus_gatewayObj[hModbusGW]);
+      }
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
+}
+
+extern int8_t ciaaModbus_gatewayRemoveSlave(
+      int32_t hModbusGW,
+      int32_t hModbusSlave)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+
+   if ( (0 <= hModbusSlave) && (0 <= hModbusGW) )
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
+      {
+         if ( (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse) &&
+              (ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler == hModbusSlave) &&
+              (ciaaModbus_gatewayObj[hModbusGW].server[loopi].task == ciaaModbus_slaveTask) )
+         {
+            ciaaModbus_gatewayServerRemove(&ciaaModbus_gatewayObj[hModbusGW], loopi);
+            ret = 0;
+         }
+      }
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_TOTAL_SLAVES > 0 */
+
+#if CIAA_MODBUS_TOTAL_MASTERS > 0
+extern int8_t ciaaModbus_gatewayAddMaster(
+      int32_t hModbusGW,
+      int32_t hModbusMaster)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+
+   if ( (0 <= hModbusGW) && (0 <= hModbusMaster))
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+      {
+         if (ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse == false)
+         {
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = true;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].handler = hModbusMaster;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].recvMsg = ciaaModbus_masterRecvMsg;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].sendMsg = ciaaModbus_masterSendMsg;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].task = ciaaModbus_masterTask;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].txReady = NULL;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].pending = NULL;
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].getRespTimeout = ciaaModbus_masterGetRespTimeout;
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].priority = 0;
+#endif
+            ret = 0;
+         }
+      }
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_TOTAL_MASTERS > 0 */
+
+extern int8_t ciaaModbus_gatewayAddTransport(
+      int32_t hModbusGW,
+      int32_t hModbusTransport)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+   int8_t transportType;
+
+   if ( (0 <= hModbusTransport) && (0 <= hModbusGW) )
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      transportType = ciaaModbus_transportGetType(hModbusTransport);
+
+      if (transportType == CIAAMODBUS_TRANSPORT_TYPE_SLAVE)
+      {
+         /* transport slave -> client */
+         for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+         {
+            if (ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse == false)
+            {
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = true;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].handler = hModbusTransport;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].recvMsg = ciaaModbus_transportRecvMsg;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].sendMsg = ciaaModbus_transportSendMsg;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].task = ciaaModbus_transportTask;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].txReady = ciaaModbus_transportTxReady;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].pending = ciaaModbus_transportPending;
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].getRespTimeout = ciaaModbus_transportGetRespTimeout;
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+               ciaaModbus_gatewayObj[hModbusGW].client[loopi].priority = 0;
+#endif
+               ret = 0;
+            }
+         }
+      }
+      else if (transportType == CIAAMODBUS_TRANSPORT_TYPE_MASTER)
+      {
+             /* transport master -> server */
+         for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
+         {
+            if (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse == false)
+            {
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = true;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler = hModbusTransport;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].busy = false;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].discard = false;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].queueHead = -1;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].queueTail = -1;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].id = 0;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].recvMsg = ciaaModbus_transportRecvMsg;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].sendMsg = ciaaModbus_transportSendMsg;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].task = ciaaModbus_transportTask;
+               ciaaModbus_gatewayObj[hModbusGW].server[loopi].txReady = ciaaModbus_transportTxReady;
+               ret = 0;
+            }
+         }
+
+         /* route ids without slave to transport */
+         if (0 == ret)
+         {
+            ciaaModbus_gatewayRouteUpdate(&ciaaModbus_gatewayObj[hModbusGW]);
+         }
+      }
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
+}
+
+extern int8_t ciaaModbus_gatewayRemoveTransport(
+      int32_t hModbusGW,
+      int32_t hModbusTransport)
+{
+   uint32_t loopi;
+   int8_t ret = -1;
+   ciaaModbus_gatewayClientType *client;
+
+   if ( (0 <= hModbusTransport) && (0 <= hModbusGW) )
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      /* transport slave -> client */
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+      {
+         client = &ciaaModbus_gatewayObj[hModbusGW].client[loopi];
+
+         if ( (client->inUse) &&
+              (client->handler == hModbusTransport) &&
+              (client->task == ciaaModbus_transportTask) )
+         {
+            /* leave queue of server */
+            if (CIAA_MODBUS_CLIENT_STATE_QUEUED == client->state)
+            {
+               ciaaModbus_gatewayServerDequeue(&ciaaModbus_gatewayObj[hModbusGW], loopi);
+            }
+
+            /* clients waiting its response drop their request */
+            ciaaModbus_gatewayCoalesceRelease(&ciaaModbus_gatewayObj[hModbusGW], loopi, false);
+
+            /* server kept busy until the response is discarded, else it
+             * would be received by the next client */
+            if (CIAA_MODBUS_CLIENT_STATE_WAITING_SERVER_RESPONSE == client->state)
+            {
+               ciaaModbus_gatewayObj[hModbusGW].server[client->indexServer].discard = true;
+               ciaaModbus_gatewayObj[hModbusGW].server[client->indexServer].timeout =
+                     client->timeout;
+            }
+
+            client->inUse = false;
+            client->state = CIAA_MODBUS_CLIENT_STATE_IDLE;
+            client->indexServer = -1;
+            client->indexLeader = -1;
+            ret = 0;
+         }
+      }
+
+      /* transport master -> server */
+      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
+      {
+         if ( (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse) &&
+              (ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler == hModbusTransport) &&
+              (ciaaModbus_gatewayObj[hModbusGW].server[loopi].task == ciaaModbus_transportTask) )
+         {
+            ciaaModbus_gatewayServerRemove(&ciaaModbus_gatewayObj[hModbusGW], loopi);
+            ret = 0;
+         }
+      }
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
+}
+
+#if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0
+extern int8_t ciaaModbus_gatewaySetCacheTtl(
+      int32_t hModbusGW,
+      uint8_t id,
+      uint32_t ttl)
+{
+   int8_t ret = -1;
+   uint32_t ticks;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) )
+   {
+      /* time to live in ticks, at least one if enabled */
+      ticks = ttl / CIAA_MODBUS_TIME_BASE;
 
-      /* set servers not in use */
-      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS ; loopi++)
+      if ( (0 != ttl) && (0 == ticks) )
       {
-         ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = false;
+         ticks = 1;
       }
 
-      /* set clients not in use */
-      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+      if (0xFFFF < ticks)
       {
-         ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = false;
+         ticks = 0xFFFF;
       }
+
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      ciaaModbus_gatewayObj[hModbusGW].cacheTtl[id] = ticks;
+
+      /* entries of previous time to live discarded */
+      ciaaModbus_gatewayCacheFlush(&ciaaModbus_gatewayObj[hModbusGW], id);
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+
+      ret = 0;
    }
-   else
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_CACHE_ENTRIES > 0 */
+
+#if CIAA_MODBUS_GATEWAY_MERGE > 0
+extern int8_t ciaaModbus_gatewaySetMergeWindow(
+      int32_t hModbusGW,
+      uint32_t window)
+{
+   int8_t ret = -1;
+   uint32_t ticks;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) )
    {
-      /* if no object available, return invalid handler */
-      hModbusGW = -1;
+      /* window in ticks, at least one if enabled */
+      ticks = window / CIAA_MODBUS_TIME_BASE;
+
+      if ( (0 != window) && (0 == ticks) )
+      {
+         ticks = 1;
+      }
+
+      if (0xFFFF < ticks)
+      {
+         ticks = 0xFFFF;
+      }
+
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      ciaaModbus_gatewayObj[hModbusGW].merge = (0 != window);
+      ciaaModbus_gatewayObj[hModbusGW].mergeWindow = ticks;
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+
+      ret = 0;
    }
 
-   /* exit critical section */
-   ReleaseResource(MODBUSR);
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_MERGE > 0 */
 
-   return hModbusGW;
+#if CIAA_MODBUS_GATEWAY_PRIORITY > 0
+#if CIAA_MODBUS_TOTAL_MASTERS > 0
+extern int8_t ciaaModbus_gatewaySetMasterPriority(
+      int32_t hModbusGW,
+      int32_t hModbusMaster,
+      uint8_t priority)
+{
+   int8_t ret = -1;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) &&
+        (CIAA_MODBUS_GATEWAY_PRIORITY_MAX >= priority) )
+   {
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      ret = ciaaModbus_gatewayClientPriority(
+            &ciaaModbus_gatewayObj[hModbusGW],
+            hModbusMaster,
+            ciaaModbus_masterTask,
+            priority);
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+   }
+
+   return ret;
 }
+#endif /* #if CIAA_MODBUS_TOTAL_MASTERS > 0 */
 
-#if CIAA_MODBUS_TOTAL_SLAVES > 0
-extern int8_t ciaaModbus_gatewayAddSlave(
+extern int8_t ciaaModbus_gatewaySetTransportPriority(
       int32_t hModbusGW,
-      int32_t hModbusSlave)
+      int32_t hModbusTransport,
+      uint8_t priority)
 {
-   uint32_t loopi;
    int8_t ret = -1;
 
-   if ( (0 <= hModbusSlave) && (0 <= hModbusGW) )
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) &&
+        (CIAA_MODBUS_GATEWAY_PRIORITY_MAX >= priority) )
    {
       /* enter critical section */
       GetResource(MODBUSR);
 
-      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
-      {
-         if (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse == false)
-         {
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = true;
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler = hModbusSlave;
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].busy = false;
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].id = ciaaModbus_slaveGetId(hModbusSlave);
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].recvMsg = ciaaModbus_slaveRecvMsg;
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].sendMsg = ciaaModbus_slaveSendMsg;
-            ciaaModbus_gatewayObj[hModbusGW].server[loopi].task = ciaaModbus_slaveTask;
-            ret = 0;
-         }
-      }
+      ret = ciaaModbus_gatewayClientPriority(
+            &ciaaModbus_gatewayObj[hModbusGW],
+            hModbusTransport,
+            ciaaModbus_transportTask,
+            priority);
 
       /* exit critical section */
       ReleaseResource(MODBUSR);
@@ -567,101 +2647,218 @@ extern int8_t ciaaModbus_gatewayAddSlave(
 
    return ret;
 }
-#endif /* #if CIAA_MODBUS_TOTAL_SLAVES > 0 */
 
-#if CIAA_MODBUS_TOTAL_MASTERS > 0
-extern int8_t ciaaModbus_gatewayAddMaster(
+extern int8_t ciaaModbus_gatewaySetFunctionPriority(
       int32_t hModbusGW,
-      int32_t hModbusMaster)
+      uint8_t function,
+      uint8_t priority)
 {
-   uint32_t loopi;
    int8_t ret = -1;
 
-   if ( (0 <= hModbusGW) && (0 <= hModbusMaster))
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) &&
+        (0 < function) && (CIAA_MODBUS_GATEWAY_TOTAL_FUNCTIONS > function) &&
+        (CIAA_MODBUS_GATEWAY_PRIORITY_MAX >= priority) )
    {
       /* enter critical section */
       GetResource(MODBUSR);
 
-      for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+      ciaaModbus_gatewayObj[hModbusGW].fcnPriority[function] = priority;
+
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+
+      ret = 0;
+   }
+
+   return ret;
+}
+
+extern int8_t ciaaModbus_gatewaySetPriorityAging(
+      int32_t hModbusGW,
+      uint32_t aging)
+{
+   int8_t ret = -1;
+   uint32_t ticks;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) )
+   {
+      /* aging in ticks, at least one if enabled */
+      ticks = aging / CIAA_MODBUS_TIME_BASE;
+
+      if ( (0 != aging) && (0 == ticks) )
       {
-         if (ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse == false)
-         {
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = true;
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].handler = hModbusMaster;
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].recvMsg = ciaaModbus_masterRecvMsg;
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].sendMsg = ciaaModbus_masterSendMsg;
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].task = ciaaModbus_masterTask;
-            ciaaModbus_gatewayObj[hModbusGW].client[loopi].getRespTimeout = ciaaModbus_masterGetRespTimeout;
-            ret = 0;
-         }
+         ticks = 1;
+      }
+
+      if (0xFFFF < ticks)
+      {
+         ticks = 0xFFFF;
       }
 
+      /* enter critical section */
+      GetResource(MODBUSR);
+
+      ciaaModbus_gatewayObj[hModbusGW].aging = ticks;
+
       /* exit critical section */
       ReleaseResource(MODBUSR);
+
+      ret = 0;
    }
 
    return ret;
 }
-#endif /* #if CIAA_MODBUS_TOTAL_MASTERS > 0 */
+#endif /* #if CIAA_MODBUS_GATEWAY_PRIORITY > 0 */
 
-extern int8_t ciaaModbus_gatewayAddTransport(
+#if CIAA_MODBUS_GATEWAY_DRR > 0
+extern int8_t ciaaModbus_gatewaySetQuantum(
       int32_t hModbusGW,
-      int32_t hModbusTransport)
+      uint16_t quantum)
 {
-   uint32_t loopi;
    int8_t ret = -1;
-   int8_t transportType;
 
-   if ( (0 <= hModbusTransport) && (0 <= hModbusGW) )
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) )
    {
       /* enter critical section */
       GetResource(MODBUSR);
 
-      transportType = ciaaModbus_transportGetType(hModbusTransport);
+      ciaaModbus_gatewayObj[hModbusGW].quantum = quantum;
 
-      if (transportType == CIAAMODBUS_TRANSPORT_TYPE_SLAVE)
+      /* exit critical section */
+      ReleaseResource(MODBUSR);
+
+      ret = 0;
+   }
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_DRR > 0 */
+
+#if CIAA_MODBUS_GATEWAY_THREADS > 0
+extern int8_t ciaaModbus_gatewayStart(
+      int32_t hModbusGW,
+      int32_t cpu)
+{
+   int8_t ret = -1;
+#if (x86 == ARCH)
+   pthread_attr_t attr;
+   cpu_set_t cpuSet;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) &&
+        (ciaaModbus_gatewayObj[hModbusGW].inUse) &&
+        (false == __atomic_load_n(&ciaaModbus_gatewayObj[hModbusGW].running, __ATOMIC_ACQUIRE)) &&
+        (CPU_SETSIZE > cpu) )
+   {
+      /* sleep of the thread while idle */
+      ciaaModbus_gatewayObj[hModbusGW].hWaiter = ciaaModbus_reactorWaiterOpen();
+
+      if ( (0 <= ciaaModbus_gatewayObj[hModbusGW].hWaiter) &&
+           (0 == pthread_attr_init(&attr)) )
       {
-         /* transport slave -> client */
-         for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS) && (ret != 0) ; loopi++)
+         ret = 0;
+
+         /* pin the thread to the cpu, if any */
+         if (0 <= cpu)
          {
-            if (ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse == false)
+            CPU_ZERO(&cpuSet);
+            CPU_SET(cpu, &cpuSet);
+
+            if (0 != pthread_attr_setaffinity_np(&attr, sizeof(cpuSet), &cpuSet))
             {
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].inUse = true;
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].handler = hModbusTransport;
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].recvMsg = ciaaModbus_transportRecvMsg;
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].sendMsg = ciaaModbus_transportSendMsg;
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].task = ciaaModbus_transportTask;
-               ciaaModbus_gatewayObj[hModbusGW].client[loopi].getRespTimeout = ciaaModbus_transportGetRespTimeout;
-               ret = 0;
+               ret = -1;
             }
          }
-      }
-      else if (transportType == CIAAMODBUS_TRANSPORT_TYPE_MASTER)
-      {
-             /* transport master -> server */
-         for (loopi = 0 ; (loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS) && (ret != 0) ; loopi++)
+
+         if (0 == ret)
          {
-            if (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse == false)
+            /* set running before the thread checks it */
+            __atomic_store_n(&ciaaModbus_gatewayObj[hModbusGW].running, true, __ATOMIC_RELEASE);
+
+            if (0 != pthread_create(&ciaaModbus_gatewayObj[hModbusGW].thread,
+                                    &attr,
+                                    ciaaModbus_gatewayThread,
+                                    (void *)(intptr_t)hModbusGW))
             {
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse = true;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].handler = hModbusTransport;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].busy = false;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].id = 0;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].recvMsg = ciaaModbus_transportRecvMsg;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].sendMsg = ciaaModbus_transportSendMsg;
-               ciaaModbus_gatewayObj[hModbusGW].server[loopi].task = ciaaModbus_transportTask;
-               ret = 0;
+               ret = -1;
             }
          }
+
+         (void)pthread_attr_destroy(&attr);
       }
 
-      /* exit critical section */
-      ReleaseResource(MODBUSR);
+      /* release the waiter if not started */
+      if ( (0 != ret) && (0 <= ciaaModbus_gatewayObj[hModbusGW].hWaiter) )
+      {
+         __atomic_store_n(&ciaaModbus_gatewayObj[hModbusGW].running, false, __ATOMIC_RELEASE);
+
+         ciaaModbus_reactorWaiterClose(ciaaModbus_gatewayObj[hModbusGW].hWaiter);
+         ciaaModbus_gatewayObj[hModbusGW].hWaiter = -1;
+      }
    }
+#endif
 
    return ret;
 }
 
+extern int8_t ciaaModbus_gatewayStop(
+      int32_t hModbusGW)
+{
+   int8_t ret = -1;
+#if (x86 == ARCH)
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) &&
+        (__atomic_load_n(&ciaaModbus_gatewayObj[hModbusGW].running, __ATOMIC_ACQUIRE)) )
+   {
+      /* stop the thread, waking it up if idle */
+      __atomic_store_n(&ciaaModbus_gatewayObj[hModbusGW].running, false, __ATOMIC_RELEASE);
+
+      ciaaModbus_reactorWakeup();
+
+      (void)pthread_join(ciaaModbus_gatewayObj[hModbusGW].thread, NULL);
+
+      ciaaModbus_reactorWaiterClose(ciaaModbus_gatewayObj[hModbusGW].hWaiter);
+      ciaaModbus_gatewayObj[hModbusGW].hWaiter = -1;
+
+      ret = 0;
+   }
+#endif
+
+   return ret;
+}
+#endif /* #if CIAA_MODBUS_GATEWAY_THREADS > 0 */
+
+extern bool ciaaModbus_gatewayIdle(
+      int32_t hModbusGW)
+{
+   bool ret = false;
+
+   if ( (0 <= hModbusGW) && (CIAA_MODBUS_TOTAL_GATEWAY > hModbusGW) )
+   {
+#if (CIAA_MODBUS_GATEWAY_THREADS > 0) && (x86 == ARCH)
+      /* gateway run by its thread: take its lock */
+      if (__atomic_load_n(&ciaaModbus_gatewayObj[hModbusGW].running, __ATOMIC_ACQUIRE))
+      {
+         (void)pthread_mutex_lock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+
+         ret = ciaaModbus_gatewayIdleCheck(&ciaaModbus_gatewayObj[hModbusGW]);
+
+         (void)pthread_mutex_unlock(&ciaaModbus_gatewayObj[hModbusGW].lock);
+      }
+      else
+#endif
+      {
+         /* enter critical section */
+         GetResource(MODBUSR);
+
+         ret = ciaaModbus_gatewayIdleCheck(&ciaaModbus_gatewayObj[hModbusGW]);
+
+         /* exit critical section */
+         ReleaseResource(MODBUSR);
+      }
+   }
+
+   return ret;
+}
 
 extern void ciaaModbus_gatewayMainTask(
       int32_t hModbusGW)
@@ -672,19 +2869,57 @@ extern void ciaaModbus_gatewayMainTask(
 
    if (0 <= hModbusGW)
    {
-      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+      /* update the ports with pending data */
+      ciaaModbus_reactorPoll();
+
+      /* time of cached and batched reads */
+      ciaaModbus_gatewayObj[hModbusGW].tick++;
+
+      /* discard responses of removed clients and send requests waiting
+       * servers which could not take them */
+      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS ; loopi++)
       {
-         countCall = 0;
+         if ( (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse) &&
+              (ciaaModbus_gatewayObj[hModbusGW].server[loopi].discard) )
+         {
+            ciaaModbus_gatewayServerDiscard(
+                  &ciaaModbus_gatewayObj[hModbusGW],
+                  loopi);
+         }
+         else if ( (ciaaModbus_gatewayObj[hModbusGW].server[loopi].inUse) &&
+                   (0 <= ciaaModbus_gatewayObj[hModbusGW].server[loopi].queueHead) )
+         {
+            ciaaModbus_gatewayServerDispatch(
+                  &ciaaModbus_gatewayObj[hModbusGW],
+                  loopi);
+         }
+      }
+
+      /* visit only clients with work */
+      (void)ciaaModbus_gatewayReadyUpdate(&ciaaModbus_gatewayObj[hModbusGW]);
 
-         do
+      for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS ; loopi++)
+      {
+         if (0 != (ciaaModbus_gatewayObj[hModbusGW].ready[loopi / 32] & (1u << (loopi % 32))))
          {
-            ret = ciaaModbus_gatewayClientProcess(
-                  &ciaaModbus_gatewayObj[hModbusGW].client[loopi],
-                  ciaaModbus_gatewayObj[hModbusGW].server);
+            countCall = 0;
 
-            countCall++;
+            /* client task not performed yet */
+            ciaaModbus_gatewayObj[hModbusGW].client[loopi].taskDone = false;
 
-         }while ( (ret > 0) && (countCall < CIAA_MODBUS_GATEWAY_LIMIT_CALLS) );
+            /* process up to CIAA_MODBUS_GATEWAY_ADU_BUDGET messages */
+            do
+            {
+               ret = ciaaModbus_gatewayClientProcess(
+                     &ciaaModbus_gatewayObj[hModbusGW],
+                     loopi);
+
+               countCall++;
+
+            }while ( (ret > 0) &&
+                     (countCall < (CIAA_MODBUS_GATEWAY_LIMIT_CALLS *
+                                   CIAA_MODBUS_GATEWAY_ADU_BUDGET)) );
+         }
       }
    }
 }
@@ -0,0 +1,340 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus Loopback functionality
+ **
+ ** This file implements a transport without I/O. Each channel has a master
+ ** end and a slave end which exchange the messages through memory queues,
+ ** e.g. to connect a master and a gateway running in the same device or
+ ** to measure the processing time of the stack.
+ **
+ ** Each queue has one producer and one consumer and is lock free, so the
+ ** ends of a channel may be used by gateways run by different threads.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_loopback.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdbool.h"
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > 0
+
+/*==================[macros and definitions]=================================*/
+
+#ifndef CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH
+/** \brief Default messages queued in each direction of a channel */
+#define CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH    4
+#endif
+
+/** \brief Range of the positions of a queue, twice its length to tell a
+ ** full queue from an empty one */
+#define CIAAMODBUS_LOOPBACK_QUEUE_RANGE      (2 * CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH)
+
+/** \brief Modbus message queued in a loopback channel */
+typedef struct
+{
+   uint8_t id;                                     /** <- identification */
+   uint32_t size;                                  /** <- size of pdu */
+   uint8_t pdu[CIAAMODBUS_LOOPBACK_PDU_MAXLENGTH]; /** <- pdu */
+}ciaaModbus_loopbackMsgType;
+
+/** \brief Queue of messages of a loopback channel */
+typedef struct
+{
+   uint32_t head;                                  /** <- position of oldest
+                                                          message, written
+                                                          by consumer */
+   uint32_t tail;                                  /** <- position of next
+                                                          message, written
+                                                          by producer */
+   ciaaModbus_loopbackMsgType msg[CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH];
+}ciaaModbus_loopbackQueueType;
+
+/** \brief Modbus Loopback channel type */
+typedef struct
+{
+   ciaaModbus_loopbackQueueType request;     /** <- from master to slave end */
+   ciaaModbus_loopbackQueueType response;    /** <- from slave to master end */
+   bool masterInUse;                         /** <- master end opened */
+   bool slaveInUse;                          /** <- slave end opened */
+}ciaaModbus_loopbackObjType;
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief Array of Modbus Loopback channels */
+static ciaaModbus_loopbackObjType ciaaModbus_loopbackObj[CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK];
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Get the messages queued
+ **
+ ** The position written by the other end is read with acquire order, so
+ ** the messages it put, or the slots it freed, are visible.
+ **
+ ** \param[in] queue queue to check
+ ** \return messages queued
+ **/
+static uint32_t ciaaModbus_loopbackCount(
+      ciaaModbus_loopbackQueueType *queue)
+{
+   uint32_t head;
+   uint32_t tail;
+
+   head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+   tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+   return (tail + CIAAMODBUS_LOOPBACK_QUEUE_RANGE - head) %
+          CIAAMODBUS_LOOPBACK_QUEUE_RANGE;
+}
+
+/** \brief Put a message at the end of a queue
+ **
+ ** \param[inout] queue queue to put the message
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+static void ciaaModbus_loopbackPut(
+      ciaaModbus_loopbackQueueType *queue,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_loopbackMsgType *msg;
+   uint32_t loopi;
+
+   /* discard message if queue full or invalid size */
+   if ( (CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH > ciaaModbus_loopbackCount(queue)) &&
+        (0 < size) &&
+        (CIAAMODBUS_LOOPBACK_PDU_MAXLENGTH >= size) )
+   {
+      /* set pointer to the free message */
+      msg = &queue->msg[queue->tail % CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH];
+
+      /* copy message */
+      msg->id = id;
+      msg->size = size;
+      for (loopi = 0 ; loopi < size ; loopi++)
+      {
+         msg->pdu[loopi] = pdu[loopi];
+      }
+
+      /* publish the message and wake up the consumer */
+      __atomic_store_n(&queue->tail,
+                       (queue->tail + 1) % CIAAMODBUS_LOOPBACK_QUEUE_RANGE,
+                       __ATOMIC_RELEASE);
+
+      ciaaModbus_reactorWakeup();
+   }
+}
+
+/** \brief Get the first message of a queue
+ **
+ ** \param[inout] queue queue to get the message
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if queue empty
+ ** \return
+ **/
+static void ciaaModbus_loopbackGet(
+      ciaaModbus_loopbackQueueType *queue,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_loopbackMsgType *msg;
+   uint32_t loopi;
+
+   if (0 < ciaaModbus_loopbackCount(queue))
+   {
+      /* set pointer to the oldest message */
+      msg = &queue->msg[queue->head % CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH];
+
+      /* copy message */
+      *id = msg->id;
+      *size = msg->size;
+      for (loopi = 0 ; loopi < msg->size ; loopi++)
+      {
+         pdu[loopi] = msg->pdu[loopi];
+      }
+
+      /* free the slot once copied */
+      __atomic_store_n(&queue->head,
+                       (queue->head + 1) % CIAAMODBUS_LOOPBACK_QUEUE_RANGE,
+                       __ATOMIC_RELEASE);
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+/*==================[external functions definition]==========================*/
+extern void ciaaModbus_loopbackInit(void)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK ; loopi++)
+   {
+      ciaaModbus_loopbackObj[loopi].masterInUse = false;
+      ciaaModbus_loopbackObj[loopi].slaveInUse = false;
+   }
+}
+
+extern int32_t ciaaModbus_loopbackMasterOpen(int32_t channel)
+{
+   int32_t hModbusLoopback = -1;
+
+   /* check channel exists and master end not in use */
+   if ( (0 <= channel) &&
+        (CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > channel) &&
+        (false == ciaaModbus_loopbackObj[channel].masterInUse) )
+   {
+      /* set master end in use */
+      ciaaModbus_loopbackObj[channel].masterInUse = true;
+
+      /* discard responses to a previous master */
+      ciaaModbus_loopbackObj[channel].response.head = 0;
+      ciaaModbus_loopbackObj[channel].response.tail = 0;
+
+      hModbusLoopback = channel;
+   }
+
+   return hModbusLoopback;
+}
+
+extern int32_t ciaaModbus_loopbackSlaveOpen(int32_t channel)
+{
+   int32_t hModbusLoopback = -1;
+
+   /* check channel exists and slave end not in use */
+   if ( (0 <= channel) &&
+        (CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > channel) &&
+        (false == ciaaModbus_loopbackObj[channel].slaveInUse) )
+   {
+      /* set slave end in use */
+      ciaaModbus_loopbackObj[channel].slaveInUse = true;
+
+      /* discard requests to a previous slave */
+      ciaaModbus_loopbackObj[channel].request.head = 0;
+      ciaaModbus_loopbackObj[channel].request.tail = 0;
+
+      hModbusLoopback = channel;
+   }
+
+   return hModbusLoopback;
+}
+
+extern void ciaaModbus_loopbackTask(int32_t handler)
+{
+   /* messages are transferred when sent */
+}
+
+extern void ciaaModbus_loopbackMasterRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_loopbackGet(&ciaaModbus_loopbackObj[handler].response, id, pdu, size);
+}
+
+extern void ciaaModbus_loopbackMasterSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_loopbackPut(&ciaaModbus_loopbackObj[handler].request, id, pdu, size);
+}
+
+extern void ciaaModbus_loopbackSlaveRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_loopbackGet(&ciaaModbus_loopbackObj[handler].request, id, pdu, size);
+}
+
+extern void ciaaModbus_loopbackSlaveSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_loopbackPut(&ciaaModbus_loopbackObj[handler].response, id, pdu, size);
+}
+
+extern bool ciaaModbus_loopbackMasterTxReady(int32_t handler)
+{
+   return (CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH >
+           ciaaModbus_loopbackCount(&ciaaModbus_loopbackObj[handler].request));
+}
+
+extern bool ciaaModbus_loopbackSlaveTxReady(int32_t handler)
+{
+   return (CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH >
+           ciaaModbus_loopbackCount(&ciaaModbus_loopbackObj[handler].response));
+}
+
+extern bool ciaaModbus_loopbackMasterPending(int32_t handler)
+{
+   return (0 < ciaaModbus_loopbackCount(&ciaaModbus_loopbackObj[handler].response));
+}
+
+extern bool ciaaModbus_loopbackSlavePending(int32_t handler)
+{
+   return (0 < ciaaModbus_loopbackCount(&ciaaModbus_loopbackObj[handler].request));
+}
+
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > 0 */
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
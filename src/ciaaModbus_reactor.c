@@ -0,0 +1,551 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus reactor
+ **
+ ** On the host build the serial ports are registered with an epoll
+ ** instance. The poll performed once by gateway task marks the ports with
+ ** pending data and the transports read only those. On the target, or for
+ ** a file descriptor not registered, the transports read on each task.
+ **
+ ** Each waiter has its own epoll instance, so a gateway run by its own
+ ** thread only sleeps on its ports. A thread bound to a waiter registers
+ ** the file descriptors with its instance, and the file descriptors
+ ** registered by other threads move to it when checked by the thread.
+ ** The other threads use the shared instance.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaPlatforms.h"
+
+#if (x86 == ARCH)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+/*==================[macros and definitions]=================================*/
+
+#ifndef CIAA_MODBUS_REACTOR_MAX_EVENTS
+/** \brief Default events processed by poll */
+#define CIAA_MODBUS_REACTOR_MAX_EVENTS    64
+#endif
+
+#ifndef CIAA_MODBUS_REACTOR_TOTAL_WAITERS
+/** \brief Default threads which can wait on the reactor at once */
+#define CIAA_MODBUS_REACTOR_TOTAL_WAITERS 8
+#endif
+
+#if (CIAA_MODBUS_REACTOR_TOTAL_WAITERS > 254)
+#error CIAA_MODBUS_REACTOR_TOTAL_WAITERS shall not be greater than 254
+#endif
+
+/** \brief Words of a bitmap of file descriptors */
+#define CIAAMODBUS_REACTOR_WORDS          ((CIAA_MODBUS_REACTOR_MAX_FDS + 31) / 32)
+
+/** \brief Sets of file descriptors: the shared one and one per waiter */
+#define CIAAMODBUS_REACTOR_TOTAL_SETS     (CIAA_MODBUS_REACTOR_TOTAL_WAITERS + 1)
+
+/** \brief Set of the threads not bound to a waiter */
+#define CIAAMODBUS_REACTOR_SHARED_SET     0
+
+#if (x86 == ARCH)
+/** \brief Set of file descriptors polled together */
+typedef struct
+{
+   bool created;                       /** <- epoll instance and eventfd
+                                              available                   */
+   bool inUse;                         /** <- waiter opened, accessed
+                                              atomically                  */
+   bool polled;                        /** <- poll performed since
+                                              created, accessed atomically */
+   int32_t epoll;                      /** <- epoll instance              */
+   int32_t wake;                       /** <- eventfd in the epoll
+                                              instance waking up a wait   */
+   uint32_t pending[CIAAMODBUS_REACTOR_WORDS];
+                                       /** <- file descriptors with data
+                                              pending at last poll        */
+   uint32_t owned[CIAAMODBUS_REACTOR_WORDS];
+                                       /** <- file descriptors polled by
+                                              the set                     */
+}ciaaModbus_reactorSetType;
+#endif
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+#if (x86 == ARCH)
+/** \brief Array of sets, the shared set first and then the set of each
+ ** waiter. The set of a waiter is kept while not in use as a wake up may
+ ** still be writing it */
+static ciaaModbus_reactorSetType ciaaModbus_reactorSet[CIAAMODBUS_REACTOR_TOTAL_SETS];
+
+/** \brief Bitmap of registered file descriptors */
+static uint32_t ciaaModbus_reactorRegistered[CIAAMODBUS_REACTOR_WORDS];
+
+/** \brief Set polling each registered file descriptor */
+static uint8_t ciaaModbus_reactorOwner[CIAA_MODBUS_REACTOR_MAX_FDS];
+
+/** \brief Set of the calling thread */
+static __thread int32_t ciaaModbus_reactorBound = CIAAMODBUS_REACTOR_SHARED_SET;
+#endif
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+#if (x86 == ARCH)
+/** \brief Create the epoll instance and the wake up eventfd of a set
+ **
+ ** \param[in] set index of the set
+ ** \return true if the set is available
+ **/
+static bool ciaaModbus_reactorCreate(int32_t set)
+{
+   ciaaModbus_reactorSetType *pSet = &ciaaModbus_reactorSet[set];
+   struct epoll_event event;
+
+   if (false == pSet->created)
+   {
+      pSet->epoll = epoll_create1(EPOLL_CLOEXEC);
+      pSet->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+      event.events = EPOLLIN;
+      event.data.fd = pSet->wake;
+
+      if ( (0 <= pSet->epoll) &&
+           (0 <= pSet->wake) &&
+           (0 == epoll_ctl(pSet->epoll, EPOLL_CTL_ADD, pSet->wake, &event)) )
+      {
+         pSet->created = true;
+      }
+      else
+      {
+         /* release what was created */
+         if (0 <= pSet->epoll)
+         {
+            close(pSet->epoll);
+         }
+
+         if (0 <= pSet->wake)
+         {
+            close(pSet->wake);
+         }
+      }
+   }
+
+   return pSet->created;
+}
+
+/** \brief Update the file descriptors of a set with pending data
+ **
+ ** \param[in] set index of the set
+ ** \param[in] timeout time to wait for data (milliseconds), 0 to return
+ **            at once, -1 to wait without limit
+ **/
+static void ciaaModbus_reactorCollect(int32_t set, int32_t timeout)
+{
+   ciaaModbus_reactorSetType *pSet = &ciaaModbus_reactorSet[set];
+   struct epoll_event event[CIAA_MODBUS_REACTOR_MAX_EVENTS];
+   uint32_t pending[CIAAMODBUS_REACTOR_WORDS];
+   int32_t count;
+   int32_t loopi;
+   uint64_t value;
+
+   for (loopi = 0 ; loopi < CIAAMODBUS_REACTOR_WORDS ; loopi++)
+   {
+      pending[loopi] = 0;
+   }
+
+   count = epoll_wait(pSet->epoll, event, CIAA_MODBUS_REACTOR_MAX_EVENTS, timeout);
+
+   for (loopi = 0 ; loopi < count ; loopi++)
+   {
+      if (event[loopi].data.fd == pSet->wake)
+      {
+         /* wake up consumed */
+         (void)read(pSet->wake, &value, sizeof(value));
+      }
+      else
+      {
+         pending[event[loopi].data.fd / 32] |= (1u << (event[loopi].data.fd % 32));
+      }
+   }
+
+   /* publish the whole poll, a file descriptor moved to other set while
+    * polling is reported by the polls of that set */
+   for (loopi = 0 ; loopi < CIAAMODBUS_REACTOR_WORDS ; loopi++)
+   {
+      __atomic_store_n(&pSet->pending[loopi], pending[loopi], __ATOMIC_RELAXED);
+   }
+
+   __atomic_store_n(&pSet->polled, true, __ATOMIC_RELEASE);
+}
+
+/** \brief Move a registered file descriptor to the set of the caller
+ **
+ ** \param[in] fildes file descriptor to move
+ ** \param[in] set index of the set polling the file descriptor
+ **/
+static void ciaaModbus_reactorMove(int32_t fildes, int32_t set)
+{
+   struct epoll_event event;
+
+   (void)epoll_ctl(ciaaModbus_reactorSet[set].epoll, EPOLL_CTL_DEL, fildes, NULL);
+   (void)__atomic_fetch_and(&ciaaModbus_reactorSet[set].owned[fildes / 32],
+                            ~(1u << (fildes % 32)),
+                            __ATOMIC_RELAXED);
+
+   event.events = EPOLLIN;
+   event.data.fd = fildes;
+
+   if ( (ciaaModbus_reactorCreate(ciaaModbus_reactorBound)) &&
+        (0 == epoll_ctl(ciaaModbus_reactorSet[ciaaModbus_reactorBound].epoll,
+                        EPOLL_CTL_ADD, fildes, &event)) )
+   {
+      __atomic_store_n(&ciaaModbus_reactorOwner[fildes],
+                       (uint8_t)ciaaModbus_reactorBound,
+                       __ATOMIC_RELAXED);
+      (void)__atomic_fetch_or(&ciaaModbus_reactorSet[ciaaModbus_reactorBound].owned[fildes / 32],
+                              (1u << (fildes % 32)),
+                              __ATOMIC_RELAXED);
+   }
+   else
+   {
+      /* not registered any more, read on each task */
+      (void)__atomic_fetch_and(&ciaaModbus_reactorRegistered[fildes / 32],
+                               ~(1u << (fildes % 32)),
+                               __ATOMIC_RELAXED);
+   }
+}
+#endif
+
+/*==================[external functions definition]==========================*/
+extern void ciaaModbus_reactorInit(void)
+{
+#if (x86 == ARCH)
+   int32_t loopi;
+   int32_t loopj;
+
+   /* the epoll instances are created by the first registration or wait */
+   for (loopi = 0 ; loopi < CIAAMODBUS_REACTOR_TOTAL_SETS ; loopi++)
+   {
+      if (ciaaModbus_reactorSet[loopi].created)
+      {
+         close(ciaaModbus_reactorSet[loopi].epoll);
+         close(ciaaModbus_reactorSet[loopi].wake);
+      }
+
+      ciaaModbus_reactorSet[loopi].created = false;
+      ciaaModbus_reactorSet[loopi].inUse = false;
+      ciaaModbus_reactorSet[loopi].polled = false;
+
+      for (loopj = 0 ; loopj < CIAAMODBUS_REACTOR_WORDS ; loopj++)
+      {
+         ciaaModbus_reactorSet[loopi].pending[loopj] = 0;
+         ciaaModbus_reactorSet[loopi].owned[loopj] = 0;
+      }
+   }
+
+   for (loopi = 0 ; loopi < CIAAMODBUS_REACTOR_WORDS ; loopi++)
+   {
+      ciaaModbus_reactorRegistered[loopi] = 0;
+   }
+
+   ciaaModbus_reactorBound = CIAAMODBUS_REACTOR_SHARED_SET;
+#endif
+}
+
+extern int32_t ciaaModbus_reactorAdd(int32_t fildes)
+{
+   int32_t ret = -1;
+#if (x86 == ARCH)
+   struct epoll_event event;
+
+   if ( (0 <= fildes) && (CIAA_MODBUS_REACTOR_MAX_FDS > fildes) )
+   {
+      /* level triggered, data not read is reported again */
+      event.events = EPOLLIN;
+      event.data.fd = fildes;
+
+      /* polled by the set of the caller */
+      if ( (ciaaModbus_reactorCreate(ciaaModbus_reactorBound)) &&
+           (0 == epoll_ctl(ciaaModbus_reactorSet[ciaaModbus_reactorBound].epoll,
+                           EPOLL_CTL_ADD, fildes, &event)) )
+      {
+         __atomic_store_n(&ciaaModbus_reactorOwner[fildes],
+                          (uint8_t)ciaaModbus_reactorBound,
+                          __ATOMIC_RELAXED);
+         (void)__atomic_fetch_or(&ciaaModbus_reactorSet[ciaaModbus_reactorBound].owned[fildes / 32],
+                                 (1u << (fildes % 32)),
+                                 __ATOMIC_RELAXED);
+         (void)__atomic_fetch_or(&ciaaModbus_reactorRegistered[fildes / 32],
+                                 (1u << (fildes % 32)),
+                                 __ATOMIC_RELAXED);
+
+         ret = 0;
+      }
+   }
+#endif
+
+   return ret;
+}
+
+extern void ciaaModbus_reactorRemove(int32_t fildes)
+{
+#if (x86 == ARCH)
+   uint32_t mask;
+   int32_t set;
+
+   if ( (0 <= fildes) && (CIAA_MODBUS_REACTOR_MAX_FDS > fildes) )
+   {
+      mask = 1u << (fildes % 32);
+
+      if (0 != (__atomic_load_n(&ciaaModbus_reactorRegistered[fildes / 32], __ATOMIC_RELAXED) & mask))
+      {
+         set = __atomic_load_n(&ciaaModbus_reactorOwner[fildes], __ATOMIC_RELAXED);
+
+         (void)epoll_ctl(ciaaModbus_reactorSet[set].epoll, EPOLL_CTL_DEL, fildes, NULL);
+
+         (void)__atomic_fetch_and(&ciaaModbus_reactorRegistered[fildes / 32],
+                                  ~mask,
+                                  __ATOMIC_RELAXED);
+         (void)__atomic_fetch_and(&ciaaModbus_reactorSet[set].pending[fildes / 32],
+                                  ~mask,
+                                  __ATOMIC_RELAXED);
+         (void)__atomic_fetch_and(&ciaaModbus_reactorSet[set].owned[fildes / 32],
+                                  ~mask,
+                                  __ATOMIC_RELAXED);
+      }
+   }
+#endif
+}
+
+extern void ciaaModbus_reactorPoll(void)
+{
+#if (x86 == ARCH)
+   if (ciaaModbus_reactorSet[ciaaModbus_reactorBound].created)
+   {
+      /* do not wait, the ports not reported are reported by next polls */
+      ciaaModbus_reactorCollect(ciaaModbus_reactorBound, 0);
+   }
+#endif
+}
+
+extern void ciaaModbus_reactorWait(int32_t timeout)
+{
+#if (x86 == ARCH)
+   if (ciaaModbus_reactorCreate(ciaaModbus_reactorBound))
+   {
+      ciaaModbus_reactorCollect(ciaaModbus_reactorBound, timeout);
+   }
+#endif
+}
+
+extern int32_t ciaaModbus_reactorWaiterOpen(void)
+{
+   int32_t hWaiter = -1;
+#if (x86 == ARCH)
+   int32_t loopi;
+
+   /* search a waiter not in use */
+   for (loopi = 0 ; (loopi < CIAA_MODBUS_REACTOR_TOTAL_WAITERS) && (0 > hWaiter) ; loopi++)
+   {
+      if (false == __atomic_load_n(&ciaaModbus_reactorSet[loopi + 1].inUse, __ATOMIC_ACQUIRE))
+      {
+         hWaiter = loopi;
+      }
+   }
+
+   /* the set of a waiter closed before is reused */
+   if ( (0 <= hWaiter) &&
+        (ciaaModbus_reactorCreate(hWaiter + 1)) )
+   {
+      __atomic_store_n(&ciaaModbus_reactorSet[hWaiter + 1].inUse, true, __ATOMIC_RELEASE);
+   }
+   else
+   {
+      hWaiter = -1;
+   }
+#endif
+
+   return hWaiter;
+}
+
+extern void ciaaModbus_reactorWaiterClose(int32_t hWaiter)
+{
+#if (x86 == ARCH)
+   if ( (0 <= hWaiter) && (CIAA_MODBUS_REACTOR_TOTAL_WAITERS > hWaiter) )
+   {
+      __atomic_store_n(&ciaaModbus_reactorSet[hWaiter + 1].inUse, false, __ATOMIC_RELEASE);
+   }
+#endif
+}
+
+extern void ciaaModbus_reactorWaiterBind(int32_t hWaiter)
+{
+#if (x86 == ARCH)
+   if ( (0 <= hWaiter) && (CIAA_MODBUS_REACTOR_TOTAL_WAITERS > hWaiter) &&
+        (__atomic_load_n(&ciaaModbus_reactorSet[hWaiter + 1].inUse, __ATOMIC_ACQUIRE)) )
+   {
+      ciaaModbus_reactorBound = hWaiter + 1;
+   }
+#endif
+}
+
+extern void ciaaModbus_reactorWaiterWait(int32_t hWaiter, int32_t timeout)
+{
+#if (x86 == ARCH)
+   if ( (0 <= hWaiter) && (CIAA_MODBUS_REACTOR_TOTAL_WAITERS > hWaiter) &&
+        (__atomic_load_n(&ciaaModbus_reactorSet[hWaiter + 1].inUse, __ATOMIC_ACQUIRE)) )
+   {
+      /* only the file descriptors of the waiter and its wake ups */
+      ciaaModbus_reactorCollect(hWaiter + 1, timeout);
+   }
+#endif
+}
+
+extern void ciaaModbus_reactorWakeup(void)
+{
+#if (x86 == ARCH)
+   uint64_t value = 1;
+   int32_t loopi;
+
+   /* wake up the shared set and all waiters, only the owner of the
+    * message knows it */
+   for (loopi = 0 ; loopi < CIAAMODBUS_REACTOR_TOTAL_SETS ; loopi++)
+   {
+      if ( ( (CIAAMODBUS_REACTOR_SHARED_SET == loopi) &&
+             (ciaaModbus_reactorSet[loopi].created) ) ||
+           (__atomic_load_n(&ciaaModbus_reactorSet[loopi].inUse, __ATOMIC_ACQUIRE)) )
+      {
+         (void)write(ciaaModbus_reactorSet[loopi].wake, &value, sizeof(value));
+      }
+   }
+#endif
+}
+
+extern bool ciaaModbus_reactorReady(int32_t fildes)
+{
+   bool ret = true;
+#if (x86 == ARCH)
+   uint32_t mask;
+   int32_t set;
+
+   if ( (0 <= fildes) && (CIAA_MODBUS_REACTOR_MAX_FDS > fildes) )
+   {
+      mask = 1u << (fildes % 32);
+
+      /* not registered file descriptors are always read */
+      if (0 != (__atomic_load_n(&ciaaModbus_reactorRegistered[fildes / 32], __ATOMIC_RELAXED) & mask))
+      {
+         set = __atomic_load_n(&ciaaModbus_reactorOwner[fildes], __ATOMIC_RELAXED);
+
+         if (set != ciaaModbus_reactorBound)
+         {
+            /* polled by the caller from now on, read once meanwhile */
+            ciaaModbus_reactorMove(fildes, set);
+         }
+         else if (__atomic_load_n(&ciaaModbus_reactorSet[set].polled, __ATOMIC_ACQUIRE))
+         {
+            ret = (0 != (__atomic_load_n(&ciaaModbus_reactorSet[set].pending[fildes / 32], __ATOMIC_RELAXED) & mask));
+         }
+         else
+         {
+            /* not polled yet */
+         }
+      }
+   }
+#endif
+
+   return ret;
+}
+
+extern int32_t ciaaModbus_reactorNext(int32_t fildes)
+{
+   int32_t ret = -1;
+#if (x86 == ARCH)
+   ciaaModbus_reactorSetType *pSet = &ciaaModbus_reactorSet[ciaaModbus_reactorBound];
+   int32_t first = (0 > fildes) ? 0 : (fildes + 1);
+   int32_t loopi;
+   uint32_t ready;
+   bool polled;
+
+   polled = __atomic_load_n(&pSet->polled, __ATOMIC_ACQUIRE);
+
+   for (loopi = first / 32 ;
+        (loopi < CIAAMODBUS_REACTOR_WORDS) && (0 > ret) ;
+        loopi++)
+   {
+      ready = __atomic_load_n(&ciaaModbus_reactorRegistered[loopi], __ATOMIC_RELAXED);
+
+      /* polled by the caller: only if data pending, same as
+       * ciaaModbus_reactorReady() */
+      if (polled)
+      {
+         ready &= ~( __atomic_load_n(&pSet->owned[loopi], __ATOMIC_RELAXED) &
+                    ~__atomic_load_n(&pSet->pending[loopi], __ATOMIC_RELAXED) );
+      }
+
+      /* only file descriptors after fildes */
+      if (loopi == (first / 32))
+      {
+         ready &= (0xFFFFFFFFu << (first % 32));
+      }
+
+      if (0 != ready)
+      {
+         ret = (loopi * 32) + __builtin_ctz(ready);
+      }
+   }
+#endif
+
+   return ret;
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
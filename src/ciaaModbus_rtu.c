@@ -0,0 +1,516 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus RTU functionality
+ **
+ ** This file implements the framing of modbus rtu and a transport on a
+ ** serial port. The end of a frame is the silent interval detected by the
+ ** task when no data is read.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_rtu.h"
+#include "ciaaModbus_transport.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdio.h"
+#include "ciaaPOSIX_stdbool.h"
+
+/*==================[macros and definitions]=================================*/
+
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_RTU
+/** \brief Default transports RTU */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_RTU   0
+#endif
+
+#ifndef CIAA_MODBUS_RTU_TX_BUFFER_SIZE
+/** \brief Default size of the transmission queue (bytes) */
+#define CIAA_MODBUS_RTU_TX_BUFFER_SIZE    (CIAAMODBUS_RTU_MAXLENGTH * 2)
+#endif
+
+#if (CIAA_MODBUS_RTU_TX_BUFFER_SIZE < CIAAMODBUS_RTU_MAXLENGTH)
+#error CIAA_MODBUS_RTU_TX_BUFFER_SIZE shall be at least CIAAMODBUS_RTU_MAXLENGTH
+#endif
+
+/** \brief Silent interval above 19200 bps (microseconds) */
+#define CIAAMODBUS_RTU_SILENCE_MIN_US     1750
+
+/** \brief Silent interval at 1 bps, 3.5 characters of 11 bits (microseconds) */
+#define CIAAMODBUS_RTU_SILENCE_BIT_US     38500000
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+/** \brief Modbus RTU Object type */
+typedef struct
+{
+   int32_t fildes;                              /** <- File descriptor */
+   int32_t hostFd;                              /** <- File descriptor in the
+                                                       host checked with the
+                                                       reactor, -1 if not known */
+   int32_t silence;                             /** <- task calls without data
+                                                       to end the frame */
+   int32_t silenceTicks;                        /** <- task calls of the silent
+                                                       interval */
+   ciaaModbus_rtuFramerType framer;             /** <- framer of received data */
+   uint32_t frameSize;                          /** <- pdu size of received frame, 0 if none */
+   uint8_t frame[CIAAMODBUS_RTU_MAXLENGTH];     /** <- received frame (id and pdu) */
+   uint8_t buffer[CIAAMODBUS_RTU_MAXLENGTH];    /** <- read and send buffer */
+   uint32_t txHead;                             /** <- first byte to write */
+   uint32_t txCount;                            /** <- bytes queued to write */
+   uint8_t txBuffer[CIAA_MODBUS_RTU_TX_BUFFER_SIZE]; /** <- transmission queue */
+   bool inUse;                                  /** <- Object in use */
+}ciaaModbus_rtuObjType;
+#endif
+
+/*==================[internal data declaration]==============================*/
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+/** \brief Array of Modbus RTU Object */
+static ciaaModbus_rtuObjType ciaaModbus_rtuObj[CIAA_MODBUS_TOTAL_TRANSPORT_RTU];
+#endif
+
+/** \brief Table of CRC-16 (polynomial 0xA001) of each byte value */
+static const uint16_t ciaaModbus_rtuCrcTable[256] =
+{
+   0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+   0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+   0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+   0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+   0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+   0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+   0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+   0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+   0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+   0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+   0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+   0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+   0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+   0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+   0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+   0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+   0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+   0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+   0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+   0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+   0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+   0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+   0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+   0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+   0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+   0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+   0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+   0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+   0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+   0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+   0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+   0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+/** \brief Store a frame received by a Modbus RTU Object
+ **
+ ** Callback of the framer of the object. A frame not yet read by
+ ** ciaaModbus_rtuRecvMsg is replaced by the newer one.
+ **
+ ** \param[in] param pointer to the Modbus RTU Object
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return
+ **/
+static void ciaaModbus_rtuRecvFrame(
+      void *param,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_rtuObjType *obj = param;
+   uint32_t loopi;
+
+   /* copy id */
+   obj->frame[0] = id;
+
+   /* copy pdu */
+   for (loopi = 0 ; loopi < size ; loopi++)
+   {
+      obj->frame[loopi+1] = pdu[loopi];
+   }
+
+   /* set size of the received pdu */
+   obj->frameSize = size;
+}
+
+/** \brief Write the transmission queue of a Modbus RTU Object
+ **
+ ** Writes until the queue is empty or the device accepts no more data. A
+ ** partial write is resumed in the next call.
+ **
+ ** \param[in] handler handler of the object
+ ** \return
+ **/
+static void ciaaModbus_rtuFlush(int32_t handler)
+{
+   ciaaModbus_rtuObjType *obj = &ciaaModbus_rtuObj[handler];
+   int32_t len;
+   int32_t written;
+
+   do
+   {
+      /* write the queued data up to the end of the queue buffer */
+      len = CIAA_MODBUS_RTU_TX_BUFFER_SIZE - obj->txHead;
+      if (len > obj->txCount)
+      {
+         len = obj->txCount;
+      }
+
+      written = 0;
+
+      if (0 < len)
+      {
+         written = ciaaPOSIX_write(obj->fildes, &obj->txBuffer[obj->txHead], len);
+      }
+
+      /* discard the written data */
+      if (0 < written)
+      {
+         obj->txHead = (obj->txHead + written) % CIAA_MODBUS_RTU_TX_BUFFER_SIZE;
+         obj->txCount -= written;
+      }
+
+      /* continue only if all data has been written (queue wrapped) */
+   }while ( (0 < len) && (written == len) && (0 < obj->txCount) );
+}
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0 */
+
+/*==================[external functions definition]==========================*/
+extern uint16_t ciaaModbus_rtuCrc16(uint8_t const *buf, int32_t len)
+{
+   int32_t loopi;
+   uint16_t crc = 0xFFFF;
+
+   /* calculate crc a byte at a time */
+   for (loopi = 0 ; loopi < len ; loopi++)
+   {
+      crc = (crc >> 8) ^ ciaaModbus_rtuCrcTable[(crc ^ buf[loopi]) & 0xFF];
+   }
+
+   return crc;
+}
+
+extern int32_t ciaaModbus_rtuSilenceTicks(uint32_t baudRate)
+{
+   uint32_t silence = CIAAMODBUS_RTU_SILENCE_MIN_US;
+
+   /* silent interval of 3.5 characters up to 19200 bps */
+   if ( (0 < baudRate) && (19200 >= baudRate) )
+   {
+      silence = CIAAMODBUS_RTU_SILENCE_BIT_US / baudRate;
+   }
+
+   /* round up to task calls */
+   return (silence + (CIAA_MODBUS_TIME_BASE * 1000) - 1) /
+          (CIAA_MODBUS_TIME_BASE * 1000);
+}
+
+extern void ciaaModbus_rtuFramerInit(
+      ciaaModbus_rtuFramerType *framer,
+      ciaaModbus_framerCbType cbFrame,
+      void *param)
+{
+   framer->cbFrame = cbFrame;
+   framer->param = param;
+   framer->size = 0;
+}
+
+extern void ciaaModbus_rtuFramerFeed(
+      ciaaModbus_rtuFramerType *framer,
+      uint8_t const *buf,
+      int32_t len)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < len ; loopi++)
+   {
+      /* if maximum size reached discard the frame up to the silent interval */
+      if (CIAAMODBUS_RTU_MAXLENGTH <= framer->size)
+      {
+         framer->size = CIAAMODBUS_RTU_MAXLENGTH + 1;
+      }
+      else
+      {
+         framer->buffer[framer->size] = buf[loopi];
+         framer->size++;
+      }
+   }
+}
+
+extern int32_t ciaaModbus_rtuFramerEnd(ciaaModbus_rtuFramerType *framer)
+{
+   int32_t ret = 0;
+
+   /* check length and crc, the crc of a frame including its crc is 0 */
+   if ( (CIAAMODBUS_RTU_MINLENGTH <= framer->size) &&
+        (CIAAMODBUS_RTU_MAXLENGTH >= framer->size) &&
+        (0 == ciaaModbus_rtuCrc16(framer->buffer, framer->size)) )
+   {
+      /* report frame without id and CRC */
+      framer->cbFrame(
+            framer->param,
+            framer->buffer[0],
+            &framer->buffer[1],
+            framer->size - 3);
+
+      ret = 1;
+   }
+
+   /* start a new frame */
+   framer->size = 0;
+
+   return ret;
+}
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+extern void ciaaModbus_rtuInit(void)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_RTU ; loopi++)
+   {
+      ciaaModbus_rtuObj[loopi].inUse = false;
+   }
+}
+
+extern int32_t ciaaModbus_rtuOpen(int32_t fildes)
+{
+   int32_t hModbusRtu = 0;
+
+   /* search a modbus rtu Object not in use */
+   while ( (hModbusRtu < CIAA_MODBUS_TOTAL_TRANSPORT_RTU) &&
+           (ciaaModbus_rtuObj[hModbusRtu].inUse == true) )
+   {
+      hModbusRtu++;
+   }
+
+   /* if object available, use it */
+   if (hModbusRtu < CIAA_MODBUS_TOTAL_TRANSPORT_RTU)
+   {
+      /* set object in use */
+      ciaaModbus_rtuObj[hModbusRtu].inUse = true;
+
+      /* set low layer file descriptor */
+      ciaaModbus_rtuObj[hModbusRtu].fildes = fildes;
+      ciaaModbus_rtuObj[hModbusRtu].hostFd = -1;
+
+      /* empty transmission queue */
+      ciaaModbus_rtuObj[hModbusRtu].txHead = 0;
+      ciaaModbus_rtuObj[hModbusRtu].txCount = 0;
+
+      /* no frame received, silent interval of the highest baud rates */
+      ciaaModbus_rtuObj[hModbusRtu].frameSize = 0;
+      ciaaModbus_rtuObj[hModbusRtu].silence = 0;
+      ciaaModbus_rtuObj[hModbusRtu].silenceTicks = ciaaModbus_rtuSilenceTicks(0);
+
+      /* init framer, frames are stored in the object */
+      ciaaModbus_rtuFramerInit(
+            &ciaaModbus_rtuObj[hModbusRtu].framer,
+            ciaaModbus_rtuRecvFrame,
+            &ciaaModbus_rtuObj[hModbusRtu]);
+   }
+   else
+   {
+      hModbusRtu = -1;
+   }
+
+   return hModbusRtu;
+}
+
+extern void ciaaModbus_rtuTask(int32_t handler)
+{
+   ciaaModbus_rtuObjType *obj = &ciaaModbus_rtuObj[handler];
+   int32_t read = 0;
+
+   /* resume the transmission */
+   ciaaModbus_rtuFlush(handler);
+
+   /* read from device if data pending */
+   if (ciaaModbus_reactorReady(obj->hostFd))
+   {
+      read = ciaaPOSIX_read(obj->fildes, obj->buffer, CIAAMODBUS_RTU_MAXLENGTH);
+   }
+
+   if (read > 0)
+   {
+      /* frame received data and restart the silent interval */
+      ciaaModbus_rtuFramerFeed(&obj->framer, obj->buffer, read);
+
+      obj->silence = obj->silenceTicks;
+   }
+   else if (0 < obj->silence)
+   {
+      obj->silence--;
+
+      /* silent interval elapsed, end of frame */
+      if (0 == obj->silence)
+      {
+         ciaaModbus_rtuFramerEnd(&obj->framer);
+      }
+   }
+}
+
+extern void ciaaModbus_rtuSetBaudRate(int32_t handler, uint32_t baudRate)
+{
+   ciaaModbus_rtuObj[handler].silenceTicks = ciaaModbus_rtuSilenceTicks(baudRate);
+}
+
+extern void ciaaModbus_rtuSetHostFd(int32_t handler, int32_t hostFd)
+{
+   ciaaModbus_rtuObj[handler].hostFd = hostFd;
+}
+
+extern void ciaaModbus_rtuRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   uint32_t loopi;
+   uint8_t *frame;
+
+   /* set pointer to received frame */
+   frame = ciaaModbus_rtuObj[handler].frame;
+
+   /* copy pdu */
+   for (loopi = 0 ; loopi < ciaaModbus_rtuObj[handler].frameSize ; loopi++)
+   {
+      pdu[loopi] = frame[loopi+1];
+   }
+
+   /* copy id */
+   *id = frame[0];
+
+   /* copy size, 0 if no frame received */
+   *size = ciaaModbus_rtuObj[handler].frameSize;
+
+   /* frame read */
+   ciaaModbus_rtuObj[handler].frameSize = 0;
+}
+
+extern void ciaaModbus_rtuSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_rtuObjType *obj = &ciaaModbus_rtuObj[handler];
+   uint32_t loopi;
+   uint32_t end;
+   uint16_t crc;
+   uint8_t *buf;
+
+   /* set pointer to buffer */
+   buf = obj->buffer;
+
+   /* verify correct len: id, pdu and crc */
+   if (CIAAMODBUS_RTU_MAXLENGTH >= (size + 3))
+   {
+      /* copy id and pdu */
+      buf[0] = id;
+      for (loopi = 0 ; loopi < size ; loopi++)
+      {
+         buf[loopi+1] = pdu[loopi];
+      }
+
+      /* increment size to include id */
+      size++;
+
+      /* add CRC low byte first and increment size */
+      crc = ciaaModbus_rtuCrc16(buf, size);
+      buf[size] = crc & 0xFF;
+      size++;
+      buf[size] = (crc >> 8) & 0xFF;
+      size++;
+
+      /* queue the frame if it fits, never queue a part of it */
+      if ( (CIAA_MODBUS_RTU_TX_BUFFER_SIZE - obj->txCount) >= size )
+      {
+         end = (obj->txHead + obj->txCount) % CIAA_MODBUS_RTU_TX_BUFFER_SIZE;
+
+         for (loopi = 0 ; loopi < size ; loopi++)
+         {
+            obj->txBuffer[end] = buf[loopi];
+            end = (end + 1) % CIAA_MODBUS_RTU_TX_BUFFER_SIZE;
+         }
+
+         obj->txCount += size;
+
+         /* start the transmission */
+         ciaaModbus_rtuFlush(handler);
+      }
+   }
+}
+
+extern bool ciaaModbus_rtuTxReady(int32_t handler)
+{
+   return ( (CIAA_MODBUS_RTU_TX_BUFFER_SIZE -
+             ciaaModbus_rtuObj[handler].txCount) >=
+            CIAAMODBUS_RTU_MAXLENGTH );
+}
+
+extern bool ciaaModbus_rtuPending(int32_t handler)
+{
+   return ( (0 != ciaaModbus_rtuObj[handler].frameSize) ||
+            (0 != ciaaModbus_rtuObj[handler].txCount) ||
+            (0 < ciaaModbus_rtuObj[handler].silence) ||
+            (ciaaModbus_reactorReady(ciaaModbus_rtuObj[handler].hostFd)) );
+}
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0 */
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
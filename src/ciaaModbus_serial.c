@@ -0,0 +1,259 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus serial line configuration
+ **
+ ** This file applies the configuration of a serial line used by the ASCII
+ ** and RTU transports.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_serial.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdio.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaPlatforms.h"
+
+#if (x86 == ARCH)
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Maximal baud rate */
+#define CIAAMODBUS_SERIAL_MAX_BAUDRATE    921600
+
+/** \brief Data bits of the ciaaPOSIX serial driver, not configurable */
+#define CIAAMODBUS_SERIAL_POSIX_DATABITS  8
+
+/** \brief Parity of the ciaaPOSIX serial driver, not configurable */
+#define CIAAMODBUS_SERIAL_POSIX_PARITY    CIAAMODBUS_SERIAL_PARITY_NONE
+
+/** \brief Stop bits of the ciaaPOSIX serial driver, not configurable */
+#define CIAAMODBUS_SERIAL_POSIX_STOPBITS  1
+
+#if (x86 == ARCH)
+/** \brief termios speed of a baud rate */
+typedef struct
+{
+   uint32_t baudRate;                  /** <- bits per second */
+   speed_t speed;                      /** <- termios speed */
+}ciaaModbus_serialSpeedType;
+#endif
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+#if (x86 == ARCH)
+/** \brief Baud rates supported by the host build */
+static const ciaaModbus_serialSpeedType ciaaModbus_serialSpeed[] =
+{
+   {1200, B1200},
+   {2400, B2400},
+   {4800, B4800},
+   {9600, B9600},
+   {19200, B19200},
+   {38400, B38400},
+   {57600, B57600},
+   {115200, B115200},
+   {230400, B230400},
+   {460800, B460800},
+   {921600, B921600},
+};
+#endif
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Check a serial line configuration
+ **
+ ** \param[in] config configuration of the line
+ ** \return true if valid
+ **/
+static bool ciaaModbus_serialCheck(ciaaModbus_serialConfigType const *config)
+{
+   return ( (0 < config->baudRate) &&
+            (CIAAMODBUS_SERIAL_MAX_BAUDRATE >= config->baudRate) &&
+            ( (7 == config->dataBits) || (8 == config->dataBits) ) &&
+            (CIAAMODBUS_SERIAL_PARITY_ODD >= config->parity) &&
+            ( (1 == config->stopBits) || (2 == config->stopBits) ) );
+}
+
+/** \brief Apply a serial line configuration through ciaaPOSIX
+ **
+ ** \param[in] fildes ciaaPOSIX file descriptor serial port
+ ** \param[in] config configuration of the line
+ ** \return 0 if configured
+ **         -1 if error or character format not supported
+ **/
+static int32_t ciaaModbus_serialPosix(
+      int32_t fildes,
+      ciaaModbus_serialConfigType const *config)
+{
+   int32_t ret = -1;
+
+   /* the character format of the driver is not configurable */
+   if ( (CIAAMODBUS_SERIAL_POSIX_DATABITS == config->dataBits) &&
+        (CIAAMODBUS_SERIAL_POSIX_PARITY == config->parity) &&
+        (CIAAMODBUS_SERIAL_POSIX_STOPBITS == config->stopBits) )
+   {
+      ret = ciaaPOSIX_ioctl(
+            fildes,
+            ciaaPOSIX_IOCTL_SET_BAUDRATE,
+            (void*)(uintptr_t)config->baudRate);
+
+      ret = (0 > ret) ? -1 : 0;
+   }
+
+   return ret;
+}
+
+#if (x86 == ARCH)
+/** \brief Apply a serial line configuration with termios
+ **
+ ** \param[in] hostFd file descriptor serial port in the host
+ ** \param[in] config configuration of the line
+ ** \return 0 if configured
+ **         -1 if error or baud rate not supported
+ **/
+static int32_t ciaaModbus_serialTermios(
+      int32_t hostFd,
+      ciaaModbus_serialConfigType const *config)
+{
+   struct termios tio;
+   struct serial_struct serial;
+   int32_t ret = -1;
+   uint32_t loopi;
+
+   /* search the speed of the baud rate */
+   for (loopi = 0 ;
+        (loopi < (sizeof(ciaaModbus_serialSpeed) / sizeof(ciaaModbus_serialSpeed[0]))) &&
+        (ciaaModbus_serialSpeed[loopi].baudRate != config->baudRate) ;
+        loopi++)
+   {
+   }
+
+   if ( (loopi < (sizeof(ciaaModbus_serialSpeed) / sizeof(ciaaModbus_serialSpeed[0]))) &&
+        (0 == tcgetattr(hostFd, &tio)) )
+   {
+      /* raw line, no echo and no translation of characters */
+      cfmakeraw(&tio);
+
+      /* character format */
+      tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cflag |= (7 == config->dataBits) ? CS7 : CS8;
+
+      if (CIAAMODBUS_SERIAL_PARITY_NONE != config->parity)
+      {
+         tio.c_cflag |= PARENB;
+      }
+
+      if (CIAAMODBUS_SERIAL_PARITY_ODD == config->parity)
+      {
+         tio.c_cflag |= PARODD;
+      }
+
+      if (2 == config->stopBits)
+      {
+         tio.c_cflag |= CSTOPB;
+      }
+
+      /* read parameters */
+      tio.c_cc[VMIN] = config->vmin;
+      tio.c_cc[VTIME] = config->vtime;
+
+      cfsetispeed(&tio, ciaaModbus_serialSpeed[loopi].speed);
+      cfsetospeed(&tio, ciaaModbus_serialSpeed[loopi].speed);
+
+      if (0 == tcsetattr(hostFd, TCSANOW, &tio))
+      {
+         ret = 0;
+      }
+   }
+
+   /* low latency is optional, not all drivers support it */
+   if ( (0 == ret) && (config->lowLatency) &&
+        (0 == ioctl(hostFd, TIOCGSERIAL, &serial)) )
+   {
+      serial.flags |= ASYNC_LOW_LATENCY;
+      (void)ioctl(hostFd, TIOCSSERIAL, &serial);
+   }
+
+   return ret;
+}
+#endif
+
+/*==================[external functions definition]==========================*/
+extern int32_t ciaaModbus_serialConfig(
+      int32_t fildes,
+      ciaaModbus_serialConfigType const *config)
+{
+   int32_t ret = -1;
+
+   if ( (NULL != config) && (ciaaModbus_serialCheck(config)) )
+   {
+#if (x86 == ARCH)
+      /* fildes is a ciaaPOSIX file descriptor, termios only applies to
+       * the file descriptor of the host */
+      if (0 <= config->hostFd)
+      {
+         ret = ciaaModbus_serialTermios(config->hostFd, config);
+      }
+      else
+#endif
+      {
+         ret = ciaaModbus_serialPosix(fildes, config);
+      }
+   }
+
+   return ret;
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
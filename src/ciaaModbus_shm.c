@@ -0,0 +1,436 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the Modbus Shared Memory functionality
+ **
+ ** This file implements a transport to a process of the same host through
+ ** a shared memory object. Each direction is a lock free single producer
+ ** single consumer ring of messages. The stack polls its ring from the
+ ** gateway task, the peer process waits on a futex.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_shm.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaPOSIX_string.h"
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_SHM > 0
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <unistd.h>
+#include <time.h>
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Modbus Shared Memory Object type */
+typedef struct
+{
+   ciaaModbus_shmSegmentType *segment;       /** <- mapped segment */
+   int32_t event;                            /** <- eventfd signalled by the
+                                                    peer, -1 if none */
+   bool inUse;                               /** <- Object in use */
+}ciaaModbus_shmObjType;
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief Array of Modbus Shared Memory Object */
+static ciaaModbus_shmObjType ciaaModbus_shmObj[CIAA_MODBUS_TOTAL_TRANSPORT_SHM];
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Put a message in a ring
+ **
+ ** Only one side puts messages in a ring. The consumer is woken up if
+ ** waiting.
+ **
+ ** \param[inout] ring ring to put the message
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return 0 if put, -1 if ring full or invalid size
+ **/
+static int32_t ciaaModbus_shmPut(
+      ciaaModbus_shmRingType *ring,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_shmMsgType *msg;
+   uint32_t tail;
+   uint32_t head;
+   uint32_t loopi;
+   int32_t ret = -1;
+
+   /* tail is only written by this side */
+   tail = ring->tail;
+   head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+   if ( (CIAAMODBUS_SHM_QUEUE_LENGTH > (tail - head)) &&
+        (0 < size) &&
+        (CIAAMODBUS_SHM_PDU_MAXLENGTH >= size) )
+   {
+      msg = &ring->msg[tail & (CIAAMODBUS_SHM_QUEUE_LENGTH - 1)];
+
+      /* copy message */
+      msg->id = id;
+      msg->size = size;
+      for (loopi = 0 ; loopi < size ; loopi++)
+      {
+         msg->pdu[loopi] = pdu[loopi];
+      }
+
+      /* publish message */
+      __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+      /* wake up consumer only if waiting */
+      __atomic_add_fetch(&ring->seq, 1, __ATOMIC_SEQ_CST);
+      if (0 < __atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST))
+      {
+         syscall(SYS_futex, &ring->seq, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+      }
+
+      ret = 0;
+   }
+
+   return ret;
+}
+
+/** \brief Get a message from a ring
+ **
+ ** Only one side gets messages from a ring. The ring is writable by the
+ ** peer, so the size is read once and messages of invalid size are
+ ** discarded.
+ **
+ ** \param[inout] ring ring to get the message
+ ** \param[out] id identification number of modbus message
+ ** \param[out] pdu buffer with stored pdu
+ ** \param[out] size size of pdu, 0 if ring empty or message discarded
+ ** \return
+ **/
+static void ciaaModbus_shmGet(
+      ciaaModbus_shmRingType *ring,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_shmMsgType *msg;
+   uint32_t tail;
+   uint32_t head;
+   uint32_t msgSize;
+   uint32_t loopi;
+
+   /* head is only written by this side */
+   head = ring->head;
+   tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+   *size = 0;
+
+   if (head != tail)
+   {
+      msg = &ring->msg[head & (CIAAMODBUS_SHM_QUEUE_LENGTH - 1)];
+
+      /* read size once, the peer may change it while copying */
+      msgSize = __atomic_load_n(&msg->size, __ATOMIC_RELAXED);
+
+      /* copy message */
+      if (CIAAMODBUS_SHM_PDU_MAXLENGTH >= msgSize)
+      {
+         *id = msg->id;
+         *size = msgSize;
+         for (loopi = 0 ; loopi < msgSize ; loopi++)
+         {
+            pdu[loopi] = msg->pdu[loopi];
+         }
+      }
+
+      /* release message */
+      __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+   }
+}
+
+/** \brief Get monotonic time in milliseconds */
+static uint64_t ciaaModbus_shmGetTime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*==================[external functions definition]==========================*/
+extern void ciaaModbus_shmInit(void)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_SHM ; loopi++)
+   {
+      ciaaModbus_shmObj[loopi].inUse = false;
+      ciaaModbus_shmObj[loopi].segment = NULL;
+
+      /* 0 before the first initialization */
+      if (0 < ciaaModbus_shmObj[loopi].event)
+      {
+         close(ciaaModbus_shmObj[loopi].event);
+      }
+
+      ciaaModbus_shmObj[loopi].event = -1;
+   }
+}
+
+extern int32_t ciaaModbus_shmOpen(int32_t fildes)
+{
+   int32_t hModbusShm = 0;
+   ciaaModbus_shmSegmentType *segment = MAP_FAILED;
+
+   /* search a modbus shared memory Object not in use */
+   while ( (hModbusShm < CIAA_MODBUS_TOTAL_TRANSPORT_SHM) &&
+           (ciaaModbus_shmObj[hModbusShm].inUse == true) )
+   {
+      hModbusShm++;
+   }
+
+   /* size and map the shared memory object */
+   if ( (hModbusShm < CIAA_MODBUS_TOTAL_TRANSPORT_SHM) &&
+        (0 == ftruncate(fildes, sizeof(ciaaModbus_shmSegmentType))) )
+   {
+      segment = mmap(NULL, sizeof(ciaaModbus_shmSegmentType),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fildes, 0);
+   }
+
+   if (MAP_FAILED != segment)
+   {
+      /* empty rings */
+      ciaaPOSIX_memset(segment, 0, sizeof(ciaaModbus_shmSegmentType));
+      segment->peerEvent = -1;
+
+      /* event signalled by the peer */
+      if (0 > ciaaModbus_shmObj[hModbusShm].event)
+      {
+         ciaaModbus_shmObj[hModbusShm].event = eventfd(0, EFD_NONBLOCK);
+
+         /* without reactor the transport is checked each task */
+         (void)ciaaModbus_reactorAdd(ciaaModbus_shmObj[hModbusShm].event);
+      }
+
+      /* segment initialized */
+      __atomic_store_n(&segment->magic, CIAAMODBUS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+      /* set object in use */
+      ciaaModbus_shmObj[hModbusShm].inUse = true;
+      ciaaModbus_shmObj[hModbusShm].segment = segment;
+   }
+   else
+   {
+      hModbusShm = -1;
+   }
+
+   return hModbusShm;
+}
+
+extern void ciaaModbus_shmTask(int32_t handler)
+{
+   int32_t event = ciaaModbus_shmObj[handler].event;
+   uint64_t value;
+
+   /* messages are transferred when sent, consume wake ups of the peer */
+   if ( (0 <= event) && (ciaaModbus_reactorReady(event)) )
+   {
+      (void)read(event, &value, sizeof(value));
+   }
+}
+
+extern void ciaaModbus_shmRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_shmGet(&ciaaModbus_shmObj[handler].segment->toStack, id, pdu, size);
+}
+
+extern void ciaaModbus_shmSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_shmPut(&ciaaModbus_shmObj[handler].segment->fromStack, id, pdu, size);
+}
+
+extern bool ciaaModbus_shmTxReady(int32_t handler)
+{
+   ciaaModbus_shmRingType *ring = &ciaaModbus_shmObj[handler].segment->fromStack;
+
+   return (CIAAMODBUS_SHM_QUEUE_LENGTH >
+           (ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)));
+}
+
+extern bool ciaaModbus_shmPending(int32_t handler)
+{
+   ciaaModbus_shmRingType *ring = &ciaaModbus_shmObj[handler].segment->toStack;
+   int32_t event = ciaaModbus_shmObj[handler].event;
+
+   /* a wake up not consumed also keeps the transport pending */
+   return ( (ring->head != __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) ||
+            ( (0 <= event) && (ciaaModbus_reactorReady(event)) ) );
+}
+
+extern int32_t ciaaModbus_shmGetEvent(int32_t handler)
+{
+   return ciaaModbus_shmObj[handler].event;
+}
+
+extern ciaaModbus_shmSegmentType * ciaaModbus_shmPeerMap(
+      int32_t fildes,
+      int32_t event)
+{
+   ciaaModbus_shmSegmentType *segment = NULL;
+   struct stat st;
+
+   /* check the object has been sized by ciaaModbus_shmOpen */
+   if ( (0 == fstat(fildes, &st)) &&
+        (sizeof(ciaaModbus_shmSegmentType) <= st.st_size) )
+   {
+      segment = mmap(NULL, sizeof(ciaaModbus_shmSegmentType),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fildes, 0);
+
+      if (MAP_FAILED == segment)
+      {
+         segment = NULL;
+      }
+      else if (CIAAMODBUS_SHM_MAGIC !=
+               __atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE))
+      {
+         /* not initialized */
+         munmap(segment, sizeof(ciaaModbus_shmSegmentType));
+         segment = NULL;
+      }
+      else
+      {
+         segment->peerEvent = event;
+      }
+   }
+
+   return segment;
+}
+
+extern int32_t ciaaModbus_shmPeerSendMsg(
+      ciaaModbus_shmSegmentType *segment,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   uint64_t value = 1;
+   int32_t ret;
+
+   ret = ciaaModbus_shmPut(&segment->toStack, id, pdu, size);
+
+   /* wake up the gateway of the stack */
+   if ( (0 == ret) && (0 <= segment->peerEvent) )
+   {
+      (void)write(segment->peerEvent, &value, sizeof(value));
+   }
+
+   return ret;
+}
+
+extern void ciaaModbus_shmPeerRecvMsg(
+      ciaaModbus_shmSegmentType *segment,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size,
+      uint32_t timeout)
+{
+   ciaaModbus_shmRingType *ring = &segment->fromStack;
+   struct timespec ts;
+   uint64_t deadline;
+   uint64_t now;
+   uint32_t seq;
+
+   deadline = ciaaModbus_shmGetTime() + timeout;
+
+   ciaaModbus_shmGet(ring, id, pdu, size);
+
+   while (0 == *size)
+   {
+      now = ciaaModbus_shmGetTime();
+
+      if (now >= deadline)
+      {
+         break;
+      }
+
+      /* announce waiter and check again before sleeping */
+      __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+      seq = __atomic_load_n(&ring->seq, __ATOMIC_SEQ_CST);
+
+      if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head)
+      {
+         ts.tv_sec = (deadline - now) / 1000;
+         ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+
+         /* returns when seq changes, timeout or signal */
+         syscall(SYS_futex, &ring->seq, FUTEX_WAIT, seq, &ts, NULL, 0);
+      }
+
+      __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+
+      ciaaModbus_shmGet(ring, id, pdu, size);
+   }
+}
+
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_SHM > 0 */
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
@@ -549,9 +549,13 @@ extern void ciaaModbus_slaveRecvMsg(
 
    *id = ciaaModbus_slaveObj[handler].id;
 
-   for (loopi = 0 ; loopi < ciaaModbus_slaveObj[handler].size ; loopi++)
+   /* the response is processed in place, copy only to another buffer */
+   if (pdu != ciaaModbus_slaveObj[handler].buf)
    {
-      pdu[loopi] = ciaaModbus_slaveObj[handler].buf[loopi];
+      for (loopi = 0 ; loopi < ciaaModbus_slaveObj[handler].size ; loopi++)
+      {
+         pdu[loopi] = ciaaModbus_slaveObj[handler].buf[loopi];
+      }
    }
 
    *size = ciaaModbus_slaveObj[handler].size;
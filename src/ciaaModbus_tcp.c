@@ -0,0 +1,1909 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \brief This file implements the Modbus TCP functionality
+ **
+ ** This file implements the Modbus TCP transports. A server is opened
+ ** over a listening socket and serves all the connections accepted from it.
+ ** A master keeps a persistent connection to its destination, connected
+ ** when the first request is sent and reconnected with exponential backoff.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_tcp.h"
+#include "ciaaModbus_transport.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdbool.h"
+#include "ciaaPOSIX_string.h"
+#include "ciaaModbus.h"
+#include "ciaaPlatforms.h"
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0
+
+#if (x86 != ARCH)
+#error CIAA_MODBUS_TOTAL_TRANSPORT_TCP is only available in Linux hosts
+#endif
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+/*==================[macros and definitions]=================================*/
+
+#ifndef CIAA_MODBUS_TCP_TOTAL_CONNECTIONS
+/** \brief Default connections accepted by all the servers */
+#define CIAA_MODBUS_TCP_TOTAL_CONNECTIONS       8
+#endif
+
+#ifndef CIAA_MODBUS_TCP_TOTAL_BUFFERS
+/** \brief Default buffers shared by the connections with pending data */
+#define CIAA_MODBUS_TCP_TOTAL_BUFFERS           4
+#endif
+
+#ifndef CIAA_MODBUS_TCP_IDLE_TIMEOUT
+/** \brief Default time to close an idle server connection (milliseconds),
+ ** 0 to disable */
+#define CIAA_MODBUS_TCP_IDLE_TIMEOUT            60000
+#endif
+
+#ifndef CIAA_MODBUS_TCP_WHEEL_TICK
+/** \brief Default resolution of the idle timeout (milliseconds) */
+#define CIAA_MODBUS_TCP_WHEEL_TICK              100
+#endif
+
+#ifndef CIAA_MODBUS_TCP_FRAME_TIMEOUT
+/** \brief Default time to close a server connection holding part of a
+ ** frame (milliseconds), 0 to disable */
+#define CIAA_MODBUS_TCP_FRAME_TIMEOUT           1000
+#endif
+
+#ifndef CIAA_MODBUS_TCP_CORK
+/** \brief Default use of TCP_CORK when responses can not be gathered */
+#define CIAA_MODBUS_TCP_CORK                    0
+#endif
+
+#ifndef CIAA_MODBUS_TCP_ADU_BUDGET
+/** \brief Default messages delivered by connection in each task */
+#define CIAA_MODBUS_TCP_ADU_BUDGET              4
+#endif
+
+#ifndef CIAA_MODBUS_TCP_MASTER_CONNECT_TIMEOUT
+/** \brief Default timeout to establish a master connection (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_CONNECT_TIMEOUT  1000
+#endif
+
+#ifndef CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN
+/** \brief Default first reconnection delay (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN      100
+#endif
+
+#ifndef CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX
+/** \brief Default maximal reconnection delay (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX      10000
+#endif
+
+#ifndef CIAA_MODBUS_TCP_MASTER_IDLE_TIMEOUT
+/** \brief Default time to close an idle master connection (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_IDLE_TIMEOUT     60000
+#endif
+
+#ifndef CIAA_MODBUS_TCP_MASTER_KEEPALIVE_IDLE
+/** \brief Default idle time before sending keepalive probes (seconds) */
+#define CIAA_MODBUS_TCP_MASTER_KEEPALIVE_IDLE   10
+#endif
+
+/** \brief Slots by level of the timer wheel */
+#define CIAAMODBUS_TCP_WHEEL_SLOTS        64
+
+/** \brief Bits of the slot index in a level of the timer wheel */
+#define CIAAMODBUS_TCP_WHEEL_BITS         6
+
+/** \brief Levels of the timer wheel */
+#define CIAAMODBUS_TCP_WHEEL_LEVELS       2
+
+/** \brief Maximal delay of a timer (ticks), longer timers are inserted
+ ** again when they fire */
+#define CIAAMODBUS_TCP_WHEEL_MAX_DELAY    \
+   (CIAAMODBUS_TCP_WHEEL_SLOTS * (CIAAMODBUS_TCP_WHEEL_SLOTS - 1))
+
+/** \brief Idle timeout (ticks) */
+#define CIAAMODBUS_TCP_IDLE_TICKS         \
+   (CIAA_MODBUS_TCP_IDLE_TIMEOUT / CIAA_MODBUS_TCP_WHEEL_TICK)
+
+/** \brief Length of the reception buffer of each connection */
+#define CIAAMODBUS_TCP_RXBUFFER_LENGTH    (2 * CIAAMODBUS_TCP_MAXLENGTH)
+
+/** \brief List of the connections to read: reported by the reactor, not
+ ** registered with it or holding data received */
+#define CIAAMODBUS_TCP_LIST_RX            0
+
+/** \brief List of the connections with responses pending */
+#define CIAAMODBUS_TCP_LIST_TX            1
+
+/** \brief Lists of connections of each server */
+#define CIAAMODBUS_TCP_LISTS              2
+
+/** \brief Link of a connection in a list of its server */
+typedef struct
+{
+   int32_t prev;                                /** <- previous connection */
+   int32_t next;                                /** <- next connection */
+   bool linked;                                 /** <- connection in list */
+}ciaaModbus_tcpLinkType;
+
+/** \brief Modbus TCP connection type
+ **
+ ** Connections of a server are linked in its lists only while they have
+ ** work pending, a buffer is attached to them only while data is pending.
+ **/
+typedef struct
+{
+   int32_t fildes;                              /** <- Socket descriptor */
+   int32_t next;                                /** <- next free connection */
+   ciaaModbus_tcpLinkType link[CIAAMODBUS_TCP_LISTS];
+                                                /** <- links in the lists of
+                                                       the server */
+   int32_t buffer;                              /** <- reception buffer, -1 if
+                                                       no data pending */
+   int32_t txBuffer;                            /** <- transmission buffer, -1 if
+                                                       no response pending */
+   int32_t server;                              /** <- handler of server */
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+   uint32_t lastActivity;                       /** <- tick of last data */
+   uint32_t expire;                             /** <- tick of timer */
+   int32_t timerSlot;                           /** <- slot of timer wheel */
+   int32_t timerPrev;                           /** <- previous timer in slot */
+   int32_t timerNext;                           /** <- next timer in slot */
+#endif
+#if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0
+   uint32_t frameStart;                         /** <- time part of a frame
+                                                       was found first */
+   bool partial;                                /** <- buffer holds part of
+                                                       a frame */
+#endif
+   uint8_t budget;                              /** <- messages left in this task */
+   bool corked;                                 /** <- TCP_CORK set */
+   bool registered;                             /** <- socket registered with
+                                                       the reactor */
+   bool inUse;                                  /** <- Connection in use */
+}ciaaModbus_tcpConnType;
+
+/** \brief Modbus TCP buffer type */
+typedef struct
+{
+   int32_t size;                                /** <- data size */
+   int32_t next;                                /** <- next free buffer */
+   uint8_t data[CIAAMODBUS_TCP_RXBUFFER_LENGTH];   /** <- data */
+}ciaaModbus_tcpBufferType;
+
+/** \brief Modbus TCP Object type */
+typedef struct
+{
+   int32_t fildes;                              /** <- Listening socket */
+   int32_t list[CIAAMODBUS_TCP_LISTS];          /** <- next connection to visit
+                                                       in each list, -1 if empty */
+   int32_t count[CIAAMODBUS_TCP_LISTS];         /** <- connections in each list */
+   int32_t connections;                         /** <- connections accepted */
+   int32_t current;                             /** <- connection of last message */
+   ciaaModbus_tcpStatsType stats;               /** <- connection statistics */
+   uint16_t transactionId;                      /** <- transaction of last message */
+   uint8_t buffer[CIAAMODBUS_TCP_MAXLENGTH];    /** <- transmission buffer of a
+                                                       response sent without
+                                                       connection buffer */
+   int32_t tailConn;                            /** <- connection of the response
+                                                       partially sent from buffer,
+                                                       -1 if none */
+   int32_t tailOffset;                          /** <- bytes of buffer sent */
+   int32_t tailSize;                            /** <- size of response in buffer */
+   bool inUse;                                  /** <- Object in use */
+}ciaaModbus_tcpObjType;
+
+/** \brief state of a Modbus TCP master connection */
+typedef enum
+{
+   CIAA_MODBUS_TCP_MASTER_STATE_DISCONNECTED = 0,
+   CIAA_MODBUS_TCP_MASTER_STATE_CONNECTING,
+   CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED,
+}ciaaModbus_tcpMasterStateEnum;
+
+/** \brief Modbus TCP master Object type */
+typedef struct
+{
+   uint32_t address;                            /** <- IPv4 address of destination */
+   uint16_t port;                               /** <- port of destination */
+   int32_t fildes;                              /** <- Socket descriptor */
+   ciaaModbus_tcpMasterStateEnum state;         /** <- connection state */
+   uint32_t backoff;                            /** <- next reconnection delay */
+   uint32_t retryTime;                          /** <- time of next connection */
+   uint32_t connectTime;                        /** <- time connection started */
+   uint32_t lastActivity;                       /** <- time of last data */
+   uint16_t transactionId;                      /** <- transaction of request */
+   uint8_t id;                                  /** <- id of request */
+   uint8_t function;                            /** <- function of request */
+   uint8_t exception;                           /** <- exception to respond */
+   bool waiting;                                /** <- waiting response */
+   int32_t txSize;                              /** <- request pending to send */
+   int32_t txOffset;                            /** <- bytes of request sent */
+   uint8_t txBuffer[CIAAMODBUS_TCP_MAXLENGTH];  /** <- transmission buffer */
+   int32_t bufferSize;                          /** <- buffer size */
+   uint8_t buffer[CIAAMODBUS_TCP_RXBUFFER_LENGTH]; /** <- reception buffer */
+   bool inUse;                                  /** <- Object in use */
+}ciaaModbus_tcpMasterObjType;
+
+/*==================[internal data declaration]==============================*/
+
+/** \brief Array of Modbus TCP Object */
+static ciaaModbus_tcpObjType ciaaModbus_tcpObj[CIAA_MODBUS_TOTAL_TRANSPORT_TCP];
+
+/** \brief Array of Modbus TCP master Object */
+static ciaaModbus_tcpMasterObjType ciaaModbus_tcpMasterObj[CIAA_MODBUS_TOTAL_TRANSPORT_TCP];
+
+/** \brief Slab of connections of all the Modbus TCP servers */
+static ciaaModbus_tcpConnType ciaaModbus_tcpConn[CIAA_MODBUS_TCP_TOTAL_CONNECTIONS];
+
+/** \brief Slab of reception buffers of all the Modbus TCP servers */
+static ciaaModbus_tcpBufferType ciaaModbus_tcpBuffer[CIAA_MODBUS_TCP_TOTAL_BUFFERS];
+
+/** \brief First connection not in use, -1 if none */
+static int32_t ciaaModbus_tcpConnFree;
+
+/** \brief Connection of each socket registered with the reactor, -1 if
+ ** none */
+static int32_t ciaaModbus_tcpConnFd[CIAA_MODBUS_REACTOR_MAX_FDS];
+
+/** \brief First buffer not in use, -1 if none */
+static int32_t ciaaModbus_tcpBufferFree;
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+/** \brief Timer wheel of idle timeouts, first connection of each slot */
+static int32_t ciaaModbus_tcpWheel[CIAAMODBUS_TCP_WHEEL_LEVELS * CIAAMODBUS_TCP_WHEEL_SLOTS];
+
+/** \brief Current tick of the timer wheel */
+static uint32_t ciaaModbus_tcpWheelTick;
+#endif
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Set socket in non blocking mode
+ **
+ ** \param[in] fildes socket descriptor
+ ** \return -1 if error, 0 if ok
+ **/
+static int32_t ciaaModbus_tcpSetNonBlock(int32_t fildes)
+{
+   int32_t ret = -1;
+   int32_t flags;
+
+   flags = fcntl(fildes, F_GETFL, 0);
+
+   if (0 <= flags)
+   {
+      ret = fcntl(fildes, F_SETFL, flags | O_NONBLOCK);
+   }
+
+   return ret;
+}
+
+/** \brief Get time in milliseconds
+ **
+ ** \return monotonic time in milliseconds, wraps around
+ **/
+static uint32_t ciaaModbus_tcpGetTime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (uint32_t)((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+/** \brief Check if a time has been reached
+ **
+ ** \param[in] now current time
+ ** \param[in] time time to check
+ ** \return true if time reached
+ **/
+static bool ciaaModbus_tcpTimeReached(uint32_t now, uint32_t time)
+{
+   return (0 <= (int32_t)(now - time));
+}
+
+/** \brief Attach a buffer to a connection
+ **
+ ** \param[inout] index index of the buffer of the connection, -1 if
+ **             no buffer attached
+ ** \return pointer to the buffer, NULL if no buffer available
+ **/
+static ciaaModbus_tcpBufferType * ciaaModbus_tcpBufferAttach(int32_t *index)
+{
+   ciaaModbus_tcpBufferType *ret = NULL;
+
+   /* take first free buffer */
+   if ( (0 > *index) && (0 <= ciaaModbus_tcpBufferFree) )
+   {
+      *index = ciaaModbus_tcpBufferFree;
+      ciaaModbus_tcpBufferFree = ciaaModbus_tcpBuffer[*index].next;
+      ciaaModbus_tcpBuffer[*index].size = 0;
+   }
+
+   if (0 <= *index)
+   {
+      ret = &ciaaModbus_tcpBuffer[*index];
+   }
+
+   return ret;
+}
+
+/** \brief Detach the buffer of a connection if it is empty
+ **
+ ** \param[inout] index index of the buffer of the connection
+ **/
+static void ciaaModbus_tcpBufferDetach(int32_t *index)
+{
+   if ( (0 <= *index) &&
+        (0 == ciaaModbus_tcpBuffer[*index].size) )
+   {
+      ciaaModbus_tcpBuffer[*index].next = ciaaModbus_tcpBufferFree;
+      ciaaModbus_tcpBufferFree = *index;
+      *index = -1;
+   }
+}
+
+/** \brief Insert a connection in a list of its server
+ **
+ ** The connection is visited after the ones in the list, a connection
+ ** already in the list keeps its place.
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ ** \param[in] list list to insert the connection in
+ ** \param[in] index index of the connection
+ **/
+static void ciaaModbus_tcpListAdd(
+      ciaaModbus_tcpObjType *obj,
+      int32_t list,
+      int32_t index)
+{
+   ciaaModbus_tcpLinkType *link = &ciaaModbus_tcpConn[index].link[list];
+
+   if (false == link->linked)
+   {
+      if (0 == obj->count[list])
+      {
+         link->prev = index;
+         link->next = index;
+         obj->list[list] = index;
+      }
+      else
+      {
+         /* insert before the next one to visit */
+         link->next = obj->list[list];
+         link->prev = ciaaModbus_tcpConn[link->next].link[list].prev;
+         ciaaModbus_tcpConn[link->prev].link[list].next = index;
+         ciaaModbus_tcpConn[link->next].link[list].prev = index;
+      }
+
+      link->linked = true;
+      obj->count[list]++;
+   }
+}
+
+/** \brief Remove a connection from a list of its server
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ ** \param[in] list list to remove the connection from
+ ** \param[in] index index of the connection
+ **/
+static void ciaaModbus_tcpListRemove(
+      ciaaModbus_tcpObjType *obj,
+      int32_t list,
+      int32_t index)
+{
+   ciaaModbus_tcpLinkType *link = &ciaaModbus_tcpConn[index].link[list];
+
+   if (link->linked)
+   {
+      link->linked = false;
+      obj->count[list]--;
+
+      if (0 == obj->count[list])
+      {
+         obj->list[list] = -1;
+      }
+      else
+      {
+         ciaaModbus_tcpConn[link->prev].link[list].next = link->next;
+         ciaaModbus_tcpConn[link->next].link[list].prev = link->prev;
+
+         if (obj->list[list] == index)
+         {
+            obj->list[list] = link->next;
+         }
+      }
+   }
+}
+
+/** \brief Write a modbus tcp frame
+ **
+ ** \param[out] buf buffer to store the frame
+ ** \param[in] transactionId transaction identifier
+ ** \param[in] id identification number of modbus message
+ ** \param[in] pdu buffer with stored pdu
+ ** \param[in] size size of pdu
+ ** \return length of the frame
+ **/
+static int32_t ciaaModbus_tcpWriteFrame(
+      uint8_t *buf,
+      uint16_t transactionId,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   uint32_t loopi;
+
+   /* write MBAP header */
+   ciaaModbus_writeInt(&buf[0], transactionId);
+   ciaaModbus_writeInt(&buf[2], CIAAMODBUS_TCP_PROTOCOL_ID);
+   ciaaModbus_writeInt(&buf[4], size + 1);
+   buf[6] = id;
+
+   /* copy pdu */
+   for (loopi = 0 ; loopi < size ; loopi++)
+   {
+      buf[CIAAMODBUS_TCP_MBAP_LENGTH + loopi] = pdu[loopi];
+   }
+
+   return size + CIAAMODBUS_TCP_MBAP_LENGTH;
+}
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+/** \brief Get current tick of timer wheel
+ **
+ ** \return time in CIAA_MODBUS_TCP_WHEEL_TICK units
+ **/
+static uint32_t ciaaModbus_tcpGetTick(void)
+{
+   return ciaaModbus_tcpGetTime() / CIAA_MODBUS_TCP_WHEEL_TICK;
+}
+
+/** \brief Insert the timer of a connection in the timer wheel
+ **
+ ** \param[in] index index of the connection
+ ** \param[in] expire tick when the timer expires
+ **/
+static void ciaaModbus_tcpTimerInsert(int32_t index, uint32_t expire)
+{
+   ciaaModbus_tcpConnType *conn = &ciaaModbus_tcpConn[index];
+   int32_t delay = (int32_t)(expire - ciaaModbus_tcpWheelTick);
+   int32_t slot;
+
+   /* expired timers fire in next tick, long ones are clamped */
+   if (1 > delay)
+   {
+      delay = 1;
+   }
+   else if (CIAAMODBUS_TCP_WHEEL_MAX_DELAY < delay)
+   {
+      delay = CIAAMODBUS_TCP_WHEEL_MAX_DELAY;
+   }
+
+   conn->expire = ciaaModbus_tcpWheelTick + delay;
+
+   if (CIAAMODBUS_TCP_WHEEL_SLOTS > delay)
+   {
+      /* first level: a slot per tick */
+      slot = conn->expire % CIAAMODBUS_TCP_WHEEL_SLOTS;
+   }
+   else
+   {
+      /* second level: a slot per CIAAMODBUS_TCP_WHEEL_SLOTS ticks */
+      slot = CIAAMODBUS_TCP_WHEEL_SLOTS +
+         ((conn->expire >> CIAAMODBUS_TCP_WHEEL_BITS) % CIAAMODBUS_TCP_WHEEL_SLOTS);
+   }
+
+   /* insert at the beginning of the slot */
+   conn->timerSlot = slot;
+   conn->timerPrev = -1;
+   conn->timerNext = ciaaModbus_tcpWheel[slot];
+
+   if (0 <= conn->timerNext)
+   {
+      ciaaModbus_tcpConn[conn->timerNext].timerPrev = index;
+   }
+
+   ciaaModbus_tcpWheel[slot] = index;
+}
+
+/** \brief Remove the timer of a connection from the timer wheel
+ **
+ ** \param[in] index index of the connection
+ **/
+static void ciaaModbus_tcpTimerRemove(int32_t index)
+{
+   ciaaModbus_tcpConnType *conn = &ciaaModbus_tcpConn[index];
+
+   if (0 > conn->timerSlot)
+   {
+      /* timer not in wheel */
+   }
+   else if (0 <= conn->timerPrev)
+   {
+      ciaaModbus_tcpConn[conn->timerPrev].timerNext = conn->timerNext;
+   }
+   else
+   {
+      ciaaModbus_tcpWheel[conn->timerSlot] = conn->timerNext;
+   }
+
+   if (0 <= conn->timerNext)
+   {
+      ciaaModbus_tcpConn[conn->timerNext].timerPrev = conn->timerPrev;
+   }
+
+   conn->timerSlot = -1;
+}
+#endif /* #if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0 */
+
+/** \brief Close a connection of a Modbus TCP server
+ **
+ ** The connection is removed from the lists of the server and returned
+ ** to the slab with its buffers.
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ ** \param[in] index index of the connection to close
+ **/
+static void ciaaModbus_tcpCloseConn(ciaaModbus_tcpObjType *obj, int32_t index)
+{
+   ciaaModbus_tcpConnType *conn = &ciaaModbus_tcpConn[index];
+
+   if (conn->registered)
+   {
+      ciaaModbus_tcpConnFd[conn->fildes] = -1;
+   }
+
+   ciaaModbus_reactorRemove(conn->fildes);
+   close(conn->fildes);
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+   ciaaModbus_tcpTimerRemove(index);
+#endif
+
+   obj->stats.closed++;
+
+   /* release buffers */
+   if (0 <= conn->buffer)
+   {
+      ciaaModbus_tcpBuffer[conn->buffer].size = 0;
+      ciaaModbus_tcpBufferDetach(&conn->buffer);
+   }
+
+   if (0 <= conn->txBuffer)
+   {
+      ciaaModbus_tcpBuffer[conn->txBuffer].size = 0;
+      ciaaModbus_tcpBufferDetach(&conn->txBuffer);
+   }
+
+   /* remove from lists of server */
+   ciaaModbus_tcpListRemove(obj, CIAAMODBUS_TCP_LIST_RX, index);
+   ciaaModbus_tcpListRemove(obj, CIAAMODBUS_TCP_LIST_TX, index);
+
+   obj->connections--;
+
+   /* return connection to slab */
+   conn->fildes = -1;
+   conn->inUse = false;
+   conn->next = ciaaModbus_tcpConnFree;
+   ciaaModbus_tcpConnFree = index;
+
+   /* a response for this connection can not be sent anymore */
+   if (obj->current == index)
+   {
+      obj->current = -1;
+   }
+
+   if (obj->tailConn == index)
+   {
+      obj->tailConn = -1;
+   }
+}
+
+/** \brief Accept pending connections of a Modbus TCP server
+ **
+ ** If the slab of connections is exhausted the new connection is closed
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ **/
+static void ciaaModbus_tcpAccept(ciaaModbus_tcpObjType *obj)
+{
+   ciaaModbus_tcpConnType *conn;
+   int32_t fildes;
+   int32_t index;
+   int32_t noDelay = 1;
+
+   while (0 <= (fildes = accept(obj->fildes, NULL, NULL)))
+   {
+      index = ciaaModbus_tcpConnFree;
+
+      if ( (0 <= index) &&
+           (0 == ciaaModbus_tcpSetNonBlock(fildes)) )
+      {
+         /* responses are sent as soon as they are ready */
+         setsockopt(fildes, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+         /* take connection from slab */
+         conn = &ciaaModbus_tcpConn[index];
+         ciaaModbus_tcpConnFree = conn->next;
+
+         conn->fildes = fildes;
+         conn->buffer = -1;
+         conn->txBuffer = -1;
+         conn->budget = 0;
+         conn->corked = false;
+#if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0
+         conn->partial = false;
+#endif
+         conn->server = obj - ciaaModbus_tcpObj;
+         conn->inUse = true;
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+         /* start idle timeout */
+         conn->lastActivity = ciaaModbus_tcpGetTick();
+         ciaaModbus_tcpTimerInsert(index, conn->lastActivity + CIAAMODBUS_TCP_IDLE_TICKS);
+#endif
+
+         /* read only if data pending, if supported, else on each task */
+         conn->registered = (0 == ciaaModbus_reactorAdd(fildes));
+
+         if (conn->registered)
+         {
+            ciaaModbus_tcpConnFd[fildes] = index;
+         }
+         else
+         {
+            ciaaModbus_tcpListAdd(obj, CIAAMODBUS_TCP_LIST_RX, index);
+         }
+
+         obj->connections++;
+         obj->stats.accepted++;
+      }
+      else
+      {
+         /* no connection available: refuse it */
+         close(fildes);
+         obj->stats.refused++;
+      }
+   }
+}
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+/** \brief Advance the timer wheel up to current tick
+ **
+ ** Timers of connections with activity since they were inserted are
+ ** inserted again, the other connections are closed.
+ **/
+static void ciaaModbus_tcpReap(void)
+{
+   ciaaModbus_tcpConnType *conn;
+   uint32_t tick = ciaaModbus_tcpGetTick();
+   int32_t slot;
+   int32_t index;
+   int32_t next;
+
+   while (0 < (int32_t)(tick - ciaaModbus_tcpWheelTick))
+   {
+      ciaaModbus_tcpWheelTick++;
+
+      /* first level wraps: move timers of next second level slot */
+      if (0 == (ciaaModbus_tcpWheelTick % CIAAMODBUS_TCP_WHEEL_SLOTS))
+      {
+         slot = CIAAMODBUS_TCP_WHEEL_SLOTS +
+            ((ciaaModbus_tcpWheelTick >> CIAAMODBUS_TCP_WHEEL_BITS) % CIAAMODBUS_TCP_WHEEL_SLOTS);
+
+         index = ciaaModbus_tcpWheel[slot];
+         ciaaModbus_tcpWheel[slot] = -1;
+
+         while (0 <= index)
+         {
+            next = ciaaModbus_tcpConn[index].timerNext;
+            ciaaModbus_tcpTimerInsert(index, ciaaModbus_tcpConn[index].expire);
+            index = next;
+         }
+      }
+
+      /* fire timers of current slot */
+      slot = ciaaModbus_tcpWheelTick % CIAAMODBUS_TCP_WHEEL_SLOTS;
+
+      index = ciaaModbus_tcpWheel[slot];
+      ciaaModbus_tcpWheel[slot] = -1;
+
+      while (0 <= index)
+      {
+         conn = &ciaaModbus_tcpConn[index];
+         next = conn->timerNext;
+         conn->timerSlot = -1;
+
+         if (0 < (int32_t)(conn->lastActivity + CIAAMODBUS_TCP_IDLE_TICKS -
+                           ciaaModbus_tcpWheelTick))
+         {
+            /* activity since inserted: insert again */
+            ciaaModbus_tcpTimerInsert(index,
+                  conn->lastActivity + CIAAMODBUS_TCP_IDLE_TICKS);
+         }
+         else
+         {
+            /* idle connection: close it */
+            ciaaModbus_tcpObj[conn->server].stats.reaped++;
+            ciaaModbus_tcpCloseConn(&ciaaModbus_tcpObj[conn->server], index);
+         }
+
+         index = next;
+      }
+   }
+}
+#endif /* #if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0 */
+
+#if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0
+/** \brief Check the time a connection holds part of a frame
+ **
+ ** A buffer is attached to a connection while part of a frame is
+ ** pending, and the buffers are shared by all the connections. A
+ ** connection not completing its frame in CIAA_MODBUS_TCP_FRAME_TIMEOUT
+ ** is closed to return its buffer, even if it keeps sending data.
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ ** \param[in] index index of the connection to check
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpFrameCheck(
+      ciaaModbus_tcpObjType *obj,
+      int32_t index,
+      uint32_t now)
+{
+   ciaaModbus_tcpConnType *conn = &ciaaModbus_tcpConn[index];
+
+   if ( (0 <= conn->buffer) &&
+        (0 == ciaaModbus_tcp_checkCompleteMsg(
+               ciaaModbus_tcpBuffer[conn->buffer].data,
+               ciaaModbus_tcpBuffer[conn->buffer].size)) )
+   {
+      if (false == conn->partial)
+      {
+         /* part of a frame: start frame timeout */
+         conn->partial = true;
+         conn->frameStart = now;
+      }
+      else if (ciaaModbus_tcpTimeReached(now,
+               conn->frameStart + CIAA_MODBUS_TCP_FRAME_TIMEOUT))
+      {
+         /* frame not completed: close connection */
+         obj->stats.incomplete++;
+         ciaaModbus_tcpCloseConn(obj, index);
+      }
+   }
+   else
+   {
+      /* no data or a complete frame */
+      conn->partial = false;
+   }
+}
+#endif /* #if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0 */
+
+/** \brief Send the responses gathered in a connection
+ **
+ ** All responses are sent with a single call. Data not accepted by the
+ ** socket is kept for the next flush. The rest of a response sent without
+ ** connection buffer is sent first, so responses keep their order.
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ ** \param[in] index index of the connection to flush
+ ** \return true if data is still pending
+ **/
+static bool ciaaModbus_tcpFlushConn(ciaaModbus_tcpObjType *obj, int32_t index)
+{
+   ciaaModbus_tcpConnType *conn = &ciaaModbus_tcpConn[index];
+   ciaaModbus_tcpBufferType *buffer;
+   int32_t loopi;
+   ssize_t write = 0;
+
+   /* rest of a response sent without connection buffer */
+   if (obj->tailConn == index)
+   {
+      write = send(conn->fildes,
+            &obj->buffer[obj->tailOffset],
+            obj->tailSize - obj->tailOffset,
+            MSG_NOSIGNAL);
+
+      if (0 < write)
+      {
+         obj->tailOffset += write;
+
+         if (obj->tailOffset == obj->tailSize)
+         {
+            obj->tailConn = -1;
+         }
+      }
+   }
+
+   /* responses gathered after it */
+   if ( (obj->tailConn != index) && (0 <= conn->txBuffer) )
+   {
+      buffer = &ciaaModbus_tcpBuffer[conn->txBuffer];
+
+      write = send(conn->fildes, buffer->data, buffer->size, MSG_NOSIGNAL);
+
+      if (0 < write)
+      {
+         /* move data not sent to the beginning of the buffer */
+         for (loopi = write ; loopi < buffer->size ; loopi++)
+         {
+            buffer->data[loopi - write] = buffer->data[loopi];
+         }
+
+         buffer->size -= write;
+
+         ciaaModbus_tcpBufferDetach(&conn->txBuffer);
+      }
+   }
+
+#if (CIAA_MODBUS_TCP_CORK > 0) && defined(TCP_CORK)
+   /* send responses written while corked */
+   if ( (0 <= write) && (conn->corked) )
+   {
+      conn->corked = false;
+      loopi = 0;
+      setsockopt(conn->fildes, IPPROTO_TCP, TCP_CORK, &loopi, sizeof(loopi));
+   }
+#endif
+
+   if ( (0 > write) &&
+        (EAGAIN != errno) &&
+        (EWOULDBLOCK != errno) )
+   {
+      ciaaModbus_tcpCloseConn(obj, index);
+   }
+
+   return ( (conn->inUse) &&
+            ( (0 <= conn->txBuffer) || (conn->corked) || (obj->tailConn == index) ) );
+}
+
+/** \brief Send the responses gathered in the connections of a server
+ **
+ ** Only the connections with responses pending are visited, they leave
+ ** the list once all their data is sent.
+ **
+ ** \param[inout] obj pointer to modbus tcp object
+ **/
+static void ciaaModbus_tcpFlush(ciaaModbus_tcpObjType *obj)
+{
+   int32_t loopi;
+   int32_t index;
+   int32_t next;
+   int32_t connections;
+
+   index = obj->list[CIAAMODBUS_TCP_LIST_TX];
+   connections = obj->count[CIAAMODBUS_TCP_LIST_TX];
+
+   for (loopi = 0 ; loopi < connections ; loopi++)
+   {
+      next = ciaaModbus_tcpConn[index].link[CIAAMODBUS_TCP_LIST_TX].next;
+
+      if (false == ciaaModbus_tcpFlushConn(obj, index))
+      {
+         ciaaModbus_tcpListRemove(obj, CIAAMODBUS_TCP_LIST_TX, index);
+      }
+
+      index = next;
+   }
+}
+
+/** \brief Close the connection of a Modbus TCP master
+ **
+ ** If a response is expected, the request fails with exception
+ ** CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND.
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ **/
+static void ciaaModbus_tcpMasterClose(ciaaModbus_tcpMasterObjType *obj)
+{
+   close(obj->fildes);
+
+   obj->fildes = -1;
+   obj->bufferSize = 0;
+   obj->state = CIAA_MODBUS_TCP_MASTER_STATE_DISCONNECTED;
+
+   /* a request partially sent is sent again from the beginning */
+   obj->txOffset = 0;
+
+   /* request can not be answered by this connection */
+   if (obj->waiting)
+   {
+      obj->exception = CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND;
+      obj->txSize = 0;
+   }
+}
+
+/** \brief Connection of a Modbus TCP master failed
+ **
+ ** The next connection is delayed by the backoff, which is doubled
+ ** up to CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX.
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpMasterFailed(
+      ciaaModbus_tcpMasterObjType *obj,
+      uint32_t now)
+{
+   ciaaModbus_tcpMasterClose(obj);
+
+   /* delay next connection */
+   obj->retryTime = now + obj->backoff;
+
+   obj->backoff *= 2;
+
+   if (CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX < obj->backoff)
+   {
+      obj->backoff = CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX;
+   }
+}
+
+/** \brief Connection of a Modbus TCP master established
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpMasterConnected(
+      ciaaModbus_tcpMasterObjType *obj,
+      uint32_t now)
+{
+   obj->state = CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED;
+   obj->backoff = CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN;
+   obj->lastActivity = now;
+}
+
+/** \brief Start the connection of a Modbus TCP master
+ **
+ ** The connection is not blocking, it is completed by
+ ** ciaaModbus_tcpMasterTask().
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpMasterConnect(
+      ciaaModbus_tcpMasterObjType *obj,
+      uint32_t now)
+{
+   struct sockaddr_in addr;
+   int32_t optVal = 1;
+
+   obj->fildes = socket(AF_INET, SOCK_STREAM, 0);
+   obj->bufferSize = 0;
+   obj->connectTime = now;
+
+   if ( (0 > obj->fildes) ||
+        (0 != ciaaModbus_tcpSetNonBlock(obj->fildes)) )
+   {
+      ciaaModbus_tcpMasterFailed(obj, now);
+   }
+   else
+   {
+      /* requests are sent as soon as they are ready */
+      setsockopt(obj->fildes, IPPROTO_TCP, TCP_NODELAY, &optVal, sizeof(optVal));
+
+      /* detect destinations lost while the connection is idle */
+      setsockopt(obj->fildes, SOL_SOCKET, SO_KEEPALIVE, &optVal, sizeof(optVal));
+#ifdef TCP_KEEPIDLE
+      optVal = CIAA_MODBUS_TCP_MASTER_KEEPALIVE_IDLE;
+      setsockopt(obj->fildes, IPPROTO_TCP, TCP_KEEPIDLE, &optVal, sizeof(optVal));
+#endif
+
+      ciaaPOSIX_memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(obj->address);
+      addr.sin_port = htons(obj->port);
+
+      if (0 == connect(obj->fildes, (struct sockaddr *)&addr, sizeof(addr)))
+      {
+         ciaaModbus_tcpMasterConnected(obj, now);
+      }
+      else if (EINPROGRESS == errno)
+      {
+         obj->state = CIAA_MODBUS_TCP_MASTER_STATE_CONNECTING;
+      }
+      else
+      {
+         ciaaModbus_tcpMasterFailed(obj, now);
+      }
+   }
+}
+
+/** \brief Check if the connection of a Modbus TCP master is completed
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpMasterCheckConnect(
+      ciaaModbus_tcpMasterObjType *obj,
+      uint32_t now)
+{
+   struct pollfd pfd;
+   int32_t error = 0;
+   socklen_t len = sizeof(error);
+
+   pfd.fd = obj->fildes;
+   pfd.events = POLLOUT;
+   pfd.revents = 0;
+
+   if (0 < poll(&pfd, 1, 0))
+   {
+      /* connection completed, check result */
+      if ( (0 == getsockopt(obj->fildes, SOL_SOCKET, SO_ERROR, &error, &len)) &&
+           (0 == error) )
+      {
+         ciaaModbus_tcpMasterConnected(obj, now);
+      }
+      else
+      {
+         ciaaModbus_tcpMasterFailed(obj, now);
+      }
+   }
+   else if (ciaaModbus_tcpTimeReached(now,
+            obj->connectTime + CIAA_MODBUS_TCP_MASTER_CONNECT_TIMEOUT))
+   {
+      ciaaModbus_tcpMasterFailed(obj, now);
+   }
+}
+
+/** \brief Send the pending request of a Modbus TCP master
+ **
+ ** Data not accepted by the socket is sent by the next task.
+ **
+ ** \param[inout] obj pointer to modbus tcp master object
+ ** \param[in] now current time
+ **/
+static void ciaaModbus_tcpMasterFlush(
+      ciaaModbus_tcpMasterObjType *obj,
+      uint32_t now)
+{
+   ssize_t write;
+
+   write = send(obj->fildes,
+         &obj->txBuffer[obj->txOffset],
+         obj->txSize - obj->txOffset,
+         MSG_NOSIGNAL);
+
+   if (0 < write)
+   {
+      obj->txOffset += write;
+      obj->lastActivity = now;
+
+      /* request completely sent */
+      if (obj->txOffset == obj->txSize)
+      {
+         obj->txSize = 0;
+         obj->txOffset = 0;
+      }
+   }
+   else if ( (0 > write) &&
+             (EAGAIN != errno) &&
+             (EWOULDBLOCK != errno) )
+   {
+      /* connection lost: request can not be sent */
+      ciaaModbus_tcpMasterClose(obj);
+   }
+}
+
+/*==================[external functions definition]==========================*/
+extern int32_t ciaaModbus_tcp_checkCompleteMsg(uint8_t * buf, int32_t len)
+{
+   int32_t ret = 0;
+   int32_t length;
+
+   /* if the MBAP header has been received */
+   if (CIAAMODBUS_TCP_MBAP_LENGTH <= len)
+   {
+      /* length of unit identifier and pdu */
+      length = ciaaModbus_readInt(&buf[4]);
+
+      /* check protocol identifier and length field */
+      if ( (CIAAMODBUS_TCP_PROTOCOL_ID != ciaaModbus_readInt(&buf[2])) ||
+           ((CIAAMODBUS_TCP_MINLENGTH - CIAAMODBUS_TCP_MBAP_LENGTH + 1) > length) ||
+           ((CIAAMODBUS_TCP_MAXLENGTH - CIAAMODBUS_TCP_MBAP_LENGTH + 1) < length) )
+      {
+         ret = -1;
+      }
+      /* check if complete message has been received */
+      else if ((CIAAMODBUS_TCP_MBAP_LENGTH - 1 + length) <= len)
+      {
+         ret = CIAAMODBUS_TCP_MBAP_LENGTH - 1 + length;
+      }
+   }
+
+   return ret;
+}
+
+extern void ciaaModbus_tcpInit(void)
+{
+   int32_t loopi;
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_TCP ; loopi++)
+   {
+      ciaaModbus_tcpObj[loopi].inUse = false;
+      ciaaModbus_tcpMasterObj[loopi].inUse = false;
+   }
+
+   /* link all connections in free list */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_TOTAL_CONNECTIONS ; loopi++)
+   {
+      ciaaModbus_tcpConn[loopi].fildes = -1;
+      ciaaModbus_tcpConn[loopi].buffer = -1;
+      ciaaModbus_tcpConn[loopi].txBuffer = -1;
+      ciaaModbus_tcpConn[loopi].link[CIAAMODBUS_TCP_LIST_RX].linked = false;
+      ciaaModbus_tcpConn[loopi].link[CIAAMODBUS_TCP_LIST_TX].linked = false;
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+      ciaaModbus_tcpConn[loopi].timerSlot = -1;
+#endif
+      ciaaModbus_tcpConn[loopi].inUse = false;
+      ciaaModbus_tcpConn[loopi].next = loopi + 1;
+   }
+   ciaaModbus_tcpConn[CIAA_MODBUS_TCP_TOTAL_CONNECTIONS - 1].next = -1;
+   ciaaModbus_tcpConnFree = 0;
+
+   /* no socket of a connection registered */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_REACTOR_MAX_FDS ; loopi++)
+   {
+      ciaaModbus_tcpConnFd[loopi] = -1;
+   }
+
+   /* link all buffers in free list */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_TOTAL_BUFFERS ; loopi++)
+   {
+      ciaaModbus_tcpBuffer[loopi].size = 0;
+      ciaaModbus_tcpBuffer[loopi].next = loopi + 1;
+   }
+   ciaaModbus_tcpBuffer[CIAA_MODBUS_TCP_TOTAL_BUFFERS - 1].next = -1;
+   ciaaModbus_tcpBufferFree = 0;
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+   /* empty timer wheel */
+   for (loopi = 0 ;
+        loopi < (CIAAMODBUS_TCP_WHEEL_LEVELS * CIAAMODBUS_TCP_WHEEL_SLOTS) ;
+        loopi++)
+   {
+      ciaaModbus_tcpWheel[loopi] = -1;
+   }
+   ciaaModbus_tcpWheelTick = ciaaModbus_tcpGetTick();
+#endif
+}
+
+extern int32_t ciaaModbus_tcpOpen(int32_t fildes)
+{
+   int32_t hModbusTcp;
+
+   /* initialize handler with valid value */
+   hModbusTcp = 0;
+
+   /* search a modbus tcp Object not in use */
+   while ( (hModbusTcp < CIAA_MODBUS_TOTAL_TRANSPORT_TCP) &&
+           (ciaaModbus_tcpObj[hModbusTcp].inUse == true) )
+   {
+      hModbusTcp++;
+   }
+
+   /* if object available and listening socket valid, use it */
+   if ( (hModbusTcp < CIAA_MODBUS_TOTAL_TRANSPORT_TCP) &&
+        (0 == ciaaModbus_tcpSetNonBlock(fildes)) )
+   {
+      /* set object in use */
+      ciaaModbus_tcpObj[hModbusTcp].inUse = true;
+
+      /* set listening socket, accept only if pending, if supported */
+      ciaaModbus_tcpObj[hModbusTcp].fildes = fildes;
+      (void)ciaaModbus_reactorAdd(fildes);
+
+      /* no message received */
+      ciaaModbus_tcpObj[hModbusTcp].current = -1;
+      ciaaModbus_tcpObj[hModbusTcp].tailConn = -1;
+
+      /* no connection accepted */
+      ciaaModbus_tcpObj[hModbusTcp].list[CIAAMODBUS_TCP_LIST_RX] = -1;
+      ciaaModbus_tcpObj[hModbusTcp].list[CIAAMODBUS_TCP_LIST_TX] = -1;
+      ciaaModbus_tcpObj[hModbusTcp].count[CIAAMODBUS_TCP_LIST_RX] = 0;
+      ciaaModbus_tcpObj[hModbusTcp].count[CIAAMODBUS_TCP_LIST_TX] = 0;
+      ciaaModbus_tcpObj[hModbusTcp].connections = 0;
+
+      /* reset statistics */
+      ciaaPOSIX_memset(&ciaaModbus_tcpObj[hModbusTcp].stats, 0,
+            sizeof(ciaaModbus_tcpObj[hModbusTcp].stats));
+   }
+   else
+   {
+      hModbusTcp = -1;
+   }
+
+   return hModbusTcp;
+}
+
+extern void ciaaModbus_tcpTask(int32_t handler)
+{
+   ciaaModbus_tcpObjType *obj = &ciaaModbus_tcpObj[handler];
+   ciaaModbus_tcpConnType *conn;
+   ciaaModbus_tcpBufferType *buffer;
+   int32_t loopi;
+   int32_t index;
+   int32_t next;
+   int32_t connections;
+   int32_t fildes;
+   ssize_t read;
+#if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0
+   uint32_t now = ciaaModbus_tcpGetTime();
+#endif
+
+   /* send responses not flushed yet */
+   ciaaModbus_tcpFlush(obj);
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+   /* close idle connections of all the servers */
+   ciaaModbus_tcpReap();
+#endif
+
+   /* accept new connections */
+   if (ciaaModbus_reactorReady(obj->fildes))
+   {
+      ciaaModbus_tcpAccept(obj);
+   }
+
+   /* connections reported by the reactor join the ones to read */
+   fildes = -1;
+
+   while (0 <= (fildes = ciaaModbus_reactorNext(fildes)))
+   {
+      index = ciaaModbus_tcpConnFd[fildes];
+
+      if ( (0 <= index) && (handler == ciaaModbus_tcpConn[index].server) )
+      {
+         ciaaModbus_tcpListAdd(obj, CIAAMODBUS_TCP_LIST_RX, index);
+      }
+   }
+
+   index = obj->list[CIAAMODBUS_TCP_LIST_RX];
+   connections = obj->count[CIAAMODBUS_TCP_LIST_RX];
+
+   for (loopi = 0 ; loopi < connections ; loopi++)
+   {
+      conn = &ciaaModbus_tcpConn[index];
+      next = conn->link[CIAAMODBUS_TCP_LIST_RX].next;
+
+      /* reload messages allowed in this task */
+      conn->budget = CIAA_MODBUS_TCP_ADU_BUDGET;
+
+      /* if no buffer available, connection is read in next task */
+      buffer = NULL;
+
+      if (ciaaModbus_reactorReady(conn->fildes))
+      {
+         buffer = ciaaModbus_tcpBufferAttach(&conn->buffer);
+      }
+
+      /* a full buffer is kept until its messages are received, recv with
+       * no room would return 0 as if the client closed the connection */
+      if ( (NULL != buffer) &&
+           (CIAAMODBUS_TCP_RXBUFFER_LENGTH > buffer->size) )
+      {
+         /* read all data that fits in buffer, a complete message always
+          * fits behind the one being processed */
+         read = recv(conn->fildes,
+               &buffer->data[buffer->size],
+               CIAAMODBUS_TCP_RXBUFFER_LENGTH - buffer->size,
+               0);
+
+         if (read > 0)
+         {
+            /* increment buffer size */
+            buffer->size += read;
+
+#if CIAA_MODBUS_TCP_IDLE_TIMEOUT > 0
+            /* timer is updated when it fires */
+            conn->lastActivity = ciaaModbus_tcpGetTick();
+#endif
+         }
+         else if ( (0 == read) ||
+                   ( (EAGAIN != errno) &&
+                     (EWOULDBLOCK != errno) &&
+                     (EINTR != errno) ) )
+         {
+            /* connection closed by client or failed */
+            ciaaModbus_tcpCloseConn(obj, index);
+         }
+         else
+         {
+            /* no data: release buffer */
+            ciaaModbus_tcpBufferDetach(&conn->buffer);
+         }
+      }
+
+#if CIAA_MODBUS_TCP_FRAME_TIMEOUT > 0
+      /* close connection holding part of a frame too long */
+      if (conn->inUse)
+      {
+         ciaaModbus_tcpFrameCheck(obj, index, now);
+      }
+#endif
+
+      /* without data it is read again when reported by the reactor */
+      if ( (conn->inUse) &&
+           (conn->registered) &&
+           (0 > conn->buffer) )
+      {
+         ciaaModbus_tcpListRemove(obj, CIAAMODBUS_TCP_LIST_RX, index);
+      }
+
+      index = next;
+   }
+}
+
+extern void ciaaModbus_tcpRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_tcpObjType *obj = &ciaaModbus_tcpObj[handler];
+   ciaaModbus_tcpConnType *conn;
+   ciaaModbus_tcpBufferType *buffer;
+   int32_t loopi;
+   int32_t loopj;
+   int32_t index;
+   int32_t next;
+   int32_t connections;
+   int32_t len = 0;
+
+   *size = 0;
+
+   index = obj->list[CIAAMODBUS_TCP_LIST_RX];
+   connections = obj->count[CIAAMODBUS_TCP_LIST_RX];
+
+   /* visit connections in round robin until a message is found */
+   for (loopi = 0 ; (loopi < connections) && (0 == *size) ; loopi++)
+   {
+      conn = &ciaaModbus_tcpConn[index];
+      next = conn->link[CIAAMODBUS_TCP_LIST_RX].next;
+
+      if ( (0 <= conn->buffer) && (0 < conn->budget) )
+      {
+         buffer = &ciaaModbus_tcpBuffer[conn->buffer];
+
+         len = ciaaModbus_tcp_checkCompleteMsg(buffer->data, buffer->size);
+
+         if (0 > len)
+         {
+            /* invalid MBAP header: stream can not be synchronized */
+            ciaaModbus_tcpCloseConn(obj, index);
+         }
+         else if (0 < len)
+         {
+            /* copy transaction identifier, id and pdu */
+            obj->transactionId = ciaaModbus_readInt(&buffer->data[0]);
+
+            *id = buffer->data[CIAAMODBUS_TCP_MBAP_LENGTH - 1];
+
+            for (loopj = CIAAMODBUS_TCP_MBAP_LENGTH ; loopj < len ; loopj++)
+            {
+               pdu[loopj - CIAAMODBUS_TCP_MBAP_LENGTH] = buffer->data[loopj];
+            }
+
+            *size = len - CIAAMODBUS_TCP_MBAP_LENGTH;
+
+            /* move the rest of data to the beginning of the buffer */
+            for (loopj = len ; loopj < buffer->size ; loopj++)
+            {
+               buffer->data[loopj - len] = buffer->data[loopj];
+            }
+
+            buffer->size -= len;
+
+            /* release buffer if no data pending */
+            ciaaModbus_tcpBufferDetach(&conn->buffer);
+
+            conn->budget--;
+
+            /* response is sent to this connection */
+            obj->current = index;
+
+            /* without data it is read again when reported by the reactor */
+            if ( (conn->registered) && (0 > conn->buffer) )
+            {
+               ciaaModbus_tcpListRemove(obj, CIAAMODBUS_TCP_LIST_RX, index);
+            }
+
+            /* next message is taken from next connection */
+            if (0 < obj->count[CIAAMODBUS_TCP_LIST_RX])
+            {
+               obj->list[CIAAMODBUS_TCP_LIST_RX] = next;
+            }
+         }
+      }
+
+      index = next;
+   }
+
+   /* no more messages in this pass: send gathered responses */
+   if (0 == *size)
+   {
+      ciaaModbus_tcpFlush(obj);
+   }
+}
+
+extern void ciaaModbus_tcpSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_tcpObjType *obj = &ciaaModbus_tcpObj[handler];
+   ciaaModbus_tcpConnType *conn;
+   ciaaModbus_tcpBufferType *buffer = NULL;
+   int32_t index;
+   int32_t len = size + CIAAMODBUS_TCP_MBAP_LENGTH;
+#if (CIAA_MODBUS_TCP_CORK > 0) && defined(TCP_CORK)
+   int32_t cork = 1;
+#endif
+   ssize_t write;
+
+   /* if response does not fit, send responses gathered before */
+   if ( (0 <= obj->current) &&
+        (0 <= ciaaModbus_tcpConn[obj->current].txBuffer) &&
+        ( (CIAAMODBUS_TCP_RXBUFFER_LENGTH -
+           ciaaModbus_tcpBuffer[ciaaModbus_tcpConn[obj->current].txBuffer].size) < len) )
+   {
+      ciaaModbus_tcpFlushConn(obj, obj->current);
+   }
+
+   /* check connection still open and correct len */
+   if ( (0 <= obj->current) &&
+        (CIAAMODBUS_TCP_MAXLENGTH >= len) )
+   {
+      index = obj->current;
+      conn = &ciaaModbus_tcpConn[index];
+
+      buffer = ciaaModbus_tcpBufferAttach(&conn->txBuffer);
+
+      if ( (NULL != buffer) &&
+           ((CIAAMODBUS_TCP_RXBUFFER_LENGTH - buffer->size) >= len) )
+      {
+         /* gather response, it is sent when the pass ends */
+         buffer->size += ciaaModbus_tcpWriteFrame(
+               &buffer->data[buffer->size],
+               obj->transactionId,
+               id,
+               pdu,
+               size);
+      }
+      else if ( (NULL == buffer) && (0 > obj->tailConn) )
+      {
+         /* no buffer available and nothing queued: send it now */
+         ciaaModbus_tcpWriteFrame(obj->buffer, obj->transactionId, id, pdu, size);
+
+#if (CIAA_MODBUS_TCP_CORK > 0) && defined(TCP_CORK)
+         /* hold segments until the pass ends */
+         if (false == conn->corked)
+         {
+            conn->corked = true;
+            setsockopt(conn->fildes, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+         }
+#endif
+
+         write = send(conn->fildes, obj->buffer, len, MSG_NOSIGNAL);
+
+         if ( (0 > write) &&
+              (EAGAIN != errno) &&
+              (EWOULDBLOCK != errno) )
+         {
+            ciaaModbus_tcpCloseConn(obj, obj->current);
+         }
+         else if (len > write)
+         {
+            /* keep the rest, it is sent before any other response */
+            obj->tailConn = obj->current;
+            obj->tailOffset = (0 < write) ? write : 0;
+            obj->tailSize = len;
+         }
+      }
+      else
+      {
+         /* responses not sent yet, this one can not be sent in order:
+          * only reached if ciaaModbus_tcpTxReady is not checked */
+         ciaaModbus_tcpCloseConn(obj, obj->current);
+      }
+
+      /* flushed when the pass ends */
+      if (conn->inUse)
+      {
+         ciaaModbus_tcpListAdd(obj, CIAAMODBUS_TCP_LIST_TX, index);
+      }
+   }
+}
+
+extern bool ciaaModbus_tcpTxReady(int32_t handler)
+{
+   ciaaModbus_tcpObjType *obj = &ciaaModbus_tcpObj[handler];
+   int32_t loopi;
+   int32_t index;
+   int32_t txBuffer;
+   bool ret;
+
+   /* a response without connection buffer needs the buffer of the server */
+   ret = (0 > obj->tailConn);
+
+   /* a response with connection buffer needs room behind the queued ones,
+    * only the connections with responses pending hold a buffer */
+   index = obj->list[CIAAMODBUS_TCP_LIST_TX];
+
+   for (loopi = 0 ; loopi < obj->count[CIAAMODBUS_TCP_LIST_TX] ; loopi++)
+   {
+      txBuffer = ciaaModbus_tcpConn[index].txBuffer;
+
+      if ( (0 <= txBuffer) &&
+           ( (CIAAMODBUS_TCP_RXBUFFER_LENGTH -
+              ciaaModbus_tcpBuffer[txBuffer].size) < CIAAMODBUS_TCP_MAXLENGTH) )
+      {
+         ret = false;
+      }
+
+      index = ciaaModbus_tcpConn[index].link[CIAAMODBUS_TCP_LIST_TX].next;
+   }
+
+   return ret;
+}
+
+extern bool ciaaModbus_tcpPending(int32_t handler)
+{
+   ciaaModbus_tcpObjType *obj = &ciaaModbus_tcpObj[handler];
+   int32_t index;
+   int32_t fildes = -1;
+   bool ret;
+
+   /* responses to flush, data received, connections to read on each task
+    * or to accept */
+   ret = ( (0 < obj->count[CIAAMODBUS_TCP_LIST_TX]) ||
+           (0 < obj->count[CIAAMODBUS_TCP_LIST_RX]) ||
+           (ciaaModbus_reactorReady(obj->fildes)) );
+
+   /* connections reported by the reactor */
+   while ( (false == ret) &&
+           (0 <= (fildes = ciaaModbus_reactorNext(fildes))) )
+   {
+      index = ciaaModbus_tcpConnFd[fildes];
+
+      ret = ( (0 <= index) && (handler == ciaaModbus_tcpConn[index].server) );
+   }
+
+   return ret;
+}
+
+extern void ciaaModbus_tcpGetStats(
+      int32_t handler,
+      ciaaModbus_tcpStatsType *stats)
+{
+   *stats = ciaaModbus_tcpObj[handler].stats;
+
+   stats->active = ciaaModbus_tcpObj[handler].connections;
+}
+
+extern int32_t ciaaModbus_tcpMasterOpen(uint32_t address, uint16_t port)
+{
+   int32_t hModbusTcp;
+
+   /* initialize handler with valid value */
+   hModbusTcp = 0;
+
+   /* search a modbus tcp master Object not in use */
+   while ( (hModbusTcp < CIAA_MODBUS_TOTAL_TRANSPORT_TCP) &&
+           (ciaaModbus_tcpMasterObj[hModbusTcp].inUse == true) )
+   {
+      hModbusTcp++;
+   }
+
+   /* if object available, use it */
+   if (hModbusTcp < CIAA_MODBUS_TOTAL_TRANSPORT_TCP)
+   {
+      /* set object in use */
+      ciaaModbus_tcpMasterObj[hModbusTcp].inUse = true;
+
+      /* set destination, connected when first request is sent */
+      ciaaModbus_tcpMasterObj[hModbusTcp].address = address;
+      ciaaModbus_tcpMasterObj[hModbusTcp].port = port;
+      ciaaModbus_tcpMasterObj[hModbusTcp].fildes = -1;
+      ciaaModbus_tcpMasterObj[hModbusTcp].state = CIAA_MODBUS_TCP_MASTER_STATE_DISCONNECTED;
+      ciaaModbus_tcpMasterObj[hModbusTcp].backoff = CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN;
+      ciaaModbus_tcpMasterObj[hModbusTcp].retryTime = ciaaModbus_tcpGetTime();
+
+      /* no request pending */
+      ciaaModbus_tcpMasterObj[hModbusTcp].transactionId = 0;
+      ciaaModbus_tcpMasterObj[hModbusTcp].exception = 0;
+      ciaaModbus_tcpMasterObj[hModbusTcp].waiting = false;
+      ciaaModbus_tcpMasterObj[hModbusTcp].txSize = 0;
+      ciaaModbus_tcpMasterObj[hModbusTcp].txOffset = 0;
+      ciaaModbus_tcpMasterObj[hModbusTcp].bufferSize = 0;
+   }
+   else
+   {
+      hModbusTcp = -1;
+   }
+
+   return hModbusTcp;
+}
+
+extern void ciaaModbus_tcpMasterTask(int32_t handler)
+{
+   ciaaModbus_tcpMasterObjType *obj;
+   uint32_t now = ciaaModbus_tcpGetTime();
+   int32_t loopi;
+   ssize_t read;
+
+   /* evict idle connections of all destinations */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_TCP ; loopi++)
+   {
+      obj = &ciaaModbus_tcpMasterObj[loopi];
+
+      if ( (obj->inUse) &&
+           (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED == obj->state) &&
+           (false == obj->waiting) &&
+           (ciaaModbus_tcpTimeReached(now,
+               obj->lastActivity + CIAA_MODBUS_TCP_MASTER_IDLE_TIMEOUT)) )
+      {
+         ciaaModbus_tcpMasterClose(obj);
+      }
+   }
+
+   obj = &ciaaModbus_tcpMasterObj[handler];
+
+   /* reconnect if a request is pending and the backoff elapsed */
+   if ( (CIAA_MODBUS_TCP_MASTER_STATE_DISCONNECTED == obj->state) &&
+        (0 < obj->txSize) &&
+        (ciaaModbus_tcpTimeReached(now, obj->retryTime)) )
+   {
+      ciaaModbus_tcpMasterConnect(obj, now);
+   }
+
+   /* check if connection is completed */
+   if (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTING == obj->state)
+   {
+      ciaaModbus_tcpMasterCheckConnect(obj, now);
+   }
+
+   if (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED == obj->state)
+   {
+      /* send request pending since connection started */
+      if (0 < obj->txSize)
+      {
+         ciaaModbus_tcpMasterFlush(obj, now);
+      }
+   }
+
+   /* a full buffer is kept until its response is received, recv with no
+    * room would return 0 as if the slave closed the connection */
+   if ( (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED == obj->state) &&
+        (CIAAMODBUS_TCP_RXBUFFER_LENGTH > obj->bufferSize) )
+   {
+      read = recv(obj->fildes,
+            &obj->buffer[obj->bufferSize],
+            CIAAMODBUS_TCP_RXBUFFER_LENGTH - obj->bufferSize,
+            0);
+
+      if (read > 0)
+      {
+         /* increment buffer size */
+         obj->bufferSize += read;
+         obj->lastActivity = now;
+      }
+      else if ( (0 == read) ||
+                ( (EAGAIN != errno) &&
+                  (EWOULDBLOCK != errno) &&
+                  (EINTR != errno) ) )
+      {
+         /* connection closed by destination or failed, it is
+          * reconnected with the next request */
+         ciaaModbus_tcpMasterClose(obj);
+      }
+   }
+}
+
+extern void ciaaModbus_tcpMasterRecvMsg(
+      int32_t handler,
+      uint8_t *id,
+      uint8_t *pdu,
+      uint32_t *size)
+{
+   ciaaModbus_tcpMasterObjType *obj = &ciaaModbus_tcpMasterObj[handler];
+   int32_t loopj;
+   int32_t len = 1;
+
+   *size = 0;
+
+   /* search response in received messages */
+   while ( (0 < len) && (0 == *size) && (0 == obj->exception) )
+   {
+      len = ciaaModbus_tcp_checkCompleteMsg(obj->buffer, obj->bufferSize);
+
+      if (0 > len)
+      {
+         /* invalid MBAP header: stream can not be synchronized */
+         ciaaModbus_tcpMasterClose(obj);
+      }
+      else if (0 < len)
+      {
+         /* response of pending request, responses of previous
+          * requests are discarded */
+         if ( (obj->waiting) &&
+              (obj->transactionId == ciaaModbus_readInt(&obj->buffer[0])) )
+         {
+            *id = obj->buffer[CIAAMODBUS_TCP_MBAP_LENGTH - 1];
+
+            for (loopj = CIAAMODBUS_TCP_MBAP_LENGTH ; loopj < len ; loopj++)
+            {
+               pdu[loopj - CIAAMODBUS_TCP_MBAP_LENGTH] = obj->buffer[loopj];
+            }
+
+            *size = len - CIAAMODBUS_TCP_MBAP_LENGTH;
+
+            obj->waiting = false;
+         }
+
+         /* move the rest of data to the beginning of the buffer */
+         for (loopj = len ; loopj < obj->bufferSize ; loopj++)
+         {
+            obj->buffer[loopj - len] = obj->buffer[loopj];
+         }
+
+         obj->bufferSize -= len;
+      }
+   }
+
+   /* request failed: respond with gateway exception */
+   if (0 != obj->exception)
+   {
+      *id = obj->id;
+      pdu[0] = obj->function | 0x80;
+      pdu[1] = obj->exception;
+      *size = CIAAMODBUS_EXCEP_RSP_PDU_MINLENGTH;
+
+      obj->exception = 0;
+      obj->waiting = false;
+   }
+}
+
+extern void ciaaModbus_tcpMasterSendMsg(
+      int32_t handler,
+      uint8_t id,
+      uint8_t *pdu,
+      uint32_t size)
+{
+   ciaaModbus_tcpMasterObjType *obj = &ciaaModbus_tcpMasterObj[handler];
+   uint32_t now = ciaaModbus_tcpGetTime();
+   uint8_t data;
+
+   /* connection closed by destination while idle: reconnect */
+   if ( (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED == obj->state) &&
+        (0 == recv(obj->fildes, &data, 1, MSG_PEEK)) )
+   {
+      ciaaModbus_tcpMasterClose(obj);
+   }
+
+   /* the rest of a request partially sent can not be replaced */
+   if ( (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED == obj->state) &&
+        (0 < obj->txOffset) )
+   {
+      ciaaModbus_tcpMasterClose(obj);
+   }
+
+   /* check correct len */
+   if (CIAAMODBUS_TCP_MAXLENGTH >= (size + CIAAMODBUS_TCP_MBAP_LENGTH))
+   {
+      obj->transactionId++;
+      obj->id = id;
+      obj->function = pdu[0];
+      obj->exception = 0;
+      obj->waiting = true;
+
+      obj->txOffset = 0;
+      obj->txSize = ciaaModbus_tcpWriteFrame(
+            obj->txBuffer,
+            obj->transactionId,
+            id,
+            pdu,
+            size);
+
+      switch (obj->state)
+      {
+         case CIAA_MODBUS_TCP_MASTER_STATE_DISCONNECTED:
+            if (ciaaModbus_tcpTimeReached(now, obj->retryTime))
+            {
+               /* connect, request is sent when connected */
+               ciaaModbus_tcpMasterConnect(obj, now);
+            }
+            else
+            {
+               /* destination reconnecting: fail fast */
+               obj->exception = CIAA_MODBUS_E_GW_PATH_UNAVAILABLE;
+               obj->txSize = 0;
+            }
+            break;
+
+         case CIAA_MODBUS_TCP_MASTER_STATE_CONNECTING:
+            /* request is sent when connected */
+            break;
+
+         case CIAA_MODBUS_TCP_MASTER_STATE_CONNECTED:
+            ciaaModbus_tcpMasterFlush(obj, now);
+            break;
+      }
+   }
+}
+
+extern bool ciaaModbus_tcpMasterPending(int32_t handler)
+{
+   ciaaModbus_tcpMasterObjType *obj = &ciaaModbus_tcpMasterObj[handler];
+
+   /* only a request in course has work, idle connections are closed
+    * with the next one */
+   return ( (obj->waiting) ||
+            (0 < obj->txSize) ||
+            (0 != obj->exception) ||
+            (CIAA_MODBUS_TCP_MASTER_STATE_CONNECTING == obj->state) );
+}
+
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0 */
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
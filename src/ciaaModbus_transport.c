@@ -45,15 +45,50 @@
 #include "ciaaModbus_Cfg.h"
 #include "ciaaModbus_transport.h"
 #include "ciaaModbus_ascii.h"
+#include "ciaaModbus_rtu.h"
+#include "ciaaModbus_tcp.h"
+#include "ciaaModbus_loopback.h"
+#include "ciaaModbus_shm.h"
+#include "ciaaModbus_auto.h"
+#include "ciaaModbus_serial.h"
+#include "ciaaModbus_reactor.h"
 #include "ciaaPOSIX_stdio.h"
 #include "ciaaPOSIX_stdbool.h"
 #include "os.h"
 
 /*==================[macros and definitions]=================================*/
 
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_USER
+/** \brief Default transports of modes registered by application */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_USER  0
+#endif
+
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK
+/** \brief Default loopback channels */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK  0
+#endif
+
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_SHM
+/** \brief Default shared memory transports */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_SHM   0
+#endif
+
+#ifndef CIAA_MODBUS_TOTAL_TRANSPORT_AUTO
+/** \brief Default serial ports with auto detection */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_AUTO  0
+#endif
+
 #define CIAA_MODBUS_TOTAL_TRANSPORTS   (  CIAA_MODBUS_TOTAL_TRANSPORT_ASCII + \
                                           CIAA_MODBUS_TOTAL_TRANSPORT_RTU   + \
-                                          CIAA_MODBUS_TOTAL_TRANSPORT_TCP )
+                                          CIAA_MODBUS_TOTAL_TRANSPORT_TCP   + \
+                                          CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK * 2 + \
+                                          CIAA_MODBUS_TOTAL_TRANSPORT_SHM   + \
+                                          CIAA_MODBUS_TOTAL_TRANSPORT_AUTO  + \
+                                          CIAA_MODBUS_TOTAL_TRANSPORT_USER )
+
+/** \brief Total transport modes (built in and registered) */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_MODES (CIAAMODBUS_TRANSPORT_MODE_USER + \
+                                           CIAA_MODBUS_TOTAL_TRANSPORT_USER)
 
 /** \brief Default response timeout (milliseconds) */
 #define CIAA_MODBUS_TRASNPORT_DEFAULT_TIMEOUT   300
@@ -63,7 +98,7 @@ typedef struct
 {
    int32_t hModbusLowLayer;            /** <- Handler of low layer transport */
    uint32_t respTimeout;               /** <- response timeout */
-   ciaaModbus_transportModeEnum mode;  /** <- Transport Mode */
+   const ciaaModbus_transportOpsType *ops;   /** <- Operations of low layer */
    bool inUse;                         /** <- Object in use */
 }ciaaModbus_transportObjType;
 
@@ -75,9 +110,297 @@ static ciaaModbus_transportObjType ciaaModbus_transportObj[CIAA_MODBUS_TOTAL_TRA
 /*==================[internal functions declaration]=========================*/
 
 /*==================[internal data definition]===============================*/
+/** \brief Operations of Modbus ASCII master */
+static const ciaaModbus_transportOpsType ciaaModbus_transportAsciiMasterOps =
+{
+   ciaaModbus_asciiOpen,
+   ciaaModbus_asciiTask,
+   ciaaModbus_asciiRecvMsg,
+   ciaaModbus_asciiSendMsg,
+   ciaaModbus_asciiTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_MASTER,
+   ciaaModbus_asciiPending,
+};
+
+/** \brief Operations of Modbus ASCII slave */
+static const ciaaModbus_transportOpsType ciaaModbus_transportAsciiSlaveOps =
+{
+   ciaaModbus_asciiOpen,
+   ciaaModbus_asciiTask,
+   ciaaModbus_asciiRecvMsg,
+   ciaaModbus_asciiSendMsg,
+   ciaaModbus_asciiTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_asciiPending,
+};
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+/** \brief Operations of Modbus RTU master */
+static const ciaaModbus_transportOpsType ciaaModbus_transportRtuMasterOps =
+{
+   ciaaModbus_rtuOpen,
+   ciaaModbus_rtuTask,
+   ciaaModbus_rtuRecvMsg,
+   ciaaModbus_rtuSendMsg,
+   ciaaModbus_rtuTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_MASTER,
+   ciaaModbus_rtuPending,
+};
+
+/** \brief Operations of Modbus RTU slave */
+static const ciaaModbus_transportOpsType ciaaModbus_transportRtuSlaveOps =
+{
+   ciaaModbus_rtuOpen,
+   ciaaModbus_rtuTask,
+   ciaaModbus_rtuRecvMsg,
+   ciaaModbus_rtuSendMsg,
+   ciaaModbus_rtuTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_rtuPending,
+};
+#endif
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0
+/** \brief Operations of Modbus TCP master, opened with
+ ** ciaaModbus_transportOpenTcpMaster() */
+static const ciaaModbus_transportOpsType ciaaModbus_transportTcpMasterOps =
+{
+   NULL,
+   ciaaModbus_tcpMasterTask,
+   ciaaModbus_tcpMasterRecvMsg,
+   ciaaModbus_tcpMasterSendMsg,
+   NULL,
+   CIAAMODBUS_TRANSPORT_TYPE_MASTER,
+   ciaaModbus_tcpMasterPending,
+};
+
+/** \brief Operations of Modbus TCP slave */
+static const ciaaModbus_transportOpsType ciaaModbus_transportTcpSlaveOps =
+{
+   ciaaModbus_tcpOpen,
+   ciaaModbus_tcpTask,
+   ciaaModbus_tcpRecvMsg,
+   ciaaModbus_tcpSendMsg,
+   ciaaModbus_tcpTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_tcpPending,
+};
+#endif
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > 0
+/** \brief Operations of master end of Modbus Loopback */
+static const ciaaModbus_transportOpsType ciaaModbus_transportLoopbackMasterOps =
+{
+   ciaaModbus_loopbackMasterOpen,
+   ciaaModbus_loopbackTask,
+   ciaaModbus_loopbackMasterRecvMsg,
+   ciaaModbus_loopbackMasterSendMsg,
+   ciaaModbus_loopbackMasterTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_MASTER,
+   ciaaModbus_loopbackMasterPending,
+};
+
+/** \brief Operations of slave end of Modbus Loopback */
+static const ciaaModbus_transportOpsType ciaaModbus_transportLoopbackSlaveOps =
+{
+   ciaaModbus_loopbackSlaveOpen,
+   ciaaModbus_loopbackTask,
+   ciaaModbus_loopbackSlaveRecvMsg,
+   ciaaModbus_loopbackSlaveSendMsg,
+   ciaaModbus_loopbackSlaveTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_loopbackSlavePending,
+};
+#endif
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_SHM > 0
+/** \brief Operations of Modbus Shared Memory master */
+static const ciaaModbus_transportOpsType ciaaModbus_transportShmMasterOps =
+{
+   ciaaModbus_shmOpen,
+   ciaaModbus_shmTask,
+   ciaaModbus_shmRecvMsg,
+   ciaaModbus_shmSendMsg,
+   ciaaModbus_shmTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_MASTER,
+   ciaaModbus_shmPending,
+};
+
+/** \brief Operations of Modbus Shared Memory slave */
+static const ciaaModbus_transportOpsType ciaaModbus_transportShmSlaveOps =
+{
+   ciaaModbus_shmOpen,
+   ciaaModbus_shmTask,
+   ciaaModbus_shmRecvMsg,
+   ciaaModbus_shmSendMsg,
+   ciaaModbus_shmTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_shmPending,
+};
+#endif
+
+#if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0
+/** \brief Operations of Modbus slave detecting ASCII or RTU */
+static const ciaaModbus_transportOpsType ciaaModbus_transportAutoSlaveOps =
+{
+   ciaaModbus_autoOpen,
+   ciaaModbus_autoTask,
+   ciaaModbus_autoRecvMsg,
+   ciaaModbus_autoSendMsg,
+   ciaaModbus_autoTxReady,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   ciaaModbus_autoPending,
+};
+#endif
+
+/** \brief Operations of each mode, NULL if not available */
+static const ciaaModbus_transportOpsType *ciaaModbus_transportOps[CIAA_MODBUS_TOTAL_TRANSPORT_MODES] =
+{
+   &ciaaModbus_transportAsciiMasterOps,   /* CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER */
+   &ciaaModbus_transportAsciiSlaveOps,    /* CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE */
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+   &ciaaModbus_transportRtuMasterOps,     /* CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER */
+   &ciaaModbus_transportRtuSlaveOps,      /* CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE */
+#else
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER */
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE */
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0
+   &ciaaModbus_transportTcpMasterOps,     /* CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER */
+   &ciaaModbus_transportTcpSlaveOps,      /* CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE */
+#else
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER */
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE */
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK > 0
+   &ciaaModbus_transportLoopbackMasterOps,   /* CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER */
+   &ciaaModbus_transportLoopbackSlaveOps,    /* CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE */
+#else
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER */
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE */
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_SHM > 0
+   &ciaaModbus_transportShmMasterOps,     /* CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER */
+   &ciaaModbus_transportShmSlaveOps,      /* CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE */
+#else
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER */
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE */
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0
+   &ciaaModbus_transportAutoSlaveOps,     /* CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE */
+#else
+   NULL,                                  /* CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE */
+#endif
+};
 
 /*==================[external data definition]===============================*/
 
+/*==================[internal functions definition]==========================*/
+
+/** \brief Bind a Transport Object to its low layer
+ **
+ ** Search a Transport Object not in use and bind it to the low layer
+ ** transport. Shall be called in critical section.
+ **
+ ** \param[in] hModbusLowLayer handler of low layer transport, -1 if
+ **            invalid
+ ** \param[in] ops operations of low layer transport
+ ** \return handler of Modbus Transport, -1 if error
+ **/
+static int32_t ciaaModbus_transportBind(
+      int32_t hModbusLowLayer,
+      const ciaaModbus_transportOpsType *ops)
+{
+   int32_t hModbusTransport = 0;
+
+   /* search a Transport Object not in use */
+   while ( (hModbusTransport < CIAA_MODBUS_TOTAL_TRANSPORTS) &&
+           (ciaaModbus_transportObj[hModbusTransport].inUse == true) )
+   {
+      hModbusTransport++;
+   }
+
+   /* check if object available and a valid low layer transport */
+   if ( (hModbusTransport < CIAA_MODBUS_TOTAL_TRANSPORTS) &&
+        (hModbusLowLayer >= 0) )
+   {
+      /* set low layer transpor */
+      ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer = hModbusLowLayer;
+
+      /* set object in use */
+      ciaaModbus_transportObj[hModbusTransport].inUse = true;
+
+      /* set low layer operations */
+      ciaaModbus_transportObj[hModbusTransport].ops = ops;
+
+      /* Set default response timeout */
+      ciaaModbus_transportObj[hModbusTransport].respTimeout = CIAA_MODBUS_TRASNPORT_DEFAULT_TIMEOUT;
+   }
+   else
+   {
+      /* if no object available or invalid low layer transport,
+       * return invalid handler */
+      hModbusTransport = -1;
+   }
+
+   return hModbusTransport;
+}
+
+/** \brief Check if a Transport Object is available
+ **
+ ** \return true if a Transport Object is not in use
+ **/
+static bool ciaaModbus_transportAvailable(void)
+{
+   int32_t loopi;
+   bool ret = false;
+
+   for (loopi = 0 ; (loopi < CIAA_MODBUS_TOTAL_TRANSPORTS) && (false == ret) ; loopi++)
+   {
+      ret = (false == ciaaModbus_transportObj[loopi].inUse);
+   }
+
+   return ret;
+}
+
+/** \brief Pass the file descriptor of the port in the host to a serial
+ ** transport
+ **
+ ** \param[in] hModbusTransport handler of Modbus Transport
+ ** \param[in] mode mode of the transport
+ ** \param[in] hostFd file descriptor registered with the reactor
+ **/
+static void ciaaModbus_transportSetHostFd(
+      int32_t hModbusTransport,
+      ciaaModbus_transportModeEnum mode,
+      int32_t hostFd)
+{
+   int32_t hModbusLowLayer = ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer;
+
+   if ( (CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER == mode) ||
+        (CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE == mode) )
+   {
+      ciaaModbus_asciiSetHostFd(hModbusLowLayer, hostFd);
+   }
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+   else if ( (CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER == mode) ||
+             (CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE == mode) )
+   {
+      ciaaModbus_rtuSetHostFd(hModbusLowLayer, hostFd);
+   }
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0
+   else if (CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE == mode)
+   {
+      ciaaModbus_autoSetHostFd(hModbusLowLayer, hostFd);
+   }
+#endif
+   else
+   {
+      /* not a serial transport */
+   }
+}
+
 /*==================[external functions definition]==========================*/
 
 extern void ciaaModbus_transportInit(void)
@@ -93,89 +416,47 @@ extern void ciaaModbus_transportInit(void)
       /* invalid handler low layer transport */
       ciaaModbus_transportObj[loopi].hModbusLowLayer = -1;
 
-      /* default mode: MODBUS ASCII SLAVE */
-      ciaaModbus_transportObj[loopi].mode = CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE;
+      /* no low layer operations */
+      ciaaModbus_transportObj[loopi].ops = NULL;
+   }
+
+   /* no mode registered */
+   for (loopi = CIAAMODBUS_TRANSPORT_MODE_USER ;
+        loopi < CIAA_MODBUS_TOTAL_TRANSPORT_MODES ;
+        loopi++)
+   {
+      ciaaModbus_transportOps[loopi] = NULL;
    }
 }
 
-extern int32_t ciaaModbus_transportOpen(
-      int32_t fildes,
-      ciaaModbus_transportModeEnum mode)
+extern int32_t ciaaModbus_transportRegister(
+      const ciaaModbus_transportOpsType *ops)
 {
-   int32_t hModbusTransport;
-   int32_t hModbusLowLayer;
+   int32_t mode = CIAAMODBUS_TRANSPORT_MODE_USER;
 
-   /* check parameter mode */
-   if ( (mode == CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER) ||
-        (mode == CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE)  ||
-        (mode == CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER)   ||
-        (mode == CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE)    ||
-        (mode == CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER)   ||
-        (mode == CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE) )
+   /* transports without open can not be opened */
+   if ( (NULL != ops) && (NULL != ops->open) && (NULL != ops->task) &&
+        (NULL != ops->recvMsg) && (NULL != ops->sendMsg) &&
+        ( (CIAAMODBUS_TRANSPORT_TYPE_MASTER == ops->type) ||
+          (CIAAMODBUS_TRANSPORT_TYPE_SLAVE == ops->type) ) )
    {
-      /* if valid mode, initialize handler with valid value */
-      hModbusTransport = 0;
-
       /* enter critical section */
       GetResource(MODBUSR);
 
-      /* search a Transport Object not in use */
-      while ( (hModbusTransport < CIAA_MODBUS_TOTAL_TRANSPORTS) &&
-              (ciaaModbus_transportObj[hModbusTransport].inUse == true) )
+      /* search a mode not registered */
+      while ( (mode < CIAA_MODBUS_TOTAL_TRANSPORT_MODES) &&
+              (NULL != ciaaModbus_transportOps[mode]) )
       {
-         hModbusTransport++;
+         mode++;
       }
 
-      /* if object available, use it */
-      if (hModbusTransport < CIAA_MODBUS_TOTAL_TRANSPORTS)
+      if (mode < CIAA_MODBUS_TOTAL_TRANSPORT_MODES)
       {
-         switch (mode)
-         {
-            case CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER:
-            case CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE:
-               /* open modbus ascii transport */
-               hModbusLowLayer = ciaaModbus_asciiOpen(fildes);
-               break;
-
-            case CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER:
-            case CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE:
-               /* ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer =
-               ciaaModbus_rtuOpen() */
-               hModbusLowLayer = -1;
-               break;
-
-            case CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER:
-            case CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE:
-               /* ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer =
-               ciaaModbus_tcpOpen() */
-               hModbusLowLayer = -1;
-               break;
-         }
-         /* check if a valid low layer transport */
-         if (hModbusLowLayer >= 0)
-         {
-            /* set low layer transpor */
-            ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer = hModbusLowLayer;
-
-            /* set object in use */
-            ciaaModbus_transportObj[hModbusTransport].inUse = true;
-
-            /* set low layer mode */
-            ciaaModbus_transportObj[hModbusTransport].mode = mode;
-
-            /* Set default response timeout */
-            ciaaModbus_transportObj[hModbusTransport].respTimeout = CIAA_MODBUS_TRASNPORT_DEFAULT_TIMEOUT;
-         }
-         else
-         {
-            /* if invalid low layer transport, return invalid handler */
-            hModbusTransport = -1;
-         }
+         ciaaModbus_transportOps[mode] = ops;
       }
       else
       {
-         /* if no object available, return invalid handler */
-         hModbusTransport = -1;
+         mode = -1;
       }
 
       /* exit critical section */
@@ -183,33 +464,129 @@ extern int32_t ciaaModbus_transportOpen(
    }
    else
    {
-      /* if invalid mode, initialize handler with invalid value*/
-      hModbusTransport = -1;
+      mode = -1;
+   }
+
+   return mode;
+}
+
+extern int32_t ciaaModbus_transportOpen(
+      int32_t fildes,
+      ciaaModbus_transportModeEnum mode)
+{
+   int32_t hModbusTransport = -1;
+   int32_t hModbusLowLayer;
+   const ciaaModbus_transportOpsType *ops = NULL;
+
+   /* enter critical section */
+   GetResource(MODBUSR);
+
+   /* check parameter mode */
+   if ( (0 <= (int32_t)mode) &&
+        (CIAA_MODBUS_TOTAL_TRANSPORT_MODES > (int32_t)mode) )
+   {
+      ops = ciaaModbus_transportOps[mode];
    }
 
+   /* if valid mode and object available, open low layer transport */
+   if ( (NULL != ops) &&
+        (NULL != ops->open) &&
+        (ciaaModbus_transportAvailable()) )
+   {
+      hModbusLowLayer = ops->open(fildes);
+
+      hModbusTransport = ciaaModbus_transportBind(hModbusLowLayer, ops);
+   }
+
+   /* exit critical section */
+   ReleaseResource(MODBUSR);
+
    return hModbusTransport;
 }
 
+#if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0
+extern int32_t ciaaModbus_transportOpenTcpMaster(
+      uint32_t address,
+      uint16_t port)
+{
+   int32_t hModbusTransport = -1;
+   int32_t hModbusLowLayer;
 
-extern void ciaaModbus_transportTask(int32_t handler)
+   /* enter critical section */
+   GetResource(MODBUSR);
+
+   /* if object available, open modbus tcp master */
+   if (ciaaModbus_transportAvailable())
+   {
+      hModbusLowLayer = ciaaModbus_tcpMasterOpen(address, port);
+
+      hModbusTransport = ciaaModbus_transportBind(
+            hModbusLowLayer,
+            &ciaaModbus_transportTcpMasterOps);
+   }
+
+   /* exit critical section */
+   ReleaseResource(MODBUSR);
+
+   return hModbusTransport;
+}
+#endif /* #if CIAA_MODBUS_TOTAL_TRANSPORT_TCP > 0 */
+
+extern int32_t ciaaModbus_transportOpenSerial(
+      int32_t fildes,
+      ciaaModbus_transportModeEnum mode,
+      ciaaModbus_serialConfigType const *config)
 {
-   switch (ciaaModbus_transportObj[handler].mode)
+   int32_t hModbusTransport = -1;
+
+   /* only serial modes, the configuration is applied before opening */
+   if ( ( (CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER == mode) ||
+          (CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE == mode) ||
+          (CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER == mode) ||
+          (CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE == mode) ||
+          (CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE == mode) ) &&
+        (0 == ciaaModbus_serialConfig(fildes, config)) )
    {
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE:
-         ciaaModbus_asciiTask(ciaaModbus_transportObj[handler].hModbusLowLayer);
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE:
-         /* ciaaModbus_rtuTask(); */
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE:
-         /* ciaaModbus_tcpTask() */
-         break;
+      hModbusTransport = ciaaModbus_transportOpen(fildes, mode);
+   }
+
+   if (0 <= hModbusTransport)
+   {
+      /* read the port only if data pending, if supported. fildes is a
+       * ciaaPOSIX file descriptor, only the one of the host is registered */
+      if ( (0 <= config->hostFd) &&
+           (0 == ciaaModbus_reactorAdd(config->hostFd)) )
+      {
+         ciaaModbus_transportSetHostFd(hModbusTransport, mode, config->hostFd);
+      }
+
+      /* pass the baud rate to the timing of rtu frames */
+#if CIAA_MODBUS_TOTAL_TRANSPORT_RTU > 0
+      if ( (CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER == mode) ||
+           (CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE == mode) )
+      {
+         ciaaModbus_rtuSetBaudRate(
+               ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer,
+               config->baudRate);
+      }
+#endif
+#if CIAA_MODBUS_TOTAL_TRANSPORT_AUTO > 0
+      if (CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE == mode)
+      {
+         ciaaModbus_autoSetBaudRate(
+               ciaaModbus_transportObj[hModbusTransport].hModbusLowLayer,
+               config->baudRate);
+      }
+#endif
    }
+
+   return hModbusTransport;
+}
+
+extern void ciaaModbus_transportTask(int32_t handler)
+{
+   ciaaModbus_transportObj[handler].ops->task(
+         ciaaModbus_transportObj[handler].hModbusLowLayer);
 }
 
 extern void ciaaModbus_transportRecvMsg(
@@ -218,27 +595,11 @@ extern void ciaaModbus_transportRecvMsg(
       uint8_t *pdu,
       uint32_t *size)
 {
-   switch (ciaaModbus_transportObj[handler].mode)
-   {
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE:
-         ciaaModbus_asciiRecvMsg(
-               ciaaModbus_transportObj[handler].hModbusLowLayer,
-               id,
-               pdu,
-               size);
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE:
-         /* ciaaModbus_rtuRecvMsg(); */
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE:
-         /* ciaaModbus_tcpRecvMsg() */
-         break;
-   }
+   ciaaModbus_transportObj[handler].ops->recvMsg(
+         ciaaModbus_transportObj[handler].hModbusLowLayer,
+         id,
+         pdu,
+         size);
 }
 
 void ciaaModbus_transportSendMsg(
@@ -247,27 +608,25 @@ void ciaaModbus_transportSendMsg(
       uint8_t *pdu,
       uint32_t size)
 {
-   switch (ciaaModbus_transportObj[handler].mode)
+   ciaaModbus_transportObj[handler].ops->sendMsg(
+         ciaaModbus_transportObj[handler].hModbusLowLayer,
+         id,
+         pdu,
+         size);
+}
+
+extern bool ciaaModbus_transportPending(int32_t handler)
+{
+   bool ret = true;
+
+   /* if not provided, the low layer transport has always work */
+   if (NULL != ciaaModbus_transportObj[handler].ops->pending)
    {
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE:
-         ciaaModbus_asciiSendMsg(
-               ciaaModbus_transportObj[handler].hModbusLowLayer,
-               id,
-               pdu,
-               size);
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE:
-         /* ciaaModbus_rtuSendMsg(); */
-         break;
-
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER:
-      case CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE:
-         /* ciaaModbus_tcpSendMsg() */
-         break;
+      ret = ciaaModbus_transportObj[handler].ops->pending(
+            ciaaModbus_transportObj[handler].hModbusLowLayer);
    }
+
+   return ret;
 }
 
 extern int8_t ciaaModbus_transportGetType(int32_t handler)
@@ -276,24 +635,21 @@ extern int8_t ciaaModbus_transportGetType(int32_t handler)
 
    if (ciaaModbus_transportObj[handler].inUse == true)
    {
-      switch (ciaaModbus_transportObj[handler].mode)
-      {
-         case CIAAMODBUS_TRANSPORT_MODE_ASCII_MASTER:
-         case CIAAMODBUS_TRANSPORT_MODE_RTU_MASTER:
-         case CIAAMODBUS_TRANSPORT_MODE_TCP_MASTER:
-            ret = CIAAMODBUS_TRANSPORT_TYPE_MASTER;
-            break;
-
-         case CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE:
-         case CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE:
-         case CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE:
-            ret = CIAAMODBUS_TRANSPORT_TYPE_SLAVE;
-            break;
-
-         default:
-            ret = CIAAMODBUS_TRANSPORT_TYPE_INVALID;
-            break;
-      }
+      ret = ciaaModbus_transportObj[handler].ops->type;
+   }
+
+   return ret;
+}
+
+extern bool ciaaModbus_transportTxReady(int32_t handler)
+{
+   bool ret = true;
+
+   /* if not provided, the low layer transport is always ready */
+   if (NULL != ciaaModbus_transportObj[handler].ops->txReady)
+   {
+      ret = ciaaModbus_transportObj[handler].ops->txReady(
+            ciaaModbus_transportObj[handler].hModbusLowLayer);
    }
 
    return ret;
@@ -0,0 +1,551 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief Modbus ASCII end to end benchmark over pseudo terminals
+ **
+ ** A Modbus ASCII transport is opened on one end of a pseudo terminal and
+ ** served by a device thread calling ciaaModbus_asciiTask every
+ ** CIAA_MODBUS_TIME_BASE or when data is available, as an application
+ ** does. A reference master, independent of the stack, sends read holding
+ ** registers requests from the other end and checks the responses. Both
+ ** ends write at the emulated baud rate.
+ **
+ ** Request to response latency percentiles and frames per second are
+ ** reported.
+ **
+ ** Build (Linux host):
+ **   gcc -O2 -Iinc -Itest/bench/inc -I<posix inc> \
+ **      test/bench/src/bench_ciaaModbus_pty.c src/ciaaModbus_ascii.c \
+ **      src/ciaaModbus_reactor.c \
+ **      -lutil -lpthread -o bench_ciaaModbus_pty
+ **
+ ** Usage:
+ **   bench_ciaaModbus_pty [baudrate [requests [registers]]]
+ **
+ ** A baudrate of 0 disables the emulation of the line.
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "ciaaModbus_ascii.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaPOSIX_stdio.h"
+#include <pty.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*==================[macros and definitions]=================================*/
+/** \brief Default emulated baud rate */
+#define BENCH_BAUDRATE           115200
+
+/** \brief Default count of requests */
+#define BENCH_REQUESTS           1000
+
+/** \brief Default registers read by request */
+#define BENCH_REGISTERS          10
+
+/** \brief Maximal registers read by request */
+#define BENCH_REGISTERS_MAX      125
+
+/** \brief Id of the emulated slave */
+#define BENCH_SLAVE_ID           0x01
+
+/** \brief Response timeout of the reference master (milliseconds) */
+#define BENCH_TIMEOUT            1000
+
+/** \brief Bits by character of the emulated line (start, 8 data, stop) */
+#define BENCH_BITS_BY_CHAR       10
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief Emulated baud rate, 0 if not emulated */
+static uint32_t bench_baudrate;
+
+/** \brief Device thread running */
+static volatile int32_t bench_running;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Get monotonic time in nanoseconds */
+static uint64_t bench_getTime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** \brief Write all data at the emulated baud rate
+ **
+ ** Each character is written when it would be completely transmitted by
+ ** the emulated line.
+ **
+ ** \param[in] fildes file descriptor
+ ** \param[in] buf data to write
+ ** \param[in] nbyte count of bytes
+ ** \return nbyte, -1 if error
+ **/
+static ssize_t bench_write(int32_t fildes, void const * buf, size_t nbyte)
+{
+   uint8_t const *data = buf;
+   struct pollfd pfd;
+   struct timespec ts;
+   uint64_t charTime = 0;
+   uint64_t deadline;
+   size_t sent = 0;
+   ssize_t ret;
+
+   if (0 < bench_baudrate)
+   {
+      charTime = 1000000000ULL * BENCH_BITS_BY_CHAR / bench_baudrate;
+   }
+
+   deadline = bench_getTime();
+
+   while (sent < nbyte)
+   {
+      /* wait until the character is transmitted */
+      if (0 < charTime)
+      {
+         deadline += charTime;
+         ts.tv_sec = deadline / 1000000000ULL;
+         ts.tv_nsec = deadline % 1000000000ULL;
+         clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+      }
+
+      ret = write(fildes, &data[sent], (0 < charTime) ? 1 : (nbyte - sent));
+
+      if (0 < ret)
+      {
+         sent += ret;
+      }
+      else if ( (0 > ret) && (EAGAIN == errno) )
+      {
+         /* wait for space in the pseudo terminal */
+         pfd.fd = fildes;
+         pfd.events = POLLOUT;
+         poll(&pfd, 1, BENCH_TIMEOUT);
+      }
+      else
+      {
+         return -1;
+      }
+   }
+
+   return nbyte;
+}
+
+/** \brief Set a pseudo terminal end in raw and non blocking mode */
+static void bench_setRaw(int32_t fildes)
+{
+   struct termios tio;
+
+   tcgetattr(fildes, &tio);
+   cfmakeraw(&tio);
+   tcsetattr(fildes, TCSANOW, &tio);
+
+   fcntl(fildes, F_SETFL, fcntl(fildes, F_GETFL) | O_NONBLOCK);
+}
+
+/** \brief Device thread
+ **
+ ** Serves the requests received by the Modbus ASCII transport. Read
+ ** holding registers is answered with the register address as value,
+ ** other functions with an illegal function exception.
+ **
+ ** \param[in] param pointer to the file descriptor
+ **/
+static void * bench_deviceThread(void * param)
+{
+   int32_t fildes = *(int32_t *)param;
+   int32_t hModbusAscii;
+   struct pollfd pfd;
+   uint8_t pdu[256];
+   uint8_t id;
+   uint32_t size;
+   uint16_t address;
+   uint16_t quantity;
+   uint32_t loopi;
+
+   ciaaModbus_asciiInit();
+
+   hModbusAscii = ciaaModbus_asciiOpen(fildes);
+
+   pfd.fd = fildes;
+   pfd.events = POLLIN;
+
+   while (bench_running)
+   {
+      /* wait for data or next time base */
+      poll(&pfd, 1, CIAA_MODBUS_TIME_BASE);
+
+      ciaaModbus_asciiTask(hModbusAscii);
+
+      ciaaModbus_asciiRecvMsg(hModbusAscii, &id, pdu, &size);
+
+      if (0 < size)
+      {
+         address = (pdu[1] << 8) | pdu[2];
+         quantity = (pdu[3] << 8) | pdu[4];
+
+         if ( (0x03 == pdu[0]) && (5 == size) &&
+              (0 < quantity) && (BENCH_REGISTERS_MAX >= quantity) )
+         {
+            pdu[1] = quantity * 2;
+            for (loopi = 0 ; loopi < quantity ; loopi++)
+            {
+               pdu[2 + loopi * 2] = (address + loopi) >> 8;
+               pdu[3 + loopi * 2] = (address + loopi) & 0xFF;
+            }
+            size = 2 + quantity * 2;
+         }
+         else
+         {
+            pdu[0] |= 0x80;
+            pdu[1] = 0x01;
+            size = 2;
+         }
+
+         ciaaModbus_asciiSendMsg(hModbusAscii, id, pdu, size);
+      }
+   }
+
+   return NULL;
+}
+
+/** \brief Encode a modbus ascii frame
+ **
+ ** \param[out] dst ascii frame
+ ** \param[in] src binary message (id and pdu)
+ ** \param[in] len length of the binary message
+ ** \return length of the ascii frame
+ **/
+static int32_t bench_encode(uint8_t * dst, uint8_t const * src, int32_t len)
+{
+   static const char hex[] = "0123456789ABCDEF";
+   uint8_t lrc = 0;
+   int32_t loopi;
+   int32_t ret = 0;
+
+   dst[ret++] = ':';
+
+   for (loopi = 0 ; loopi <= len ; loopi++)
+   {
+      uint8_t byte;
+
+      if (loopi < len)
+      {
+         byte = src[loopi];
+         lrc += byte;
+      }
+      else
+      {
+         byte = -lrc;
+      }
+
+      dst[ret++] = hex[byte >> 4];
+      dst[ret++] = hex[byte & 0x0F];
+   }
+
+   dst[ret++] = '\r';
+   dst[ret++] = '\n';
+
+   return ret;
+}
+
+/** \brief Decode and check a modbus ascii frame
+ **
+ ** \param[out] dst binary message (id and pdu, LRC discarded)
+ ** \param[in] src ascii frame with CRLF
+ ** \param[in] len length of the ascii frame
+ ** \return length of the binary message, -1 if invalid
+ **/
+static int32_t bench_decode(uint8_t * dst, uint8_t const * src, int32_t len)
+{
+   uint8_t lrc = 0;
+   int32_t loopi;
+   int32_t ret = 0;
+   int32_t nibble[2];
+   int32_t loopj;
+
+   if ( (9 > len) || (':' != src[0]) || (0 == (len & 1)) )
+   {
+      return -1;
+   }
+
+   for (loopi = 1 ; loopi < len - 2 ; loopi += 2)
+   {
+      for (loopj = 0 ; loopj < 2 ; loopj++)
+      {
+         uint8_t c = src[loopi + loopj];
+
+         if ( ('0' <= c) && ('9' >= c) )
+         {
+            nibble[loopj] = c - '0';
+         }
+         else if ( ('A' <= c) && ('F' >= c) )
+         {
+            nibble[loopj] = c - 'A' + 10;
+         }
+         else
+         {
+            return -1;
+         }
+      }
+
+      dst[ret] = (nibble[0] << 4) | nibble[1];
+      lrc += dst[ret];
+      ret++;
+   }
+
+   /* LRC of the message and LRC shall be 0 */
+   return (0 == lrc) ? (ret - 1) : -1;
+}
+
+/** \brief Receive a frame on the reference master
+ **
+ ** \param[in] fildes file descriptor
+ ** \param[out] buf ascii frame
+ ** \param[in] size size of buf
+ ** \return length of the frame, -1 if timeout
+ **/
+static int32_t bench_recvFrame(int32_t fildes, uint8_t * buf, int32_t size)
+{
+   struct pollfd pfd;
+   int32_t len = 0;
+   ssize_t ret;
+
+   pfd.fd = fildes;
+   pfd.events = POLLIN;
+
+   while ( (2 > len) || ('\r' != buf[len-2]) || ('\n' != buf[len-1]) )
+   {
+      if ( (len >= size) || (0 >= poll(&pfd, 1, BENCH_TIMEOUT)) )
+      {
+         return -1;
+      }
+
+      ret = read(fildes, &buf[len], size - len);
+
+      if (0 < ret)
+      {
+         len += ret;
+      }
+   }
+
+   return len;
+}
+
+/** \brief Compare two latencies for qsort */
+static int bench_compare(void const * a, void const * b)
+{
+   uint64_t la = *(uint64_t const *)a;
+   uint64_t lb = *(uint64_t const *)b;
+
+   return (la > lb) - (la < lb);
+}
+
+/** \brief Get a percentile of sorted latencies in microseconds */
+static double bench_percentile(uint64_t const * lat, int32_t count, int32_t pct)
+{
+   int32_t index = (count * pct) / 100;
+
+   if (index >= count)
+   {
+      index = count - 1;
+   }
+
+   return lat[index] / 1000.0;
+}
+
+/*==================[external functions definition]==========================*/
+extern ssize_t ciaaPOSIX_read(int32_t fildes, void * buf, size_t nbyte)
+{
+   ssize_t ret;
+
+   ret = read(fildes, buf, nbyte);
+
+   /* no data available */
+   if (0 > ret)
+   {
+      ret = 0;
+   }
+
+   return ret;
+}
+
+extern ssize_t ciaaPOSIX_write(int32_t fildes, void const * buf, size_t nbyte)
+{
+   return bench_write(fildes, buf, nbyte);
+}
+
+int main(int argc, char * argv[])
+{
+   int32_t fildesMaster;
+   int32_t fildesDevice;
+   pthread_t device;
+   uint64_t *lat;
+   uint64_t start;
+   uint64_t t0;
+   uint8_t msg[256];
+   uint8_t ascii[600];
+   int32_t requests;
+   int32_t registers;
+   int32_t count = 0;
+   int32_t errors = 0;
+   int32_t len;
+   int32_t loopi;
+   double elapsed;
+
+   bench_baudrate = (1 < argc) ? strtoul(argv[1], NULL, 0) : BENCH_BAUDRATE;
+   requests = (2 < argc) ? atoi(argv[2]) : BENCH_REQUESTS;
+   registers = (3 < argc) ? atoi(argv[3]) : BENCH_REGISTERS;
+
+   if ( (0 >= requests) || (0 >= registers) ||
+        (BENCH_REGISTERS_MAX < registers) )
+   {
+      fprintf(stderr, "usage: %s [baudrate [requests [registers]]]\n", argv[0]);
+      return 1;
+   }
+
+   lat = malloc(requests * sizeof(uint64_t));
+
+   if ( (NULL == lat) ||
+        (0 != openpty(&fildesMaster, &fildesDevice, NULL, NULL, NULL)) )
+   {
+      perror("openpty");
+      return 1;
+   }
+
+   bench_setRaw(fildesMaster);
+   bench_setRaw(fildesDevice);
+
+   bench_running = 1;
+   pthread_create(&device, NULL, bench_deviceThread, &fildesDevice);
+
+   start = bench_getTime();
+
+   for (loopi = 0 ; loopi < requests ; loopi++)
+   {
+      /* read holding registers */
+      msg[0] = BENCH_SLAVE_ID;
+      msg[1] = 0x03;
+      msg[2] = loopi >> 8;
+      msg[3] = loopi & 0xFF;
+      msg[4] = 0x00;
+      msg[5] = registers;
+
+      len = bench_encode(ascii, msg, 6);
+
+      t0 = bench_getTime();
+
+      bench_write(fildesMaster, ascii, len);
+
+      len = bench_recvFrame(fildesMaster, ascii, sizeof(ascii));
+
+      if (0 < len)
+      {
+         len = bench_decode(msg, ascii, len);
+      }
+
+      /* check id, function, byte count and first register */
+      if ( (2 + 2 * registers + 1 == len) &&
+           (BENCH_SLAVE_ID == msg[0]) && (0x03 == msg[1]) &&
+           (2 * registers == msg[2]) &&
+           ((loopi & 0xFFFF) == ((msg[3] << 8) | msg[4])) )
+      {
+         lat[count] = bench_getTime() - t0;
+         count++;
+      }
+      else
+      {
+         errors++;
+
+         /* discard pending data */
+         tcflush(fildesMaster, TCIFLUSH);
+      }
+   }
+
+   elapsed = (bench_getTime() - start) / 1e9;
+
+   bench_running = 0;
+   pthread_join(device, NULL);
+
+   printf("baudrate %u, registers %d, requests %d, responses %d, errors %d\n",
+         bench_baudrate, registers, requests, count, errors);
+
+   if (0 < count)
+   {
+      qsort(lat, count, sizeof(uint64_t), bench_compare);
+
+      printf("latency us: min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+            lat[0] / 1000.0,
+            bench_percentile(lat, count, 50),
+            bench_percentile(lat, count, 90),
+            bench_percentile(lat, count, 99),
+            lat[count-1] / 1000.0);
+   }
+
+   printf("frames/s: %.1f\n", count / elapsed);
+
+   free(lat);
+   close(fildesMaster);
+   close(fildesDevice);
+
+   return (0 == errors) ? 0 : 1;
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
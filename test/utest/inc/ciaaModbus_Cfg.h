@@ -66,12 +66,97 @@ extern "C" {
 /** \brief Total transport available */
 #define CIAA_MODBUS_TOTAL_TRANSPORT_ASCII    2
 
+/** \brief Size of the transmission queue of transport ASCII (bytes) */
+#define CIAA_MODBUS_ASCII_TX_BUFFER_SIZE     1024
+
 /** \brief Total transport available */
 #define CIAA_MODBUS_TOTAL_TRANSPORT_RTU      2
 
+/** \brief Size of the transmission queue of transport RTU (bytes) */
+#define CIAA_MODBUS_RTU_TX_BUFFER_SIZE       512
+
+/** \brief Total serial ports with auto detection */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_AUTO     1
+
 /** \brief Total transport available */
 #define CIAA_MODBUS_TOTAL_TRANSPORT_TCP      2
 
+/** \brief Total transport of application modes */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_USER     1
+
+/** \brief Total loopback channels */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK 2
+
+/** \brief Total transport shared memory */
+#define CIAA_MODBUS_TOTAL_TRANSPORT_SHM      1
+
+/** \brief Messages queued by loopback channel */
+#define CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH    2
+
+/** \brief Total TCP server connections */
+#define CIAA_MODBUS_TCP_TOTAL_CONNECTIONS    4
+
+/** \brief Total TCP server buffers */
+#define CIAA_MODBUS_TCP_TOTAL_BUFFERS        2
+
+/** \brief Idle timeout of TCP server connections (milliseconds) */
+#define CIAA_MODBUS_TCP_IDLE_TIMEOUT         100
+
+/** \brief Resolution of the idle timeout (milliseconds) */
+#define CIAA_MODBUS_TCP_WHEEL_TICK           10
+
+/** \brief Frame timeout of TCP server connections (milliseconds) */
+#define CIAA_MODBUS_TCP_FRAME_TIMEOUT        50
+
+/** \brief TCP_CORK in TCP server connections */
+#define CIAA_MODBUS_TCP_CORK                 1
+
+/** \brief Messages by TCP connection */
+#define CIAA_MODBUS_TCP_ADU_BUDGET           4
+
+/** \brief Connection timeout of TCP master (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_CONNECT_TIMEOUT  100
+
+/** \brief Reconnection backoff of TCP master (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN      50
+#define CIAA_MODBUS_TCP_MASTER_BACKOFF_MAX      200
+
+/** \brief Idle timeout of TCP master (milliseconds) */
+#define CIAA_MODBUS_TCP_MASTER_IDLE_TIMEOUT     100
+
+/** \brief Keepalive of TCP master (seconds) */
+#define CIAA_MODBUS_TCP_MASTER_KEEPALIVE_IDLE   10
+
+/** \brief Messages by gateway client */
+#define CIAA_MODBUS_GATEWAY_ADU_BUDGET       4
+
+/** \brief Clients by gateway */
+#define CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS    4
+
+/** \brief Servers by gateway */
+#define CIAA_MODBUS_GATEWAY_TOTAL_SERVERS    4
+
+/** \brief Read responses cached by gateway */
+#define CIAA_MODBUS_GATEWAY_CACHE_ENTRIES    2
+
+/** \brief Merge adjacent reads in gateway */
+#define CIAA_MODBUS_GATEWAY_MERGE            1
+
+/** \brief Priority of gateway clients */
+#define CIAA_MODBUS_GATEWAY_PRIORITY         1
+
+/** \brief Deficit round robin of gateway clients */
+#define CIAA_MODBUS_GATEWAY_DRR              1
+
+/** \brief Gateways run by their own thread */
+#define CIAA_MODBUS_GATEWAY_THREADS          1
+
+/** \brief File descriptors registered with the reactor (0 .. max-1) */
+#define CIAA_MODBUS_REACTOR_MAX_FDS          64
+
+/** \brief Threads waiting on the reactor at once */
+#define CIAA_MODBUS_REACTOR_TOTAL_WAITERS    2
+
 /** \brief Time between calls (milliseconds) */
 #define CIAA_MODBUS_TIME_BASE                5
 
@@ -45,6 +45,7 @@
 #include "ciaaModbus_Cfg.h"
 #include "string.h"
 #include "mock_ciaaPOSIX_stdio.h"
+#include "mock_ciaaModbus_reactor.h"
 #include "mock_ciaaPOSIX_string.h"
 
 /*==================[macros and definitions]=================================*/
@@ -62,6 +63,7 @@ typedef struct {
    uint8_t buf[10][500];
    int32_t len[10];
    int32_t count;
+   int32_t limit;          /** <= max bytes written by call, -1 no limit */
 } writeStubType;
 
 /*==================[internal data declaration]==============================*/
@@ -78,6 +80,14 @@ static writeStubType write_stub;
 
 static int32_t hModbusAscii;
 
+/** \brief frames reported by the framer */
+static struct {
+   int32_t count;
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+} framer_cb;
+
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
@@ -90,9 +100,14 @@ static int32_t hModbusAscii;
  **/
 void setUp(void)
 {
+   /* all ports with data pending */
+   ciaaModbus_reactorReady_IgnoreAndReturn(true);
+
    ciaaPOSIX_read_init();
    ciaaPOSIX_write_init();
 
+   framer_cb.count = 0;
+
    ciaaModbus_asciiInit();
 }
 
@@ -111,6 +126,17 @@ void doNothing(void)
 
 /**** Helper Functions ****/
 
+/** \brief framer callback, stores the last frame */
+static void tst_framerCb(void *param, uint8_t id, uint8_t *pdu, uint32_t size)
+{
+   TEST_ASSERT_EQUAL_PTR(&framer_cb, param);
+
+   framer_cb.count++;
+   framer_cb.id = id;
+   memcpy(framer_cb.pdu, pdu, size);
+   framer_cb.size = size;
+}
+
 /** \brief Init posix write stub */
 static void ciaaPOSIX_write_init(void)
 {
@@ -118,6 +144,7 @@ static void ciaaPOSIX_write_init(void)
 
    write_stub.fildes = 0;
    write_stub.count = 0;
+   write_stub.limit = -1;
 
    for(loopi = 0; loopi < 10; loopi++)
    {
@@ -220,6 +247,18 @@ ssize_t ciaaPOSIX_read_stub(int32_t fildes, void * buf, size_t nbyte, int cmock_
 }
 ssize_t ciaaPOSIX_write_stub(int32_t fildes, void const * buf, size_t nbyte, int cmock_num_calls)
 {
+   /* device accepts only a part of the data */
+   if ( (0 <= write_stub.limit) && (write_stub.limit < nbyte) )
+   {
+      nbyte = write_stub.limit;
+   }
+
+   /* nothing written */
+   if (0 == nbyte)
+   {
+      return 0;
+   }
+
    memcpy(write_stub.buf[write_stub.count], buf, nbyte);
    write_stub.len[write_stub.count] = nbyte;
    write_stub.count++;
@@ -672,6 +711,100 @@ void test_ciaaModbus_asciiRecvMsg_06(void) {
 }
 
 
+/** \brief test ciaaModbus_asciiFramerFeed
+ ** frame fed byte by byte */
+void test_ciaaModbus_asciiFramerFeed_01(void)
+{
+   ciaaModbus_asciiFramerType framer;
+   uint8_t msgAscii[100] = ":11030000000A";
+   uint8_t msgBin[100];
+   int32_t lenAscii;
+   int32_t lenBin;
+   int32_t loopi;
+   int32_t ret = 0;
+
+   /* obtain msg in binary */
+   lenBin = tst_convert2bin(msgBin, msgAscii, strlen((char *)msgAscii));
+
+   /* add LRC and CRLF */
+   lenAscii = tst_asciipdu(msgAscii, 1, 1);
+
+   ciaaModbus_asciiFramerInit(&framer, tst_framerCb, &framer_cb);
+
+   for (loopi = 0 ; loopi < lenAscii ; loopi++)
+   {
+      ret += ciaaModbus_asciiFramerFeed(&framer, &msgAscii[loopi], 1);
+   }
+
+   TEST_ASSERT_EQUAL_INT(1, ret);
+   TEST_ASSERT_EQUAL_INT(1, framer_cb.count);
+   TEST_ASSERT_EQUAL_UINT8(msgBin[0], framer_cb.id);
+   TEST_ASSERT_EQUAL_INT(lenBin - 1, framer_cb.size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(&msgBin[1], framer_cb.pdu, lenBin - 1);
+}
+
+/** \brief test ciaaModbus_asciiFramerFeed
+ ** several frames, noise and an invalid LRC in one chunk */
+void test_ciaaModbus_asciiFramerFeed_02(void)
+{
+   ciaaModbus_asciiFramerType framer;
+   uint8_t stream[200];
+   int32_t len = 0;
+   int32_t ret;
+
+   /* noise before first frame */
+   memcpy(stream, "XX", 2);
+   len += 2;
+
+   /* valid frame */
+   strcpy((char *)&stream[len], ":0103000A0001");
+   len += tst_asciipdu(&stream[len], 1, 1);
+
+   /* frame with invalid LRC */
+   strcpy((char *)&stream[len], ":01030000000100");
+   len += tst_asciipdu(&stream[len], 1, 0);
+
+   /* frame interrupted by a new start character */
+   memcpy(&stream[len], ":0103", 5);
+   len += 5;
+
+   /* valid frame */
+   strcpy((char *)&stream[len], ":0203000B0002");
+   len += tst_asciipdu(&stream[len], 1, 1);
+
+   ciaaModbus_asciiFramerInit(&framer, tst_framerCb, &framer_cb);
+
+   ret = ciaaModbus_asciiFramerFeed(&framer, stream, len);
+
+   TEST_ASSERT_EQUAL_INT(2, ret);
+   TEST_ASSERT_EQUAL_INT(2, framer_cb.count);
+   TEST_ASSERT_EQUAL_UINT8(0x02, framer_cb.id);
+   TEST_ASSERT_EQUAL_INT(5, framer_cb.size);
+   TEST_ASSERT_EQUAL_UINT8(0x0B, framer_cb.pdu[2]);
+}
+
+/** \brief test ciaaModbus_asciiFramerReset
+ ** frame discarded by reset */
+void test_ciaaModbus_asciiFramerReset_01(void)
+{
+   ciaaModbus_asciiFramerType framer;
+   uint8_t msgAscii[100] = ":0103000A0001";
+   int32_t lenAscii;
+   int32_t ret;
+
+   lenAscii = tst_asciipdu(msgAscii, 1, 1);
+
+   ciaaModbus_asciiFramerInit(&framer, tst_framerCb, &framer_cb);
+
+   /* feed first half, reset (timeout) and feed the rest */
+   ret = ciaaModbus_asciiFramerFeed(&framer, msgAscii, 6);
+   ciaaModbus_asciiFramerReset(&framer);
+   ret += ciaaModbus_asciiFramerFeed(&framer, &msgAscii[6], lenAscii - 6);
+
+   TEST_ASSERT_EQUAL_INT(0, ret);
+   TEST_ASSERT_EQUAL_INT(0, framer_cb.count);
+}
+
 /** \brief test ciaaModbus_asciiSendMsg */
 void test_ciaaModbus_asciiSendMsg_01(void)
 {
@@ -727,6 +860,86 @@ void test_ciaaModbus_asciiSendMsg_01(void)
    TEST_ASSERT_EQUAL_UINT8_ARRAY(buf[1][0], write_stub.buf[1], lenin[1]);
 }
 
+/** \brief test ciaaModbus_asciiSendMsg
+ ** partial writes are resumed by the task */
+void test_ciaaModbus_asciiSendMsg_02(void)
+{
+   uint8_t msgAscii[100] = ":0001020304050607";
+   uint8_t msgBin[100];
+   uint8_t written[100];
+   int32_t lenAscii;
+   int32_t lenBin;
+   int32_t len = 0;
+   int32_t loopi;
+
+   /* set stub callback */
+   ciaaPOSIX_write_StubWithCallback(ciaaPOSIX_write_stub);
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   /* device accepts 10 bytes by call */
+   write_stub.limit = 10;
+
+   lenBin = tst_convert2bin(msgBin, msgAscii, strlen((char *)msgAscii));
+   lenAscii = tst_asciipdu(msgAscii, 1, 1);
+
+   hModbusAscii = ciaaModbus_asciiOpen(1);
+
+   ciaaModbus_asciiSendMsg(hModbusAscii, msgBin[0], &msgBin[1], lenBin - 1);
+
+   /* first part written */
+   TEST_ASSERT_EQUAL_INT(1, write_stub.count);
+
+   /* remaining parts written by the task */
+   ciaaModbus_asciiTask(hModbusAscii);
+   ciaaModbus_asciiTask(hModbusAscii);
+   ciaaModbus_asciiTask(hModbusAscii);
+
+   for (loopi = 0 ; loopi < write_stub.count ; loopi++)
+   {
+      memcpy(&written[len], write_stub.buf[loopi], write_stub.len[loopi]);
+      len += write_stub.len[loopi];
+   }
+
+   TEST_ASSERT_EQUAL_INT(3, write_stub.count);
+   TEST_ASSERT_EQUAL_INT(lenAscii, len);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(msgAscii, written, lenAscii);
+}
+
+/** \brief test ciaaModbus_asciiTxReady
+ ** queue full while the device accepts no data */
+void test_ciaaModbus_asciiTxReady_01(void)
+{
+   uint8_t pdu[100];
+   int32_t count = 0;
+
+   /* set stub callback */
+   ciaaPOSIX_write_StubWithCallback(ciaaPOSIX_write_stub);
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   memset(pdu, 0x11, sizeof(pdu));
+
+   /* device accepts no data */
+   write_stub.limit = 0;
+
+   hModbusAscii = ciaaModbus_asciiOpen(1);
+
+   /* queue messages until not ready */
+   while ( (ciaaModbus_asciiTxReady(hModbusAscii)) && (100 > count) )
+   {
+      ciaaModbus_asciiSendMsg(hModbusAscii, 0x01, pdu, sizeof(pdu));
+      count++;
+   }
+
+   TEST_ASSERT_FALSE(ciaaModbus_asciiTxReady(hModbusAscii));
+   TEST_ASSERT_EQUAL_INT(0, write_stub.count);
+
+   /* device accepts data again */
+   write_stub.limit = -1;
+   ciaaModbus_asciiTask(hModbusAscii);
+
+   TEST_ASSERT_TRUE(ciaaModbus_asciiTxReady(hModbusAscii));
+}
+
 /** \brief test function Open
  **
  ** this function call open more times than allowed
@@ -0,0 +1,301 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_auto.h"
+#include "ciaaModbus_ascii.h"
+#include "ciaaModbus_rtu.h"
+#include "ciaaModbus_Cfg.h"
+#include "string.h"
+#include "mock_ciaaPOSIX_stdio.h"
+#include "mock_ciaaModbus_reactor.h"
+
+/*==================[macros and definitions]=================================*/
+/** \brief Type for the stub read function */
+typedef struct {
+   uint8_t buf[10][300];   /** <= data returned in each call */
+   int32_t len[10];        /** <= count of bytes returned in each call */
+   int32_t total;          /** <= calls returning data */
+   int32_t count;          /** <= count of calls */
+} readStubType;
+
+/** \brief Type for the stub write function */
+typedef struct {
+   uint8_t buf[10][300];
+   int32_t len[10];
+   int32_t count;
+} writeStubType;
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+ssize_t ciaaPOSIX_read_stub(int32_t fildes, void * buf, size_t nbyte, int cmock_num_calls);
+ssize_t ciaaPOSIX_write_stub(int32_t fildes, void const * buf, size_t nbyte, int cmock_num_calls);
+
+/*==================[internal data definition]===============================*/
+static readStubType read_stub;
+
+static writeStubType write_stub;
+
+/** \brief ascii frame, id 0x01 function 0x03 */
+static const uint8_t msgAscii[] = ":0103000A0001F1\r\n";
+
+/** \brief rtu frame, id 0x11 function 0x03 */
+static const uint8_t msgRtu[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+
+/** \brief ports reported as pending by the reactor stub */
+static bool tst_ready;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   /* all ports with data pending */
+   ciaaModbus_reactorReady_IgnoreAndReturn(true);
+
+   memset(&read_stub, 0, sizeof(read_stub));
+   memset(&write_stub, 0, sizeof(write_stub));
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+   ciaaPOSIX_write_StubWithCallback(ciaaPOSIX_write_stub);
+
+   ciaaModbus_asciiInit();
+   ciaaModbus_rtuInit();
+   ciaaModbus_autoInit();
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+}
+
+void doNothing(void)
+{
+}
+
+/**** Helper Functions ****/
+
+/** \brief Add a call returning data to the read stub */
+static void tst_readAdd(uint8_t const *data, int32_t len)
+{
+   memcpy(read_stub.buf[read_stub.total], data, len);
+   read_stub.len[read_stub.total] = len;
+   read_stub.total++;
+}
+
+ssize_t ciaaPOSIX_read_stub(int32_t fildes, void * buf, size_t nbyte, int cmock_num_calls)
+{
+   ssize_t ret = 0;
+
+   /* return the data of this call, nothing once all returned */
+   if (read_stub.count < read_stub.total)
+   {
+      ret = read_stub.len[read_stub.count];
+
+      TEST_ASSERT_TRUE(nbyte >= ret);
+
+      memcpy(buf, read_stub.buf[read_stub.count], ret);
+   }
+
+   read_stub.count++;
+
+   return ret;
+}
+
+ssize_t ciaaPOSIX_write_stub(int32_t fildes, void const * buf, size_t nbyte, int cmock_num_calls)
+{
+   memcpy(write_stub.buf[write_stub.count], buf, nbyte);
+   write_stub.len[write_stub.count] = nbyte;
+   write_stub.count++;
+
+   return nbyte;
+}
+
+static bool ciaaModbus_reactorReady_stub(int32_t fildes, int cmock_num_calls)
+{
+   return tst_ready;
+}
+
+/**** Tests ****/
+
+/** \brief test ciaaModbus_autoTask
+ ** ASCII detected */
+void test_ciaaModbus_autoTask_01(void)
+{
+   int32_t hModbusAuto;
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+
+   tst_readAdd(msgAscii, sizeof(msgAscii) - 1);
+
+   hModbusAuto = ciaaModbus_autoOpen(1);
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_autoGetMode(hModbusAuto));
+
+   ciaaModbus_autoTask(hModbusAuto);
+
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE,
+         ciaaModbus_autoGetMode(hModbusAuto));
+
+   /* the frame of the detection is received */
+   ciaaModbus_autoRecvMsg(hModbusAuto, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_UINT8(0x01, id);
+   TEST_ASSERT_EQUAL_INT(5, size);
+   TEST_ASSERT_EQUAL_UINT8(0x0A, pdu[2]);
+
+   /* the response is sent as ascii */
+   ciaaModbus_autoSendMsg(hModbusAuto, id, pdu, size);
+
+   TEST_ASSERT_EQUAL_INT(1, write_stub.count);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(msgAscii, write_stub.buf[0], sizeof(msgAscii) - 1);
+
+   /* next frames are received by the ascii transport */
+   tst_readAdd(msgAscii, sizeof(msgAscii) - 1);
+
+   ciaaModbus_autoTask(hModbusAuto);
+   ciaaModbus_autoRecvMsg(hModbusAuto, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(5, size);
+}
+
+/** \brief test ciaaModbus_autoTask
+ ** RTU detected */
+void test_ciaaModbus_autoTask_02(void)
+{
+   int32_t hModbusAuto;
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+
+   tst_readAdd(msgRtu, sizeof(msgRtu));
+
+   hModbusAuto = ciaaModbus_autoOpen(1);
+
+   /* frame received, not detected up to the silent interval */
+   ciaaModbus_autoTask(hModbusAuto);
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_autoGetMode(hModbusAuto));
+
+   /* silent interval pending, even without data */
+   tst_ready = false;
+   ciaaModbus_reactorReady_StubWithCallback(ciaaModbus_reactorReady_stub);
+   TEST_ASSERT_TRUE(ciaaModbus_autoPending(hModbusAuto));
+
+   ciaaModbus_autoTask(hModbusAuto);
+
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE,
+         ciaaModbus_autoGetMode(hModbusAuto));
+
+   /* frame of the detection pending, then the rtu transport is checked */
+   TEST_ASSERT_TRUE(ciaaModbus_autoPending(hModbusAuto));
+
+   ciaaModbus_autoRecvMsg(hModbusAuto, &id, pdu, &size);
+
+   TEST_ASSERT_FALSE(ciaaModbus_autoPending(hModbusAuto));
+
+   TEST_ASSERT_EQUAL_UINT8(0x11, id);
+   TEST_ASSERT_EQUAL_INT(5, size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(&msgRtu[1], pdu, 5);
+
+   /* the response is sent as rtu */
+   ciaaModbus_autoSendMsg(hModbusAuto, id, pdu, size);
+
+   TEST_ASSERT_EQUAL_INT(1, write_stub.count);
+   TEST_ASSERT_EQUAL_INT(sizeof(msgRtu), write_stub.len[0]);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(msgRtu, write_stub.buf[0], sizeof(msgRtu));
+}
+
+/** \brief test ciaaModbus_autoTask
+ ** invalid frames are not detected */
+void test_ciaaModbus_autoTask_03(void)
+{
+   int32_t hModbusAuto;
+   uint8_t noise[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x88};
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+
+   tst_readAdd(noise, sizeof(noise));
+   tst_readAdd((uint8_t const *)":0103000A0001F2\r\n", 17);
+
+   hModbusAuto = ciaaModbus_autoOpen(1);
+
+   ciaaModbus_autoTask(hModbusAuto);
+   ciaaModbus_autoTask(hModbusAuto);
+   ciaaModbus_autoTask(hModbusAuto);
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_autoGetMode(hModbusAuto));
+
+   ciaaModbus_autoRecvMsg(hModbusAuto, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(0, size);
+
+   /* messages discarded while detecting */
+   TEST_ASSERT_TRUE(ciaaModbus_autoTxReady(hModbusAuto));
+
+   ciaaModbus_autoSendMsg(hModbusAuto, 0x01, pdu, 5);
+
+   TEST_ASSERT_EQUAL_INT(0, write_stub.count);
+}
+
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
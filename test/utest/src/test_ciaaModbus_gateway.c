@@ -46,9 +46,11 @@
 #include "mock_os.h"
 #include "mock_ciaaModbus_transport.h"
 #include "mock_ciaaModbus_slave.h"
+#include "mock_ciaaModbus_reactor.h"
 #include "os.h"
 #include "string.h"
 #include "mock_ciaaPOSIX_string.h"
+#include <unistd.h>
 
 /*==================[macros and definitions]=================================*/
 
@@ -57,6 +59,75 @@
 /*==================[internal functions declaration]=========================*/
 
 /*==================[internal data definition]===============================*/
+static int32_t transportRecvMsgCount;
+
+static int32_t transportSendMsgCount;
+
+static uint8_t routeId;
+
+static int32_t routeHandler;
+
+static int32_t routeCount;
+
+static int32_t queueTick;
+
+static int32_t queueRequestTick[3];
+
+static int32_t queueSlaveRecvCount;
+
+static uint8_t queueSent[4];
+
+static int32_t queueSentCount;
+
+static int32_t queueResponse[4];
+
+static int32_t queueResponseCount;
+
+static uint8_t cacheRequest[9];
+
+static uint32_t cacheRequestSize;
+
+static int32_t cacheSlaveCount;
+
+static int32_t cacheResponseCount;
+
+static uint8_t cacheResponse[4];
+
+static bool coalesceRequest[2];
+
+static int32_t coalesceServerRecvCount;
+
+static int32_t coalesceServerSendCount;
+
+static int32_t coalesceResponseCount[2];
+
+static uint8_t mergeFunction;
+
+static uint16_t mergeStart[3];
+
+static uint16_t mergeQuantity[3];
+
+static bool mergeRequest[3];
+
+static uint8_t mergeServerReq[5];
+
+static int32_t mergeServerSendCount;
+
+static bool mergeServerPending;
+
+static bool mergeServerHold;
+
+static bool mergeException;
+
+static int32_t mergeResponseCount[3];
+
+static uint8_t drrQuantity[4];
+
+static bool drrRequest[4];
+
+static int32_t drrResponseCount[4];
+
+static int32_t drrSlaveRecvCount;
 
 /*==================[external data definition]===============================*/
 
@@ -66,6 +137,11 @@ static void * memset_stub(void * s, int c, size_t n, int cmock_num_calls)
    return memset(s, c, n);
 }
 
+static void * memcpy_stub(void * d, const void * s, size_t n, int cmock_num_calls)
+{
+   return memcpy(d, s, n);
+}
+
 
 static void ciaaModbus_transportRecvMsg_CALLBACK(int32_t handler,
       uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
@@ -84,6 +160,518 @@ static void ciaaModbus_transportRecvMsg_CALLBACK(int32_t handler,
    *size = CIAAMODBUS_REQ_PDU_MINLENGTH;
 }
 
+static void ciaaModbus_transportRecvMsg_CALLBACK_PIPELINED(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* three requests pending in transport */
+   if (3 > transportRecvMsgCount)
+   {
+      *id = 2;
+      pdu[0] = 0x03;
+      pdu[1] = 0x00;
+      pdu[2] = transportRecvMsgCount;
+      pdu[3] = 0x00;
+      pdu[4] = 0x01;
+      *size = 5;
+
+      transportRecvMsgCount++;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(0, handler);
+   TEST_ASSERT_EQUAL(2, id);
+   TEST_ASSERT_EQUAL(transportSendMsgCount, pdu[2]);
+
+   transportSendMsgCount++;
+}
+
+static void ciaaModbus_slaveRecvMsg_CALLBACK(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* response is processed in place */
+   *id = 2;
+   pdu[1] = 0x02;
+   *size = 4;
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_ROUTE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* one request of id routeId pending in client transport 0 */
+   if ( (0 == handler) && (0 == transportRecvMsgCount) )
+   {
+      *id = routeId;
+      pdu[0] = 0x03;
+      pdu[1] = 0x00;
+      pdu[2] = 0x00;
+      pdu[3] = 0x00;
+      pdu[4] = 0x01;
+      *size = 5;
+
+      transportRecvMsgCount++;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_ROUTE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(routeId, id);
+
+   routeHandler = handler;
+
+   routeCount++;
+}
+
+static void ciaaModbus_slaveRecvMsg_CALLBACK_ROUTE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* response not available */
+   *size = 0;
+}
+
+static void ciaaModbus_slaveSendMsg_CALLBACK_ROUTE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(routeId, id);
+
+   routeHandler = handler;
+
+   routeCount++;
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_QUEUE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* each client transport receives a request in its tick */
+   if (queueRequestTick[handler] == queueTick)
+   {
+      *id = 2;
+      pdu[0] = 0x03;
+      pdu[1] = 0x00;
+      pdu[2] = handler;
+      pdu[3] = 0x00;
+      pdu[4] = 0x01;
+      *size = 5;
+
+      queueRequestTick[handler] = -1;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_QUEUE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(handler, pdu[2]);
+
+   queueResponse[queueResponseCount++] = handler;
+}
+
+static void ciaaModbus_slaveSendMsg_CALLBACK_QUEUE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   queueSent[queueSentCount++] = pdu[2];
+
+   queueSlaveRecvCount = 0;
+}
+
+static void ciaaModbus_slaveRecvMsg_CALLBACK_QUEUE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* response available in third call, processed in place */
+   queueSlaveRecvCount++;
+
+   if (3 == queueSlaveRecvCount)
+   {
+      *id = 2;
+      pdu[1] = 0x02;
+      *size = 4;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_CACHE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* one request pending in each main task call */
+   if (0 != cacheRequestSize)
+   {
+      *id = 2;
+      memcpy(pdu, cacheRequest, cacheRequestSize);
+      *size = cacheRequestSize;
+
+      cacheRequestSize = 0;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_CACHE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(2, id);
+
+   memcpy(cacheResponse, pdu, 4);
+
+   cacheResponseCount++;
+}
+
+static void ciaaModbus_slaveSendMsg_CALLBACK_CACHE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   cacheSlaveCount++;
+}
+
+static void ciaaModbus_slaveRecvMsg_CALLBACK_CACHE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* response processed in place: one register read, writes echoed */
+   *id = 2;
+   if (0x03 == pdu[0])
+   {
+      pdu[1] = 0x02;
+      pdu[2] = 0x12;
+      pdu[3] = cacheSlaveCount;
+      *size = 4;
+   }
+   else
+   {
+      *size = 5;
+   }
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_COALESCE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   *size = 0;
+
+   if ( (2 > handler) && (coalesceRequest[handler]) )
+   {
+      /* same read in client transports 0 and 1 */
+      *id = 7;
+      pdu[0] = 0x03;
+      pdu[1] = 0x00;
+      pdu[2] = 0x10;
+      pdu[3] = 0x00;
+      pdu[4] = 0x01;
+      *size = 5;
+
+      coalesceRequest[handler] = false;
+   }
+   else if (5 == handler)
+   {
+      /* response of transport master in second call */
+      coalesceServerRecvCount++;
+
+      if (2 == coalesceServerRecvCount)
+      {
+         *id = 7;
+         pdu[0] = 0x03;
+         pdu[1] = 0x02;
+         pdu[2] = 0xAB;
+         pdu[3] = 0xCD;
+         *size = 4;
+      }
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_COALESCE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(7, id);
+
+   if (5 == handler)
+   {
+      coalesceServerSendCount++;
+      coalesceServerRecvCount = 0;
+   }
+   else
+   {
+      TEST_ASSERT_EQUAL(4, size);
+      TEST_ASSERT_EQUAL_HEX8(0xAB, pdu[2]);
+      coalesceResponseCount[handler]++;
+   }
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_MERGE(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   uint16_t start;
+   uint16_t quantity;
+   uint32_t loopi;
+
+   *size = 0;
+
+   if ( (3 > handler) && (mergeRequest[handler]) )
+   {
+      /* read of client transports 0 to 2 */
+      *id = 7;
+      pdu[0] = mergeFunction;
+      pdu[1] = mergeStart[handler] >> 8;
+      pdu[2] = mergeStart[handler];
+      pdu[3] = mergeQuantity[handler] >> 8;
+      pdu[4] = mergeQuantity[handler];
+      *size = 5;
+
+      mergeRequest[handler] = false;
+   }
+   else if ( (5 == handler) && (mergeServerPending) && (false == mergeServerHold) )
+   {
+      /* response of transport master: register n has value n, coil n
+       * is on if multiple of 3 */
+      start = (mergeServerReq[1] << 8) | mergeServerReq[2];
+      quantity = (mergeServerReq[3] << 8) | mergeServerReq[4];
+
+      *id = 7;
+      if (mergeException)
+      {
+         pdu[0] = mergeServerReq[0] | 0x80;
+         pdu[1] = 0x02;
+         *size = 2;
+
+         mergeException = false;
+      }
+      else if (0x03 == mergeServerReq[0])
+      {
+         pdu[0] = 0x03;
+         pdu[1] = 2 * quantity;
+         for (loopi = 0 ; loopi < quantity ; loopi++)
+         {
+            pdu[2 + (2 * loopi)] = 0x00;
+            pdu[3 + (2 * loopi)] = start + loopi;
+         }
+         *size = 2 + (2 * quantity);
+      }
+      else
+      {
+         pdu[0] = mergeServerReq[0];
+         pdu[1] = (quantity + 7) / 8;
+         memset(&pdu[2], 0x00, pdu[1]);
+         for (loopi = 0 ; loopi < quantity ; loopi++)
+         {
+            if (0 == ((start + loopi) % 3))
+            {
+               pdu[2 + (loopi / 8)] |= 1 << (loopi % 8);
+            }
+         }
+         *size = 2 + pdu[1];
+      }
+
+      mergeServerPending = false;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_MERGE(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   uint32_t loopi;
+   uint8_t bit;
+
+   TEST_ASSERT_EQUAL(7, id);
+
+   if (5 == handler)
+   {
+      memcpy(mergeServerReq, pdu, 5);
+      mergeServerPending = true;
+      mergeServerSendCount++;
+   }
+   else
+   {
+      /* response of the read of the client */
+      TEST_ASSERT_EQUAL(mergeFunction, pdu[0]);
+
+      if (0x03 == mergeFunction)
+      {
+         TEST_ASSERT_EQUAL(2 * mergeQuantity[handler], pdu[1]);
+         for (loopi = 0 ; loopi < mergeQuantity[handler] ; loopi++)
+         {
+            TEST_ASSERT_EQUAL(mergeStart[handler] + loopi, pdu[3 + (2 * loopi)]);
+         }
+      }
+      else
+      {
+         TEST_ASSERT_EQUAL((mergeQuantity[handler] + 7) / 8, pdu[1]);
+         for (loopi = 0 ; loopi < (8 * pdu[1]) ; loopi++)
+         {
+            bit = (pdu[2 + (loopi / 8)] >> (loopi % 8)) & 0x01;
+            TEST_ASSERT_EQUAL( (loopi < mergeQuantity[handler]) &&
+                               (0 == ((mergeStart[handler] + loopi) % 3)), bit);
+         }
+      }
+
+      TEST_ASSERT_EQUAL(2 + pdu[1], size);
+
+      mergeResponseCount[handler]++;
+   }
+}
+
+static void ciaaModbus_transportRecvMsg_CALLBACK_DRR(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* each client requests again once answered */
+   if (false == drrRequest[handler])
+   {
+      *id = 2;
+      pdu[0] = 0x03;
+      pdu[1] = 0x00;
+      pdu[2] = handler;
+      pdu[3] = 0x00;
+      pdu[4] = drrQuantity[handler];
+      *size = 5;
+
+      drrRequest[handler] = true;
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+static void ciaaModbus_transportSendMsg_CALLBACK_DRR(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   TEST_ASSERT_EQUAL(2 + (2 * drrQuantity[handler]), size);
+
+   drrRequest[handler] = false;
+   drrResponseCount[handler]++;
+}
+
+static void ciaaModbus_slaveSendMsg_CALLBACK_DRR(int32_t handler,
+      uint8_t id, uint8_t* pdu, uint32_t size, int cmock_num_calls)
+{
+   drrSlaveRecvCount = 0;
+}
+
+static void ciaaModbus_slaveRecvMsg_CALLBACK_DRR(int32_t handler,
+      uint8_t* id, uint8_t* pdu, uint32_t* size, int cmock_num_calls)
+{
+   /* response available in second call, processed in place */
+   drrSlaveRecvCount++;
+
+   if (2 == drrSlaveRecvCount)
+   {
+      *id = 2;
+      pdu[1] = 2 * pdu[4];
+      *size = 2 + pdu[1];
+   }
+   else
+   {
+      *size = 0;
+   }
+}
+
+/** \brief Open gateway with two client transports and a transport master
+ ** reading function, start and quantity of each client
+ **
+ ** \return handler of gateway
+ **/
+static int32_t tst_mergeOpen(uint8_t function,
+      uint16_t start0, uint16_t quantity0,
+      uint16_t start1, uint16_t quantity1)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+   ciaaModbus_transportGetType_ExpectAndReturn(1, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 1);
+   ciaaModbus_transportGetType_ExpectAndReturn(5, CIAAMODBUS_TRANSPORT_TYPE_MASTER);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 5);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_MERGE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_MERGE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+
+   mergeFunction = function;
+   mergeStart[0] = start0;
+   mergeQuantity[0] = quantity0;
+   mergeStart[1] = start1;
+   mergeQuantity[1] = quantity1;
+   mergeRequest[0] = true;
+   mergeRequest[1] = true;
+   mergeRequest[2] = false;
+   mergeServerSendCount = 0;
+   mergeServerPending = false;
+   mergeServerHold = false;
+   mergeException = false;
+   mergeResponseCount[0] = 0;
+   mergeResponseCount[1] = 0;
+   mergeResponseCount[2] = 0;
+
+   return hModbusGW;
+}
+
+/** \brief Send a request to gateway and perform a main task call
+ **
+ ** \param[in] hModbusGW handler of gateway
+ ** \param[in] function function of request
+ ** \param[in] address address of request
+ ** \return count of requests sent to slave
+ **/
+static int32_t tst_cache(int32_t hModbusGW, uint8_t function, uint16_t address)
+{
+   cacheRequest[0] = function;
+   cacheRequest[1] = address >> 8;
+   cacheRequest[2] = address;
+   cacheRequest[3] = 0x00;
+   cacheRequest[4] = 0x01;
+   cacheRequestSize = 5;
+
+   /* mask write carries and and or masks */
+   if (0x16 == function)
+   {
+      cacheRequest[5] = 0x00;
+      cacheRequest[6] = 0x00;
+      cacheRequestSize = 7;
+   }
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   return cacheSlaveCount;
+}
+
+/** \brief Send a request of id to gateway and get server routed
+ **
+ ** \param[in] hModbusGW handler of gateway
+ ** \param[in] id id of request
+ ** \return handler of server which receives the request, -1 if none
+ **/
+static int32_t tst_route(int32_t hModbusGW, uint8_t id)
+{
+   routeId = id;
+   routeHandler = -1;
+   routeCount = 0;
+   transportRecvMsgCount = 0;
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_EQUAL(1, transportRecvMsgCount);
+   TEST_ASSERT_TRUE(1 >= routeCount);
+
+   return routeHandler;
+}
+
 /*==================[external functions definition]==========================*/
 /** \brief set Up function
  **
@@ -100,6 +688,20 @@ void setUp(void)
 
    /* set stub callback */
    ciaaPOSIX_memset_StubWithCallback(memset_stub);
+   ciaaPOSIX_memcpy_StubWithCallback(memcpy_stub);
+
+   /* transports ready to send */
+   ciaaModbus_transportTxReady_IgnoreAndReturn(true);
+
+   /* transports with work */
+   ciaaModbus_transportPending_IgnoreAndReturn(true);
+
+   /* ignore calls reactorPoll */
+   ciaaModbus_reactorPoll_Ignore();
+
+   transportRecvMsgCount = 0;
+
+   transportSendMsgCount = 0;
 
    /* init gateway module */
    ciaaModbus_gatewayInit();
@@ -210,6 +812,42 @@ void test_ciaaModbus_gatewayAddTransport_05(void)
    TEST_ASSERT_EQUAL(-1, ret);
 }
 
+/** \brief Test ciaaModbus_gatewayRemoveTransport
+ **
+ ** The response to a request of a transport removed is not sent to the
+ ** next client, its request is sent once the response is discarded.
+ **
+ **/
+void test_ciaaModbus_gatewayRemoveTransport_01(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = tst_mergeOpen(0x03, 0, 10, 10, 20);
+
+   /* read of client 0 sent, response delayed */
+   mergeServerHold = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(0, mergeServerReq[2]);
+
+   /* server kept busy */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayRemoveTransport(hModbusGW, 0));
+   TEST_ASSERT_FALSE(ciaaModbus_gatewayIdle(hModbusGW));
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+
+   /* response discarded, then read of client 1 sent and answered */
+   mergeServerHold = false;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(2, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(10, mergeServerReq[2]);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(0, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[1]);
+}
+
 /** \brief Test ciaaModbus_gatewayAddSlave
  **
  **/
@@ -260,6 +898,856 @@ void test_ciaaModbus_gatewayAddSlave_03(void)
    TEST_ASSERT_EQUAL(-1, ret);
 }
 
+/** \brief Test ciaaModbus_gatewayAddSlave
+ **
+ ** Slaves are added up to CIAA_MODBUS_GATEWAY_TOTAL_SERVERS.
+ **
+ **/
+void test_ciaaModbus_gatewayAddSlave_04(void)
+{
+   int32_t hModbusGW;
+   int32_t loopi;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_GATEWAY_TOTAL_SERVERS ; loopi++)
+   {
+      ciaaModbus_slaveGetId_ExpectAndReturn(loopi, loopi + 1);
+      TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayAddSlave(hModbusGW, loopi));
+   }
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayAddSlave(hModbusGW, loopi));
+
+   TEST_ASSERT_TRUE(ciaaModbus_gatewayRamSize >
+         (CIAA_MODBUS_GATEWAY_TOTAL_CLIENTS * 256));
+}
+
+/** \brief Test ciaaModbus_gatewayMainTask
+ **
+ ** All the requests pending in a client transport are processed in the
+ ** same call and the transport task is performed once.
+ **
+ **/
+void test_ciaaModbus_gatewayMainTask_01(void)
+{
+   int32_t hModbusGW;
+   int32_t hModbusTransport = 0;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+
+   ciaaModbus_transportGetType_ExpectAndReturn(hModbusTransport, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, hModbusTransport);
+
+   ciaaModbus_transportTask_Expect(hModbusTransport);
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_PIPELINED);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveSendMsg_Ignore();
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_EQUAL(3, transportRecvMsgCount);
+   TEST_ASSERT_EQUAL(3, transportSendMsgCount);
+}
+
+/** \brief Test ciaaModbus_gatewayMainTask
+ **
+ ** No request is received from a client transport which can not send
+ ** the response.
+ **
+ **/
+void test_ciaaModbus_gatewayMainTask_02(void)
+{
+   int32_t hModbusGW;
+   int32_t hModbusTransport = 0;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_transportGetType_ExpectAndReturn(hModbusTransport, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, hModbusTransport);
+
+   /* transmission queue of client transport full */
+   ciaaModbus_transportTxReady_IgnoreAndReturn(false);
+   ciaaModbus_transportTask_Expect(hModbusTransport);
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_PIPELINED);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_EQUAL(0, transportRecvMsgCount);
+}
+
+/** \brief Test ciaaModbus_gatewayMainTask
+ **
+ ** Client transports without work are not visited and the gateway is
+ ** idle.
+ **
+ **/
+void test_ciaaModbus_gatewayMainTask_03(void)
+{
+   int32_t hModbusGW;
+   int32_t hModbusTransport = 0;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_transportGetType_ExpectAndReturn(hModbusTransport, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, hModbusTransport);
+
+   /* nothing received, task and recvMsg not called */
+   ciaaModbus_transportPending_IgnoreAndReturn(false);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_TRUE(ciaaModbus_gatewayIdle(hModbusGW));
+
+   /* data pending */
+   ciaaModbus_transportPending_IgnoreAndReturn(true);
+   ciaaModbus_transportTask_Expect(hModbusTransport);
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_PIPELINED);
+
+   TEST_ASSERT_FALSE(ciaaModbus_gatewayIdle(hModbusGW));
+
+   ciaaModbus_transportTxReady_IgnoreAndReturn(false);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+}
+
+/** \brief Test queue of servers
+ **
+ ** Clients waiting a busy server are served in arrival order, and the
+ ** next request is sent in the same call the response is received.
+ **
+ **/
+void test_ciaaModbus_gatewayQueue_01(void)
+{
+   int32_t hModbusGW;
+   int32_t loopi;
+   uint8_t order[] = {1, 2, 0};
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+
+   for (loopi = 0 ; loopi < 3 ; loopi++)
+   {
+      ciaaModbus_transportGetType_ExpectAndReturn(loopi, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+      ciaaModbus_gatewayAddTransport(hModbusGW, loopi);
+   }
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_QUEUE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_QUEUE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_QUEUE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_QUEUE);
+
+   /* client 1 arrives first, then client 2 and client 0 */
+   queueRequestTick[0] = 3;
+   queueRequestTick[1] = 1;
+   queueRequestTick[2] = 2;
+   queueSentCount = 0;
+   queueResponseCount = 0;
+
+   for (queueTick = 1 ; queueTick <= 5 ; queueTick++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+
+   /* third request sent with the second response */
+   TEST_ASSERT_EQUAL(3, queueSentCount);
+   TEST_ASSERT_EQUAL(2, queueResponseCount);
+
+   for ( ; queueTick <= 8 ; queueTick++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+
+   TEST_ASSERT_EQUAL(3, queueResponseCount);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(order, queueSent, 3);
+   for (loopi = 0 ; loopi < 3 ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(order[loopi], queueResponse[loopi]);
+   }
+}
+
+/** \brief Run three clients of same server with priorities
+ **
+ ** Client 1 arrives first and is sent at once, then client 2 and
+ ** client 0 wait the server.
+ **
+ ** \param[in] priority priority of each client transport
+ ** \param[in] fcnPriority priority of reads of holding registers
+ ** \param[in] aging aging of requests (milliseconds)
+ ** \param[in] order expected order of requests sent
+ **/
+static void tst_priority(uint8_t *priority, uint8_t fcnPriority,
+      uint32_t aging, uint8_t *order)
+{
+   int32_t hModbusGW;
+   int32_t loopi;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+
+   for (loopi = 0 ; loopi < 3 ; loopi++)
+   {
+      ciaaModbus_transportGetType_ExpectAndReturn(loopi, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+      ciaaModbus_gatewayAddTransport(hModbusGW, loopi);
+      TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetTransportPriority(hModbusGW, loopi, priority[loopi]));
+   }
+
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetFunctionPriority(hModbusGW, 0x03, fcnPriority));
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetPriorityAging(hModbusGW, aging));
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_QUEUE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_QUEUE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_QUEUE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_QUEUE);
+
+   queueRequestTick[0] = 3;
+   queueRequestTick[1] = 1;
+   queueRequestTick[2] = 2;
+   queueSentCount = 0;
+   queueResponseCount = 0;
+
+   for (queueTick = 1 ; queueTick <= 8 ; queueTick++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+
+   TEST_ASSERT_EQUAL(3, queueResponseCount);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(order, queueSent, 3);
+}
+
+/** \brief Test priority of clients
+ **
+ ** The request of highest priority is sent first.
+ **
+ **/
+void test_ciaaModbus_gatewayPriority_01(void)
+{
+   int32_t hModbusGW;
+   uint8_t priority[] = {2, 0, 0};
+   uint8_t order[] = {1, 0, 2};
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   /* invalid parameters */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewaySetTransportPriority(hModbusGW, 0, 2));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewaySetFunctionPriority(hModbusGW, 0x03, 8));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewaySetFunctionPriority(hModbusGW, 0x83, 1));
+
+   ciaaModbus_gatewayInit();
+
+   tst_priority(priority, 0, 0, order);
+}
+
+/** \brief Test priority of functions
+ **
+ ** The function raises the priority of the clients below it, requests
+ ** of the same priority keep their arrival order.
+ **
+ **/
+void test_ciaaModbus_gatewayPriority_02(void)
+{
+   uint8_t priority[] = {1, 0, 0};
+   uint8_t order[] = {1, 2, 0};
+
+   tst_priority(priority, 1, 0, order);
+}
+
+/** \brief Test aging of priority
+ **
+ ** A request of lower priority queued earlier reaches the priority of a
+ ** later one and keeps its arrival order.
+ **
+ **/
+void test_ciaaModbus_gatewayPriority_03(void)
+{
+   uint8_t priority[] = {1, 0, 0};
+   uint8_t orderNoAging[] = {1, 0, 2};
+   uint8_t orderAging[] = {1, 2, 0};
+
+   tst_priority(priority, 0, 0, orderNoAging);
+
+   ciaaModbus_gatewayInit();
+
+   tst_priority(priority, 0, CIAA_MODBUS_TIME_BASE, orderAging);
+}
+
+/** \brief Run a client of large reads and three of small reads of the
+ ** same slave
+ **
+ ** \param[in] quantum quantum of deficit round robin (bytes)
+ **/
+static void tst_drr(uint16_t quantum)
+{
+   int32_t hModbusGW;
+   int32_t loopi;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+
+   for (loopi = 0 ; loopi < 4 ; loopi++)
+   {
+      ciaaModbus_transportGetType_ExpectAndReturn(loopi, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+      ciaaModbus_gatewayAddTransport(hModbusGW, loopi);
+      drrQuantity[loopi] = 1;
+      drrRequest[loopi] = false;
+      drrResponseCount[loopi] = 0;
+   }
+
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetQuantum(hModbusGW, quantum));
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_DRR);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_DRR);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_DRR);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_DRR);
+
+   /* 209 bytes by request and response of client 0, 11 of others */
+   drrQuantity[0] = 100;
+
+   for (loopi = 0 ; loopi < 96 ; loopi++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+}
+
+/** \brief Test deficit round robin
+ **
+ ** In arrival order the clients take turns and the client of large reads
+ ** takes most of the link. By deficit round robin each client of small
+ ** reads sends a request by round, and the client of large reads one
+ ** each 11 rounds.
+ **
+ **/
+void test_ciaaModbus_gatewayDrr_01(void)
+{
+   tst_drr(0);
+
+   TEST_ASSERT_EQUAL(19, drrResponseCount[0]);
+   TEST_ASSERT_EQUAL(19, drrResponseCount[1]);
+   TEST_ASSERT_EQUAL(19, drrResponseCount[2]);
+   TEST_ASSERT_EQUAL(19, drrResponseCount[3]);
+
+   ciaaModbus_gatewayInit();
+
+   tst_drr(20);
+
+   TEST_ASSERT_EQUAL(3, drrResponseCount[0]);
+   TEST_ASSERT_EQUAL(23, drrResponseCount[1]);
+   TEST_ASSERT_EQUAL(23, drrResponseCount[2]);
+   TEST_ASSERT_EQUAL(22, drrResponseCount[3]);
+}
+
+/** \brief Test cache of gateway
+ **
+ ** Reads are answered from cache until a write of the same registers.
+ **
+ **/
+void test_ciaaModbus_gatewayCache_01(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_CACHE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_CACHE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_CACHE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_CACHE);
+
+   cacheSlaveCount = 0;
+   cacheResponseCount = 0;
+
+   /* reads not cached without time to live */
+   TEST_ASSERT_EQUAL(1, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(2, tst_cache(hModbusGW, 0x03, 0x0010));
+
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetCacheTtl(hModbusGW, 2, 1000));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewaySetCacheTtl(-1, 2, 1000));
+
+   /* second read answered from cache */
+   TEST_ASSERT_EQUAL(3, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(3, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(4, cacheResponseCount);
+   TEST_ASSERT_EQUAL(3, cacheResponse[3]);
+
+   /* input registers kept apart */
+   TEST_ASSERT_EQUAL(4, tst_cache(hModbusGW, 0x04, 0x0010));
+   TEST_ASSERT_EQUAL(4, tst_cache(hModbusGW, 0x04, 0x0010));
+
+   /* entries cached at different times */
+   usleep(2000);
+
+   /* write of other register keeps entry */
+   TEST_ASSERT_EQUAL(5, tst_cache(hModbusGW, 0x06, 0x0012));
+   TEST_ASSERT_EQUAL(5, tst_cache(hModbusGW, 0x03, 0x0010));
+
+   /* write of register read invalidates entry */
+   TEST_ASSERT_EQUAL(6, tst_cache(hModbusGW, 0x06, 0x0010));
+   TEST_ASSERT_EQUAL(7, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(7, cacheResponse[3]);
+   TEST_ASSERT_EQUAL(7, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(7, cacheResponse[3]);
+
+   /* mask write of register read invalidates entry */
+   TEST_ASSERT_EQUAL(8, tst_cache(hModbusGW, 0x16, 0x0010));
+   TEST_ASSERT_EQUAL(9, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(9, cacheResponse[3]);
+   TEST_ASSERT_EQUAL(9, tst_cache(hModbusGW, 0x03, 0x0010));
+
+   /* entry closest to expire replaced when cache full */
+   TEST_ASSERT_EQUAL(10, tst_cache(hModbusGW, 0x03, 0x0011));
+   TEST_ASSERT_EQUAL(10, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(11, tst_cache(hModbusGW, 0x04, 0x0010));
+}
+
+/** \brief Test cache of gateway
+ **
+ ** Entries expire after the time to live.
+ **
+ **/
+void test_ciaaModbus_gatewayCache_02(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_CACHE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_CACHE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_CACHE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_CACHE);
+
+   cacheSlaveCount = 0;
+   cacheResponseCount = 0;
+
+   /* time to live of two time bases */
+   ciaaModbus_gatewaySetCacheTtl(hModbusGW, 2, 2 * CIAA_MODBUS_TIME_BASE);
+
+   TEST_ASSERT_EQUAL(1, tst_cache(hModbusGW, 0x03, 0x0010));
+   TEST_ASSERT_EQUAL(1, tst_cache(hModbusGW, 0x03, 0x0010));
+
+   /* a valid entry does not keep the gateway awake */
+   ciaaModbus_transportPending_IgnoreAndReturn(false);
+   TEST_ASSERT_TRUE(ciaaModbus_gatewayIdle(hModbusGW));
+   ciaaModbus_transportPending_IgnoreAndReturn(true);
+
+   /* expired while sleeping, without main task calls */
+   usleep(2 * CIAA_MODBUS_TIME_BASE * 1000);
+   TEST_ASSERT_EQUAL(2, tst_cache(hModbusGW, 0x03, 0x0010));
+
+   /* disabling time to live discards entries */
+   ciaaModbus_gatewaySetCacheTtl(hModbusGW, 2, 0);
+   TEST_ASSERT_EQUAL(3, tst_cache(hModbusGW, 0x03, 0x0010));
+}
+
+/** \brief Test coalescing of reads
+ **
+ ** The same read received from two clients is sent once to the server
+ ** and its response is sent to both clients.
+ **
+ **/
+void test_ciaaModbus_gatewayCoalesce_01(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+   ciaaModbus_transportGetType_ExpectAndReturn(1, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 1);
+   ciaaModbus_transportGetType_ExpectAndReturn(5, CIAAMODBUS_TRANSPORT_TYPE_MASTER);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 5);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_COALESCE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_COALESCE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+
+   coalesceServerRecvCount = 0;
+   coalesceServerSendCount = 0;
+   coalesceResponseCount[0] = 0;
+   coalesceResponseCount[1] = 0;
+
+   /* both requests received in the same call */
+   coalesceRequest[0] = true;
+   coalesceRequest[1] = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_EQUAL(1, coalesceServerSendCount);
+   TEST_ASSERT_EQUAL(1, coalesceResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, coalesceResponseCount[1]);
+
+   /* request received after the response is sent again */
+   coalesceRequest[1] = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   TEST_ASSERT_EQUAL(2, coalesceServerSendCount);
+   TEST_ASSERT_EQUAL(1, coalesceResponseCount[0]);
+   TEST_ASSERT_EQUAL(2, coalesceResponseCount[1]);
+}
+
+/** \brief Test merge of reads
+ **
+ ** Adjacent reads of registers are sent in one request once the
+ ** batching window elapses, and sent apart if it fails.
+ **
+ **/
+void test_ciaaModbus_gatewayMerge_01(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = tst_mergeOpen(0x03, 0, 10, 10, 20);
+
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewaySetMergeWindow(hModbusGW, 2 * CIAA_MODBUS_TIME_BASE));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewaySetMergeWindow(-1, 0));
+
+   /* reads wait the batching window */
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(0, mergeServerSendCount);
+
+   /* one request of registers 0 to 29 */
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(0, mergeServerReq[2]);
+   TEST_ASSERT_EQUAL(30, mergeServerReq[4]);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[1]);
+
+   /* exception of merged request: reads sent apart */
+   mergeRequest[0] = true;
+   mergeRequest[1] = true;
+   mergeException = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+
+   /* merged request, then each read */
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(4, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(20, mergeServerReq[4]);
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[1]);
+}
+
+/** \brief Test merge of reads
+ **
+ ** Overlapping reads of coils are merged and the bits of each response
+ ** are taken from the merged one. Reads are not merged if disabled.
+ **
+ **/
+void test_ciaaModbus_gatewayMerge_02(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = tst_mergeOpen(0x01, 8, 12, 3, 7);
+
+   ciaaModbus_gatewaySetMergeWindow(hModbusGW, 1);
+
+   /* one request of coils 3 to 19 */
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(3, mergeServerReq[2]);
+   TEST_ASSERT_EQUAL(17, mergeServerReq[4]);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[1]);
+
+   /* merge disabled */
+   ciaaModbus_gatewaySetMergeWindow(hModbusGW, 0);
+   mergeRequest[0] = true;
+   mergeRequest[1] = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(3, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[1]);
+}
+
+/** \brief Test merge of reads
+ **
+ ** A read equal to the merged request sent is not answered with the part
+ ** of the first client, it is sent once the merged request is answered.
+ **
+ **/
+void test_ciaaModbus_gatewayMerge_03(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = tst_mergeOpen(0x03, 0, 10, 10, 20);
+
+   ciaaModbus_transportGetType_ExpectAndReturn(2, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 2);
+
+   ciaaModbus_gatewaySetMergeWindow(hModbusGW, 1);
+
+   /* one request of registers 0 to 29, response delayed */
+   mergeServerHold = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(30, mergeServerReq[4]);
+
+   /* read of registers 0 to 29 received while waiting the response */
+   mergeStart[2] = 0;
+   mergeQuantity[2] = 30;
+   mergeRequest[2] = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+
+   /* merged response split, then the read is sent and answered */
+   mergeServerHold = false;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[1]);
+
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(2, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(0, mergeServerReq[2]);
+   TEST_ASSERT_EQUAL(30, mergeServerReq[4]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[2]);
+}
+
+/** \brief Test merge of reads
+ **
+ ** A read coalesced with a read later merged is released when the merged
+ ** request times out or its client is removed.
+ **
+ **/
+void test_ciaaModbus_gatewayMerge_04(void)
+{
+   int32_t hModbusGW;
+   int32_t loopi;
+
+   hModbusGW = tst_mergeOpen(0x03, 0, 10, 10, 20);
+
+   ciaaModbus_transportGetType_ExpectAndReturn(2, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 2);
+
+   ciaaModbus_gatewaySetMergeWindow(hModbusGW, 2 * CIAA_MODBUS_TIME_BASE);
+
+   /* read of client 2 waits the one of client 1, then merged */
+   mergeStart[2] = 10;
+   mergeQuantity[2] = 20;
+   mergeRequest[2] = true;
+   mergeServerHold = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(1, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(30, mergeServerReq[4]);
+
+   /* merged request times out */
+   for (loopi = 0 ; loopi < 400 ; loopi++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+   mergeServerPending = false;
+   mergeServerHold = false;
+
+   /* each client is able to read again */
+   mergeRequest[0] = true;
+   mergeRequest[1] = true;
+   mergeRequest[2] = true;
+   for (loopi = 0 ; loopi < 8 ; loopi++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[0]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[1]);
+   TEST_ASSERT_EQUAL(1, mergeResponseCount[2]);
+
+   /* same reads, client of merged request removed */
+   mergeRequest[0] = true;
+   mergeRequest[1] = true;
+   mergeRequest[2] = true;
+   mergeServerHold = true;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(3, mergeServerSendCount);
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayRemoveTransport(hModbusGW, 0));
+
+   /* response of removed client dropped */
+   for (loopi = 0 ; loopi < 400 ; loopi++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+   mergeServerPending = false;
+   mergeServerHold = false;
+
+   mergeRequest[1] = true;
+   mergeRequest[2] = true;
+   for (loopi = 0 ; loopi < 8 ; loopi++)
+   {
+      ciaaModbus_gatewayMainTask(hModbusGW);
+   }
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[1]);
+   TEST_ASSERT_EQUAL(2, mergeResponseCount[2]);
+}
+
+/** \brief Test route table of gateway
+ **
+ ** Requests are routed to the slave with the same id, else to the
+ ** transport master.
+ **
+ **/
+void test_ciaaModbus_gatewayRoute_01(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   /* no server: request dropped */
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_ROUTE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_ROUTE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_ROUTE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_ROUTE);
+
+   TEST_ASSERT_EQUAL(-1, tst_route(hModbusGW, 2));
+
+   /* slave id 2 and transport master */
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+   ciaaModbus_transportGetType_ExpectAndReturn(1, CIAAMODBUS_TRANSPORT_TYPE_MASTER);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 1);
+
+   TEST_ASSERT_EQUAL(1, tst_route(hModbusGW, 5));
+}
+
+/** \brief Test route table of gateway
+ **
+ ** Servers removed are no longer routed and their requests in course
+ ** are dropped.
+ **
+ **/
+void test_ciaaModbus_gatewayRoute_02(void)
+{
+   int32_t hModbusGW;
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   ciaaModbus_transportGetType_ExpectAndReturn(0, CIAAMODBUS_TRANSPORT_TYPE_SLAVE);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 0);
+   ciaaModbus_transportGetType_ExpectAndReturn(1, CIAAMODBUS_TRANSPORT_TYPE_MASTER);
+   ciaaModbus_gatewayAddTransport(hModbusGW, 1);
+   ciaaModbus_slaveGetId_ExpectAndReturn(0x11223344, 2);
+   ciaaModbus_gatewayAddSlave(hModbusGW, 0x11223344);
+
+   ciaaModbus_transportTask_Ignore();
+   ciaaModbus_transportRecvMsg_StubWithCallback(ciaaModbus_transportRecvMsg_CALLBACK_ROUTE);
+   ciaaModbus_transportSendMsg_StubWithCallback(ciaaModbus_transportSendMsg_CALLBACK_ROUTE);
+   ciaaModbus_transportGetRespTimeout_IgnoreAndReturn(300);
+   ciaaModbus_slaveTask_Ignore();
+   ciaaModbus_slaveRecvMsg_StubWithCallback(ciaaModbus_slaveRecvMsg_CALLBACK_ROUTE);
+   ciaaModbus_slaveSendMsg_StubWithCallback(ciaaModbus_slaveSendMsg_CALLBACK_ROUTE);
+
+   /* slave id 2 takes precedence over transport master */
+   TEST_ASSERT_EQUAL(0x11223344, tst_route(hModbusGW, 2));
+
+   /* remove slave: request in course dropped, id 2 routed to transport */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayRemoveSlave(hModbusGW, 0x11223344));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayRemoveSlave(hModbusGW, 0x11223344));
+   TEST_ASSERT_EQUAL(1, tst_route(hModbusGW, 2));
+
+   /* remove transport master: no server */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayRemoveTransport(hModbusGW, 1));
+   TEST_ASSERT_EQUAL(-1, tst_route(hModbusGW, 2));
+
+   /* remove transport slave: no request received */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayRemoveTransport(hModbusGW, 0));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayRemoveTransport(hModbusGW, 0));
+   transportRecvMsgCount = 0;
+   ciaaModbus_gatewayMainTask(hModbusGW);
+   TEST_ASSERT_EQUAL(0, transportRecvMsgCount);
+}
+
+/** \brief Test gateway run by its own thread
+ **
+ ** The gateway shall be opened and a waiter available, and is started
+ ** and stopped once.
+ **
+ **/
+void test_ciaaModbus_gatewayStart_01(void)
+{
+   int32_t hModbusGW;
+
+   /* invalid handler or gateway not opened */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStart(-1, -1));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStart(0, -1));
+
+   hModbusGW = ciaaModbus_gatewayOpen();
+
+   /* no waiter available */
+   ciaaModbus_reactorWaiterOpen_ExpectAndReturn(-1);
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStart(hModbusGW, -1));
+
+   /* not running */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStop(hModbusGW));
+
+   /* idle gateway sleeps on the waiter */
+   ciaaModbus_reactorWaiterOpen_ExpectAndReturn(1);
+   ciaaModbus_reactorWaiterBind_Ignore();
+   ciaaModbus_reactorWaiterWait_Ignore();
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayStart(hModbusGW, -1));
+
+   /* already running */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStart(hModbusGW, -1));
+
+   /* checked from another thread while running */
+   TEST_ASSERT_TRUE(ciaaModbus_gatewayIdle(hModbusGW));
+
+   ciaaModbus_reactorWakeup_Expect();
+   ciaaModbus_reactorWaiterClose_Expect(1);
+   TEST_ASSERT_EQUAL(0, ciaaModbus_gatewayStop(hModbusGW));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_gatewayStop(hModbusGW));
+}
 
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
@@ -0,0 +1,222 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_loopback.h"
+#include "mock_ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "string.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   ciaaModbus_loopbackInit();
+
+   ciaaModbus_reactorWakeup_Ignore();
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+}
+
+void doNothing(void)
+{
+}
+
+/** \brief Test ciaaModbus_loopbackMasterOpen and
+ ** ciaaModbus_loopbackSlaveOpen
+ **
+ **/
+void test_ciaaModbus_loopbackOpen_01(void)
+{
+   int32_t loopi;
+
+   /* open both ends of all channels */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(loopi, ciaaModbus_loopbackMasterOpen(loopi));
+      TEST_ASSERT_EQUAL(loopi, ciaaModbus_loopbackSlaveOpen(loopi));
+   }
+
+   /* ends already opened */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_loopbackMasterOpen(0));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_loopbackSlaveOpen(0));
+
+   /* invalid channels */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_loopbackMasterOpen(-1));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_loopbackSlaveOpen(CIAA_MODBUS_TOTAL_TRANSPORT_LOOPBACK));
+}
+
+/** \brief Test request and response through a channel
+ **
+ **/
+void test_ciaaModbus_loopbackSendMsg_01(void)
+{
+   int32_t hMaster;
+   int32_t hSlave;
+   uint8_t request[] = {0x03, 0x00, 0x10, 0x00, 0x02};
+   uint8_t response[] = {0x03, 0x04, 0x11, 0x22, 0x33, 0x44};
+   uint8_t pdu[256];
+   uint8_t id;
+   uint32_t size;
+
+   hMaster = ciaaModbus_loopbackMasterOpen(1);
+   hSlave = ciaaModbus_loopbackSlaveOpen(1);
+
+   /* nothing received */
+   TEST_ASSERT_FALSE(ciaaModbus_loopbackSlavePending(hSlave));
+   ciaaModbus_loopbackSlaveRecvMsg(hSlave, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* request from master to slave end */
+   ciaaModbus_loopbackMasterSendMsg(hMaster, 0x11, request, sizeof(request));
+   ciaaModbus_loopbackTask(hSlave);
+
+   TEST_ASSERT_TRUE(ciaaModbus_loopbackSlavePending(hSlave));
+   TEST_ASSERT_FALSE(ciaaModbus_loopbackMasterPending(hMaster));
+
+   /* not received by the master end */
+   ciaaModbus_loopbackMasterRecvMsg(hMaster, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   ciaaModbus_loopbackSlaveRecvMsg(hSlave, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0x11, id);
+   TEST_ASSERT_EQUAL(sizeof(request), size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(request, pdu, sizeof(request));
+   TEST_ASSERT_FALSE(ciaaModbus_loopbackSlavePending(hSlave));
+
+   /* response from slave to master end */
+   ciaaModbus_loopbackSlaveSendMsg(hSlave, 0x11, response, sizeof(response));
+   ciaaModbus_loopbackTask(hMaster);
+
+   ciaaModbus_loopbackMasterRecvMsg(hMaster, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0x11, id);
+   TEST_ASSERT_EQUAL(sizeof(response), size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(response, pdu, sizeof(response));
+
+   /* channel empty */
+   ciaaModbus_loopbackMasterRecvMsg(hMaster, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+   TEST_ASSERT_FALSE(ciaaModbus_loopbackMasterPending(hMaster));
+}
+
+/** \brief Test messages are queued in order and discarded when full
+ **
+ **/
+void test_ciaaModbus_loopbackSendMsg_02(void)
+{
+   int32_t hMaster;
+   int32_t hSlave;
+   uint8_t pdu[256];
+   uint8_t id;
+   uint32_t size;
+   int32_t loopi;
+
+   hMaster = ciaaModbus_loopbackMasterOpen(0);
+   hSlave = ciaaModbus_loopbackSlaveOpen(0);
+
+   /* one more message than queue length */
+   for (loopi = 0 ; loopi <= CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH ; loopi++)
+   {
+      pdu[0] = 0x03;
+      pdu[1] = loopi;
+      ciaaModbus_loopbackMasterSendMsg(hMaster, loopi, pdu, 2);
+   }
+
+   /* queue full */
+   TEST_ASSERT_FALSE(ciaaModbus_loopbackMasterTxReady(hMaster));
+   TEST_ASSERT_TRUE(ciaaModbus_loopbackSlaveTxReady(hSlave));
+
+   /* queued messages received in order */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH ; loopi++)
+   {
+      ciaaModbus_loopbackSlaveRecvMsg(hSlave, &id, pdu, &size);
+      TEST_ASSERT_EQUAL(loopi, id);
+      TEST_ASSERT_EQUAL(2, size);
+      TEST_ASSERT_EQUAL(loopi, pdu[1]);
+   }
+
+   /* last message discarded */
+   ciaaModbus_loopbackSlaveRecvMsg(hSlave, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+   TEST_ASSERT_TRUE(ciaaModbus_loopbackMasterTxReady(hMaster));
+
+   /* positions wrap around the queue */
+   for (loopi = 0 ; loopi < (3 * CIAA_MODBUS_LOOPBACK_QUEUE_LENGTH) ; loopi++)
+   {
+      pdu[1] = loopi;
+      ciaaModbus_loopbackMasterSendMsg(hMaster, loopi, pdu, 2);
+      ciaaModbus_loopbackSlaveRecvMsg(hSlave, &id, pdu, &size);
+      TEST_ASSERT_EQUAL(loopi, id);
+      TEST_ASSERT_EQUAL(2, size);
+   }
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
@@ -0,0 +1,335 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_reactor.h"
+#include "ciaaModbus_Cfg.h"
+#include "string.h"
+#include <time.h>
+#include <unistd.h>
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief pipes of the test, read end is index 0 */
+static int tst_pipe[2][2];
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   TEST_ASSERT_EQUAL_INT(0, pipe(tst_pipe[0]));
+   TEST_ASSERT_EQUAL_INT(0, pipe(tst_pipe[1]));
+
+   ciaaModbus_reactorInit();
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+   close(tst_pipe[0][0]);
+   close(tst_pipe[0][1]);
+   close(tst_pipe[1][0]);
+   close(tst_pipe[1][1]);
+}
+
+void doNothing(void)
+{
+}
+
+/** \brief test ciaaModbus_reactorReady
+ ** only registered file descriptors with data pending are ready */
+void test_ciaaModbus_reactorReady_01(void)
+{
+   uint8_t data = 0x3A;
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+
+   /* read on each task until polled */
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   /* not registered, always ready */
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[1][0]));
+
+   /* data pending */
+   TEST_ASSERT_EQUAL_INT(1, write(tst_pipe[0][1], &data, 1));
+
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   /* reported again while not read */
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   TEST_ASSERT_EQUAL_INT(1, read(tst_pipe[0][0], &data, 1));
+
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+}
+
+/** \brief test ciaaModbus_reactorAdd
+ ** invalid file descriptors */
+void test_ciaaModbus_reactorAdd_01(void)
+{
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorAdd(-1));
+
+   /* not a valid file descriptor */
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorAdd(CIAA_MODBUS_REACTOR_MAX_FDS - 1));
+
+   /* registered twice */
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+
+   /* unregistered: always ready and registered again */
+   ciaaModbus_reactorPoll();
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   ciaaModbus_reactorRemove(tst_pipe[0][0]);
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+}
+
+/** \brief test ciaaModbus_reactorNext
+ ** only the registered file descriptors ready are visited */
+void test_ciaaModbus_reactorNext_01(void)
+{
+   uint8_t data = 0x3A;
+   int32_t low = (tst_pipe[0][0] < tst_pipe[1][0]) ? tst_pipe[0][0] : tst_pipe[1][0];
+   int32_t high = (tst_pipe[0][0] < tst_pipe[1][0]) ? tst_pipe[1][0] : tst_pipe[0][0];
+
+   /* nothing registered */
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorNext(-1));
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[1][0]));
+
+   /* all visited until polled */
+   TEST_ASSERT_EQUAL_INT(low, ciaaModbus_reactorNext(-1));
+   TEST_ASSERT_EQUAL_INT(high, ciaaModbus_reactorNext(low));
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorNext(high));
+
+   ciaaModbus_reactorPoll();
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorNext(-1));
+
+   /* only the one with data pending */
+   TEST_ASSERT_EQUAL_INT(1, write(tst_pipe[1][1], &data, 1));
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_EQUAL_INT(tst_pipe[1][0], ciaaModbus_reactorNext(-1));
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorNext(tst_pipe[1][0]));
+
+   /* not visited once unregistered */
+   ciaaModbus_reactorRemove(tst_pipe[1][0]);
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorNext(-1));
+}
+
+
+/** \brief test ciaaModbus_reactorWait
+ ** wait returns on data pending or wake up, not waiting the timeout */
+void test_ciaaModbus_reactorWait_01(void)
+{
+   uint8_t data = 0x3A;
+   time_t start;
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+
+   /* data pending */
+   TEST_ASSERT_EQUAL_INT(1, write(tst_pipe[0][1], &data, 1));
+
+   start = time(NULL);
+
+   ciaaModbus_reactorWait(5000);
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   TEST_ASSERT_EQUAL_INT(1, read(tst_pipe[0][0], &data, 1));
+
+   /* woken up without data pending */
+   ciaaModbus_reactorWakeup();
+
+   ciaaModbus_reactorWait(5000);
+
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   /* timeout */
+   ciaaModbus_reactorWait(10);
+
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   TEST_ASSERT_TRUE(2 > (time(NULL) - start));
+}
+
+/** \brief test ciaaModbus_reactorWaiterWait
+ ** a wake up reaches all waiters, even not waiting yet */
+void test_ciaaModbus_reactorWaiter_01(void)
+{
+   uint8_t data = 0x3A;
+   int32_t hWaiter[2];
+   time_t start;
+
+   hWaiter[0] = ciaaModbus_reactorWaiterOpen();
+   hWaiter[1] = ciaaModbus_reactorWaiterOpen();
+
+   TEST_ASSERT_EQUAL_INT(0, hWaiter[0]);
+   TEST_ASSERT_EQUAL_INT(1, hWaiter[1]);
+
+   /* no waiter available */
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_reactorWaiterOpen());
+
+   /* registered with the waiter of the test thread */
+   ciaaModbus_reactorWaiterBind(hWaiter[1]);
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+
+   start = time(NULL);
+
+   /* woken up before waiting */
+   ciaaModbus_reactorWakeup();
+
+   ciaaModbus_reactorWaiterWait(hWaiter[0], 5000);
+   ciaaModbus_reactorWaiterWait(hWaiter[1], 5000);
+
+   /* data pending */
+   TEST_ASSERT_EQUAL_INT(1, write(tst_pipe[0][1], &data, 1));
+
+   ciaaModbus_reactorWaiterWait(hWaiter[1], 5000);
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   TEST_ASSERT_EQUAL_INT(1, read(tst_pipe[0][0], &data, 1));
+
+   /* timeout */
+   ciaaModbus_reactorWaiterWait(hWaiter[0], 10);
+
+   TEST_ASSERT_TRUE(2 > (time(NULL) - start));
+
+   /* closed waiter available again */
+   ciaaModbus_reactorWaiterClose(hWaiter[0]);
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorWaiterOpen());
+}
+
+/** \brief test waiters only woken up by their file descriptors
+ **
+ ** this function test a file descriptor registered by a thread not bound
+ ** moving to the waiter checking it, and not waking up other waiters
+ **
+ **/
+void test_ciaaModbus_reactorWaiter_02(void)
+{
+   uint8_t data = 0x3A;
+   int32_t hWaiter[2];
+   struct timespec start;
+   struct timespec stop;
+
+   hWaiter[0] = ciaaModbus_reactorWaiterOpen();
+   hWaiter[1] = ciaaModbus_reactorWaiterOpen();
+
+   /* registered by a thread not bound */
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_reactorAdd(tst_pipe[0][0]));
+
+   /* data pending */
+   TEST_ASSERT_EQUAL_INT(1, write(tst_pipe[0][1], &data, 1));
+
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   /* checked by the waiter 1, read once while moving */
+   ciaaModbus_reactorWaiterBind(hWaiter[1]);
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   /* the waiter 0 is not woken up by the file descriptor */
+   (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+   ciaaModbus_reactorWaiterWait(hWaiter[0], 200);
+
+   (void)clock_gettime(CLOCK_MONOTONIC, &stop);
+
+   TEST_ASSERT_TRUE(150 <= ( (stop.tv_sec - start.tv_sec) * 1000 +
+                             (stop.tv_nsec - start.tv_nsec) / 1000000 ));
+
+   /* the waiter 1 is */
+   ciaaModbus_reactorWaiterWait(hWaiter[1], 5000);
+
+   TEST_ASSERT_TRUE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   TEST_ASSERT_EQUAL_INT(1, read(tst_pipe[0][0], &data, 1));
+
+   ciaaModbus_reactorPoll();
+
+   TEST_ASSERT_FALSE(ciaaModbus_reactorReady(tst_pipe[0][0]));
+
+   ciaaModbus_reactorRemove(tst_pipe[0][0]);
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
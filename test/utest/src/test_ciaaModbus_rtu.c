@@ -0,0 +1,497 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_rtu.h"
+#include "ciaaModbus_Cfg.h"
+#include "string.h"
+#include "mock_ciaaPOSIX_stdio.h"
+#include "mock_ciaaModbus_reactor.h"
+
+/*==================[macros and definitions]=================================*/
+/** \brief Type for the stub read function */
+typedef struct {
+   uint8_t buf[10][300];   /** <= data returned in each call */
+   int32_t len[10];        /** <= count of bytes returned in each call */
+   int32_t total;          /** <= calls returning data */
+   int32_t count;          /** <= count of calls */
+} readStubType;
+
+/** \brief Type for the stub write function */
+typedef struct {
+   uint8_t buf[10][300];
+   int32_t len[10];
+   int32_t count;
+} writeStubType;
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+static readStubType read_stub;
+
+static writeStubType write_stub;
+
+/** \brief frames reported by the framer */
+static struct {
+   int32_t count;
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+} framer_cb;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   /* all ports with data pending */
+   ciaaModbus_reactorReady_IgnoreAndReturn(true);
+
+   memset(&read_stub, 0, sizeof(read_stub));
+   memset(&write_stub, 0, sizeof(write_stub));
+
+   framer_cb.count = 0;
+
+   ciaaModbus_rtuInit();
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+}
+
+void doNothing(void)
+{
+}
+
+/**** Helper Functions ****/
+
+/** \brief framer callback, stores the last frame */
+static void tst_framerCb(void *param, uint8_t id, uint8_t *pdu, uint32_t size)
+{
+   TEST_ASSERT_EQUAL_PTR(&framer_cb, param);
+
+   framer_cb.count++;
+   framer_cb.id = id;
+   memcpy(framer_cb.pdu, pdu, size);
+   framer_cb.size = size;
+}
+
+/** \brief Add a call returning data to the read stub */
+static void tst_readAdd(uint8_t const *data, int32_t len)
+{
+   memcpy(read_stub.buf[read_stub.total], data, len);
+   read_stub.len[read_stub.total] = len;
+   read_stub.total++;
+}
+
+ssize_t ciaaPOSIX_read_stub(int32_t fildes, void * buf, size_t nbyte, int cmock_num_calls)
+{
+   ssize_t ret = 0;
+
+   /* return the data of this call, nothing once all returned */
+   if (read_stub.count < read_stub.total)
+   {
+      ret = read_stub.len[read_stub.count];
+
+      TEST_ASSERT_TRUE(nbyte >= ret);
+
+      memcpy(buf, read_stub.buf[read_stub.count], ret);
+   }
+
+   read_stub.count++;
+
+   return ret;
+}
+
+ssize_t ciaaPOSIX_write_stub(int32_t fildes, void const * buf, size_t nbyte, int cmock_num_calls)
+{
+   memcpy(write_stub.buf[write_stub.count], buf, nbyte);
+   write_stub.len[write_stub.count] = nbyte;
+   write_stub.count++;
+
+   return nbyte;
+}
+
+/**** Tests ****/
+
+/** \brief test ciaaModbus_rtuCrc16
+ ** known values, low byte sent first */
+void test_ciaaModbus_rtuCrc16_01(void)
+{
+   uint8_t msg[2][8] =
+   {
+      {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD},
+      {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87},
+   };
+
+   TEST_ASSERT_EQUAL_HEX16(0xCDC5, ciaaModbus_rtuCrc16(msg[0], 6));
+   TEST_ASSERT_EQUAL_HEX16(0x8776, ciaaModbus_rtuCrc16(msg[1], 6));
+
+   /* crc of a frame including its crc is 0 */
+   TEST_ASSERT_EQUAL_HEX16(0x0000, ciaaModbus_rtuCrc16(msg[0], 8));
+   TEST_ASSERT_EQUAL_HEX16(0x0000, ciaaModbus_rtuCrc16(msg[1], 8));
+}
+
+/** \brief test ciaaModbus_rtuFramerEnd
+ ** frame fed in chunks */
+void test_ciaaModbus_rtuFramerEnd_01(void)
+{
+   ciaaModbus_rtuFramerType framer;
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   int32_t ret;
+
+   ciaaModbus_rtuFramerInit(&framer, tst_framerCb, &framer_cb);
+
+   ciaaModbus_rtuFramerFeed(&framer, msg, 3);
+   ciaaModbus_rtuFramerFeed(&framer, &msg[3], 5);
+
+   ret = ciaaModbus_rtuFramerEnd(&framer);
+
+   TEST_ASSERT_EQUAL_INT(1, ret);
+   TEST_ASSERT_EQUAL_INT(1, framer_cb.count);
+   TEST_ASSERT_EQUAL_UINT8(0x11, framer_cb.id);
+   TEST_ASSERT_EQUAL_INT(5, framer_cb.size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(&msg[1], framer_cb.pdu, 5);
+
+   /* no frame after the silent interval */
+   ret = ciaaModbus_rtuFramerEnd(&framer);
+
+   TEST_ASSERT_EQUAL_INT(0, ret);
+   TEST_ASSERT_EQUAL_INT(1, framer_cb.count);
+}
+
+/** \brief test ciaaModbus_rtuFramerEnd
+ ** invalid crc, too short and too long frames */
+void test_ciaaModbus_rtuFramerEnd_02(void)
+{
+   ciaaModbus_rtuFramerType framer;
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x88};
+   uint8_t noise[300];
+   int32_t ret;
+
+   memset(noise, 0, sizeof(noise));
+
+   ciaaModbus_rtuFramerInit(&framer, tst_framerCb, &framer_cb);
+
+   /* invalid crc */
+   ciaaModbus_rtuFramerFeed(&framer, msg, 8);
+   ret = ciaaModbus_rtuFramerEnd(&framer);
+
+   /* too short */
+   ciaaModbus_rtuFramerFeed(&framer, msg, 3);
+   ret += ciaaModbus_rtuFramerEnd(&framer);
+
+   /* too long */
+   ciaaModbus_rtuFramerFeed(&framer, noise, 300);
+   ret += ciaaModbus_rtuFramerEnd(&framer);
+
+   TEST_ASSERT_EQUAL_INT(0, ret);
+   TEST_ASSERT_EQUAL_INT(0, framer_cb.count);
+}
+
+/** \brief test ciaaModbus_rtuRecvMsg
+ ** frame received at the end of the silent interval */
+void test_ciaaModbus_rtuRecvMsg_01(void)
+{
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+   int32_t hModbusRtu;
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   tst_readAdd(msg, 4);
+   tst_readAdd(&msg[4], 4);
+
+   hModbusRtu = ciaaModbus_rtuOpen(1);
+
+   /* receive the frame in two calls */
+   ciaaModbus_rtuTask(hModbusRtu);
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(0, size);
+
+   /* silent interval */
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_UINT8(0x11, id);
+   TEST_ASSERT_EQUAL_INT(5, size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(&msg[1], pdu, 5);
+
+   /* frame read once */
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(0, size);
+}
+
+/** \brief test ciaaModbus_rtuRecvMsg
+ ** silent interval of a low baud rate */
+void test_ciaaModbus_rtuRecvMsg_02(void)
+{
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+   int32_t hModbusRtu;
+   int32_t loopi;
+   int32_t ticks;
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   tst_readAdd(msg, 8);
+
+   hModbusRtu = ciaaModbus_rtuOpen(1);
+
+   ciaaModbus_rtuSetBaudRate(hModbusRtu, 1200);
+   ticks = ciaaModbus_rtuSilenceTicks(1200);
+
+   /* receive the frame */
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   /* not ended before the silent interval */
+   for (loopi = 0 ; loopi < (ticks - 1) ; loopi++)
+   {
+      ciaaModbus_rtuTask(hModbusRtu);
+   }
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(0, size);
+
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(5, size);
+}
+
+/** \brief test ciaaModbus_rtuTask
+ ** port without data pending is not read but ends the frame */
+void test_ciaaModbus_rtuTask_01(void)
+{
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+   int32_t hModbusRtu;
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   tst_readAdd(msg, 8);
+
+   hModbusRtu = ciaaModbus_rtuOpen(1);
+
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   /* no data pending */
+   ciaaModbus_reactorReady_IgnoreAndReturn(false);
+
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(1, read_stub.count);
+   TEST_ASSERT_EQUAL_INT(5, size);
+}
+
+/** \brief reactor stub, data pending in the file descriptor 9 of the host,
+ ** 8 registered without data and -1 not registered */
+static bool ciaaModbus_reactorReady_stub(int32_t fildes, int cmock_num_calls)
+{
+   return ( (9 == fildes) || (0 > fildes) );
+}
+
+/** \brief test ciaaModbus_rtuTask
+ ** the reactor checks the file descriptor of the host, not the ciaaPOSIX
+ ** one */
+void test_ciaaModbus_rtuTask_02(void)
+{
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   int32_t hModbusRtu;
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+   ciaaModbus_reactorReady_StubWithCallback(ciaaModbus_reactorReady_stub);
+
+   tst_readAdd(msg, 8);
+
+   /* ciaaPOSIX file descriptor with the number of other registered one */
+   hModbusRtu = ciaaModbus_rtuOpen(8);
+
+   /* file descriptor of the host not known: always read */
+   TEST_ASSERT_TRUE(ciaaModbus_rtuPending(hModbusRtu));
+
+   ciaaModbus_rtuSetHostFd(hModbusRtu, 9);
+
+   TEST_ASSERT_TRUE(ciaaModbus_rtuPending(hModbusRtu));
+
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   TEST_ASSERT_EQUAL_INT(1, read_stub.count);
+}
+
+/** \brief test ciaaModbus_rtuPending
+ ** work pending until the frame received is read */
+void test_ciaaModbus_rtuPending_01(void)
+{
+   uint8_t msg[] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03, 0x76, 0x87};
+   uint8_t id;
+   uint8_t pdu[256];
+   uint32_t size;
+   int32_t hModbusRtu;
+
+   ciaaPOSIX_read_StubWithCallback(ciaaPOSIX_read_stub);
+
+   tst_readAdd(msg, 8);
+
+   hModbusRtu = ciaaModbus_rtuOpen(1);
+
+   /* data pending */
+   TEST_ASSERT_TRUE(ciaaModbus_rtuPending(hModbusRtu));
+
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   /* no data pending, silent interval running */
+   ciaaModbus_reactorReady_IgnoreAndReturn(false);
+
+   TEST_ASSERT_TRUE(ciaaModbus_rtuPending(hModbusRtu));
+
+   /* frame received */
+   ciaaModbus_rtuTask(hModbusRtu);
+
+   TEST_ASSERT_TRUE(ciaaModbus_rtuPending(hModbusRtu));
+
+   ciaaModbus_rtuRecvMsg(hModbusRtu, &id, pdu, &size);
+
+   TEST_ASSERT_EQUAL_INT(5, size);
+   TEST_ASSERT_FALSE(ciaaModbus_rtuPending(hModbusRtu));
+}
+
+/** \brief test ciaaModbus_rtuSilenceTicks */
+void test_ciaaModbus_rtuSilenceTicks_01(void)
+{
+   /* 3.5 characters of 11 bits rounded up to task calls */
+   TEST_ASSERT_EQUAL_INT((38500000 / 1200 + CIAA_MODBUS_TIME_BASE * 1000 - 1) /
+                         (CIAA_MODBUS_TIME_BASE * 1000),
+                         ciaaModbus_rtuSilenceTicks(1200));
+
+   /* fixed 1750 us above 19200 bps and if baud rate unknown */
+   TEST_ASSERT_EQUAL_INT(ciaaModbus_rtuSilenceTicks(0),
+                         ciaaModbus_rtuSilenceTicks(921600));
+   TEST_ASSERT_EQUAL_INT(ciaaModbus_rtuSilenceTicks(38400),
+                         ciaaModbus_rtuSilenceTicks(921600));
+
+   /* at least one call */
+   TEST_ASSERT_TRUE(1 <= ciaaModbus_rtuSilenceTicks(921600));
+   TEST_ASSERT_TRUE(ciaaModbus_rtuSilenceTicks(1200) >
+                    ciaaModbus_rtuSilenceTicks(19200));
+}
+
+/** \brief test ciaaModbus_rtuSendMsg */
+void test_ciaaModbus_rtuSendMsg_01(void)
+{
+   uint8_t msg[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+   int32_t hModbusRtu;
+
+   ciaaPOSIX_write_StubWithCallback(ciaaPOSIX_write_stub);
+
+   hModbusRtu = ciaaModbus_rtuOpen(1);
+
+   TEST_ASSERT_TRUE(ciaaModbus_rtuTxReady(hModbusRtu));
+
+   ciaaModbus_rtuSendMsg(hModbusRtu, msg[0], &msg[1], 5);
+
+   TEST_ASSERT_EQUAL_INT(1, write_stub.count);
+   TEST_ASSERT_EQUAL_INT(8, write_stub.len[0]);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(msg, write_stub.buf[0], 8);
+   TEST_ASSERT_TRUE(ciaaModbus_rtuTxReady(hModbusRtu));
+}
+
+/** \brief test function Open
+ **
+ ** this function call open more times than allowed
+ **
+ **/
+void test_ciaaModbus_rtuOpen_01(void)
+{
+   int32_t loopi;
+   int32_t hModbusRtu[CIAA_MODBUS_TOTAL_TRANSPORT_RTU+1];
+
+   for (loopi = 0 ; loopi < (CIAA_MODBUS_TOTAL_TRANSPORT_RTU+1) ; loopi++)
+   {
+      hModbusRtu[loopi] = ciaaModbus_rtuOpen(0);
+   }
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_RTU ; loopi++)
+   {
+      TEST_ASSERT_NOT_EQUAL(-1, hModbusRtu[loopi]);
+   }
+
+   TEST_ASSERT_EQUAL(-1, hModbusRtu[loopi]);
+}
+
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
@@ -0,0 +1,211 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_serial.h"
+#include "ciaaModbus_Cfg.h"
+#include "mock_ciaaPOSIX_stdio.h"
+#include "string.h"
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+/*==================[macros and definitions]=================================*/
+/** \brief ciaaPOSIX file descriptor of the port of the test */
+#define TST_FILDES         5
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief master and slave of the pseudo terminal of the test */
+static int tst_master;
+static int tst_slave;
+
+/** \brief configuration of the test */
+static ciaaModbus_serialConfigType tst_config;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   TEST_ASSERT_EQUAL_INT(0, openpty(&tst_master, &tst_slave, NULL, NULL, NULL));
+
+   tst_config.baudRate = 921600;
+   tst_config.dataBits = 8;
+   tst_config.parity = CIAAMODBUS_SERIAL_PARITY_EVEN;
+   tst_config.stopBits = 1;
+   tst_config.vmin = 0;
+   tst_config.vtime = 0;
+   tst_config.lowLatency = true;
+   tst_config.hostFd = tst_slave;
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+   close(tst_slave);
+   close(tst_master);
+}
+
+void doNothing(void)
+{
+}
+
+/** \brief test ciaaModbus_serialConfig
+ ** configuration applied with termios to the file descriptor of the host */
+void test_ciaaModbus_serialConfig_01(void)
+{
+   struct termios tio;
+
+   /* low latency not supported by pseudo terminals, ignored */
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+
+   TEST_ASSERT_EQUAL_INT(0, tcgetattr(tst_slave, &tio));
+   TEST_ASSERT_EQUAL(B921600, cfgetospeed(&tio));
+   TEST_ASSERT_EQUAL(0, tio.c_cflag & CSTOPB);
+   TEST_ASSERT_EQUAL(0, tio.c_lflag & (ICANON | ECHO));
+   TEST_ASSERT_EQUAL(0, tio.c_cc[VMIN]);
+   TEST_ASSERT_EQUAL(0, tio.c_cc[VTIME]);
+
+   /* pseudo terminals force 8 bits without parity, only stop bits are
+    * checked */
+   tst_config.baudRate = 9600;
+   tst_config.dataBits = 7;
+   tst_config.parity = CIAAMODBUS_SERIAL_PARITY_ODD;
+   tst_config.stopBits = 2;
+
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+
+   TEST_ASSERT_EQUAL_INT(0, tcgetattr(tst_slave, &tio));
+   TEST_ASSERT_EQUAL(B9600, cfgetospeed(&tio));
+   TEST_ASSERT_EQUAL(CSTOPB, tio.c_cflag & CSTOPB);
+}
+
+/** \brief test ciaaModbus_serialConfig
+ ** invalid configurations */
+void test_ciaaModbus_serialConfig_02(void)
+{
+   int fildes[2];
+
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(TST_FILDES, NULL));
+
+   /* baud rate too high and not supported */
+   tst_config.baudRate = 1000000;
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+   tst_config.baudRate = 1000;
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+
+   /* invalid character format */
+   tst_config.baudRate = 9600;
+   tst_config.stopBits = 3;
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+
+   /* not a serial port */
+   tst_config.stopBits = 1;
+   TEST_ASSERT_EQUAL_INT(0, pipe(fildes));
+   tst_config.hostFd = fildes[0];
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(TST_FILDES, &tst_config));
+   close(fildes[0]);
+   close(fildes[1]);
+}
+
+/** \brief test ciaaModbus_serialConfig
+ ** without file descriptor of the host only the baud rate is set through
+ ** ciaaPOSIX, the descriptor is not used as one of the host */
+void test_ciaaModbus_serialConfig_03(void)
+{
+   struct termios tio;
+   struct termios tioBefore;
+
+   TEST_ASSERT_EQUAL_INT(0, tcgetattr(tst_slave, &tioBefore));
+
+   tst_config.hostFd = -1;
+   tst_config.baudRate = 19200;
+   tst_config.parity = CIAAMODBUS_SERIAL_PARITY_NONE;
+
+   /* baud rate set by the driver */
+   ciaaPOSIX_ioctl_ExpectAndReturn(
+         tst_slave,
+         ciaaPOSIX_IOCTL_SET_BAUDRATE,
+         (void*)19200,
+         0);
+   TEST_ASSERT_EQUAL_INT(0, ciaaModbus_serialConfig(tst_slave, &tst_config));
+
+   /* same number of the pseudo terminal, not configured with termios */
+   TEST_ASSERT_EQUAL_INT(0, tcgetattr(tst_slave, &tio));
+   TEST_ASSERT_EQUAL(cfgetospeed(&tioBefore), cfgetospeed(&tio));
+
+   /* error of the driver */
+   ciaaPOSIX_ioctl_ExpectAndReturn(
+         tst_slave,
+         ciaaPOSIX_IOCTL_SET_BAUDRATE,
+         (void*)19200,
+         -1);
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(tst_slave, &tst_config));
+
+   /* character format of the driver not configurable */
+   tst_config.parity = CIAAMODBUS_SERIAL_PARITY_EVEN;
+   TEST_ASSERT_EQUAL_INT(-1, ciaaModbus_serialConfig(tst_slave, &tst_config));
+}
+
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
@@ -0,0 +1,307 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_shm.h"
+#include "ciaaModbus_Cfg.h"
+#include "mock_ciaaPOSIX_string.h"
+#include "mock_ciaaModbus_reactor.h"
+#include "string.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief shared memory object of the test */
+static int32_t tst_fildes;
+
+/** \brief handler of the transport */
+static int32_t hModbusShm;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static void * memset_stub(void * s, int c, size_t n, int cmock_num_calls)
+{
+   return memset(s, c, n);
+}
+
+/** \brief send a response after a delay */
+static void * tst_sendDelayed(void * param)
+{
+   uint8_t pdu[] = {0x03, 0x02, 0x12, 0x34};
+
+   usleep(20000);
+
+   ciaaModbus_shmSendMsg(hModbusShm, 0x05, pdu, sizeof(pdu));
+
+   return NULL;
+}
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   /* set stub callback */
+   ciaaPOSIX_memset_StubWithCallback(memset_stub);
+
+   ciaaModbus_reactorAdd_IgnoreAndReturn(0);
+
+   ciaaModbus_shmInit();
+
+   tst_fildes = memfd_create("tst_ciaaModbus_shm", 0);
+
+   hModbusShm = ciaaModbus_shmOpen(tst_fildes);
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+   close(tst_fildes);
+}
+
+void doNothing(void)
+{
+}
+
+/** \brief Test ciaaModbus_shmOpen and ciaaModbus_shmPeerMap
+ **
+ **/
+void test_ciaaModbus_shmOpen_01(void)
+{
+   int32_t fildes;
+
+   TEST_ASSERT_NOT_EQUAL(-1, hModbusShm);
+   TEST_ASSERT_NOT_NULL(ciaaModbus_shmPeerMap(tst_fildes, -1));
+
+   /* not initialized by the stack */
+   fildes = memfd_create("tst_ciaaModbus_shm_2", 0);
+   TEST_ASSERT_NULL(ciaaModbus_shmPeerMap(fildes, -1));
+
+   /* no more objects */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_shmOpen(fildes));
+
+   close(fildes);
+}
+
+/** \brief Test messages between peer and stack
+ **
+ **/
+void test_ciaaModbus_shmRecvMsg_01(void)
+{
+   ciaaModbus_shmSegmentType *segment;
+   uint8_t request[] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t response[] = {0x03, 0x02, 0x12, 0x34};
+   uint8_t pdu[256];
+   uint8_t id;
+   uint32_t size;
+
+   segment = ciaaModbus_shmPeerMap(tst_fildes, -1);
+
+   /* nothing received */
+   ciaaModbus_shmRecvMsg(hModbusShm, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* request from peer */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_shmPeerSendMsg(segment, 0x05, request, sizeof(request)));
+
+   ciaaModbus_reactorReady_ExpectAndReturn(ciaaModbus_shmGetEvent(hModbusShm), false);
+   ciaaModbus_shmTask(hModbusShm);
+   ciaaModbus_shmRecvMsg(hModbusShm, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0x05, id);
+   TEST_ASSERT_EQUAL(sizeof(request), size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(request, pdu, sizeof(request));
+
+   /* response to peer */
+   ciaaModbus_shmSendMsg(hModbusShm, 0x05, response, sizeof(response));
+
+   ciaaModbus_shmPeerRecvMsg(segment, &id, pdu, &size, 0);
+   TEST_ASSERT_EQUAL(0x05, id);
+   TEST_ASSERT_EQUAL(sizeof(response), size);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(response, pdu, sizeof(response));
+
+   /* nothing more */
+   ciaaModbus_shmPeerRecvMsg(segment, &id, pdu, &size, 0);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* size corrupted by peer: message discarded */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_shmPeerSendMsg(segment, 0x06, request, sizeof(request)));
+   segment->toStack.msg[(segment->toStack.tail - 1) &
+      (CIAAMODBUS_SHM_QUEUE_LENGTH - 1)].size = CIAAMODBUS_SHM_PDU_MAXLENGTH + 1;
+   TEST_ASSERT_EQUAL(0, ciaaModbus_shmPeerSendMsg(segment, 0x07, request, sizeof(request)));
+
+   ciaaModbus_shmRecvMsg(hModbusShm, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   ciaaModbus_shmRecvMsg(hModbusShm, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0x07, id);
+   TEST_ASSERT_EQUAL(sizeof(request), size);
+}
+
+/** \brief Test ciaaModbus_shmPending
+ **
+ ** A message of the peer signals the event and keeps the transport pending
+ ** until received.
+ **
+ **/
+void test_ciaaModbus_shmPending_01(void)
+{
+   ciaaModbus_shmSegmentType *segment;
+   uint8_t pdu[256] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t id;
+   uint32_t size;
+   int32_t event;
+   struct pollfd fds;
+
+   event = ciaaModbus_shmGetEvent(hModbusShm);
+   TEST_ASSERT_TRUE(0 <= event);
+
+   segment = ciaaModbus_shmPeerMap(tst_fildes, event);
+
+   fds.fd = event;
+   fds.events = POLLIN;
+
+   /* nothing sent */
+   ciaaModbus_reactorReady_ExpectAndReturn(event, false);
+   TEST_ASSERT_FALSE(ciaaModbus_shmPending(hModbusShm));
+   TEST_ASSERT_EQUAL(0, poll(&fds, 1, 0));
+
+   /* message of peer signals the event */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_shmPeerSendMsg(segment, 0x05, pdu, 5));
+   TEST_ASSERT_EQUAL(1, poll(&fds, 1, 0));
+   TEST_ASSERT_TRUE(ciaaModbus_shmPending(hModbusShm));
+
+   /* task consumes the wake up */
+   ciaaModbus_reactorReady_ExpectAndReturn(event, true);
+   ciaaModbus_shmTask(hModbusShm);
+   TEST_ASSERT_EQUAL(0, poll(&fds, 1, 0));
+
+   /* pending until received */
+   TEST_ASSERT_TRUE(ciaaModbus_shmPending(hModbusShm));
+   ciaaModbus_shmRecvMsg(hModbusShm, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   ciaaModbus_reactorReady_ExpectAndReturn(event, false);
+   TEST_ASSERT_FALSE(ciaaModbus_shmPending(hModbusShm));
+}
+
+/** \brief Test ciaaModbus_shmTxReady
+ **
+ **/
+void test_ciaaModbus_shmTxReady_01(void)
+{
+   ciaaModbus_shmSegmentType *segment;
+   uint8_t pdu[256] = {0x03, 0x02, 0x12, 0x34};
+   uint8_t id;
+   uint32_t size;
+   int32_t loopi;
+
+   segment = ciaaModbus_shmPeerMap(tst_fildes, -1);
+
+   for (loopi = 0 ; loopi < CIAAMODBUS_SHM_QUEUE_LENGTH ; loopi++)
+   {
+      TEST_ASSERT_TRUE(ciaaModbus_shmTxReady(hModbusShm));
+      ciaaModbus_shmSendMsg(hModbusShm, loopi, pdu, 4);
+   }
+
+   /* ring full */
+   TEST_ASSERT_FALSE(ciaaModbus_shmTxReady(hModbusShm));
+
+   /* peer receives the first message */
+   ciaaModbus_shmPeerRecvMsg(segment, &id, pdu, &size, 0);
+   TEST_ASSERT_EQUAL(0, id);
+   TEST_ASSERT_TRUE(ciaaModbus_shmTxReady(hModbusShm));
+}
+
+/** \brief Test ciaaModbus_shmPeerRecvMsg
+ **
+ ** The peer waits until the message is sent or the timeout expires.
+ **
+ **/
+void test_ciaaModbus_shmPeerRecvMsg_01(void)
+{
+   ciaaModbus_shmSegmentType *segment;
+   pthread_t thread;
+   uint8_t pdu[256];
+   uint8_t id;
+   uint32_t size;
+
+   segment = ciaaModbus_shmPeerMap(tst_fildes, -1);
+
+   /* timeout */
+   ciaaModbus_shmPeerRecvMsg(segment, &id, pdu, &size, 10);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* woken up by the message */
+   pthread_create(&thread, NULL, tst_sendDelayed, NULL);
+
+   ciaaModbus_shmPeerRecvMsg(segment, &id, pdu, &size, 1000);
+
+   pthread_join(thread, NULL);
+
+   TEST_ASSERT_EQUAL(0x05, id);
+   TEST_ASSERT_EQUAL(4, size);
+   TEST_ASSERT_EQUAL(0x34, pdu[3]);
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
+
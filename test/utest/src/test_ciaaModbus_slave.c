@@ -1499,6 +1499,60 @@ void test_ciaaModbus_function0x17Msg_01(void)
 
 
 
+/** \brief test response in place
+ **
+ ** this function test receive the response in the buffer sent
+ **
+ **/
+void test_ciaaModbus_inPlace_01(void)
+{
+   uint8_t pdu[256] = {0x03, 0x00, 0x10, 0x00, 0x02};
+   uint8_t pduExpected[256] = {0x03, 0x04, 0x12, 0x34, 0x56, 0x78};
+   uint8_t id;
+   uint32_t size;
+
+   const ciaaModbus_slaveCmd_type callbacksStruct =
+   {
+      NULL,
+      NULL,
+      cmd0x03ReadHoldingReg,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+   };
+
+   valueHoldReg[0x0010] = 0x1234;
+   valueHoldReg[0x0011] = 0x5678;
+
+   /* open modbus slave */
+   hModbusSlave = ciaaModbus_slaveOpen(&callbacksStruct, SLAVE_ID);
+
+   /* send, task and recv with the same buffer */
+   ciaaModbus_slaveSendMsg(
+         hModbusSlave,
+         SLAVE_ID,
+         pdu,
+         5);
+
+   ciaaModbus_slaveTask(hModbusSlave);
+
+   ciaaModbus_slaveRecvMsg(
+         hModbusSlave,
+         &id,
+         pdu,
+         &size);
+
+   /* verify */
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(
+         pduExpected,
+         pdu,
+         6);
+   TEST_ASSERT_EQUAL_UINT8(SLAVE_ID, id);
+   TEST_ASSERT_EQUAL_UINT32(6, size);
+}
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /*==================[end of file]============================================*/
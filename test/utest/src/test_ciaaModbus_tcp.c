@@ -0,0 +1,1189 @@
+/* Copyright 2015, ACSE & CADIEEL
+ *    ACSE   : http://www.sase.com.ar/asociacion-civil-sistemas-embebidos/ciaa/
+ *    CADIEEL: http://www.cadieel.org.ar
+ *
+ * This file is part of CIAA Firmware.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/** \brief This file implements the test of the modbus library
+ **
+ **/
+
+/** \addtogroup CIAA_Firmware CIAA Firmware
+ ** @{ */
+/** \addtogroup Modbus CIAA Modbus
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+#include "unity.h"
+#include "ciaaModbus_tcp.h"
+#include "ciaaModbus_Cfg.h"
+#include "ciaaModbus.h"
+#include "mock_ciaaPOSIX_string.h"
+#include "mock_ciaaModbus_reactor.h"
+#include "string.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+/** \brief listening socket */
+static int32_t listenFd;
+
+/** \brief client socket */
+static int32_t clientFd;
+
+/** \brief file descriptors reported as pending by the reactor */
+static bool tst_ready;
+
+/** \brief file descriptors pending visited by ciaaModbus_reactorNext */
+static bool tst_next;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+static void * memset_stub(void * s, int c, size_t n, int cmock_num_calls)
+{
+   return memset(s, c, n);
+}
+
+static bool reactorReady_stub(int32_t fildes, int cmock_num_calls)
+{
+   return tst_ready;
+}
+
+static int32_t reactorNext_stub(int32_t fildes, int cmock_num_calls)
+{
+   int32_t ret = -1;
+   int32_t loopi;
+
+   /* next open file descriptor */
+   for (loopi = fildes + 1 ;
+        (tst_ready) && (tst_next) && (0 > ret) && (loopi < CIAA_MODBUS_REACTOR_MAX_FDS) ;
+        loopi++)
+   {
+      if (-1 != fcntl(loopi, F_GETFD))
+      {
+         ret = loopi;
+      }
+   }
+
+   return ret;
+}
+
+/** \brief Write a read holding registers request in buffer
+ **
+ ** \param[out] buf buffer to store the request
+ ** \param[in] transactionId transaction identifier of the request
+ ** \return length of the request
+ **/
+static int32_t tst_request(uint8_t *buf, uint16_t transactionId)
+{
+   uint8_t request[] =
+   {
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x02,
+      0x03, 0x00, 0x10, 0x00, 0x01,
+   };
+
+   memcpy(buf, request, sizeof(request));
+
+   buf[0] = transactionId >> 8;
+   buf[1] = transactionId & 0xFF;
+
+   return sizeof(request);
+}
+
+/** \brief Open a listening socket and connect a client to it */
+static void tst_connect(void)
+{
+   struct sockaddr_in addr;
+   socklen_t len = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+
+   listenFd = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(0 == bind(listenFd, (struct sockaddr *)&addr, len));
+   TEST_ASSERT_TRUE(0 == listen(listenFd, 4));
+   TEST_ASSERT_TRUE(0 == getsockname(listenFd, (struct sockaddr *)&addr, &len));
+
+   clientFd = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(0 == connect(clientFd, (struct sockaddr *)&addr, len));
+}
+
+/** \brief Connect a new client to the listening socket
+ **
+ ** \return socket of the client
+ **/
+static int32_t tst_connectClient(void)
+{
+   struct sockaddr_in addr;
+   socklen_t len = sizeof(addr);
+   int32_t fildes;
+
+   TEST_ASSERT_TRUE(0 == getsockname(listenFd, (struct sockaddr *)&addr, &len));
+
+   fildes = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(0 == connect(fildes, (struct sockaddr *)&addr, len));
+
+   return fildes;
+}
+
+/** \brief Open a listening socket
+ **
+ ** \return port of the listening socket
+ **/
+static uint16_t tst_listen(void)
+{
+   struct sockaddr_in addr;
+   socklen_t len = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+
+   listenFd = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(0 == bind(listenFd, (struct sockaddr *)&addr, len));
+   TEST_ASSERT_TRUE(0 == listen(listenFd, 4));
+   TEST_ASSERT_TRUE(0 == getsockname(listenFd, (struct sockaddr *)&addr, &len));
+
+   return ntohs(addr.sin_port);
+}
+
+/** \brief Perform master task until a message is received
+ **
+ ** \param[in] hModbusTcp handler of modbus tcp master
+ ** \param[out] pdu buffer to store the pdu
+ ** \return size of the pdu received
+ **/
+static uint32_t tst_masterWaitMsg(int32_t hModbusTcp, uint8_t *pdu)
+{
+   uint8_t id;
+   uint32_t size = 0;
+   int32_t loopi;
+
+   for (loopi = 0 ; (loopi < 100) && (0 == size) ; loopi++)
+   {
+      usleep(5000);
+      ciaaModbus_tcpMasterTask(hModbusTcp);
+      ciaaModbus_tcpMasterRecvMsg(hModbusTcp, &id, pdu, &size);
+   }
+
+   return size;
+}
+
+/*==================[external functions definition]==========================*/
+/** \brief set Up function
+ **
+ ** This function is called before each test case is executed
+ **
+ **/
+void setUp(void)
+{
+   listenFd = -1;
+   clientFd = -1;
+
+   /* set stub callback */
+   ciaaPOSIX_memset_StubWithCallback(memset_stub);
+
+   /* all the sockets are read unless a test says otherwise */
+   tst_ready = true;
+   tst_next = true;
+   ciaaModbus_reactorReady_StubWithCallback(reactorReady_stub);
+   ciaaModbus_reactorNext_StubWithCallback(reactorNext_stub);
+   ciaaModbus_reactorAdd_IgnoreAndReturn(0);
+   ciaaModbus_reactorRemove_Ignore();
+
+   ciaaModbus_tcpInit();
+}
+
+/** \brief tear Down function
+ **
+ ** This function is called after each test case is executed
+ **
+ **/
+void tearDown(void)
+{
+   if (0 <= clientFd)
+   {
+      close(clientFd);
+   }
+
+   if (0 <= listenFd)
+   {
+      close(listenFd);
+   }
+}
+
+void doNothing(void)
+{
+}
+
+/** \brief test ciaaModbus_tcp_checkCompleteMsg
+ **
+ **/
+void test_ciaaModbus_tcp_checkCompleteMsg_01(void)
+{
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 2];
+   int32_t len;
+
+   len = tst_request(buf, 0x1234);
+
+   /* incomplete header */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_tcp_checkCompleteMsg(buf, 5));
+
+   /* incomplete pdu */
+   TEST_ASSERT_EQUAL(0, ciaaModbus_tcp_checkCompleteMsg(buf, len - 1));
+
+   /* complete message */
+   TEST_ASSERT_EQUAL(len, ciaaModbus_tcp_checkCompleteMsg(buf, len));
+
+   /* two messages: length of the first one is returned */
+   len += tst_request(&buf[len], 0x1235);
+   TEST_ASSERT_EQUAL(12, ciaaModbus_tcp_checkCompleteMsg(buf, len));
+
+   /* invalid protocol identifier */
+   buf[3] = 0x01;
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_tcp_checkCompleteMsg(buf, len));
+
+   /* invalid length */
+   buf[3] = 0x00;
+   buf[5] = 0x01;
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_tcp_checkCompleteMsg(buf, len));
+   buf[4] = 0x01;
+   buf[5] = 0x00;
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_tcp_checkCompleteMsg(buf, len));
+}
+
+/** \brief test ciaaModbus_tcpOpen
+ **
+ ** open more servers than available and open with invalid socket
+ **
+ **/
+void test_ciaaModbus_tcpOpen_01(void)
+{
+   int32_t fildes[CIAA_MODBUS_TOTAL_TRANSPORT_TCP + 1];
+   int32_t loopi;
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_tcpOpen(-1));
+
+   for (loopi = 0 ; loopi < (CIAA_MODBUS_TOTAL_TRANSPORT_TCP + 1) ; loopi++)
+   {
+      fildes[loopi] = socket(AF_INET, SOCK_STREAM, 0);
+   }
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TOTAL_TRANSPORT_TCP ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(loopi, ciaaModbus_tcpOpen(fildes[loopi]));
+   }
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_tcpOpen(fildes[loopi]));
+
+   for (loopi = 0 ; loopi < (CIAA_MODBUS_TOTAL_TRANSPORT_TCP + 1) ; loopi++)
+   {
+      close(fildes[loopi]);
+   }
+}
+
+/** \brief test pipelined requests
+ **
+ ** all requests received in one segment are delivered after one task
+ ** and responses use the transaction identifier of each request
+ **
+ **/
+void test_ciaaModbus_tcpRecvMsg_01(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 2];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* send two requests in one segment */
+   len = tst_request(buf, 0x0101);
+   len += tst_request(&buf[len], 0x0102);
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+
+   /* wait data available */
+   usleep(10000);
+
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* first request */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+   TEST_ASSERT_EQUAL(2, id);
+   TEST_ASSERT_EQUAL_HEX8(0x03, pdu[0]);
+
+   /* response to first request */
+   pdu[1] = 0x02;
+   pdu[2] = 0x12;
+   pdu[3] = 0x34;
+   ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu, 4);
+
+   /* second request without performing task */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu, 4);
+
+   /* no more requests */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* check responses */
+   usleep(10000);
+   TEST_ASSERT_EQUAL(22, recv(clientFd, buf, sizeof(buf), 0));
+   TEST_ASSERT_EQUAL_HEX8(0x01, buf[0]);
+   TEST_ASSERT_EQUAL_HEX8(0x01, buf[1]);
+   TEST_ASSERT_EQUAL_HEX8(0x05, buf[5]);
+   TEST_ASSERT_EQUAL_HEX8(0x02, buf[6]);
+   TEST_ASSERT_EQUAL_HEX8(0x01, buf[11]);
+   TEST_ASSERT_EQUAL_HEX8(0x02, buf[12]);
+}
+
+/** \brief test budget by connection
+ **
+ ** only CIAA_MODBUS_TCP_ADU_BUDGET requests are delivered by task
+ **
+ **/
+void test_ciaaModbus_tcpRecvMsg_02(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 2];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len = 0;
+   int32_t loopi;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   for (loopi = 0 ; loopi < (CIAA_MODBUS_TCP_ADU_BUDGET + 1) ; loopi++)
+   {
+      len += tst_request(&buf[len], loopi);
+   }
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+
+   usleep(10000);
+
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_ADU_BUDGET ; loopi++)
+   {
+      ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+      TEST_ASSERT_EQUAL(5, size);
+   }
+
+   /* budget consumed */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* budget reloaded */
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+}
+
+/** \brief test invalid MBAP header
+ **
+ ** the connection is closed
+ **
+ **/
+void test_ciaaModbus_tcpRecvMsg_03(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   len = tst_request(buf, 0x0001);
+   buf[2] = 0xFF;
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+
+   usleep(10000);
+
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* connection closed by server */
+   usleep(10000);
+   TEST_ASSERT_EQUAL(0, recv(clientFd, buf, sizeof(buf), 0));
+}
+
+/** \brief test write coalescing
+ **
+ ** responses are gathered and sent together when no more requests are
+ ** pending
+ **
+ **/
+void test_ciaaModbus_tcpSendMsg_01(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 2];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   len = tst_request(buf, 0x0001);
+   len += tst_request(&buf[len], 0x0002);
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu, 4);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu, 4);
+
+   /* responses not sent yet */
+   usleep(10000);
+   TEST_ASSERT_EQUAL(-1, recv(clientFd, buf, sizeof(buf), MSG_DONTWAIT));
+
+   /* no more requests: responses sent */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   usleep(10000);
+   TEST_ASSERT_EQUAL(22, recv(clientFd, buf, sizeof(buf), MSG_DONTWAIT));
+   TEST_ASSERT_EQUAL_HEX8(0x01, buf[1]);
+   TEST_ASSERT_EQUAL_HEX8(0x02, buf[12]);
+}
+
+/** \brief test response backpressure
+ **
+ ** a client not reading its responses makes the server not ready to send,
+ ** responses already accepted are sent in order once the client reads
+ **
+ **/
+void test_ciaaModbus_tcpSendMsg_02(void)
+{
+   int32_t hModbusTcp;
+   struct sockaddr_in addr;
+   socklen_t addrLen = sizeof(addr);
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 2];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len = 0;
+   int32_t sent = 0;
+   int32_t count = 0;
+   int32_t opt = 2048;
+   int32_t loopi;
+   bool ready = true;
+
+   /* small socket buffers, filled by a few responses */
+   tst_listen();
+   TEST_ASSERT_TRUE(0 == setsockopt(listenFd, SOL_SOCKET, SO_SNDBUF, &opt, sizeof(opt)));
+   TEST_ASSERT_TRUE(0 == getsockname(listenFd, (struct sockaddr *)&addr, &addrLen));
+
+   clientFd = socket(AF_INET, SOCK_STREAM, 0);
+   TEST_ASSERT_TRUE(0 == setsockopt(clientFd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt)));
+   TEST_ASSERT_TRUE(0 == connect(clientFd, (struct sockaddr *)&addr, addrLen));
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* client sends requests but does not read responses */
+   for (loopi = 0 ; loopi < 100 ; loopi++)
+   {
+      len = tst_request(buf, loopi);
+      TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+   }
+
+   usleep(10000);
+
+   /* maximal responses until the server is not ready */
+   for (loopi = 0 ; (loopi < 200) && (ready) ; loopi++)
+   {
+      ciaaModbus_tcpTask(hModbusTcp);
+
+      ready = ciaaModbus_tcpTxReady(hModbusTcp);
+
+      if (ready)
+      {
+         ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+
+         if (0 < size)
+         {
+            ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu,
+                  CIAAMODBUS_TCP_MAXLENGTH - CIAAMODBUS_TCP_MBAP_LENGTH);
+            sent++;
+         }
+      }
+   }
+
+   TEST_ASSERT_FALSE(ready);
+   TEST_ASSERT_TRUE(100 > sent);
+
+   /* all responses received in order */
+   len = 0;
+   for (loopi = 0 ; (loopi < 200) && (sent > count) ; loopi++)
+   {
+      ciaaModbus_tcpTask(hModbusTcp);
+      usleep(1000);
+
+      size = recv(clientFd, &buf[len], CIAAMODBUS_TCP_MAXLENGTH - len, MSG_DONTWAIT);
+
+      if (0 < (int32_t)size)
+      {
+         len += size;
+      }
+
+      if (CIAAMODBUS_TCP_MAXLENGTH == len)
+      {
+         TEST_ASSERT_EQUAL(count, (buf[0] << 8) | buf[1]);
+         count++;
+         len = 0;
+      }
+   }
+
+   TEST_ASSERT_EQUAL(sent, count);
+   TEST_ASSERT_TRUE(ciaaModbus_tcpTxReady(hModbusTcp));
+}
+
+/** \brief test ciaaModbus_tcpPending
+ **
+ ** the server has work while connections are pending in the reactor, data
+ ** is received or responses are not sent
+ **
+ **/
+void test_ciaaModbus_tcpPending_01(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* connection to accept */
+   TEST_ASSERT_TRUE(ciaaModbus_tcpPending(hModbusTcp));
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* nothing pending in the reactor */
+   tst_ready = false;
+   TEST_ASSERT_FALSE(ciaaModbus_tcpPending(hModbusTcp));
+
+   /* not read while not pending */
+   len = tst_request(buf, 0x0001);
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* data read, pending until received */
+   tst_ready = true;
+   ciaaModbus_tcpTask(hModbusTcp);
+   tst_ready = false;
+   TEST_ASSERT_TRUE(ciaaModbus_tcpPending(hModbusTcp));
+
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   /* response not sent */
+   ciaaModbus_tcpSendMsg(hModbusTcp, id, pdu, 4);
+   TEST_ASSERT_TRUE(ciaaModbus_tcpPending(hModbusTcp));
+
+   /* response sent */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+   TEST_ASSERT_FALSE(ciaaModbus_tcpPending(hModbusTcp));
+}
+
+/** \brief test slab of connections
+ **
+ ** connections exceeding CIAA_MODBUS_TCP_TOTAL_CONNECTIONS are refused
+ ** and a closed connection is reused
+ **
+ **/
+void test_ciaaModbus_tcpTask_01(void)
+{
+   int32_t hModbusTcp;
+   int32_t fildes[CIAA_MODBUS_TCP_TOTAL_CONNECTIONS + 1];
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t loopi;
+   ciaaModbus_tcpStatsType stats;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* clientFd takes the first connection */
+   for (loopi = 1 ; loopi < (CIAA_MODBUS_TCP_TOTAL_CONNECTIONS + 1) ; loopi++)
+   {
+      fildes[loopi] = tst_connectClient();
+   }
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* last connection refused */
+   usleep(10000);
+   TEST_ASSERT_EQUAL(0, recv(fildes[CIAA_MODBUS_TCP_TOTAL_CONNECTIONS], buf, sizeof(buf), 0));
+   close(fildes[CIAA_MODBUS_TCP_TOTAL_CONNECTIONS]);
+
+   ciaaModbus_tcpGetStats(hModbusTcp, &stats);
+   TEST_ASSERT_EQUAL(CIAA_MODBUS_TCP_TOTAL_CONNECTIONS, stats.active);
+   TEST_ASSERT_EQUAL(1, stats.refused);
+
+   /* close a connection and connect again */
+   close(fildes[1]);
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   fildes[1] = tst_connectClient();
+   TEST_ASSERT_EQUAL(tst_request(buf, 0x0001), send(fildes[1], buf, 12, 0));
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   for (loopi = 1 ; loopi < CIAA_MODBUS_TCP_TOTAL_CONNECTIONS ; loopi++)
+   {
+      close(fildes[loopi]);
+   }
+}
+
+/** \brief test slab of buffers
+ **
+ ** connections with data pending are read when a buffer is available
+ **
+ **/
+void test_ciaaModbus_tcpTask_02(void)
+{
+   int32_t hModbusTcp;
+   int32_t fildes[CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1];
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t loopi;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   fildes[0] = clientFd;
+   for (loopi = 1 ; loopi < (CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1) ; loopi++)
+   {
+      fildes[loopi] = tst_connectClient();
+   }
+
+   /* accept connections */
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* one request by connection */
+   for (loopi = 0 ; loopi < (CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1) ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(12, send(fildes[loopi], buf, tst_request(buf, loopi), 0));
+   }
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_TOTAL_BUFFERS ; loopi++)
+   {
+      ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+      TEST_ASSERT_EQUAL(5, size);
+   }
+
+   /* no buffer was available for last connection */
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* buffers released */
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   for (loopi = 1 ; loopi < (CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1) ; loopi++)
+   {
+      close(fildes[loopi]);
+   }
+}
+
+/** \brief test idle timeout
+ **
+ ** connections without data are closed, connections with data are kept
+ **
+ **/
+void test_ciaaModbus_tcpTask_03(void)
+{
+   int32_t hModbusTcp;
+   int32_t fildes;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t loopi;
+   ciaaModbus_tcpStatsType stats;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   fildes = tst_connectClient();
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* only clientFd sends data */
+   for (loopi = 0 ; loopi < 4 ; loopi++)
+   {
+      usleep(CIAA_MODBUS_TCP_IDLE_TIMEOUT * 1000 / 2);
+      TEST_ASSERT_EQUAL(12, send(clientFd, buf, tst_request(buf, loopi), 0));
+      usleep(10000);
+      ciaaModbus_tcpTask(hModbusTcp);
+      ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   }
+
+   /* idle connection closed */
+   usleep(10000);
+   TEST_ASSERT_EQUAL(0, recv(fildes, buf, sizeof(buf), MSG_DONTWAIT));
+   close(fildes);
+
+   /* active connection kept */
+   TEST_ASSERT_EQUAL(-1, recv(clientFd, buf, sizeof(buf), MSG_DONTWAIT));
+
+   ciaaModbus_tcpGetStats(hModbusTcp, &stats);
+   TEST_ASSERT_EQUAL(1, stats.active);
+   TEST_ASSERT_EQUAL(2, stats.accepted);
+   TEST_ASSERT_EQUAL(0, stats.refused);
+   TEST_ASSERT_EQUAL(1, stats.reaped);
+   TEST_ASSERT_EQUAL(1, stats.closed);
+}
+
+/** \brief test full reception buffer
+ **
+ ** a connection whose buffer is full is not read, nor closed, until its
+ ** requests are received
+ **
+ **/
+void test_ciaaModbus_tcpTask_04(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH * 3];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+   int32_t len = 0;
+   int32_t count = 0;
+   int32_t loopi;
+   ciaaModbus_tcpStatsType stats;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* more requests than fit in the reception buffer */
+   for (loopi = 0 ; loopi < 50 ; loopi++)
+   {
+      len += tst_request(&buf[len], loopi);
+   }
+   TEST_ASSERT_EQUAL(len, send(clientFd, buf, len, 0));
+
+   /* buffer filled and full in next task */
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   ciaaModbus_tcpGetStats(hModbusTcp, &stats);
+   TEST_ASSERT_EQUAL(1, stats.active);
+   TEST_ASSERT_EQUAL(0, stats.closed);
+
+   /* all requests received in order */
+   for (loopi = 0 ; (loopi < 100) && (50 > count) ; loopi++)
+   {
+      ciaaModbus_tcpTask(hModbusTcp);
+
+      do
+      {
+         ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+
+         if (0 < size)
+         {
+            count++;
+         }
+      }while (0 < size);
+   }
+
+   TEST_ASSERT_EQUAL(50, count);
+}
+
+/** \brief test frame timeout
+ **
+ ** connections holding part of a frame are closed, even if they keep
+ ** sending data, so other connections take the buffers
+ **
+ **/
+void test_ciaaModbus_tcpTask_05(void)
+{
+   int32_t hModbusTcp;
+   int32_t fildes[CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1];
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size = 0;
+   int32_t loopi;
+   ciaaModbus_tcpStatsType stats;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   fildes[0] = clientFd;
+   for (loopi = 1 ; loopi < (CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1) ; loopi++)
+   {
+      fildes[loopi] = tst_connectClient();
+   }
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   /* first connections take all the buffers with a byte of a frame */
+   tst_request(buf, 0x0001);
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_TOTAL_BUFFERS ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(1, send(fildes[loopi], buf, 1, 0));
+   }
+   TEST_ASSERT_EQUAL(12, send(fildes[loopi], buf, 12, 0));
+
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* frames not completed, though data is received */
+   for (loopi = 0 ; loopi < CIAA_MODBUS_TCP_TOTAL_BUFFERS ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(1, send(fildes[loopi], &buf[1], 1, 0));
+   }
+
+   usleep(CIAA_MODBUS_TCP_FRAME_TIMEOUT * 1000);
+
+   /* last connection read once the others are closed */
+   for (loopi = 0 ; (loopi < 3) && (0 == size) ; loopi++)
+   {
+      ciaaModbus_tcpTask(hModbusTcp);
+      ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   }
+   TEST_ASSERT_EQUAL(5, size);
+
+   ciaaModbus_tcpGetStats(hModbusTcp, &stats);
+   TEST_ASSERT_EQUAL(CIAA_MODBUS_TCP_TOTAL_BUFFERS, stats.incomplete);
+   TEST_ASSERT_EQUAL(0, stats.reaped);
+
+   for (loopi = 1 ; loopi < (CIAA_MODBUS_TCP_TOTAL_BUFFERS + 1) ; loopi++)
+   {
+      close(fildes[loopi]);
+   }
+}
+
+/** \brief test connections read by the task
+ **
+ ** registered connections are read only when visited by the reactor,
+ ** connections not registered on each task
+ **
+ **/
+void test_ciaaModbus_tcpTask_06(void)
+{
+   int32_t hModbusTcp;
+   int32_t fildes;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t id;
+   uint32_t size;
+
+   tst_connect();
+
+   hModbusTcp = ciaaModbus_tcpOpen(listenFd);
+
+   /* accept connection, reactor does not report it */
+   tst_next = false;
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   TEST_ASSERT_EQUAL(12, send(clientFd, buf, tst_request(buf, 0x0001), 0));
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(0, size);
+
+   /* listening socket not pending either */
+   tst_ready = false;
+   TEST_ASSERT_FALSE(ciaaModbus_tcpPending(hModbusTcp));
+
+   /* reported by the reactor */
+   tst_ready = true;
+   tst_next = true;
+   TEST_ASSERT_TRUE(ciaaModbus_tcpPending(hModbusTcp));
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   /* connection not registered */
+   ciaaModbus_reactorAdd_IgnoreAndReturn(-1);
+   fildes = tst_connectClient();
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+
+   tst_next = false;
+   TEST_ASSERT_EQUAL(12, send(fildes, buf, tst_request(buf, 0x0002), 0));
+   usleep(10000);
+   ciaaModbus_tcpTask(hModbusTcp);
+   ciaaModbus_tcpRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(5, size);
+
+   close(fildes);
+}
+
+/** \brief test modbus tcp master
+ **
+ ** the connection is established with the first request and reused by the
+ ** next one, responses with other transaction identifier are discarded
+ **
+ **/
+void test_ciaaModbus_tcpMasterRecvMsg_01(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t response[] =
+   {
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x02, 0x03, 0x02, 0x12, 0x34,
+   };
+   uint32_t loopi;
+   uint16_t port;
+
+   port = tst_listen();
+
+   hModbusTcp = ciaaModbus_tcpMasterOpen(INADDR_LOOPBACK, port);
+   TEST_ASSERT_EQUAL(0, hModbusTcp);
+
+   for (loopi = 1 ; loopi <= 2 ; loopi++)
+   {
+      pdu[0] = 0x03;
+      ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+      ciaaModbus_tcpMasterTask(hModbusTcp);
+
+      /* connection accepted only once */
+      if (1 == loopi)
+      {
+         clientFd = accept(listenFd, NULL, NULL);
+         TEST_ASSERT_TRUE(0 <= clientFd);
+      }
+
+      ciaaModbus_tcpMasterTask(hModbusTcp);
+      usleep(10000);
+      TEST_ASSERT_EQUAL(12, recv(clientFd, buf, sizeof(buf), 0));
+      TEST_ASSERT_EQUAL(loopi, (buf[0] << 8) | buf[1]);
+      TEST_ASSERT_EQUAL_HEX8(0x02, buf[6]);
+
+      /* stale response and response */
+      response[1] = loopi - 1;
+      TEST_ASSERT_EQUAL(sizeof(response), send(clientFd, response, sizeof(response), 0));
+      response[1] = loopi;
+      TEST_ASSERT_EQUAL(sizeof(response), send(clientFd, response, sizeof(response), 0));
+
+      TEST_ASSERT_EQUAL(4, tst_masterWaitMsg(hModbusTcp, pdu));
+      TEST_ASSERT_EQUAL_HEX8(0x03, pdu[0]);
+      TEST_ASSERT_EQUAL_HEX8(0x12, pdu[2]);
+   }
+}
+
+/** \brief test modbus tcp master
+ **
+ ** a failed connection is reported with an exception and requests sent
+ ** while reconnecting fail at once
+ **
+ **/
+void test_ciaaModbus_tcpMasterRecvMsg_02(void)
+{
+   int32_t hModbusTcp;
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t id;
+   uint32_t size;
+   uint16_t port;
+
+   /* destination not listening */
+   port = tst_listen();
+   close(listenFd);
+   listenFd = -1;
+
+   hModbusTcp = ciaaModbus_tcpMasterOpen(INADDR_LOOPBACK, port);
+
+   ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+   TEST_ASSERT_EQUAL(2, tst_masterWaitMsg(hModbusTcp, pdu));
+   TEST_ASSERT_EQUAL_HEX8(0x83, pdu[0]);
+   TEST_ASSERT_EQUAL_HEX8(CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND, pdu[1]);
+
+   /* reconnecting: fail without performing task */
+   pdu[0] = 0x03;
+   ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+   ciaaModbus_tcpMasterRecvMsg(hModbusTcp, &id, pdu, &size);
+   TEST_ASSERT_EQUAL(2, size);
+   TEST_ASSERT_EQUAL(2, id);
+   TEST_ASSERT_EQUAL_HEX8(0x83, pdu[0]);
+   TEST_ASSERT_EQUAL_HEX8(CIAA_MODBUS_E_GW_PATH_UNAVAILABLE, pdu[1]);
+
+   /* after backoff connection is retried */
+   usleep(CIAA_MODBUS_TCP_MASTER_BACKOFF_MIN * 1000);
+   pdu[0] = 0x03;
+   ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+   TEST_ASSERT_EQUAL(2, tst_masterWaitMsg(hModbusTcp, pdu));
+   TEST_ASSERT_EQUAL_HEX8(CIAA_MODBUS_E_GW_TARGET_NOT_RESPOND, pdu[1]);
+}
+
+/** \brief test modbus tcp master
+ **
+ ** idle connection is closed
+ **
+ **/
+void test_ciaaModbus_tcpMasterTask_01(void)
+{
+   int32_t hModbusTcp;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t response[] =
+   {
+      0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x02, 0x03, 0x02, 0x12, 0x34,
+   };
+
+   hModbusTcp = ciaaModbus_tcpMasterOpen(INADDR_LOOPBACK, tst_listen());
+
+   ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+   clientFd = accept(listenFd, NULL, NULL);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+   usleep(10000);
+   TEST_ASSERT_EQUAL(12, recv(clientFd, buf, sizeof(buf), 0));
+   TEST_ASSERT_EQUAL(sizeof(response), send(clientFd, response, sizeof(response), 0));
+   TEST_ASSERT_EQUAL(4, tst_masterWaitMsg(hModbusTcp, pdu));
+
+   /* no traffic during idle timeout */
+   usleep(CIAA_MODBUS_TCP_MASTER_IDLE_TIMEOUT * 1000);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+
+   usleep(10000);
+   TEST_ASSERT_EQUAL(0, recv(clientFd, buf, sizeof(buf), 0));
+}
+
+/** \brief test modbus tcp master
+ **
+ ** a buffer full of stale responses does not close the connection
+ **
+ **/
+void test_ciaaModbus_tcpMasterTask_02(void)
+{
+   int32_t hModbusTcp;
+   int32_t loopi;
+   uint8_t buf[CIAAMODBUS_TCP_MAXLENGTH];
+   uint8_t pdu[CIAAMODBUS_TCP_MAXLENGTH] = {0x03, 0x00, 0x10, 0x00, 0x01};
+   uint8_t response[] =
+   {
+      0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x02, 0x03, 0x02, 0x12, 0x34,
+   };
+
+   hModbusTcp = ciaaModbus_tcpMasterOpen(INADDR_LOOPBACK, tst_listen());
+
+   ciaaModbus_tcpMasterSendMsg(hModbusTcp, 2, pdu, 5);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+   clientFd = accept(listenFd, NULL, NULL);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+   usleep(10000);
+   TEST_ASSERT_EQUAL(12, recv(clientFd, buf, sizeof(buf), 0));
+
+   /* two stale responses of max length fill the buffer */
+   memset(buf, 0, sizeof(buf));
+   buf[5] = CIAAMODBUS_TCP_MAXLENGTH - CIAAMODBUS_TCP_MBAP_LENGTH + 1;
+   buf[6] = 0x02;
+   buf[7] = 0x03;
+   for (loopi = 0 ; loopi < 2 ; loopi++)
+   {
+      TEST_ASSERT_EQUAL(sizeof(buf), send(clientFd, buf, sizeof(buf), 0));
+   }
+
+   /* full buffer read again without room */
+   usleep(10000);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+   ciaaModbus_tcpMasterTask(hModbusTcp);
+
+   /* stale responses discarded, response received on same connection */
+   TEST_ASSERT_EQUAL(sizeof(response), send(clientFd, response, sizeof(response), 0));
+   TEST_ASSERT_EQUAL(4, tst_masterWaitMsg(hModbusTcp, pdu));
+   TEST_ASSERT_EQUAL_HEX8(0x03, pdu[0]);
+   TEST_ASSERT_EQUAL_HEX8(0x12, pdu[2]);
+}
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+/*==================[end of file]============================================*/
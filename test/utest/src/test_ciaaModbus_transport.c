@@ -46,6 +46,13 @@
 #include "mock_os.h"
 #include "mock_ciaaPOSIX_stdio.h"
 #include "mock_ciaaModbus_ascii.h"
+#include "mock_ciaaModbus_tcp.h"
+#include "mock_ciaaModbus_loopback.h"
+#include "mock_ciaaModbus_shm.h"
+#include "mock_ciaaModbus_rtu.h"
+#include "mock_ciaaModbus_auto.h"
+#include "mock_ciaaModbus_serial.h"
+#include "mock_ciaaModbus_reactor.h"
 #include "os.h"
 #include "string.h"
 
@@ -84,6 +91,12 @@ static ciaaModbus_asciiSendMsgMockDataType ciaaModbus_asciiSendMsgMockData[CIAA_
 
 static int32_t hModbusAscii;
 
+static int32_t hModbusRtu;
+
+static int32_t hModbusTcp;
+
+static int32_t userTaskCount;
+
 
 
 /*==================[internal functions declaration]=========================*/
@@ -112,6 +125,42 @@ static int32_t ciaaModbus_asciiOpen_CALLBACK(int32_t fildes, int cmock_num_calls
    return ret;
 }
 
+static int32_t ciaaModbus_rtuOpen_CALLBACK(int32_t fildes, int cmock_num_calls)
+{
+   int32_t ret;
+
+   /* check correct fd */
+   if (CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU != fildes)
+   {
+      ret = -1;
+   }
+   else
+   {
+      ret = hModbusRtu;
+      hModbusRtu++;
+   }
+
+   return ret;
+}
+
+static int32_t ciaaModbus_tcpOpen_CALLBACK(int32_t fildes, int cmock_num_calls)
+{
+   int32_t ret;
+
+   /* check correct fd */
+   if (CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_TCP != fildes)
+   {
+      ret = -1;
+   }
+   else
+   {
+      ret = hModbusTcp;
+      hModbusTcp++;
+   }
+
+   return ret;
+}
+
 static void ciaaModbus_asciiTask_CALLBACK(int32_t handler, int cmock_num_calls)
 {
    ciaaModbus_asciiTaskCount[handler]++;
@@ -133,6 +182,62 @@ static void ciaaModbus_asciiRecvMsg_CALLBACK(int32_t handler, uint8_t* id, uint8
    ciaaModbus_asciiRecvMsgMockData[handler].size = size;
    ciaaModbus_asciiRecvMsgMockData[handler].cmock_num_calls = cmock_num_calls;
 }
+static int32_t user_open(int32_t fildes)
+{
+   return fildes;
+}
+
+static void user_task(int32_t handler)
+{
+   TEST_ASSERT_EQUAL(7, handler);
+   userTaskCount++;
+}
+
+static void user_recvMsg(int32_t handler, uint8_t *id, uint8_t *pdu, uint32_t *size)
+{
+   TEST_ASSERT_EQUAL(7, handler);
+   *size = 3;
+}
+
+static void user_sendMsg(int32_t handler, uint8_t id, uint8_t *pdu, uint32_t size)
+{
+   TEST_ASSERT_EQUAL(7, handler);
+   TEST_ASSERT_EQUAL(0x44, id);
+   userTaskCount++;
+}
+
+static const ciaaModbus_transportOpsType user_ops =
+{
+   user_open,
+   user_task,
+   user_recvMsg,
+   user_sendMsg,
+   NULL,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   NULL,
+};
+
+static const ciaaModbus_transportOpsType user_opsNoOpen =
+{
+   NULL,
+   user_task,
+   user_recvMsg,
+   user_sendMsg,
+   NULL,
+   CIAAMODBUS_TRANSPORT_TYPE_SLAVE,
+   NULL,
+};
+
+static const ciaaModbus_transportOpsType user_opsInvalidType =
+{
+   user_open,
+   user_task,
+   user_recvMsg,
+   user_sendMsg,
+   NULL,
+   CIAAMODBUS_TRANSPORT_TYPE_INVALID,
+   NULL,
+};
 /*==================[external functions definition]==========================*/
 /** \brief set Up function
  **
@@ -159,11 +264,25 @@ void setUp(void)
    /* set callback AsciiSendMsg */
    ciaaModbus_asciiSendMsg_StubWithCallback(ciaaModbus_asciiSendMsg_CALLBACK);
 
+   /* set callback RtuOpen */
+   ciaaModbus_rtuOpen_StubWithCallback(ciaaModbus_rtuOpen_CALLBACK);
+
+   /* set callback TcpOpen */
+   ciaaModbus_tcpOpen_StubWithCallback(ciaaModbus_tcpOpen_CALLBACK);
+
    /* init transport module */
    ciaaModbus_transportInit();
 
    /* initi modbus ascii handler count */
    hModbusAscii = 0;
+
+   /* initi modbus rtu handler count */
+   hModbusRtu = 0;
+
+   /* initi modbus tcp handler count */
+   hModbusTcp = 0;
+
+   userTaskCount = 0;
 }
 
 /** \brief tear Down function
@@ -225,10 +344,10 @@ void test_ciaaModbus_transportOpen_01(void)
 
    TEST_ASSERT_EQUAL(0, hModbusTransp[0]);
    TEST_ASSERT_EQUAL(1, hModbusTransp[1]);
-   TEST_ASSERT_EQUAL(-1, hModbusTransp[2]);
-   TEST_ASSERT_EQUAL(-1, hModbusTransp[3]);
+   TEST_ASSERT_EQUAL(2, hModbusTransp[2]);
+   TEST_ASSERT_EQUAL(3, hModbusTransp[3]);
    TEST_ASSERT_EQUAL(-1, hModbusTransp[4]);
-   TEST_ASSERT_EQUAL(-1, hModbusTransp[5]);
+   TEST_ASSERT_EQUAL(4, hModbusTransp[5]);
    TEST_ASSERT_EQUAL(-1, hModbusTransp[6]);
 }
 
@@ -272,7 +391,7 @@ void test_ciaaModbus_transportTask_01(void)
    ciaaModbus_transportTask(hModbusTransp[0]);
 
    TEST_ASSERT_NOT_EQUAL(-1, hModbusTransp[0]);
-   TEST_ASSERT_EQUAL(-1, hModbusTransp[1]);
+   TEST_ASSERT_NOT_EQUAL(-1, hModbusTransp[1]);
    TEST_ASSERT_EQUAL(-1, hModbusTransp[2]);
    TEST_ASSERT_EQUAL(1, ciaaModbus_asciiTaskCount[0]);
 }
@@ -387,6 +506,104 @@ void test_ciaaModbus_transportGetType_01(void)
    TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, type[1]);
 }
 
+/** \brief test ciaaModbus_transportTxReady
+ **
+ **/
+void test_ciaaModbus_transportTxReady_01(void)
+{
+   int32_t hModbusTransp;
+
+   hModbusTransp = ciaaModbus_transportOpen(
+            CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_ASCII,
+            CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE);
+
+   /* result of low layer transport */
+   ciaaModbus_asciiTxReady_ExpectAndReturn(0, false);
+   TEST_ASSERT_FALSE(ciaaModbus_transportTxReady(hModbusTransp));
+
+   ciaaModbus_asciiTxReady_ExpectAndReturn(0, true);
+   TEST_ASSERT_TRUE(ciaaModbus_transportTxReady(hModbusTransp));
+}
+
+/** \brief test ciaaModbus_transportPending
+ **
+ **/
+void test_ciaaModbus_transportPending_01(void)
+{
+   int32_t hModbusTransp;
+
+   hModbusTransp = ciaaModbus_transportOpen(
+            CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_ASCII,
+            CIAAMODBUS_TRANSPORT_MODE_ASCII_SLAVE);
+
+   /* result of low layer transport */
+   ciaaModbus_asciiPending_ExpectAndReturn(0, false);
+   TEST_ASSERT_FALSE(ciaaModbus_transportPending(hModbusTransp));
+
+   ciaaModbus_asciiPending_ExpectAndReturn(0, true);
+   TEST_ASSERT_TRUE(ciaaModbus_transportPending(hModbusTransp));
+}
+
+/** \brief test transport TCP slave
+ **
+ ** this function test task, receive and send message of a TCP slave
+ ** transport
+ **
+ **/
+void test_ciaaModbus_transportTcp_01(void)
+{
+   int32_t hModbusTransp;
+   uint8_t *id = (uint8_t*)0x11;
+   uint8_t *pPdu = (uint8_t*)0x22;
+   uint32_t *size = (uint32_t*)0x33;
+
+   hModbusTransp = ciaaModbus_transportOpen(
+            CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_TCP,
+            CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE);
+
+   ciaaModbus_tcpTask_Expect(0);
+   ciaaModbus_tcpRecvMsg_Expect(0, id, pPdu, size);
+   ciaaModbus_tcpSendMsg_Expect(0, 0x44, pPdu, 0x55);
+
+   ciaaModbus_transportTask(hModbusTransp);
+   ciaaModbus_transportRecvMsg(hModbusTransp, id, pPdu, size);
+   ciaaModbus_transportSendMsg(hModbusTransp, 0x44, pPdu, 0x55);
+
+   TEST_ASSERT_EQUAL(0, hModbusTransp);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, ciaaModbus_transportGetType(hModbusTransp));
+}
+
+/** \brief Test ciaaModbus_transportOpenTcpMaster
+ **
+ **/
+void test_ciaaModbus_transportTcp_02(void)
+{
+   int32_t hModbusTransp;
+   uint8_t *id = (uint8_t*)0x11;
+   uint8_t *pPdu = (uint8_t*)0x22;
+   uint32_t *size = (uint32_t*)0x33;
+
+   ciaaModbus_tcpMasterOpen_ExpectAndReturn(0x7F000001, 502, 1);
+
+   hModbusTransp = ciaaModbus_transportOpenTcpMaster(0x7F000001, 502);
+
+   ciaaModbus_tcpMasterTask_Expect(1);
+   ciaaModbus_tcpMasterRecvMsg_Expect(1, id, pPdu, size);
+   ciaaModbus_tcpMasterSendMsg_Expect(1, 0x44, pPdu, 0x55);
+
+   ciaaModbus_transportTask(hModbusTransp);
+   ciaaModbus_transportRecvMsg(hModbusTransp, id, pPdu, size);
+   ciaaModbus_transportSendMsg(hModbusTransp, 0x44, pPdu, 0x55);
+
+   TEST_ASSERT_EQUAL(0, hModbusTransp);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_MASTER, ciaaModbus_transportGetType(hModbusTransp));
+
+   /* invalid low layer */
+   ciaaModbus_tcpMasterOpen_ExpectAndReturn(0x7F000001, 502, -1);
+
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportOpenTcpMaster(0x7F000001, 502));
+}
+
 /** \brief test function GetRespTimeout
  **
  ** this function test transport get response timeout
@@ -410,6 +627,176 @@ void test_ciaaModbus_transportGetRespTimeout_01(void)
    TEST_ASSERT_EQUAL(CIAA_MODBUS_TRASNPORT_DEFAULT_TIMEOUT, timeout);
 }
 
+/** \brief test loopback modes
+ **
+ **/
+void test_ciaaModbus_transportLoopback_01(void)
+{
+   int32_t hMaster;
+   int32_t hSlave;
+
+   ciaaModbus_loopbackMasterOpen_ExpectAndReturn(1, 1);
+   ciaaModbus_loopbackSlaveOpen_ExpectAndReturn(1, 1);
+
+   hMaster = ciaaModbus_transportOpen(1, CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_MASTER);
+   hSlave = ciaaModbus_transportOpen(1, CIAAMODBUS_TRANSPORT_MODE_LOOPBACK_SLAVE);
+
+   TEST_ASSERT_NOT_EQUAL(-1, hMaster);
+   TEST_ASSERT_NOT_EQUAL(-1, hSlave);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_MASTER, ciaaModbus_transportGetType(hMaster));
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, ciaaModbus_transportGetType(hSlave));
+
+   /* each end is bound to its own operations */
+   ciaaModbus_loopbackMasterSendMsg_Expect(1, 0x11, NULL, 0);
+   ciaaModbus_loopbackSlaveSendMsg_Expect(1, 0x11, NULL, 0);
+
+   ciaaModbus_transportSendMsg(hMaster, 0x11, NULL, 0);
+   ciaaModbus_transportSendMsg(hSlave, 0x11, NULL, 0);
+}
+
+/** \brief test shared memory modes
+ **
+ **/
+void test_ciaaModbus_transportShm_01(void)
+{
+   int32_t hMaster;
+   int32_t hSlave;
+
+   ciaaModbus_shmOpen_ExpectAndReturn(3, 0);
+   ciaaModbus_shmOpen_ExpectAndReturn(4, 1);
+
+   hMaster = ciaaModbus_transportOpen(3, CIAAMODBUS_TRANSPORT_MODE_SHM_MASTER);
+   hSlave = ciaaModbus_transportOpen(4, CIAAMODBUS_TRANSPORT_MODE_SHM_SLAVE);
+
+   TEST_ASSERT_NOT_EQUAL(-1, hMaster);
+   TEST_ASSERT_NOT_EQUAL(-1, hSlave);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_MASTER, ciaaModbus_transportGetType(hMaster));
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, ciaaModbus_transportGetType(hSlave));
+
+   /* low layer handler passed */
+   ciaaModbus_shmTxReady_ExpectAndReturn(1, false);
+   TEST_ASSERT_FALSE(ciaaModbus_transportTxReady(hSlave));
+}
+
+/** \brief Test serial port with auto detection
+ **
+ **/
+void test_ciaaModbus_transportAuto_01(void)
+{
+   int32_t hSlave;
+
+   ciaaModbus_autoOpen_ExpectAndReturn(5, 0);
+
+   hSlave = ciaaModbus_transportOpen(5, CIAAMODBUS_TRANSPORT_MODE_AUTO_SLAVE);
+
+   TEST_ASSERT_NOT_EQUAL(-1, hSlave);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, ciaaModbus_transportGetType(hSlave));
+
+   /* low layer handler passed */
+   ciaaModbus_autoTask_Expect(0);
+   ciaaModbus_transportTask(hSlave);
+
+   ciaaModbus_autoTxReady_ExpectAndReturn(0, false);
+   TEST_ASSERT_FALSE(ciaaModbus_transportTxReady(hSlave));
+}
+
+/** \brief Test ciaaModbus_transportOpenSerial
+ **
+ **/
+void test_ciaaModbus_transportOpenSerial_01(void)
+{
+   ciaaModbus_serialConfigType config =
+   {
+      1200, 8, CIAAMODBUS_SERIAL_PARITY_EVEN, 1, 0, 0, true, -1,
+   };
+   int32_t hModbusTransp[4];
+
+   /* configuration not supported */
+   ciaaModbus_serialConfig_ExpectAndReturn(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU, &config, -1);
+
+   hModbusTransp[0] = ciaaModbus_transportOpenSerial(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU,
+         CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE,
+         &config);
+
+   /* not a serial mode */
+   hModbusTransp[1] = ciaaModbus_transportOpenSerial(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_TCP,
+         CIAAMODBUS_TRANSPORT_MODE_TCP_SLAVE,
+         &config);
+
+   /* ciaaPOSIX file descriptor not registered, baud rate passed to rtu */
+   ciaaModbus_serialConfig_ExpectAndReturn(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU, &config, 0);
+   ciaaModbus_rtuSetBaudRate_Expect(0, 1200);
+
+   hModbusTransp[2] = ciaaModbus_transportOpenSerial(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU,
+         CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE,
+         &config);
+
+   /* file descriptor of the host registered and checked by rtu */
+   config.hostFd = 9;
+   ciaaModbus_serialConfig_ExpectAndReturn(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU, &config, 0);
+   ciaaModbus_reactorAdd_ExpectAndReturn(9, 0);
+   ciaaModbus_rtuSetHostFd_Expect(1, 9);
+   ciaaModbus_rtuSetBaudRate_Expect(1, 1200);
+
+   hModbusTransp[3] = ciaaModbus_transportOpenSerial(
+         CIAA_MODBUS_TRASNPORT_FIL_DES_MODBUS_RTU,
+         CIAAMODBUS_TRANSPORT_MODE_RTU_SLAVE,
+         &config);
+
+   TEST_ASSERT_EQUAL(-1, hModbusTransp[0]);
+   TEST_ASSERT_EQUAL(-1, hModbusTransp[1]);
+   TEST_ASSERT_EQUAL(0, hModbusTransp[2]);
+   TEST_ASSERT_EQUAL(1, hModbusTransp[3]);
+}
+
+/** \brief Test ciaaModbus_transportRegister
+ **
+ **/
+void test_ciaaModbus_transportRegister_01(void)
+{
+   int32_t mode;
+   int32_t hModbusTransp;
+   uint32_t size = 0;
+
+   /* invalid operations */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportRegister(NULL));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportRegister(&user_opsNoOpen));
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportRegister(&user_opsInvalidType));
+
+   mode = ciaaModbus_transportRegister(&user_ops);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_MODE_USER, mode);
+
+   /* no more modes available */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportRegister(&user_ops));
+
+   hModbusTransp = ciaaModbus_transportOpen(7, mode);
+   TEST_ASSERT_EQUAL(0, hModbusTransp);
+   TEST_ASSERT_EQUAL(CIAAMODBUS_TRANSPORT_TYPE_SLAVE, ciaaModbus_transportGetType(hModbusTransp));
+
+   ciaaModbus_transportTask(hModbusTransp);
+   ciaaModbus_transportRecvMsg(hModbusTransp, NULL, NULL, &size);
+   ciaaModbus_transportSendMsg(hModbusTransp, 0x44, NULL, 0);
+
+   /* always ready and with work if not provided */
+   TEST_ASSERT_TRUE(ciaaModbus_transportTxReady(hModbusTransp));
+   TEST_ASSERT_TRUE(ciaaModbus_transportPending(hModbusTransp));
+
+   TEST_ASSERT_EQUAL(2, userTaskCount);
+   TEST_ASSERT_EQUAL(3, size);
+
+   /* open fails if low layer fails */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportOpen(-1, mode));
+
+   /* mode not registered */
+   TEST_ASSERT_EQUAL(-1, ciaaModbus_transportOpen(7, mode + 1));
+}
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 /*==================[end of file]============================================*/